@@ -108,6 +108,12 @@ module Common =
     let UC_QUERY_PAGE_SIZE = 2
     let UC_QUERY_ARCH = 3
     let UC_QUERY_TIMEOUT = 4
+    let UC_QUERY_TB_REUSED = 5
+    let UC_QUERY_TB_TRANSLATED = 6
+    let UC_QUERY_TIMEOUT_PRECISION = 7
+    let UC_QUERY_TB_CACHE_SIZE = 8
+    let UC_QUERY_TB_CACHE_USED = 9
+    let UC_QUERY_TB_FLUSHES = 10
 
     let UC_PROT_NONE = 0
     let UC_PROT_READ = 1
@@ -103,6 +103,12 @@ const (
 	QUERY_PAGE_SIZE = 2
 	QUERY_ARCH = 3
 	QUERY_TIMEOUT = 4
+	QUERY_TB_REUSED = 5
+	QUERY_TB_TRANSLATED = 6
+	QUERY_TIMEOUT_PRECISION = 7
+	QUERY_TB_CACHE_SIZE = 8
+	QUERY_TB_CACHE_USED = 9
+	QUERY_TB_FLUSHES = 10
 
 	PROT_NONE = 0
 	PROT_READ = 1
@@ -105,6 +105,12 @@ public interface UnicornConst {
    public static final int UC_QUERY_PAGE_SIZE = 2;
    public static final int UC_QUERY_ARCH = 3;
    public static final int UC_QUERY_TIMEOUT = 4;
+   public static final int UC_QUERY_TB_REUSED = 5;
+   public static final int UC_QUERY_TB_TRANSLATED = 6;
+   public static final int UC_QUERY_TIMEOUT_PRECISION = 7;
+   public static final int UC_QUERY_TB_CACHE_SIZE = 8;
+   public static final int UC_QUERY_TB_CACHE_USED = 9;
+   public static final int UC_QUERY_TB_FLUSHES = 10;
 
    public static final int UC_PROT_NONE = 0;
    public static final int UC_PROT_READ = 1;
@@ -103,6 +103,12 @@ module UnicornEngine
 	UC_QUERY_PAGE_SIZE = 2
 	UC_QUERY_ARCH = 3
 	UC_QUERY_TIMEOUT = 4
+	UC_QUERY_TB_REUSED = 5
+	UC_QUERY_TB_TRANSLATED = 6
+	UC_QUERY_TIMEOUT_PRECISION = 7
+	UC_QUERY_TB_CACHE_SIZE = 8
+	UC_QUERY_TB_CACHE_USED = 9
+	UC_QUERY_TB_FLUSHES = 10
 
 	UC_PROT_NONE = 0
 	UC_PROT_READ = 1
@@ -26,13 +26,15 @@ typedef struct RAMBlock {
     ram_addr_t length;
     uint32_t flags;
     char idstr[256];
-    /* Reads can take either the iothread or the ramlist lock.
-     * Writes must take both locks.
-     */
-    QTAILQ_ENTRY(RAMBlock) next;
     int fd;
 } RAMBlock;
 
+/* Free range of RAM offsets between two blocks */
+typedef struct RAMGap {
+    ram_addr_t offset;
+    ram_addr_t length;
+} RAMGap;
+
 typedef struct {
     MemoryRegion *mr;
     void *buffer;
@@ -44,7 +46,19 @@ typedef struct RAMList {
     /* Protected by the iothread lock.  */
     unsigned long *dirty_memory[DIRTY_MEMORY_NUM];
     RAMBlock *mru_block;
-    QTAILQ_HEAD(, RAMBlock) blocks;
+    /* The blocks sorted by offset, and the same blocks sorted by host
+     * address.  Offsets past the last block are free.
+     */
+    RAMBlock **blocks;
+    RAMBlock **blocks_by_host;
+    uint32_t block_count;
+    uint32_t block_capacity;
+    /* Free ranges before and between the blocks, sorted by length then
+     * offset, so that the best fit for a new block is found by bisection.
+     */
+    RAMGap *gaps;
+    uint32_t gap_count;
+    uint32_t gap_capacity;
     uint32_t version;
 } RAMList;
 
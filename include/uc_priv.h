@@ -75,6 +75,47 @@ typedef void (*uc_mem_unmap_t)(struct uc_struct*, MemoryRegion *mr);
 
 typedef void (*uc_readonly_mem_t)(MemoryRegion *mr, bool readonly);
 
+// the RAM region maps host memory it was given, as by uc_mem_map_ptr()
+typedef bool (*uc_memory_region_is_prealloc_t)(MemoryRegion *mr);
+
+// copy bytes of a RAM region from or to the host, at an offset in the region
+typedef void (*uc_read_ram_t)(struct uc_struct *uc, MemoryRegion *mr, uint64_t offset, uint8_t *buf, size_t len);
+typedef void (*uc_write_ram_t)(struct uc_struct *uc, MemoryRegion *mr, uint64_t offset, const uint8_t *buf, size_t len);
+
+// host pointer to the RAM region at an offset in it, and the length from there
+// it is contiguous for, up to *len
+typedef void *(*uc_get_ram_ptr_t)(struct uc_struct *uc, MemoryRegion *mr, uint64_t offset, size_t *len);
+
+// bytes of a RAM region at an offset in it were written by the host
+typedef void (*uc_ram_written_t)(struct uc_struct *uc, MemoryRegion *mr, uint64_t offset, size_t len);
+
+// open or close a batch of changes to the memory map
+typedef void (*uc_memory_batch_t)(struct uc_struct *uc, bool begin);
+
+// invalidate translated blocks overlapping guest memory [start, start + len)
+typedef void (*uc_invalidate_tb_t)(struct uc_struct *uc, uint64_t start, size_t len);
+
+// copy a memory region into a snapshot and track its pages written from now on
+typedef void (*uc_snapshot_save_t)(struct uc_struct *uc, MemoryRegion *mr, uint8_t *data);
+
+// copy back the written (or all, or the given) pages of a memory range from a snapshot
+typedef void (*uc_snapshot_reset_t)(struct uc_struct *uc, MemoryRegion *mr, uint64_t address, size_t len, const uint8_t *data, bool all, const uint8_t *pages);
+
+// start or stop logging the pages written in a memory range
+typedef void (*uc_dirty_log_enable_t)(struct uc_struct *uc, MemoryRegion *mr, uint64_t address, size_t len, bool enable);
+
+// set the bits of the pages written in a memory range, and optionally clear them
+typedef void (*uc_dirty_log_sync_t)(struct uc_struct *uc, MemoryRegion *mr, uint64_t address, size_t len, uint8_t *bitmap, uint64_t bit, bool clear);
+
+// get or set the pages of a memory range written since it was mapped from a file
+typedef void (*uc_file_written_t)(struct uc_struct *uc, MemoryRegion *mr, uint64_t address, size_t len, uint8_t *bitmap, uint64_t bit, bool get);
+
+// flush the translation cache and reallocate it with the given size
+typedef bool (*uc_tb_cache_resize_t)(struct uc_struct *uc, size_t size);
+
+// size and use of the translation cache, in bytes, and number of flushes
+typedef void (*uc_tb_cache_query_t)(struct uc_struct *uc, size_t *size, size_t *used, size_t *flushes);
+
 // which interrupt should make emulation stop?
 typedef bool (*uc_args_int_t)(int intno);
 
@@ -116,9 +157,53 @@ enum uc_hook_idx {
     UC_HOOK_MAX,
 };
 
+// memory hook types called on data accesses
+#define UC_HOOK_MEM_DATA_MASK (UC_HOOK_MEM_READ_UNMAPPED | UC_HOOK_MEM_WRITE_UNMAPPED | \
+        UC_HOOK_MEM_READ_PROT | UC_HOOK_MEM_WRITE_PROT | UC_HOOK_MEM_READ | \
+        UC_HOOK_MEM_WRITE | UC_HOOK_MEM_READ_AFTER)
+
+// hook types checked while translating code: adding or removing such hooks
+// invalidates the translation cache
+#define UC_HOOK_TB_MASK (UC_HOOK_CODE | UC_HOOK_BLOCK | UC_HOOK_MEM_FETCH | \
+        UC_HOOK_MEM_DATA_MASK)
+
+// Hooks of one type indexed by address: the address space is cut into
+// segments at the bounds of the hooks, and each segment lists the hooks
+// covering it, in the order of the hook list. Built on first use after
+// a hook of this type is added or deleted.
+struct hook_table {
+    uint32_t count;         // number of segments
+    uint64_t *start;        // start address of each segment, sorted, start[0] == 0
+    uint32_t *first;        // index in hooks of the first hook of each segment, count + 1 entries
+    struct hook **hooks;    // hooks of all segments
+};
+
+// Walk over the hooks of one type whose range holds an address: those of
+// its segment in the table, or those of the list when the table could not
+// be built for lack of memory.
+struct hook_iter {
+    struct hook **cur, **end;   // hooks of the segment left to walk
+    struct list_item *item;     // hook of the list to look at next
+    uint64_t addr;
+};
+
+void hook_iter_start(struct uc_struct *uc, int idx, uint64_t addr, struct hook_iter *it);
+struct hook *hook_iter_next_item(struct hook_iter *it);
+
+// next hook, NULL after the last one
+static inline struct hook *hook_iter_next(struct hook_iter *it)
+{
+    if (it->cur < it->end)
+        return *it->cur++;
+    return it->item != NULL ? hook_iter_next_item(it) : NULL;
+}
+
 #define HOOK_FOREACH_VAR_DECLARE                          \
     struct list_item *cur
 
+#define HOOK_FOREACH_ADDR_VAR_DECLARE                     \
+    struct hook_iter hook_it
+
 // for loop macro to loop over hook lists
 #define HOOK_FOREACH(uc, hh, idx)                         \
     for (                                                 \
@@ -126,22 +211,22 @@ enum uc_hook_idx {
         cur != NULL && ((hh) = (struct hook *)cur->data); \
         cur = cur->next)
 
-// if statement to check hook bounds
-#define HOOK_BOUND_CHECK(hh, addr)                  \
-    ((((addr) >= (hh)->begin && (addr) <= (hh)->end) \
-        || (hh)->begin > (hh)->end) && !((hh)->to_delete))
+// for loop macro to loop over the hooks whose range holds this address
+#define HOOK_FOREACH_ADDR(uc, hh, idx, addr)                              \
+    for (                                                                 \
+        hook_iter_start((uc), idx##_IDX, (addr), &hook_it);               \
+        ((hh) = hook_iter_next(&hook_it)) != NULL;                        \
+        )
 
 #define HOOK_EXISTS(uc, idx) ((uc)->hook[idx##_IDX].head != NULL)
-#define HOOK_EXISTS_BOUNDED(uc, idx, addr) _hook_exists_bounded((uc)->hook[idx##_IDX].head, addr)
+#define HOOK_EXISTS_BOUNDED(uc, idx, addr) _hook_exists_bounded(uc, idx##_IDX, addr)
 
-static inline bool _hook_exists_bounded(struct list_item *cur, uint64_t addr)
+static inline bool _hook_exists_bounded(struct uc_struct *uc, int idx, uint64_t addr)
 {
-    while (cur != NULL) {
-        if (HOOK_BOUND_CHECK((struct hook *)cur->data, addr))
-            return true;
-        cur = cur->next;
-    }
-    return false;
+    struct hook_iter it;
+
+    hook_iter_start(uc, idx, addr, &it);
+    return hook_iter_next(&it) != NULL;
 }
 
 //relloc increment, KEEP THIS A POWER OF 2!
@@ -172,7 +257,24 @@ struct uc_struct {
     uc_args_uc_ram_size_ptr_t memory_map_ptr;
     uc_mem_unmap_t memory_unmap;
     uc_readonly_mem_t readonly_mem;
+    uc_memory_region_is_prealloc_t memory_region_is_prealloc;
+    uc_read_ram_t read_ram;
+    uc_write_ram_t write_ram;   // whatever the protection of the region
+    uc_get_ram_ptr_t get_ram_ptr;
+    uc_ram_written_t ram_written;
+    uc_memory_batch_t memory_batch;
     uc_mem_redirect_t mem_redirect;
+    uc_args_uc_t tb_flush;  // drop the whole translation cache
+    uc_invalidate_tb_t uc_invalidate_tb;
+    uc_args_uc_t uc_tlb_flush;  // drop all TLB entries of the CPU
+    uc_snapshot_save_t snapshot_save;
+    uc_snapshot_reset_t snapshot_reset;
+    uc_dirty_log_enable_t dirty_log_enable;
+    uc_dirty_log_sync_t dirty_log_sync;
+    uc_file_written_t file_written;
+    uc_tb_cache_resize_t tb_cache_resize;
+    uc_tb_cache_query_t tb_cache_query;
+    uc_args_uc_t context_copied;    // fix up registers copied from another engine
     // TODO: remove current_cpu, as it's a flag for something else ("cpu running"?)
     CPUState *cpu, *current_cpu;
 
@@ -216,13 +318,13 @@ struct uc_struct {
 
     // linked lists containing hooks per type
     struct list hook[UC_HOOK_MAX];
+    struct hook_table *hook_table[UC_HOOK_MAX]; // address index of hook[], NULL until used
+    struct list hook_tables_retired;    // replaced indexes, freed after emulation
     struct list hooks_to_del;
 
-    // hook to count number of instructions for uc_emu_start()
-    uc_hook count_hook;
-
     size_t emu_counter; // current counter of uc_emu_start()
     size_t emu_count; // save counter of uc_emu_start()
+    bool icount;    // translated code counts instructions against emu_count
 
     uint64_t block_addr;    // save the last block address we hooked
 
@@ -233,8 +335,9 @@ struct uc_struct {
     bool quit_request;  // request to quit the current TB, but continue to emulate - for uc_mem_protect()
     bool emulation_done;  // emulation is done by uc_emu_start()
     bool timed_out;     // emulation timed out, that can retrieve via uc_query(UC_QUERY_TIMEOUT)
-    QemuThread timer;   // timer for emulation timeout
-    uint64_t timeout;   // timeout for uc_emu_start()
+    uint64_t timeout;   // timeout for uc_emu_start(), in nanoseconds
+    int64_t timeout_deadline;   // get_clock() value when uc_emu_start() times out
+    uint64_t timeout_overrun;   // how late the last timeout stopped emulation
 
     uint64_t invalid_addr;  // invalid address to be accessed
     int invalid_error;  // invalid memory code: 1 = READ, 2 = WRITE, 3 = CODE
@@ -246,17 +349,61 @@ struct uc_struct {
     // full TCG cache leads to middle-block break in the last translation?
     bool block_full;
     int size_arg;     // what tcg arg slot do we need to update with the size of the block?
-    MemoryRegion **mapped_blocks;
+    // translation cache is kept across uc_emu_start() calls
+    bool tb_flush_pending;  // hooks changed, cached code no longer matches them
+    bool mmio_mapped;       // uc_mmio_map() was used
+    bool tb_partial;    // some blocks of this run were cut short (tb->partial)
+    size_t tb_reused;   // number of lookups served by the translation cache
+    size_t tb_translated;   // number of blocks (re)translated
+    size_t tb_cache_max;    // size the translation cache grows to when full
+    size_t tb_cache_resize_to;  // size to reallocate the translation cache to, 0 if none
+    MemoryRegion **mapped_blocks;   // sorted by address
     uint32_t mapped_block_count;
     uint32_t mapped_block_cache_index;
+    MemoryRegion **unmapped_blocks; // unmapped in the open batch, freed on its commit
+    uint32_t unmapped_block_count;
+    uint32_t mem_batch_depth;   // nesting of uc_mem_batch_begin()
+    bool mem_batch_tlb_flush;   // flush the TLB on commit
+    struct uc_mapped_file *mapped_files;    // host memory of uc_mem_map_file()
+    uint32_t mapped_file_count;
     void *qemu_thread_data; // to support cross compile to Windows (qemu-thread-win32.c)
     uint32_t target_page_size;
     uint32_t target_page_align;
     uint64_t next_pc;   // save next PC for some special cases
     bool hook_insert;	// insert new hook at begin of the hook list (append by default)
     struct list saved_contexts; // The contexts saved by this uc_struct.
+    struct list snapshots;  // The snapshots taken by this uc_struct.
+    struct uc_snapshot *snapshot;   // snapshot the written pages are tracked against
+    struct uc_dirty_range *dirty_ranges;    // sorted ranges logged by uc_mem_dirty_log_start()
+    uint32_t dirty_range_count;
+
+    // uc_clone()
+    struct uc_struct *clone_template;   // engine this one was cloned from
+    struct list clones;         // engines cloned from this one, not closed yet
+    struct list clones_spare;   // closed clones, handed out again by uc_clone()
+    uint32_t layout_gen;    // changes of the memory map, of the hooks, of the snapshot tracked,
+                            // of the dirty logging and of the translation cache size
+    uint32_t content_gen;   // changes of the memory content
+    uint32_t clone_layout_gen;      // layout_gen when last reset from clone_template
+    uint32_t template_layout_gen;   // clone_template->layout_gen at that time
+    uint32_t template_content_gen;  // clone_template->content_gen at that time
 };
 
+// true if a memory hook or an MMIO callback may stop emulation during a
+// data access, translated code then checks for exit requests after each one
+static inline bool uc_mem_access_can_stop(struct uc_struct *uc)
+{
+    int i;
+
+    if (uc->mmio_mapped)
+        return true;
+    for (i = 0; i < UC_HOOK_MAX; i++) {
+        if (((1 << i) & UC_HOOK_MEM_DATA_MASK) && uc->hook[i].head != NULL)
+            return true;
+    }
+    return false;
+}
+
 // Metadata stub for the variable-size cpu context used with uc_context_*()
 // We also save cpu->jmp_env, so emulation can be reentrant
 struct uc_context {
@@ -266,8 +413,41 @@ struct uc_context {
    char data[0]; // context + cpu->jmp_env
 };
 
+// Range of guest memory whose written pages are logged, used with uc_mem_dirty_log_*()
+struct uc_dirty_range {
+    uint64_t begin; // begin address of the range (inclusive)
+    uint64_t end;   // end address of the range (exclusive)
+};
+
+// Host memory mapped from a file by uc_mem_map_file(), unmapped when no
+// region is left in it
+struct uc_mapped_file {
+    uint8_t *host;      // begin of the mapping
+    size_t size;        // size of the mapping
+    int fd;             // duplicate of the file descriptor, for clones to map it again
+    uint64_t offset;    // offset in the file of the begin of the mapping
+};
+
+// Copy of a mapped RAM region, used with uc_snapshot_*()
+struct uc_snapshot_region {
+    uint64_t begin; // begin address of the region (inclusive)
+    uint64_t end;   // end address of the region (inclusive)
+    uint32_t perms; // memory permissions of the region
+    uint8_t *page_perms;    // permissions of each page, NULL if all have perms
+    uint8_t *data;  // content of the region
+};
+
+// Registers and memory saved by uc_snapshot_take()
+struct uc_snapshot {
+    struct uc_struct *uc;   // the uc_struct which takes this snapshot
+    uc_context *context;
+    uint32_t region_count;
+    struct uc_snapshot_region *regions;
+};
+
 // check if this address is mapped in (via uc_mem_map())
 MemoryRegion *memory_mapping(struct uc_struct* uc, uint64_t address);
+uint32_t bsearch_mapped_blocks(const struct uc_struct *uc, uint64_t address);
 
 #endif
 /* vim: set ts=4 noet:  */
@@ -355,12 +355,22 @@ typedef enum uc_query_type {
     UC_QUERY_PAGE_SIZE, // query pagesize of engine
     UC_QUERY_ARCH,  // query architecture of engine (for ARM to query Thumb mode)
     UC_QUERY_TIMEOUT,  // query if emulation stops due to timeout (indicated if result = True)
+    UC_QUERY_TB_REUSED, // query number of blocks served by the translation cache
+    UC_QUERY_TB_TRANSLATED, // query number of blocks translated (or retranslated)
+    UC_QUERY_TIMEOUT_PRECISION, // query how late (in microseconds) the last timeout stopped emulation
+    UC_QUERY_TB_CACHE_SIZE, // query size (in bytes) of the translation cache
+    UC_QUERY_TB_CACHE_USED, // query how many bytes of the translation cache hold translated code
+    UC_QUERY_TB_FLUSHES,    // query number of times the translation cache was flushed
 } uc_query_type;
 
 // Opaque storage for CPU context, used with uc_context_*()
 struct uc_context;
 typedef struct uc_context uc_context;
 
+// Opaque storage for CPU context and memory, used with uc_snapshot_*()
+struct uc_snapshot;
+typedef struct uc_snapshot uc_snapshot;
+
 /*
  Return combined API version & major and minor version numbers.
 
@@ -422,6 +432,40 @@ uc_err uc_open(uc_arch arch, uc_mode mode, uc_engine **uc);
 UNICORN_EXPORT
 uc_err uc_close(uc_engine *uc);
 
+/*
+ Create a new engine from another one: same architecture and mode, same
+ memory mappings with a copy of their content, same CPU registers and same
+ hooks. The two engines run independently from then on.
+
+ Clones passed to uc_close() are kept by @uc and handed out again by the next
+ uc_clone(): only the pages written since they were cloned are copied back
+ from @uc, as long as the memory mappings, the hooks, the dirty logging and
+ the translation cache size of both engines did not change in between. This
+ makes uc_clone() and uc_close() much cheaper than uc_open() and uc_mem_map()
+ for running many emulations from the same initial state, e.g. one per
+ fuzzing input.
+
+ Memory of uc_mem_map_ptr() is copied like other memory, and copied in full
+ each time a clone is handed out. Memory of uc_mem_map_file() is mapped from
+ the file again, and only the pages written are copied. MMIO regions of the
+ clone call the same callbacks with the same user data, and have the same
+ permissions. @uc must not be emulating, and must not be used from another
+ thread at the same time.
+
+ @uc keeps lists of its clones without any lock: uc_clone() of @uc and
+ uc_close() of @uc or of any of its clones must all be called from one
+ thread, or under one lock held by the caller. Clones may emulate on other
+ threads in between.
+
+ @uc: handle returned by uc_open() or uc_clone()
+ @result: pointer to uc_engine, which will be updated at return time
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_clone(uc_engine *uc, uc_engine **result);
+
 /*
  Query internal status of engine.
 
@@ -435,6 +479,30 @@ uc_err uc_close(uc_engine *uc);
 UNICORN_EXPORT
 uc_err uc_query(uc_engine *uc, uc_query_type type, size_t *result);
 
+/*
+ Set the size of the translation cache, which holds the code translated from
+ the emulated instructions.
+
+ Each engine starts with a small cache, which doubles each time it fills up
+ until it reaches @max_size bytes (8MB by default). From then on, the whole
+ cache is flushed each time it fills up: engines running a lot of code should
+ raise @max_size, while many engines running little code each can lower it.
+ See UC_QUERY_TB_CACHE_SIZE, UC_QUERY_TB_CACHE_USED and UC_QUERY_TB_FLUSHES.
+
+ The cache is flushed and reallocated with @size bytes at the next
+ uc_emu_start(). Sizes are rounded up to 1MB at least, and down to the
+ maximum the host supports.
+
+ @uc: handle returned by uc_open()
+ @size: size of the cache in bytes, or 0 to keep the current one
+ @max_size: size in bytes the cache may grow to, at least @size
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_tb_cache_resize(uc_engine *uc, size_t size, size_t max_size);
+
 /*
  Report the last error number when some API function fails.
  Like glibc's errno, uc_errno might not retain its old value once accessed.
@@ -543,6 +611,49 @@ uc_err uc_mem_write(uc_engine *uc, uint64_t address, const void *bytes, size_t s
 UNICORN_EXPORT
 uc_err uc_mem_read(uc_engine *uc, uint64_t address, void *bytes, size_t size);
 
+/*
+ Get a pointer to access a range of bytes in memory in place, without copying
+ them with uc_mem_read() or uc_mem_write().
+
+ The range must start in a region mapped by uc_mem_map() or uc_mem_map_ptr().
+ Only the part of it in that region is returned, as the next region need not
+ follow it in the host memory.
+
+ The pointer stays valid until any part of the region is unmapped, or the
+ engine is closed. The bytes may be written through it whatever the
+ protection of the region, but the emulation does not see it: call
+ uc_mem_written() on the bytes written before emulating again.
+
+ @uc: handle returned by uc_open()
+ @address: starting memory address of the bytes.
+ @size: size of the range of bytes.
+ @ptr: pointer to a variable receiving the host address of the bytes.
+ @len: pointer to a variable receiving the number of bytes, from @address and
+   at most @size, that may be accessed through *@ptr.
+
+ @return UC_ERR_OK on success, UC_ERR_READ_UNMAPPED if @address is not mapped,
+   UC_ERR_ARG if @size is 0 or @address is in a MMIO region, or other value on
+   failure (refer to uc_err enum for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_get_ptr(uc_engine *uc, uint64_t address, size_t size, void **ptr, size_t *len);
+
+/*
+ Tell the emulation that a range of bytes in memory was written through a
+ pointer from uc_mem_get_ptr(), as uc_mem_write() would: the code translated
+ from these bytes is dropped, and their pages are marked as written for
+ uc_mem_dirty_log_get(), uc_snapshot_restore() and uc_clone().
+
+ @uc: handle returned by uc_open()
+ @address: starting memory address of the bytes written.
+ @size: size of the range of bytes written.
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_written(uc_engine *uc, uint64_t address, size_t size);
+
 /*
  Emulate machine code in a specific duration of time.
 
@@ -551,6 +662,8 @@ uc_err uc_mem_read(uc_engine *uc, uint64_t address, void *bytes, size_t size);
  @until: address where emulation stops (i.e. when this address is hit)
  @timeout: duration to emulate the code (in microseconds). When this value is 0,
         we will emulate the code in infinite time, until the code is finished.
+        The deadline is checked every few thousand instructions, so emulation
+        stops slightly late (see UC_QUERY_TIMEOUT_PRECISION).
  @count: the number of instructions to be emulated. When this value is 0,
         we will emulate all the code available, until the code is finished.
   
@@ -664,6 +777,37 @@ uc_err uc_mem_map(uc_engine *uc, uint64_t address, size_t size, uint32_t perms);
 UNICORN_EXPORT
 uc_err uc_mem_map_ptr(uc_engine *uc, uint64_t address, size_t size, uint32_t perms, void *ptr);
 
+/*
+ Map a range of a file in for emulation.
+ This API adds a memory region backed by the file, privately: its pages are
+ read from the file on first access, and the writes to them are kept in the
+ engine, never written back. Engines mapping the same file share the pages
+ they have not written. The memory past the end of the file reads as zeros.
+
+ The file may be closed once this returns, but must not change while mapped:
+ clones map it again and copy only the pages written. The host memory is
+ released when the region is unmapped, or the engine closed.
+
+ @uc: handle returned by uc_open()
+ @address: starting address of the new memory region to be mapped in.
+    This address must be aligned to 4KB, or this will return with UC_ERR_ARG error.
+ @size: size of the new memory region to be mapped in.
+    This size must be a multiple of 4KB, or this will return with UC_ERR_ARG error.
+ @perms: Permissions for the newly mapped region.
+    This must be some combination of UC_PROT_READ | UC_PROT_WRITE | UC_PROT_EXEC,
+    or this will return with UC_ERR_ARG error.
+ @fd: file descriptor of the file, open for reading.
+ @offset: offset in the file of the first byte of the region.
+    This offset must be a multiple of the page size of the host, or this will
+    return with UC_ERR_ARG error.
+
+ @return UC_ERR_OK on success, UC_ERR_ARG if the file cannot be mapped (or on
+   Windows, where this is not supported), or other value on failure (refer to
+   uc_err enum for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_map_file(uc_engine *uc, uint64_t address, size_t size, uint32_t perms, int fd, uint64_t offset);
+
 /*
  Unmap a region of emulation memory.
  This API deletes a memory mapping from the emulation memory space.
@@ -683,6 +827,9 @@ uc_err uc_mem_unmap(uc_engine *uc, uint64_t address, size_t size);
 /*
  Set memory permissions for emulation memory.
  This API changes permissions on an existing memory region.
+ Each page of a region mapped by uc_mem_map() or uc_mem_map_ptr() has its own
+ permissions, so protecting part of it neither splits nor copies it. An MMIO
+ region can only be protected as a whole.
 
  @uc: handle returned by uc_open()
  @address: starting address of the memory region to be modified.
@@ -699,11 +846,45 @@ uc_err uc_mem_unmap(uc_engine *uc, uint64_t address, size_t size);
 UNICORN_EXPORT
 uc_err uc_mem_protect(uc_engine *uc, uint64_t address, size_t size, uint32_t perms);
 
+/*
+ Start a batch of changes to the memory map.
+ Each uc_mem_map(), uc_mem_map_ptr(), uc_mmio_map(), uc_mem_unmap() and
+ uc_mem_protect() rebuilds the view of all the mapped regions that the
+ emulated CPU accesses memory through, and flushes its TLB. Between this
+ call and uc_mem_batch_commit(), this is done only once, on commit, so
+ that an image with many sections is loaded in linear time.
+
+ Within a batch, uc_mem_read(), uc_mem_write() and uc_mem_regions() see the
+ changes already made. uc_emu_start() and the accesses to MMIO regions
+ apply them first, leaving the batch open.
+
+ Batches may be nested: the changes are applied on the last commit.
+
+ @uc: handle returned by uc_open()
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_batch_begin(uc_engine *uc);
+
+/*
+ Apply the changes to the memory map made since uc_mem_batch_begin().
+
+ @uc: handle returned by uc_open()
+
+ @return UC_ERR_OK on success, UC_ERR_ARG if no batch is open, or other
+   value on failure (refer to uc_err enum for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_batch_commit(uc_engine *uc);
+
 /*
  Retrieve all memory regions mapped by uc_mem_map() and uc_mem_map_ptr()
  This API allocates memory for @regions, and user must free this memory later
  by uc_free() to avoid leaking memory.
- NOTE: memory regions may be split by uc_mem_unmap()
+ NOTE: memory regions may be split by uc_mem_unmap(), and the pages of a
+ region with permissions of their own are listed as regions apart
 
  @uc: handle returned by uc_open()
  @regions: pointer to an array of uc_mem_region struct. This is allocated by
@@ -730,6 +911,10 @@ uc_err uc_mem_regions(uc_engine *uc, uc_mem_region **regions, uint32_t *count);
  @user_data: user-defined data. This will be passed to callback function in its
       last argument @user_data
 
+ NOTE: fewer MMIO regions than the page size less 4 (see UC_QUERY_PAGE_SIZE)
+ can be mapped at once; past that, this returns UC_ERR_NOMEM. The number of
+ RAM regions is not limited.
+
  @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
    for detailed error).
 */
@@ -819,6 +1004,114 @@ size_t uc_context_size(uc_engine *uc);
 UNICORN_EXPORT
 uc_err uc_context_free(uc_context *context);
 
+/*
+ Take a snapshot of the CPU context and of the content of all memory regions
+ mapped with uc_mem_map() and uc_mem_map_ptr(). Regions mapped with
+ uc_mmio_map() are not saved.
+
+ From then on, the engine tracks the pages written by the guest or by
+ uc_mem_write(), so that uc_snapshot_restore() copies back only these pages.
+ Only the last snapshot taken or restored is tracked: restoring any other
+ one copies back all its memory. Writes done directly to the memory of
+ uc_mem_map_ptr() are not tracked.
+
+ @uc: handle returned by uc_open()
+ @snapshot: pointer to a uc_snapshot*. This will be updated with the pointer to
+   the new snapshot on successful return of this function.
+   Later, this allocated memory must be freed with uc_snapshot_free().
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_snapshot_take(uc_engine *uc, uc_snapshot **snapshot);
+
+/*
+ Roll the CPU context, the memory content and the permissions of the saved
+ regions back to a snapshot taken by uc_snapshot_take(). Regions mapped since
+ the snapshot are left as they are.
+
+ @uc: handle returned by uc_open()
+ @snapshot: handle returned by uc_snapshot_take()
+
+ @return UC_ERR_OK on success, UC_ERR_MAP if a saved region is not mapped
+   anymore, or other value on failure (refer to uc_err enum for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_snapshot_restore(uc_engine *uc, uc_snapshot *snapshot);
+
+/*
+  Free the snapshot taken by uc_snapshot_take().
+
+  @snapshot: handle returned by uc_snapshot_take()
+
+  @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_snapshot_free(uc_snapshot *snapshot);
+
+/*
+ Start logging the pages written in a range of memory. The first write to
+ each page since the logging started or was last cleared marks the page in
+ the log; later writes to it run at full speed. Writes by the guest and by
+ uc_mem_write() are logged. Writes done directly to the memory of
+ uc_mem_map_ptr() are not.
+
+ Logging a range already logged clears its log. The range stays logged when
+ memory in it is unmapped or mapped again: pages mapped since the last clear,
+ including those of regions split by uc_mem_protect() or uc_mem_unmap(), are
+ reported as written. Regions mapped with uc_mmio_map() are not logged.
+
+ @uc: handle returned by uc_open()
+ @address: starting address of the range. This must be aligned to the page
+   size (see UC_QUERY_PAGE_SIZE).
+ @size: size of the range. This must be a multiple of the page size.
+
+ @return UC_ERR_OK on success, UC_ERR_ARG if the range is not aligned,
+   UC_ERR_NOMEM if it is not entirely mapped, or other value on failure
+   (refer to uc_err enum for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_dirty_log_start(uc_engine *uc, uint64_t address, size_t size);
+
+/*
+ Stop logging the pages written in a range of memory.
+
+ @uc: handle returned by uc_open()
+ @address: starting address of the range, aligned to the page size.
+ @size: size of the range, a multiple of the page size.
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_dirty_log_stop(uc_engine *uc, uint64_t address, size_t size);
+
+/*
+ Fetch the log of the pages written in a range of memory, and optionally
+ clear it in the same call, so that no write between the two is missed.
+
+ Bit n of @bitmap (bit n % 8 of byte n / 8) is set when page n of the range,
+ at @address + n * page size, is logged and was written since its logging
+ started or was last cleared. Pages that are not logged have their bit
+ clear.
+
+ @uc: handle returned by uc_open()
+ @address: starting address of the range, aligned to the page size.
+ @size: size of the range, a multiple of the page size.
+ @bitmap: buffer of at least (size / page size + 7) / 8 bytes, to receive
+   the log.
+ @clear: true to clear the log of the range, so that the pages are marked
+   again by their next write.
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_dirty_log_get(uc_engine *uc, uint64_t address, size_t size,
+        uint8_t *bitmap, bool clear);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,8 +1,8 @@
 /* Autogen header for Unicorn Engine - DONOT MODIFY */
 #ifndef UNICORN_AUTOGEN_AARCH64EB_H
 #define UNICORN_AUTOGEN_AARCH64EB_H
-#define tci_tb_ptr tci_tb_ptr_aarch64eb
 #define tcg_qemu_tb_exec tcg_qemu_tb_exec_aarch64eb
+#define tci_op_entry tci_op_entry_aarch64eb
 #define arm_release arm_release_aarch64eb
 #define aarch64_tb_set_jmp_target aarch64_tb_set_jmp_target_aarch64eb
 #define ppc_tb_set_jmp_target ppc_tb_set_jmp_target_aarch64eb
@@ -2049,6 +2049,7 @@
 #define memory_region_is_iommu memory_region_is_iommu_aarch64eb
 #define memory_region_is_logging memory_region_is_logging_aarch64eb
 #define memory_region_is_mapped memory_region_is_mapped_aarch64eb
+#define memory_region_is_prealloc memory_region_is_prealloc_aarch64eb
 #define memory_region_is_ram memory_region_is_ram_aarch64eb
 #define memory_region_is_rom memory_region_is_rom_aarch64eb
 #define memory_region_is_romd memory_region_is_romd_aarch64eb
@@ -2647,6 +2648,8 @@
 #define tb_add_jump tb_add_jump_aarch64eb
 #define tb_alloc tb_alloc_aarch64eb
 #define tb_alloc_page tb_alloc_page_aarch64eb
+#define tb_cache_query tb_cache_query_aarch64eb
+#define tb_cache_resize tb_cache_resize_aarch64eb
 #define tb_check_watchpoint tb_check_watchpoint_aarch64eb
 #define tb_find_fast tb_find_fast_aarch64eb
 #define tb_find_pc tb_find_pc_aarch64eb
@@ -1,8 +1,8 @@
 /* Autogen header for Unicorn Engine - DONOT MODIFY */
 #ifndef UNICORN_AUTOGEN_ARM_H
 #define UNICORN_AUTOGEN_ARM_H
-#define tci_tb_ptr tci_tb_ptr_arm
 #define tcg_qemu_tb_exec tcg_qemu_tb_exec_arm
+#define tci_op_entry tci_op_entry_arm
 #define arm_release arm_release_arm
 #define aarch64_tb_set_jmp_target aarch64_tb_set_jmp_target_arm
 #define ppc_tb_set_jmp_target ppc_tb_set_jmp_target_arm
@@ -2049,6 +2049,7 @@
 #define memory_region_is_iommu memory_region_is_iommu_arm
 #define memory_region_is_logging memory_region_is_logging_arm
 #define memory_region_is_mapped memory_region_is_mapped_arm
+#define memory_region_is_prealloc memory_region_is_prealloc_arm
 #define memory_region_is_ram memory_region_is_ram_arm
 #define memory_region_is_rom memory_region_is_rom_arm
 #define memory_region_is_romd memory_region_is_romd_arm
@@ -2647,6 +2648,8 @@
 #define tb_add_jump tb_add_jump_arm
 #define tb_alloc tb_alloc_arm
 #define tb_alloc_page tb_alloc_page_arm
+#define tb_cache_query tb_cache_query_arm
+#define tb_cache_resize tb_cache_resize_arm
 #define tb_check_watchpoint tb_check_watchpoint_arm
 #define tb_find_fast tb_find_fast_arm
 #define tb_find_pc tb_find_pc_arm
@@ -21,6 +21,7 @@
 
 #include "tcg.h"
 #include "sysemu/sysemu.h"
+#include "qemu/timer.h"
 
 #include "uc_priv.h"
 
@@ -29,6 +30,7 @@ static TranslationBlock *tb_find_slow(CPUArchState *env, target_ulong pc,
         target_ulong cs_base, uint64_t flags);
 static TranslationBlock *tb_find_fast(CPUArchState *env);
 static void cpu_handle_debug_exception(CPUArchState *env);
+static void tb_invalidate_partial(CPUArchState *env);
 
 void cpu_loop_exit(CPUState *cpu)
 {
@@ -46,6 +48,45 @@ void cpu_resume_from_signal(CPUState *cpu, void *puc)
     longjmp(cpu->jmp_env, 1);
 }
 
+/* Unicorn: instructions run between two checks of the @timeout deadline */
+#define TIMEOUT_SLICE 0x1000
+
+static inline int icount_slice(struct uc_struct *uc)
+{
+    return uc->timeout ? TIMEOUT_SLICE : 0xffff;
+}
+
+/* Execute the code without caching the generated code. An interpreter
+   could be used if available. */
+static void cpu_exec_nocache(CPUArchState *env, int max_cycles,
+                             TranslationBlock *orig_tb)
+{
+    CPUState *cpu = ENV_GET_CPU(env);
+    TranslationBlock *tb;
+
+    /* Should never happen.
+       We only end up here when an existing TB is too long.  */
+    if (max_cycles > CF_COUNT_MASK)
+        max_cycles = CF_COUNT_MASK;
+
+    tb = tb_gen_code(cpu, orig_tb->pc, orig_tb->cs_base, orig_tb->flags,
+                     max_cycles);
+    if (!tb) {
+        return;
+    }
+    // Unicorn: dropped at the end of cpu_exec() if the block does not
+    // return here
+    tb->partial = true;
+    env->uc->tb_partial = true;
+    cpu->current_tb = tb;
+    /* execute the generated code */
+    cpu_tb_exec(cpu, tb->tc_ptr);
+    cpu->current_tb = NULL;
+    tb_phys_invalidate(env->uc, tb, -1);
+    tb->partial = false;
+    tb_free(env->uc, tb);
+}
+
 /* main execution loop */
 
 int cpu_exec(struct uc_struct *uc, CPUArchState *env)   // qq
@@ -269,6 +310,49 @@ int cpu_exec(struct uc_struct *uc, CPUArchState *env)   // qq
                             tb = (TranslationBlock *)(next_tb & ~TB_EXIT_MASK);
                             next_tb = 0;
                             break;
+                        case TB_EXIT_ICOUNT_EXPIRED:
+                        {
+                            /* Instruction counter expired.  */
+                            int insns_left;
+                            tb = (TranslationBlock *)(next_tb & ~TB_EXIT_MASK);
+                            insns_left = cpu->icount_decr.u32;
+                            next_tb = 0;
+                            if (cpu->icount_extra && insns_left >= 0) {
+                                // Unicorn: check the deadline of @timeout
+                                // between two slices of instructions
+                                if (uc->timeout) {
+                                    int64_t late = get_clock() - uc->timeout_deadline;
+                                    if (late >= 0) {
+                                        uc->timed_out = true;
+                                        uc->timeout_overrun = late;
+                                        uc->stop_request = true;
+                                        cpu_loop_exit(cpu);
+                                    }
+                                }
+                                /* Refill decrementer and continue execution.  */
+                                cpu->icount_extra += insns_left;
+                                if (cpu->icount_extra > icount_slice(uc)) {
+                                    insns_left = icount_slice(uc);
+                                } else {
+                                    insns_left = cpu->icount_extra;
+                                }
+                                cpu->icount_extra -= insns_left;
+                                cpu->icount_decr.u16.low = insns_left;
+                            } else {
+                                if (insns_left > 0) {
+                                    /* Execute remaining instructions.  */
+                                    cpu_exec_nocache(env, insns_left, tb);
+                                }
+                                // Unicorn: the next instruction would go
+                                // over the @count of uc_emu_start()
+                                if (!uc->stop_request && !env->invalid_error) {
+                                    uc->emu_counter = uc->emu_count + 1;
+                                    uc->stop_request = true;
+                                }
+                                cpu_loop_exit(cpu);
+                            }
+                            break;
+                        }
                         default:
                             break;
                     }
@@ -295,10 +379,11 @@ int cpu_exec(struct uc_struct *uc, CPUArchState *env)   // qq
 
     cc->cpu_exec_exit(cpu);
 
-    // Unicorn: flush JIT cache to because emulation might stop in
-    // the middle of translation, thus generate incomplete code.
-    // TODO: optimize this for better performance
-    tb_flush(env);
+    // Unicorn: keep the JIT cache for the next uc_emu_start(), but drop
+    // the blocks which were cut short during this run.
+    if (uc->tb_partial) {
+        tb_invalidate_partial(env);
+    }
 
     /* fail safe : never use current_cpu outside cpu_exec() */
     // uc->current_cpu = NULL;
@@ -324,9 +409,9 @@ static tcg_target_ulong cpu_tb_exec(CPUState *cpu, uint8_t *tb_ptr)
         TranslationBlock *tb = (TranslationBlock *)(next_tb & ~TB_EXIT_MASK);
 
         /* Both set_pc() & synchronize_fromtb() can be ignored when code tracing hook is installed,
-         * or timer mode is in effect, since these already fix the PC.
+         * since it already fixes the PC.
          */
-        if (!HOOK_EXISTS(env->uc, UC_HOOK_CODE) && !env->uc->timeout) {
+        if (!HOOK_EXISTS(env->uc, UC_HOOK_CODE)) {
             // We should sync pc for R/W error.
             switch (env->invalid_error) {
                 case UC_ERR_WRITE_PROT:
@@ -415,8 +500,11 @@ not_found:
     if (tb == NULL) {
         return NULL;
     }
+    goto translated;
 
 found:
+    env->uc->tb_reused++;
+translated:
     /* Move the last found TB to the head of the list */
     if (likely(*ptb1)) {
         *ptb1 = tb->phys_hash_next;
@@ -443,10 +531,29 @@ static TranslationBlock *tb_find_fast(CPUArchState *env)    // qq
     if (unlikely(!tb || tb->pc != pc || tb->cs_base != cs_base ||
                 tb->flags != flags)) {
         tb = tb_find_slow(env, pc, cs_base, flags); // qq
+    } else {
+        env->uc->tb_reused++;
     }
     return tb;
 }
 
+/* Unicorn: invalidate the blocks marked as partial by tb_gen_code() */
+static void tb_invalidate_partial(CPUArchState *env)
+{
+    struct uc_struct *uc = env->uc;
+    TCGContext *tcg_ctx = uc->tcg_ctx;
+    TranslationBlock *tb;
+    int i;
+
+    for (i = 0; i < tcg_ctx->tb_ctx.nb_tbs; i++) {
+        tb = &tcg_ctx->tb_ctx.tbs[i];
+        if (tb->partial) {
+            tb_phys_invalidate(uc, tb, -1);
+        }
+    }
+    uc->tb_partial = false;
+}
+
 static void cpu_handle_debug_exception(CPUArchState *env)
 {
     CPUState *cpu = ENV_GET_CPU(env);
@@ -210,6 +210,7 @@ void tlb_set_page(CPUState *cpu, target_ulong vaddr,
     uintptr_t addend;
     CPUTLBEntry *te;
     hwaddr iotlb, xlat, sz;
+    uint32_t perms;
     unsigned vidx = env->vtlb_index++ % CPU_VTLB_SIZE;
 
     assert(size >= TARGET_PAGE_SIZE);
@@ -228,6 +229,10 @@ void tlb_set_page(CPUState *cpu, target_ulong vaddr,
            vaddr, paddr, prot, mmu_idx);
 #endif
 
+    // Unicorn: only RAM is kept out of the TLB by its permissions
+    perms = memory_region_is_ram(section->mr) ?
+        memory_region_page_perms(section->mr, xlat) : UC_PROT_ALL;
+
     address = vaddr;
     if (!memory_region_is_ram(section->mr) && !memory_region_is_romd(section->mr)) {
         /* IO memory case */
@@ -252,7 +257,9 @@ void tlb_set_page(CPUState *cpu, target_ulong vaddr,
     /* refill the tlb */
     env->iotlb[mmu_idx][index] = iotlb - vaddr;
     te->addend = (uintptr_t)(addend - vaddr);
-    if (prot & PAGE_READ) {
+    /* Unicorn: RAM without UC_PROT_READ never hits the read TLB, so the
+       inline fast paths need not look at the page permissions. */
+    if ((prot & PAGE_READ) && (perms & UC_PROT_READ)) {
         te->addr_read = address;
     } else {
         te->addr_read = -1;
@@ -264,7 +271,8 @@ void tlb_set_page(CPUState *cpu, target_ulong vaddr,
         te->addr_code = -1;
     }
     if (prot & PAGE_WRITE) {
-        if ((memory_region_is_ram(section->mr) && section->readonly)
+        if ((memory_region_is_ram(section->mr)
+             && (section->readonly || !(perms & UC_PROT_WRITE)))
             || memory_region_is_romd(section->mr)) {
             /* Write access calls the I/O callback.  */
             te->addr_write = address | TLB_MMIO;
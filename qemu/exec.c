@@ -90,10 +90,15 @@ typedef PhysPageEntry Node[P_L2_SIZE];
 typedef struct PhysPageMap {
     unsigned sections_nb;
     unsigned sections_nb_alloc;
+    unsigned io_sections_nb;
     unsigned nodes_nb;
     unsigned nodes_nb_alloc;
     Node *nodes;
     MemoryRegionSection *sections;
+    /* Unicorn: the sections that are not RAM are numbered apart for their
+       iotlb entries, see phys_section_add() */
+    uint16_t *section_io;       /* iotlb index of each section */
+    uint32_t *io_sections;      /* section of each iotlb index */
 } PhysPageMap;
 
 struct AddressSpaceDispatch {
@@ -110,7 +115,7 @@ typedef struct subpage_t {
     MemoryRegion iomem;
     AddressSpace *as;
     hwaddr base;
-    uint16_t sub_section[TARGET_PAGE_SIZE];
+    uint32_t sub_section[TARGET_PAGE_SIZE];
 } subpage_t;
 
 #define PHYS_SECTION_UNASSIGNED 0
@@ -150,7 +155,7 @@ static uint32_t phys_map_node_alloc(PhysPageMap *map)
 }
 
 static void phys_page_set_level(PhysPageMap *map, PhysPageEntry *lp,
-        hwaddr *index, hwaddr *nb, uint16_t leaf,
+        hwaddr *index, hwaddr *nb, uint32_t leaf,
         int level)
 {
     PhysPageEntry *p;
@@ -186,7 +191,7 @@ static void phys_page_set_level(PhysPageMap *map, PhysPageEntry *lp,
 
 static void phys_page_set(AddressSpaceDispatch *d,
         hwaddr index, hwaddr nb,
-        uint16_t leaf)
+        uint32_t leaf)
 {
     /* Wildly overreserve - it doesn't matter much. */
     phys_map_node_reserve(&d->map, 3 * P_L2_LEVELS);
@@ -679,29 +684,76 @@ void cpu_abort(CPUState *cpu, const char *fmt, ...)
 }
 
 #if !defined(CONFIG_USER_ONLY)
-static RAMBlock *qemu_get_ram_block(struct uc_struct *uc, ram_addr_t addr)
+/* Number of blocks at or below RAM offset @addr.  */
+static uint32_t ram_block_index(struct uc_struct *uc, ram_addr_t addr)
+{
+    uint32_t left = 0, right = uc->ram_list.block_count, mid;
+
+    while (left < right) {
+        mid = left + (right - left) / 2;
+        if (uc->ram_list.blocks[mid]->offset <= addr) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+
+    return left;
+}
+
+/* Number of blocks whose host memory starts at or below @host.  */
+static uint32_t ram_block_host_index(struct uc_struct *uc, uint8_t *host)
+{
+    uint32_t left = 0, right = uc->ram_list.block_count, mid;
+
+    while (left < right) {
+        mid = left + (right - left) / 2;
+        if ((uintptr_t)uc->ram_list.blocks_by_host[mid]->host <= (uintptr_t)host) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+
+    return left;
+}
+
+/* The block holding RAM offset @addr, or NULL.  */
+static RAMBlock *ram_block_find(struct uc_struct *uc, ram_addr_t addr)
 {
     RAMBlock *block;
+    uint32_t i;
 
-    /* The list is protected by the iothread lock here.  */
     block = uc->ram_list.mru_block;
     if (block && addr - block->offset < block->length) {
-        goto found;
-    }
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (addr - block->offset < block->length) {
-            goto found;
-        }
+        return block;
     }
 
-    fprintf(stderr, "Bad ram offset %" PRIx64 "\n", (uint64_t)addr);
-    abort();
+    i = ram_block_index(uc, addr);
+    if (i == 0) {
+        return NULL;
+    }
+    block = uc->ram_list.blocks[i - 1];
+    if (addr - block->offset >= block->length) {
+        return NULL;
+    }
 
-found:
     uc->ram_list.mru_block = block;
     return block;
 }
 
+static RAMBlock *qemu_get_ram_block(struct uc_struct *uc, ram_addr_t addr)
+{
+    RAMBlock *block = ram_block_find(uc, addr);
+
+    if (block == NULL) {
+        fprintf(stderr, "Bad ram offset %" PRIx64 "\n", (uint64_t)addr);
+        abort();
+    }
+
+    return block;
+}
+
 static void tlb_reset_dirty_range_all(struct uc_struct* uc,
     ram_addr_t start, ram_addr_t length)
 {
@@ -745,13 +797,16 @@ hwaddr memory_region_section_get_iotlb(CPUState *cpu,
         /* Normal RAM.  */
         iotlb = (memory_region_get_ram_addr(section->mr) & TARGET_PAGE_MASK)
             + xlat;
-        if (!section->readonly) {
+        if (!section->readonly &&
+            (memory_region_page_perms(section->mr, xlat) & UC_PROT_WRITE)) {
             iotlb |= PHYS_SECTION_NOTDIRTY;
         } else {
             iotlb |= PHYS_SECTION_ROM;
         }
     } else {
-        iotlb = section - section->address_space->dispatch->map.sections;
+        PhysPageMap *map = &section->address_space->dispatch->map;
+
+        iotlb = map->section_io[section - map->sections];
         iotlb += xlat;
     }
 
@@ -775,7 +830,7 @@ hwaddr memory_region_section_get_iotlb(CPUState *cpu,
 #if !defined(CONFIG_USER_ONLY)
 
 static int subpage_register (subpage_t *mmio, uint32_t start, uint32_t end,
-        uint16_t section);
+        uint32_t section);
 static subpage_t *subpage_init(AddressSpace *as, hwaddr base);
 
 static void *(*phys_mem_alloc)(size_t size, uint64_t *align) =
@@ -791,20 +846,32 @@ void phys_mem_set_alloc(void *(*alloc)(size_t, uint64_t *align))
     phys_mem_alloc = alloc;
 }
 
-static uint16_t phys_section_add(PhysPageMap *map,
+static uint32_t phys_section_add(PhysPageMap *map,
         MemoryRegionSection *section)
 {
-    /* The physical section number is ORed with a page-aligned
-     * pointer to produce the iotlb entries.  Thus it should
-     * never overflow into the page-aligned value.
-     */
-    assert(map->sections_nb < TARGET_PAGE_SIZE);
-
     if (map->sections_nb == map->sections_nb_alloc) {
         map->sections_nb_alloc = MAX(map->sections_nb_alloc * 2, 16);
         map->sections = g_renew(MemoryRegionSection, map->sections,
                 map->sections_nb_alloc);
+        map->section_io = g_renew(uint16_t, map->section_io,
+                map->sections_nb_alloc);
+        map->io_sections = g_renew(uint32_t, map->io_sections,
+                map->sections_nb_alloc);
+    }
+
+    /* The iotlb number of a section is ORed with a page-aligned
+     * pointer to produce the iotlb entries.  Thus it should
+     * never overflow into the page-aligned value.
+     * Unicorn: the iotlb entries of RAM hold its address instead, so
+     * only the other sections are numbered, and any number of RAM
+     * regions can be mapped.
+     */
+    if (!memory_region_is_ram(section->mr)) {
+        assert(map->io_sections_nb < TARGET_PAGE_SIZE);
+        map->section_io[map->sections_nb] = map->io_sections_nb;
+        map->io_sections[map->io_sections_nb++] = map->sections_nb;
     }
+
     map->sections[map->sections_nb] = *section;
     memory_region_ref(section->mr);
     return map->sections_nb++;
@@ -828,6 +895,8 @@ static void phys_sections_free(PhysPageMap *map)
         phys_section_destroy(section->mr);
     }
     g_free(map->sections);
+    g_free(map->section_io);
+    g_free(map->io_sections);
     g_free(map->nodes);
 }
 
@@ -865,7 +934,7 @@ static void register_multipage(AddressSpaceDispatch *d,
         MemoryRegionSection *section)
 {
     hwaddr start_addr = section->offset_within_address_space;
-    uint16_t section_index = phys_section_add(&d->map, section);
+    uint32_t section_index = phys_section_add(&d->map, section);
     uint64_t num_pages = int128_get64(int128_rshift(section->size,
                 TARGET_PAGE_BITS));
 
@@ -914,50 +983,164 @@ static void mem_add(MemoryListener *listener, MemoryRegionSection *section)
 
 #endif
 
-static ram_addr_t find_ram_offset(struct uc_struct *uc, ram_addr_t size)
+/* Index of the first gap not shorter than @length, or at the same length,
+ * not below @offset.  */
+static uint32_t ram_gap_index(struct uc_struct *uc, ram_addr_t length,
+        ram_addr_t offset)
 {
-    RAMBlock *block, *next_block;
-    ram_addr_t offset = RAM_ADDR_MAX, mingap = RAM_ADDR_MAX;
+    uint32_t left = 0, right = uc->ram_list.gap_count, mid;
+    RAMGap *gap;
 
-    assert(size != 0); /* it would hand out same offset multiple times */
+    while (left < right) {
+        mid = left + (right - left) / 2;
+        gap = &uc->ram_list.gaps[mid];
+        if (gap->length < length ||
+            (gap->length == length && gap->offset < offset)) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
 
-    if (QTAILQ_EMPTY(&uc->ram_list.blocks))
-        return 0;
+    return left;
+}
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        ram_addr_t end, next = RAM_ADDR_MAX;
+static void ram_gap_add(struct uc_struct *uc, ram_addr_t offset,
+        ram_addr_t length)
+{
+    RAMList *rl = &uc->ram_list;
+    uint32_t i;
 
-        end = block->offset + block->length;
+    if (length == 0) {
+        return;
+    }
+    if (rl->gap_count == rl->gap_capacity) {
+        rl->gap_capacity = rl->gap_capacity ? rl->gap_capacity * 2 : 16;
+        rl->gaps = g_renew(RAMGap, rl->gaps, rl->gap_capacity);
+    }
 
-        QTAILQ_FOREACH(next_block, &uc->ram_list.blocks, next) {
-            if (next_block->offset >= end) {
-                next = MIN(next, next_block->offset);
-            }
-        }
-        if (next - end >= size && next - end < mingap) {
-            offset = end;
-            mingap = next - end;
-        }
+    i = ram_gap_index(uc, length, offset);
+    memmove(&rl->gaps[i + 1], &rl->gaps[i],
+            (rl->gap_count - i) * sizeof(RAMGap));
+    rl->gaps[i].offset = offset;
+    rl->gaps[i].length = length;
+    rl->gap_count++;
+}
+
+static void ram_gap_remove(struct uc_struct *uc, ram_addr_t offset,
+        ram_addr_t length)
+{
+    RAMList *rl = &uc->ram_list;
+    uint32_t i;
+
+    if (length == 0) {
+        return;
     }
 
-    if (offset == RAM_ADDR_MAX) {
-        fprintf(stderr, "Failed to find gap of requested size: %" PRIu64 "\n",
-                (uint64_t)size);
-        abort();
+    i = ram_gap_index(uc, length, offset);
+    assert(i < rl->gap_count && rl->gaps[i].offset == offset);
+    rl->gap_count--;
+    memmove(&rl->gaps[i], &rl->gaps[i + 1],
+            (rl->gap_count - i) * sizeof(RAMGap));
+}
+
+/* Take the smallest gap that fits @size, or the offsets past the last
+ * block when none does.  */
+static ram_addr_t find_ram_offset(struct uc_struct *uc, ram_addr_t size)
+{
+    RAMGap gap;
+    uint32_t i;
+
+    assert(size != 0); /* it would hand out same offset multiple times */
+
+    i = ram_gap_index(uc, size, 0);
+    if (i == uc->ram_list.gap_count) {
+        return last_ram_offset(uc);
     }
 
-    return offset;
+    gap = uc->ram_list.gaps[i];
+    ram_gap_remove(uc, gap.offset, gap.length);
+    ram_gap_add(uc, gap.offset + size, gap.length - size);
+
+    return gap.offset;
 }
 
 ram_addr_t last_ram_offset(struct uc_struct *uc)
 {
     RAMBlock *block;
-    ram_addr_t last = 0;
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next)
-        last = MAX(last, block->offset + block->length);
+    if (uc->ram_list.block_count == 0) {
+        return 0;
+    }
+    block = uc->ram_list.blocks[uc->ram_list.block_count - 1];
+
+    return block->offset + block->length;
+}
+
+static void ram_block_insert(struct uc_struct *uc, RAMBlock *new_block)
+{
+    RAMList *rl = &uc->ram_list;
+    uint32_t i;
+
+    if (rl->block_count == rl->block_capacity) {
+        rl->block_capacity = rl->block_capacity ? rl->block_capacity * 2 : 16;
+        rl->blocks = g_renew(RAMBlock *, rl->blocks, rl->block_capacity);
+        rl->blocks_by_host = g_renew(RAMBlock *, rl->blocks_by_host,
+                rl->block_capacity);
+    }
+
+    i = ram_block_index(uc, new_block->offset);
+    memmove(&rl->blocks[i + 1], &rl->blocks[i],
+            (rl->block_count - i) * sizeof(RAMBlock *));
+    rl->blocks[i] = new_block;
+
+    i = ram_block_host_index(uc, new_block->host);
+    memmove(&rl->blocks_by_host[i + 1], &rl->blocks_by_host[i],
+            (rl->block_count - i) * sizeof(RAMBlock *));
+    rl->blocks_by_host[i] = new_block;
+
+    rl->block_count++;
+}
+
+/* Take @block out of the lists and give its offsets back.  */
+static void ram_block_remove(struct uc_struct *uc, RAMBlock *block)
+{
+    RAMList *rl = &uc->ram_list;
+    ram_addr_t start, end;
+    uint32_t i, h;
+
+    i = ram_block_index(uc, block->offset) - 1;
+    assert(rl->blocks[i] == block);
+
+    /* Blocks of uc_mem_map_ptr() may share their host memory.  */
+    for (h = ram_block_host_index(uc, block->host); h > 0; h--) {
+        if (rl->blocks_by_host[h - 1] == block) {
+            break;
+        }
+    }
+    assert(h > 0);
+    h--;
+
+    /* Merge the gaps on both sides.  Past the last block, the offsets
+     * are free anyway.  */
+    start = i > 0 ? rl->blocks[i - 1]->offset + rl->blocks[i - 1]->length : 0;
+    end = block->offset + block->length;
+    ram_gap_remove(uc, start, block->offset - start);
+    if (i + 1 < rl->block_count) {
+        ram_gap_remove(uc, end, rl->blocks[i + 1]->offset - end);
+        ram_gap_add(uc, start, rl->blocks[i + 1]->offset - start);
+    }
+
+    rl->block_count--;
+    memmove(&rl->blocks[i], &rl->blocks[i + 1],
+            (rl->block_count - i) * sizeof(RAMBlock *));
+    memmove(&rl->blocks_by_host[h], &rl->blocks_by_host[h + 1],
+            (rl->block_count - h) * sizeof(RAMBlock *));
 
-    return last;
+    if (rl->mru_block == block) {
+        rl->mru_block = NULL;
+    }
+    rl->version++;
 }
 
 static void qemu_ram_setup_dump(void *addr, ram_addr_t size)
@@ -966,12 +1149,10 @@ static void qemu_ram_setup_dump(void *addr, ram_addr_t size)
 
 static RAMBlock *find_ram_block(struct uc_struct *uc, ram_addr_t addr)
 {
-    RAMBlock *block;
+    RAMBlock *block = ram_block_find(uc, addr);
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (block->offset == addr) {
-            return block;
-        }
+    if (block && block->offset == addr) {
+        return block;
     }
 
     return NULL;
@@ -993,13 +1174,10 @@ static int memory_try_enable_merging(void *addr, size_t len)
 
 static ram_addr_t ram_block_add(struct uc_struct *uc, RAMBlock *new_block, Error **errp)
 {
-    RAMBlock *block;
     ram_addr_t old_ram_size, new_ram_size;
 
     old_ram_size = last_ram_offset(uc) >> TARGET_PAGE_BITS;
 
-    new_block->offset = find_ram_offset(uc, new_block->length);
-
     if (!new_block->host) {
         new_block->host = phys_mem_alloc(new_block->length,
                 &new_block->mr->align);
@@ -1012,18 +1190,9 @@ static ram_addr_t ram_block_add(struct uc_struct *uc, RAMBlock *new_block, Error
         memory_try_enable_merging(new_block->host, new_block->length);
     }
 
-    /* Keep the list sorted from biggest to smallest block.  */
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (block->length < new_block->length) {
-            break;
-        }
-    }
-    if (block) {
-        QTAILQ_INSERT_BEFORE(block, new_block, next);
-    } else {
-        QTAILQ_INSERT_TAIL(&uc->ram_list.blocks, new_block, next);
-    }
-    uc->ram_list.mru_block = NULL;
+    new_block->offset = find_ram_offset(uc, new_block->length);
+    ram_block_insert(uc, new_block);
+    new_block->mr->ram_block = new_block;
 
     uc->ram_list.version++;
 
@@ -1082,41 +1251,39 @@ ram_addr_t qemu_ram_alloc(ram_addr_t size, MemoryRegion *mr, Error **errp)
 
 void qemu_ram_free_from_ptr(struct uc_struct *uc, ram_addr_t addr)
 {
-    RAMBlock *block;
+    RAMBlock *block = find_ram_block(uc, addr);
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (addr == block->offset) {
-            QTAILQ_REMOVE(&uc->ram_list.blocks, block, next);
-            uc->ram_list.mru_block = NULL;
-            uc->ram_list.version++;
-            g_free(block);
-            break;
-        }
+    if (block) {
+        ram_block_remove(uc, block);
+        g_free(block);
     }
 }
 
+/* Unicorn: the RAM region maps host memory it was given, which it does
+ * not own and which the host may write behind its back
+ */
+bool memory_region_is_prealloc(MemoryRegion *mr)
+{
+    return mr->ram_block != NULL && (mr->ram_block->flags & RAM_PREALLOC);
+}
+
 void qemu_ram_free(struct uc_struct *uc, ram_addr_t addr)
 {
-    RAMBlock *block;
+    RAMBlock *block = find_ram_block(uc, addr);
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (addr == block->offset) {
-            QTAILQ_REMOVE(&uc->ram_list.blocks, block, next);
-            uc->ram_list.mru_block = NULL;
-            uc->ram_list.version++;
-            if (block->flags & RAM_PREALLOC) {
-                ;
+    if (block) {
+        ram_block_remove(uc, block);
+        if (block->flags & RAM_PREALLOC) {
+            ;
 #ifndef _WIN32
-            } else if (block->fd >= 0) {
-                munmap(block->host, block->length);
-                close(block->fd);
+        } else if (block->fd >= 0) {
+            munmap(block->host, block->length);
+            close(block->fd);
 #endif
-            } else {
-                qemu_anon_ram_free(block->host, block->length);
-            }
-            g_free(block);
-            break;
+        } else {
+            qemu_anon_ram_free(block->host, block->length);
         }
+        g_free(block);
     }
 }
 
@@ -1128,42 +1295,40 @@ void qemu_ram_remap(struct uc_struct *uc, ram_addr_t addr, ram_addr_t length)
     int flags;
     void *area, *vaddr;
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
+    block = ram_block_find(uc, addr);
+    if (block) {
         offset = addr - block->offset;
-        if (offset < block->length) {
-            vaddr = block->host + offset;
-            if (block->flags & RAM_PREALLOC) {
-                ;
+        vaddr = block->host + offset;
+        if (block->flags & RAM_PREALLOC) {
+            ;
+        } else {
+            flags = MAP_FIXED;
+            munmap(vaddr, length);
+            if (block->fd >= 0) {
+                flags |= (block->flags & RAM_SHARED ?
+                        MAP_SHARED : MAP_PRIVATE);
+                area = mmap(vaddr, length, PROT_READ | PROT_WRITE,
+                        flags, block->fd, offset);
             } else {
-                flags = MAP_FIXED;
-                munmap(vaddr, length);
-                if (block->fd >= 0) {
-                    flags |= (block->flags & RAM_SHARED ?
-                            MAP_SHARED : MAP_PRIVATE);
-                    area = mmap(vaddr, length, PROT_READ | PROT_WRITE,
-                            flags, block->fd, offset);
-                } else {
-                    /*
-                     * Remap needs to match alloc.  Accelerators that
-                     * set phys_mem_alloc never remap.  If they did,
-                     * we'd need a remap hook here.
-                     */
-                    assert(phys_mem_alloc == qemu_anon_ram_alloc);
-
-                    flags |= MAP_PRIVATE | MAP_ANONYMOUS;
-                    area = mmap(vaddr, length, PROT_READ | PROT_WRITE,
-                            flags, -1, 0);
-                }
-                if (area == MAP_FAILED || area != vaddr) {
-                    fprintf(stderr, "Could not remap addr: "
-                            RAM_ADDR_FMT "@" RAM_ADDR_FMT "\n",
-                            length, addr);
-                    exit(1);
-                }
-                memory_try_enable_merging(vaddr, length);
-                qemu_ram_setup_dump(vaddr, length);
+                /*
+                 * Remap needs to match alloc.  Accelerators that
+                 * set phys_mem_alloc never remap.  If they did,
+                 * we'd need a remap hook here.
+                 */
+                assert(phys_mem_alloc == qemu_anon_ram_alloc);
+
+                flags |= MAP_PRIVATE | MAP_ANONYMOUS;
+                area = mmap(vaddr, length, PROT_READ | PROT_WRITE,
+                        flags, -1, 0);
+            }
+            if (area == MAP_FAILED || area != vaddr) {
+                fprintf(stderr, "Could not remap addr: "
+                        RAM_ADDR_FMT "@" RAM_ADDR_FMT "\n",
+                        length, addr);
+                exit(1);
             }
-            return;
+            memory_try_enable_merging(vaddr, length);
+            qemu_ram_setup_dump(vaddr, length);
         }
     }
 }
@@ -1200,23 +1365,17 @@ void *qemu_get_ram_ptr(struct uc_struct *uc, ram_addr_t addr)
 
 /* Return a host pointer to guest's ram. Similar to qemu_get_ram_ptr
  * but takes a size argument */
-static void *qemu_ram_ptr_length(struct uc_struct *uc, ram_addr_t addr, hwaddr *size)
+void *qemu_ram_ptr_length(struct uc_struct *uc, ram_addr_t addr, hwaddr *size)
 {
     RAMBlock *block;
     if (*size == 0) {
         return NULL;
     }
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (addr - block->offset < block->length) {
-            if (addr - block->offset + *size > block->length)
-                *size = block->length - addr + block->offset;
-            return block->host + (addr - block->offset);
-        }
-    }
-
-    fprintf(stderr, "Bad ram offset %" PRIx64 "\n", (uint64_t)addr);
-    abort();
+    block = qemu_get_ram_block(uc, addr);
+    if (addr - block->offset + *size > block->length)
+        *size = block->length - addr + block->offset;
+    return block->host + (addr - block->offset);
 }
 
 /* Some of the softmmu routines need to translate from a host pointer
@@ -1225,18 +1384,26 @@ MemoryRegion *qemu_ram_addr_from_host(struct uc_struct *uc, void *ptr, ram_addr_
 {
     RAMBlock *block;
     uint8_t *host = ptr;
+    uint32_t i;
 
     block = uc->ram_list.mru_block;
     if (block && block->host && host - block->host < block->length) {
         goto found;
     }
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        /* This case append when the block is not mapped. */
-        if (block->host == NULL) {
-            continue;
+    i = ram_block_host_index(uc, host);
+    if (i > 0) {
+        block = uc->ram_list.blocks_by_host[i - 1];
+        if (block->host && host - block->host < block->length) {
+            goto found;
         }
-        if (host - block->host < block->length) {
+    }
+
+    /* The host memory of uc_mem_map_ptr() blocks may overlap, so the
+       block starting closest below @host need not be the one holding it.  */
+    for (i = 0; i < uc->ram_list.block_count; i++) {
+        block = uc->ram_list.blocks[i];
+        if (block->host && host - block->host < block->length) {
             goto found;
         }
     }
@@ -1319,7 +1486,7 @@ static const MemoryRegionOps subpage_ops = {
 };
 
 static int subpage_register (subpage_t *mmio, uint32_t start, uint32_t end,
-        uint16_t section)
+        uint32_t section)
 {
     int idx, eidx;
 
@@ -1356,6 +1523,7 @@ static void notdirty_mem_write(struct uc_struct* uc, uint64_t ram_addr, unsigned
     default:
         abort();
     }
+    cpu_physical_memory_set_dirty_range_nocode(uc, ram_addr, size);
     /* we remove the notdirty callback only if the code has been
        flushed */
     if (!cpu_physical_memory_is_clean(uc, ram_addr)) {
@@ -1410,7 +1578,7 @@ static subpage_t *subpage_init(AddressSpace *as, hwaddr base)
     return mmio;
 }
 
-static uint16_t dummy_section(PhysPageMap *map, AddressSpace *as,
+static uint32_t dummy_section(PhysPageMap *map, AddressSpace *as,
         MemoryRegion *mr)
 {
     MemoryRegionSection section = MemoryRegionSection_make(
@@ -1427,20 +1595,24 @@ static uint16_t dummy_section(PhysPageMap *map, AddressSpace *as,
 
 MemoryRegion *iotlb_to_region(AddressSpace *as, hwaddr index)
 {
-    return as->dispatch->map.sections[index & ~TARGET_PAGE_MASK].mr;
+    PhysPageMap *map = &as->dispatch->map;
+
+    return map->sections[map->io_sections[index & ~TARGET_PAGE_MASK]].mr;
 }
 
 void phys_mem_clean(struct uc_struct* uc)
 {
     AddressSpaceDispatch* d = uc->as.next_dispatch;
     g_free(d->map.sections);
+    g_free(d->map.section_io);
+    g_free(d->map.io_sections);
 }
 
 static void mem_begin(MemoryListener *listener)
 {
     AddressSpace *as = container_of(listener, AddressSpace, dispatch_listener);
     AddressSpaceDispatch *d = g_new0(AddressSpaceDispatch, 1);
-    uint16_t n;
+    uint32_t n;
     PhysPageEntry ppe = { 1, PHYS_MAP_NODE_NIL };
     struct uc_struct *uc = as->uc;
 
@@ -1588,11 +1760,14 @@ int cpu_memory_rw_debug(CPUState *cpu, target_ulong addr,
 
 #else
 
-static void invalidate_and_set_dirty(struct uc_struct *uc, hwaddr addr,
+void invalidate_and_set_dirty(struct uc_struct *uc, hwaddr addr,
         hwaddr length)
 {
     if (cpu_physical_memory_range_includes_clean(uc, addr, length)) {
-        tb_invalidate_phys_range(uc, addr, addr + length, 0);
+        if (cpu_physical_memory_get_clean(uc, addr, length, DIRTY_MEMORY_CODE)) {
+            tb_invalidate_phys_range(uc, addr, addr + length, 0);
+        }
+        cpu_physical_memory_set_dirty_range_nocode(uc, addr, length);
     }
 }
 
@@ -2336,8 +2511,10 @@ bool cpu_physical_memory_is_io(AddressSpace *as, hwaddr phys_addr)
 void qemu_ram_foreach_block(struct uc_struct *uc, RAMBlockIterFunc func, void *opaque)
 {
     RAMBlock *block;
+    uint32_t i;
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
+    for (i = 0; i < uc->ram_list.block_count; i++) {
+        block = uc->ram_list.blocks[i];
         func(block->host, block->offset, block->length, opaque);
     }
 }
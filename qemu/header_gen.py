@@ -7,8 +7,8 @@
 import sys
 
 symbols = (
-    'tci_tb_ptr',
     'tcg_qemu_tb_exec',
+    'tci_op_entry',
     'arm_release',
     'aarch64_tb_set_jmp_target',
     'ppc_tb_set_jmp_target',
@@ -2055,6 +2055,7 @@ symbols = (
     'memory_region_is_iommu',
     'memory_region_is_logging',
     'memory_region_is_mapped',
+    'memory_region_is_prealloc',
     'memory_region_is_ram',
     'memory_region_is_rom',
     'memory_region_is_romd',
@@ -2653,6 +2654,8 @@ symbols = (
     'tb_add_jump',
     'tb_alloc',
     'tb_alloc_page',
+    'tb_cache_query',
+    'tb_cache_resize',
     'tb_check_watchpoint',
     'tb_find_fast',
     'tb_find_pc',
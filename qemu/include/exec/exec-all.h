@@ -143,6 +143,11 @@ struct TranslationBlock {
     uint16_t cflags;    /* compile flags */
 #define CF_COUNT_MASK  0x7fff
 #define CF_LAST_IO     0x8000 /* Last insn may be an IO access.  */
+    /* Unicorn: block was cut short and must not outlive the current run */
+    bool partial;
+    /* Unicorn: memory accesses are followed by an exit request check, kept
+       so that cpu_restore_state() regenerates the same code */
+    bool mem_exit_check;
 
     void *tc_ptr;    /* pointer to the translated code */
     /* next matching tb for physical address. */
@@ -206,6 +211,9 @@ static inline unsigned int tb_phys_hash_func(tb_page_addr_t pc)
 
 void tb_free(struct uc_struct *uc, TranslationBlock *tb);
 void tb_flush(CPUArchState *env);
+bool tb_cache_resize(struct uc_struct *uc, size_t tb_size);
+void tb_cache_query(struct uc_struct *uc, size_t *size, size_t *used,
+                    size_t *flushes);
 void tb_phys_invalidate(struct uc_struct *uc,
     TranslationBlock *tb, tb_page_addr_t page_addr);
 
@@ -214,9 +222,8 @@ void tb_phys_invalidate(struct uc_struct *uc,
 #if defined(CONFIG_TCG_INTERPRETER)
 static inline void tb_set_jmp_target1(uintptr_t jmp_addr, uintptr_t addr)
 {
-    /* patch the branch destination */
-    UNALIGNED_WRITE32_LE(jmp_addr, addr - (jmp_addr + 4));
-    /* no need to flush icache explicitly */
+    /* patch the branch destination, an absolute bytecode address */
+    *(uintptr_t *)jmp_addr = addr;
 }
 #elif defined(_ARCH_PPC)
 void ppc_tb_set_jmp_target(uintptr_t jmp_addr, uintptr_t addr);
@@ -304,8 +311,9 @@ static inline void tb_add_jump(TranslationBlock *tb, int n,
 /* GETRA is the true target of the return instruction that we'll execute,
    defined here for simplicity of defining the follow-up macros.  */
 #if defined(CONFIG_TCG_INTERPRETER)
-extern uintptr_t tci_tb_ptr;
-# define GETRA() tci_tb_ptr
+/* The interpreter tracks its position per vCPU; every user of GETRA()
+   is a helper with the CPU state in scope as env. */
+# define GETRA() (ENV_GET_CPU(env)->tci_tb_ptr)
 #elif defined(_MSC_VER)
 #include <intrin.h>
 # define GETRA() (uintptr_t)_ReturnAddress()
@@ -5,12 +5,9 @@
 
 /* Helpers for instruction counting code generation.  */
 
-//static TCGArg *icount_arg;
-//static int icount_label;
-
 static inline void gen_tb_start(TCGContext *tcg_ctx)
 {
-    // TCGv_i32 count;
+    TCGv_i32 count;
     TCGv_i32 flag;
 
     tcg_ctx->exitreq_label = gen_new_label(tcg_ctx);
@@ -20,23 +17,22 @@ static inline void gen_tb_start(TCGContext *tcg_ctx)
     tcg_gen_brcondi_i32(tcg_ctx, TCG_COND_NE, flag, 0, tcg_ctx->exitreq_label);
     tcg_temp_free_i32(tcg_ctx, flag);
 
-#if 0
-    if (!use_icount)
+    // Unicorn: count instructions for uc_emu_start() with @count
+    if (!tcg_ctx->uc->icount)
         return;
 
-    icount_label = gen_new_label();
-    count = tcg_temp_local_new_i32();
-    tcg_gen_ld_i32(count, cpu_env,
+    tcg_ctx->icount_label = gen_new_label(tcg_ctx);
+    count = tcg_temp_local_new_i32(tcg_ctx);
+    tcg_gen_ld_i32(tcg_ctx, count, tcg_ctx->cpu_env,
                    -ENV_OFFSET + offsetof(CPUState, icount_decr.u32));
     /* This is a horrid hack to allow fixing up the value later.  */
-    icount_arg = tcg_ctx.gen_opparam_ptr + 1;
-    tcg_gen_subi_i32(count, count, 0xdeadbeef);
+    tcg_ctx->icount_arg = tcg_ctx->gen_opparam_ptr + 1;
+    tcg_gen_subi_i32(tcg_ctx, count, count, 0xdeadbeef);
 
-    tcg_gen_brcondi_i32(TCG_COND_LT, count, 0, icount_label);
-    tcg_gen_st16_i32(count, cpu_env,
+    tcg_gen_brcondi_i32(tcg_ctx, TCG_COND_LT, count, 0, tcg_ctx->icount_label);
+    tcg_gen_st16_i32(tcg_ctx, count, tcg_ctx->cpu_env,
                      -ENV_OFFSET + offsetof(CPUState, icount_decr.u16.low));
-    tcg_temp_free_i32(count);
-#endif
+    tcg_temp_free_i32(tcg_ctx, count);
 }
 
 static inline void gen_tb_end(TCGContext *tcg_ctx, TranslationBlock *tb, int num_insns)
@@ -44,13 +40,11 @@ static inline void gen_tb_end(TCGContext *tcg_ctx, TranslationBlock *tb, int num
     gen_set_label(tcg_ctx, tcg_ctx->exitreq_label);
     tcg_gen_exit_tb(tcg_ctx, (uintptr_t)tb + TB_EXIT_REQUESTED);
 
-#if 0
-    if (use_icount) {
-        *icount_arg = num_insns;
-        gen_set_label(icount_label);
-        tcg_gen_exit_tb((uintptr_t)tb + TB_EXIT_ICOUNT_EXPIRED);
+    if (tcg_ctx->uc->icount) {
+        *tcg_ctx->icount_arg = num_insns;
+        gen_set_label(tcg_ctx, tcg_ctx->icount_label);
+        tcg_gen_exit_tb(tcg_ctx, (uintptr_t)tb + TB_EXIT_ICOUNT_EXPIRED);
     }
-#endif
 }
 
 #if 0
@@ -17,7 +17,10 @@
 #ifndef CONFIG_USER_ONLY
 
 #define DIRTY_MEMORY_CODE      0
-#define DIRTY_MEMORY_NUM       1        /* num of dirty bits */
+#define DIRTY_MEMORY_SNAPSHOT  1        /* pages written since uc_snapshot_take() */
+#define DIRTY_MEMORY_LOG       2        /* pages written since uc_mem_dirty_log_start() */
+#define DIRTY_MEMORY_FILE      3        /* pages written since uc_mem_map_file() */
+#define DIRTY_MEMORY_NUM       4        /* num of dirty bits */
 
 #include "unicorn/platform.h"
 #include "unicorn/unicorn.h"
@@ -136,6 +139,7 @@ struct MemoryRegion {
     hwaddr addr;
     void (*destructor)(MemoryRegion *mr);
     ram_addr_t ram_addr;
+    struct RAMBlock *ram_block;
     uint64_t align;
     bool subpage;
     bool terminates;
@@ -156,6 +160,7 @@ struct MemoryRegion {
     uint8_t dirty_log_mask;
     struct uc_struct *uc;
     uint32_t perms;   //all perms, partially redundant with readonly
+    uint8_t *page_perms;    // perms of each page of RAM, NULL if all have perms
     uint64_t end;
 };
 
@@ -853,6 +858,14 @@ void address_space_unmap(AddressSpace *as, void *buffer, hwaddr len,
 
 void memory_register_types(struct uc_struct *uc);
 
+#ifdef NEED_CPU_H
+/* Unicorn: permissions of the page at @offset in @mr */
+static inline uint32_t memory_region_page_perms(MemoryRegion *mr, hwaddr offset)
+{
+    return mr->page_perms ? mr->page_perms[offset >> TARGET_PAGE_BITS] : mr->perms;
+}
+#endif
+
 MemoryRegion *memory_map(struct uc_struct *uc, hwaddr begin, size_t size, uint32_t perms);
 MemoryRegion *memory_map_io(struct uc_struct *uc, ram_addr_t begin, size_t size, uc_cb_mmio_read read_cb, uc_cb_mmio_write write_cb, void *user_data);
 MemoryRegion *memory_map_ptr(struct uc_struct *uc, hwaddr begin, size_t size, uint32_t perms, void *ptr);
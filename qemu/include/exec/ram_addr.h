@@ -29,7 +29,9 @@ ram_addr_t qemu_ram_alloc(ram_addr_t size, MemoryRegion *mr, Error **errp);
 int qemu_get_ram_fd(struct uc_struct *uc, ram_addr_t addr);
 void *qemu_get_ram_block_host_ptr(struct uc_struct *uc, ram_addr_t addr);
 void *qemu_get_ram_ptr(struct uc_struct *uc, ram_addr_t addr);
+void *qemu_ram_ptr_length(struct uc_struct *uc, ram_addr_t addr, hwaddr *size);
 void qemu_ram_free(struct uc_struct *c, ram_addr_t addr);
+bool memory_region_is_prealloc(MemoryRegion *mr);
 void qemu_ram_free_from_ptr(struct uc_struct *uc, ram_addr_t addr);
 
 static inline bool cpu_physical_memory_get_dirty(struct uc_struct *uc, ram_addr_t start,
@@ -70,13 +72,21 @@ static inline bool cpu_physical_memory_get_dirty_flag(struct uc_struct *uc, ram_
 
 static inline bool cpu_physical_memory_is_clean(struct uc_struct *uc, ram_addr_t addr)
 {
-    return !cpu_physical_memory_get_dirty_flag(uc, addr, DIRTY_MEMORY_CODE);
+    bool code = cpu_physical_memory_get_dirty_flag(uc, addr, DIRTY_MEMORY_CODE);
+    bool snapshot = cpu_physical_memory_get_dirty_flag(uc, addr, DIRTY_MEMORY_SNAPSHOT);
+    bool log = cpu_physical_memory_get_dirty_flag(uc, addr, DIRTY_MEMORY_LOG);
+    bool file = cpu_physical_memory_get_dirty_flag(uc, addr, DIRTY_MEMORY_FILE);
+    return !code || !snapshot || !log || !file;
 }
 
 static inline bool cpu_physical_memory_range_includes_clean(struct uc_struct *uc, ram_addr_t start,
                                                             ram_addr_t length)
 {
-    return cpu_physical_memory_get_clean(uc, start, length, DIRTY_MEMORY_CODE);
+    bool code = cpu_physical_memory_get_clean(uc, start, length, DIRTY_MEMORY_CODE);
+    bool snapshot = cpu_physical_memory_get_clean(uc, start, length, DIRTY_MEMORY_SNAPSHOT);
+    bool log = cpu_physical_memory_get_clean(uc, start, length, DIRTY_MEMORY_LOG);
+    bool file = cpu_physical_memory_get_clean(uc, start, length, DIRTY_MEMORY_FILE);
+    return code || snapshot || log || file;
 }
 
 static inline void cpu_physical_memory_set_dirty_flag(struct uc_struct *uc, ram_addr_t addr,
@@ -94,6 +104,21 @@ static inline void cpu_physical_memory_set_dirty_range(struct uc_struct *uc, ram
     end = TARGET_PAGE_ALIGN(start + length) >> TARGET_PAGE_BITS;
     page = start >> TARGET_PAGE_BITS;
     qemu_bitmap_set(uc->ram_list.dirty_memory[DIRTY_MEMORY_CODE], page, end - page);
+    qemu_bitmap_set(uc->ram_list.dirty_memory[DIRTY_MEMORY_SNAPSHOT], page, end - page);
+    qemu_bitmap_set(uc->ram_list.dirty_memory[DIRTY_MEMORY_LOG], page, end - page);
+    qemu_bitmap_set(uc->ram_list.dirty_memory[DIRTY_MEMORY_FILE], page, end - page);
+}
+
+static inline void cpu_physical_memory_set_dirty_range_nocode(struct uc_struct *uc, ram_addr_t start,
+                                                              ram_addr_t length)
+{
+    unsigned long end, page;
+
+    end = TARGET_PAGE_ALIGN(start + length) >> TARGET_PAGE_BITS;
+    page = start >> TARGET_PAGE_BITS;
+    qemu_bitmap_set(uc->ram_list.dirty_memory[DIRTY_MEMORY_SNAPSHOT], page, end - page);
+    qemu_bitmap_set(uc->ram_list.dirty_memory[DIRTY_MEMORY_LOG], page, end - page);
+    qemu_bitmap_set(uc->ram_list.dirty_memory[DIRTY_MEMORY_FILE], page, end - page);
 }
 
 #if !defined(_WIN32)
@@ -119,6 +144,9 @@ static inline void cpu_physical_memory_set_dirty_lebitmap(struct uc_struct *uc,
             if (bitmap[k]) {
                 unsigned long temp = leul_to_cpu(bitmap[k]);
                 uc->ram_list.dirty_memory[DIRTY_MEMORY_CODE][page + k] |= temp;
+                uc->ram_list.dirty_memory[DIRTY_MEMORY_SNAPSHOT][page + k] |= temp;
+                uc->ram_list.dirty_memory[DIRTY_MEMORY_LOG][page + k] |= temp;
+                uc->ram_list.dirty_memory[DIRTY_MEMORY_FILE][page + k] |= temp;
             }
         }
     } else {
@@ -159,5 +187,10 @@ static inline void cpu_physical_memory_clear_dirty_range(struct uc_struct *uc, r
 void cpu_physical_memory_reset_dirty(struct uc_struct *uc,
     ram_addr_t start, ram_addr_t length, unsigned client);
 
+/* drop the code translated from RAM [addr, addr + length) and mark its
+   pages dirty, after a write that did not go through the TLB */
+void invalidate_and_set_dirty(struct uc_struct *uc, hwaddr addr,
+    hwaddr length);
+
 #endif
 #endif
@@ -0,0 +1,46 @@
+/*
+ * Guest crypto instructions on the crypto instructions of the host
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QEMU_HOST_CRYPTO_H
+#define QEMU_HOST_CRYPTO_H
+
+#include "qemu-common.h"
+
+/*
+ * Set at startup when the host has AES-NI, PCLMULQDQ and SHA-NI. The target
+ * helpers call the functions below only when the matching flag is set, and
+ * keep their portable code otherwise. Setting UNICORN_NO_HOST_CRYPTO in the
+ * environment leaves all the flags clear.
+ *
+ * AES blocks are 16 bytes with state byte 0 first, as in the x86 XMM and
+ * the ARM vector registers.
+ */
+extern bool host_crypto_aes;
+extern bool host_crypto_clmul;
+extern bool host_crypto_sha;
+
+/* x86 AESENC, AESENCLAST, AESDEC and AESDECLAST */
+void host_aes_enc_round(uint8_t *d, const uint8_t *st, const uint8_t *rk, bool last);
+void host_aes_dec_round(uint8_t *d, const uint8_t *st, const uint8_t *rk, bool last);
+/* ARM AESE and AESD: AddRoundKey, then (Inv)ShiftRows and (Inv)SubBytes */
+void host_aes_sub_shift(uint8_t *d, const uint8_t *st, const uint8_t *rk, bool decrypt);
+/* MixColumns, or InvMixColumns for x86 AESIMC and ARM AESIMC */
+void host_aes_mix_columns(uint8_t *d, const uint8_t *st, bool inverse);
+
+/* carry-less product of 'a' and 'b' */
+void host_clmul(uint64_t *lo, uint64_t *hi, uint64_t a, uint64_t b);
+
+/*
+ * Four rounds of SHA-1 on 'abcd' (a in word 0) and 'e', with the words 'wk'
+ * of the message schedule plus the round constant. 'f' selects the logical
+ * function: 0 for Ch, 1 for Parity, 2 for Maj.
+ */
+void host_sha1_rounds4(uint32_t *abcd, uint32_t e, const uint32_t *wk, int f);
+/* four rounds of SHA-256 on 'abcd' and 'efgh' with the words 'wk' */
+void host_sha256_rounds4(uint32_t *abcd, uint32_t *efgh, const uint32_t *wk);
+
+#endif
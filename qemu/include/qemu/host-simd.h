@@ -0,0 +1,252 @@
+/*
+ * Host SIMD kernels for the vector helpers of the targets
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QEMU_HOST_SIMD_H
+#define QEMU_HOST_SIMD_H
+
+#include "qemu-common.h"
+
+/*
+ * The guest vector helpers get 32 or 64 bits worth of lanes at a time.
+ * On x86 hosts HOST_SIMD is defined and a helper can load those bits into
+ * the low part of a host vector with simd_from32() or simd_from64() and
+ * work on all the lanes at once. The functions below only define the low
+ * 64 bits of their result.
+ *
+ * The build does not assume SSE2: -m32 builds leave it out. The functions
+ * below and their callers are built for it with HOST_SIMD_FN, and may only
+ * run when host_simd is set. The callers must not be inline, as the
+ * helpers that call them are not built for SSE2. It is set at startup when the host has SSE2,
+ * unless UNICORN_NO_HOST_SIMD is in the environment: the helpers then keep
+ * their per-lane C code, which is how the two are compared.
+ * host_simd_shuffle is set when the host also has SSSE3, for simd_lookup8().
+ *
+ * Other hosts, wasm builds included, leave HOST_SIMD undefined and keep the
+ * per-lane C code.
+ */
+extern bool host_simd;
+extern bool host_simd_shuffle;
+
+#if defined(CONFIG_CPUID_H) && (defined(__x86_64__) || defined(__i386__)) && \
+    !defined(_MSC_VER) && (QEMU_GNUC_PREREQ(4, 9) || defined(__clang__))
+
+#define HOST_SIMD
+
+#include <emmintrin.h>
+
+#define HOST_SIMD_FN __attribute__((target("sse2")))
+
+typedef __m128i simd_vec;
+
+static inline HOST_SIMD_FN simd_vec simd_from32(uint32_t x)
+{
+    return _mm_cvtsi32_si128(x);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_from64(uint64_t x)
+{
+    return _mm_loadl_epi64((const __m128i *)&x);
+}
+
+static inline HOST_SIMD_FN uint32_t simd_to32(simd_vec v)
+{
+    return _mm_cvtsi128_si32(v);
+}
+
+static inline HOST_SIMD_FN uint64_t simd_to64(simd_vec v)
+{
+    uint64_t x;
+
+    _mm_storel_epi64((__m128i *)&x, v);
+    return x;
+}
+
+static inline HOST_SIMD_FN simd_vec simd_splat8(uint8_t x)
+{
+    return _mm_set1_epi8(x);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_splat16(uint16_t x)
+{
+    return _mm_set1_epi16(x);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_and(simd_vec a, simd_vec b)
+{
+    return _mm_and_si128(a, b);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_or(simd_vec a, simd_vec b)
+{
+    return _mm_or_si128(a, b);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_xor(simd_vec a, simd_vec b)
+{
+    return _mm_xor_si128(a, b);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_not(simd_vec a)
+{
+    return _mm_xor_si128(a, _mm_set1_epi32(-1));
+}
+
+#define SIMD_OP2(name, insn) \
+static inline HOST_SIMD_FN simd_vec simd_##name(simd_vec a, simd_vec b) \
+{ \
+    return insn(a, b); \
+}
+
+SIMD_OP2(add8, _mm_add_epi8)
+SIMD_OP2(add16, _mm_add_epi16)
+SIMD_OP2(add32, _mm_add_epi32)
+SIMD_OP2(sub8, _mm_sub_epi8)
+SIMD_OP2(sub16, _mm_sub_epi16)
+SIMD_OP2(adds_s8, _mm_adds_epi8)
+SIMD_OP2(adds_u8, _mm_adds_epu8)
+SIMD_OP2(adds_s16, _mm_adds_epi16)
+SIMD_OP2(adds_u16, _mm_adds_epu16)
+SIMD_OP2(subs_s8, _mm_subs_epi8)
+SIMD_OP2(subs_u8, _mm_subs_epu8)
+SIMD_OP2(subs_s16, _mm_subs_epi16)
+SIMD_OP2(subs_u16, _mm_subs_epu16)
+SIMD_OP2(avgr_u8, _mm_avg_epu8)
+SIMD_OP2(avgr_u16, _mm_avg_epu16)
+SIMD_OP2(min_u8, _mm_min_epu8)
+SIMD_OP2(max_u8, _mm_max_epu8)
+SIMD_OP2(min_s16, _mm_min_epi16)
+SIMD_OP2(max_s16, _mm_max_epi16)
+SIMD_OP2(cmpeq8, _mm_cmpeq_epi8)
+SIMD_OP2(cmpeq16, _mm_cmpeq_epi16)
+SIMD_OP2(cmpgt_s8, _mm_cmpgt_epi8)
+SIMD_OP2(cmpgt_s16, _mm_cmpgt_epi16)
+SIMD_OP2(mul16, _mm_mullo_epi16)
+#undef SIMD_OP2
+
+/* SSE2 lacks these: flip the sign bits to use the other signedness */
+static inline HOST_SIMD_FN simd_vec simd_min_s8(simd_vec a, simd_vec b)
+{
+    simd_vec bias = _mm_set1_epi8(0x80);
+
+    return _mm_xor_si128(_mm_min_epu8(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias)), bias);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_max_s8(simd_vec a, simd_vec b)
+{
+    simd_vec bias = _mm_set1_epi8(0x80);
+
+    return _mm_xor_si128(_mm_max_epu8(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias)), bias);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_min_u16(simd_vec a, simd_vec b)
+{
+    simd_vec bias = _mm_set1_epi16(0x8000);
+
+    return _mm_xor_si128(_mm_min_epi16(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias)), bias);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_max_u16(simd_vec a, simd_vec b)
+{
+    simd_vec bias = _mm_set1_epi16(0x8000);
+
+    return _mm_xor_si128(_mm_max_epi16(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias)), bias);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_cmpgt_u8(simd_vec a, simd_vec b)
+{
+    simd_vec bias = _mm_set1_epi8(0x80);
+
+    return _mm_cmpgt_epi8(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias));
+}
+
+static inline HOST_SIMD_FN simd_vec simd_cmpgt_u16(simd_vec a, simd_vec b)
+{
+    simd_vec bias = _mm_set1_epi16(0x8000);
+
+    return _mm_cmpgt_epi16(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias));
+}
+
+/* the lanes shift out entirely for counts from the lane width up */
+static inline HOST_SIMD_FN simd_vec simd_shl16(simd_vec a, unsigned n)
+{
+    return _mm_sll_epi16(a, _mm_cvtsi32_si128(n));
+}
+
+static inline HOST_SIMD_FN simd_vec simd_shr_u16(simd_vec a, unsigned n)
+{
+    return _mm_srl_epi16(a, _mm_cvtsi32_si128(n));
+}
+
+static inline HOST_SIMD_FN simd_vec simd_shr_s16(simd_vec a, unsigned n)
+{
+    return _mm_sra_epi16(a, _mm_cvtsi32_si128(n));
+}
+
+static inline HOST_SIMD_FN simd_vec simd_shr_s32(simd_vec a, unsigned n)
+{
+    return _mm_sra_epi32(a, _mm_cvtsi32_si128(n));
+}
+
+/* the low 8 or 4 lanes, zero or sign extended */
+static inline HOST_SIMD_FN simd_vec simd_widen_u8(simd_vec a)
+{
+    return _mm_unpacklo_epi8(a, _mm_setzero_si128());
+}
+
+static inline HOST_SIMD_FN simd_vec simd_widen_s8(simd_vec a)
+{
+    return _mm_srai_epi16(_mm_unpacklo_epi8(a, a), 8);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_widen_u16(simd_vec a)
+{
+    return _mm_unpacklo_epi16(a, _mm_setzero_si128());
+}
+
+static inline HOST_SIMD_FN simd_vec simd_widen_s16(simd_vec a)
+{
+    return _mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16);
+}
+
+/* products of the low 4 lanes of 16 bits, as 4 lanes of 32 bits */
+static inline HOST_SIMD_FN simd_vec simd_mull_u16(simd_vec a, simd_vec b)
+{
+    return _mm_unpacklo_epi16(_mm_mullo_epi16(a, b), _mm_mulhi_epu16(a, b));
+}
+
+static inline HOST_SIMD_FN simd_vec simd_mull_s16(simd_vec a, simd_vec b)
+{
+    return _mm_unpacklo_epi16(_mm_mullo_epi16(a, b), _mm_mulhi_epi16(a, b));
+}
+
+/* the 8 lanes of 16 bits, or 4 of 32 bits, of 'a' narrowed with saturation */
+static inline HOST_SIMD_FN simd_vec simd_narrow_s16_s8(simd_vec a)
+{
+    return _mm_packs_epi16(a, a);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_narrow_s16_u8(simd_vec a)
+{
+    return _mm_packus_epi16(a, a);
+}
+
+static inline HOST_SIMD_FN simd_vec simd_narrow_s32_s16(simd_vec a)
+{
+    return _mm_packs_epi32(a, a);
+}
+
+/*
+ * The lanes of 'idx' in base..base+count-1, count at most 16, select a byte
+ * of the 16 at 'table'; the other lanes keep the byte of 'res'. This one
+ * needs SSSE3, so it is not inline: check host_simd_shuffle first.
+ */
+uint64_t simd_lookup8(uint64_t res, uint64_t idx, const void *table,
+                      uint8_t base, uint8_t count);
+
+#endif
+
+#endif
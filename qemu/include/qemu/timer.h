@@ -181,9 +181,17 @@ static inline int64_t get_clock(void)
 
 #else
 
+/* Monotonic where available: deadlines must not move with the wall clock */
 static inline int64_t get_clock(void)
 {
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
     return get_clock_realtime();
+#endif
 }
 #endif
 
@@ -198,6 +198,7 @@ struct kvm_run;
  * @opaque: User data.
  * @mem_io_pc: Host Program Counter at which the memory was accessed.
  * @mem_io_vaddr: Target virtual address at which the memory was accessed.
+ * @tci_tb_ptr: Bytecode address of the op being interpreted (TCI only).
  * @kvm_fd: vCPU file descriptor for KVM.
  *
  * State of one CPU core or thread.
@@ -250,6 +251,9 @@ struct CPUState {
      */
     uintptr_t mem_io_pc;
     vaddr mem_io_vaddr;
+#if defined(CONFIG_TCG_INTERPRETER)
+    uintptr_t tci_tb_ptr;
+#endif
 
     int kvm_fd;
     bool kvm_vcpu_dirty;
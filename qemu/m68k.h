@@ -1,8 +1,8 @@
 /* Autogen header for Unicorn Engine - DONOT MODIFY */
 #ifndef UNICORN_AUTOGEN_M68K_H
 #define UNICORN_AUTOGEN_M68K_H
-#define tci_tb_ptr tci_tb_ptr_m68k
 #define tcg_qemu_tb_exec tcg_qemu_tb_exec_m68k
+#define tci_op_entry tci_op_entry_m68k
 #define arm_release arm_release_m68k
 #define aarch64_tb_set_jmp_target aarch64_tb_set_jmp_target_m68k
 #define ppc_tb_set_jmp_target ppc_tb_set_jmp_target_m68k
@@ -2049,6 +2049,7 @@
 #define memory_region_is_iommu memory_region_is_iommu_m68k
 #define memory_region_is_logging memory_region_is_logging_m68k
 #define memory_region_is_mapped memory_region_is_mapped_m68k
+#define memory_region_is_prealloc memory_region_is_prealloc_m68k
 #define memory_region_is_ram memory_region_is_ram_m68k
 #define memory_region_is_rom memory_region_is_rom_m68k
 #define memory_region_is_romd memory_region_is_romd_m68k
@@ -2647,6 +2648,8 @@
 #define tb_add_jump tb_add_jump_m68k
 #define tb_alloc tb_alloc_m68k
 #define tb_alloc_page tb_alloc_page_m68k
+#define tb_cache_query tb_cache_query_m68k
+#define tb_cache_resize tb_cache_resize_m68k
 #define tb_check_watchpoint tb_check_watchpoint_m68k
 #define tb_find_fast tb_find_fast_m68k
 #define tb_find_pc tb_find_pc_m68k
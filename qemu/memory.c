@@ -35,14 +35,18 @@ MemoryRegion *memory_map(struct uc_struct *uc, hwaddr begin, size_t size, uint32
 {
     MemoryRegion *ram = g_new(MemoryRegion, 1);
 
-    memory_region_init_ram(uc, ram, NULL, "pc.ram", size, perms, &error_abort);
+    // Mapped regions are unnamed: they are kept in uc->mapped_blocks, and
+    // a named region is added to the QOM tree under the first free name
+    // "pc.ram[N]", which takes a linear search for every N
+    memory_region_init_ram(uc, ram, NULL, NULL, size, perms, &error_abort);
     if (ram->ram_addr == -1)
         // out of memory
         return NULL;
 
     memory_region_add_subregion(get_system_memory(uc), begin, ram);
 
-    if (uc->current_cpu)
+    // in a batch, the TLB is flushed when the batch is committed
+    if (uc->current_cpu && !uc->memory_region_transaction_depth)
         tlb_flush(uc->current_cpu, 1);
 
     return ram;
@@ -58,13 +62,13 @@ MemoryRegion *memory_map_io(struct uc_struct *uc, ram_addr_t begin, size_t size,
     ops->write = write_cb;
     ops->endianness = DEVICE_NATIVE_ENDIAN;
 
-    memory_region_init_io(uc, mmio, NULL, ops, user_data, "pc.io", size);
+    memory_region_init_io(uc, mmio, NULL, ops, user_data, NULL, size);
     mmio->perms = 0;
     if (read_cb)  mmio->perms |= UC_PROT_READ;
     if (write_cb) mmio->perms |= UC_PROT_WRITE;
     memory_region_add_subregion(get_system_memory(uc), begin, mmio);
 
-    if (uc->current_cpu)
+    if (uc->current_cpu && !uc->memory_region_transaction_depth)
         tlb_flush(uc->current_cpu, 1);
 
     return mmio;
@@ -74,7 +78,7 @@ MemoryRegion *memory_map_ptr(struct uc_struct *uc, hwaddr begin, size_t size, ui
 {
     MemoryRegion *ram = g_new(MemoryRegion, 1);
 
-    memory_region_init_ram_ptr(uc, ram, NULL, "pc.ram", size, ptr);
+    memory_region_init_ram_ptr(uc, ram, NULL, NULL, size, ptr);
     ram->perms = perms;
     if (ram->ram_addr == -1)
         // out of memory
@@ -82,7 +86,8 @@ MemoryRegion *memory_map_ptr(struct uc_struct *uc, hwaddr begin, size_t size, ui
 
     memory_region_add_subregion(get_system_memory(uc), begin, ram);
 
-    if (uc->current_cpu)
+    // in a batch, the TLB is flushed when the batch is committed
+    if (uc->current_cpu && !uc->memory_region_transaction_depth)
         tlb_flush(uc->current_cpu, 1);
 
     return ram;
@@ -90,56 +95,72 @@ MemoryRegion *memory_map_ptr(struct uc_struct *uc, hwaddr begin, size_t size, ui
 
 static void memory_region_update_container_subregions(MemoryRegion *subregion);
 
+// free a region taken out of the memory map, once no flat view holds it
+static void memory_region_free_unmapped(MemoryRegion *mr)
+{
+    Object *obj = OBJECT(mr);
+
+    if (mr->ops != &unassigned_mem_ops) {
+        g_free(mr->ops);
+    }
+    g_free(mr->page_perms);
+    mr->destructor(mr);
+    obj->ref = 1;
+    obj->free = g_free;
+    object_unref(mr->uc, obj);
+}
+
 void memory_unmap(struct uc_struct *uc, MemoryRegion *mr)
 {
     int i;
     target_ulong addr;
-    Object *obj;
+    MemoryRegion **regions;
 
     // Make sure all pages associated with the MemoryRegion are flushed
-    // Only need to do this if we are in a running state
-    if (uc->current_cpu) {
+    // Only need to do this if we are in a running state; in a batch, the
+    // whole TLB is flushed when the batch is committed
+    if (uc->current_cpu && !uc->memory_region_transaction_depth) {
         for (addr = mr->addr; addr < mr->end; addr += uc->target_page_size) {
            tlb_flush_page(uc->current_cpu, addr);
         }
     }
+    // Translated code survives across uc_emu_start(), so drop the blocks
+    // of this region before its RAM offsets can be handed out again
+    if (memory_region_is_ram(mr)) {
+        tb_invalidate_phys_range(uc, mr->ram_addr,
+                mr->ram_addr + int128_get64(mr->size), 0);
+    }
     memory_region_del_subregion(get_system_memory(uc), mr);
 
-    for (i = 0; i < uc->mapped_block_count; i++) {
-        if (uc->mapped_blocks[i] == mr) {
-            uc->mapped_block_count--;
-            //shift remainder of array down over deleted pointer
-            memmove(&uc->mapped_blocks[i], &uc->mapped_blocks[i + 1], sizeof(MemoryRegion*) * (uc->mapped_block_count - i));
-            if (mr->ops != &unassigned_mem_ops) {
-                g_free(mr->ops);
-            }
-            mr->destructor(mr);
-            obj = OBJECT(mr);
-            obj->ref = 1;
-            obj->free = g_free;
-            g_free((char *)mr->name);
-            mr->name = NULL;
-            object_property_del_child(mr->uc, qdev_get_machine(mr->uc), obj, &error_abort);
-            break;
+    i = bsearch_mapped_blocks(uc, mr->addr);
+    if (i < uc->mapped_block_count && uc->mapped_blocks[i] == mr) {
+        uc->mapped_block_count--;
+        //shift remainder of array down over deleted pointer
+        memmove(&uc->mapped_blocks[i], &uc->mapped_blocks[i + 1], sizeof(MemoryRegion*) * (uc->mapped_block_count - i));
+        if (!uc->memory_region_transaction_depth) {
+            memory_region_free_unmapped(mr);
+            return;
+        }
+        // the flat view keeps the region until the batch is committed
+        if ((uc->unmapped_block_count & (MEM_BLOCK_INCR - 1)) == 0) {
+            regions = (MemoryRegion**)g_realloc(uc->unmapped_blocks,
+                    sizeof(MemoryRegion*) * (uc->unmapped_block_count + MEM_BLOCK_INCR));
+            uc->unmapped_blocks = regions;
         }
+        uc->unmapped_blocks[uc->unmapped_block_count++] = mr;
     }
 }
 
 int memory_free(struct uc_struct *uc)
 {
     MemoryRegion *mr;
-    Object *obj;
     int i;
 
     for (i = 0; i < uc->mapped_block_count; i++) {
         mr = uc->mapped_blocks[i];
         mr->enabled = false;
         memory_region_del_subregion(get_system_memory(uc), mr);
-        mr->destructor(mr);
-        obj = OBJECT(mr);
-        obj->ref = 1;
-        obj->free = g_free;
-        object_property_del_child(mr->uc, qdev_get_machine(mr->uc), obj, &error_abort);
+        memory_region_free_unmapped(mr);
     }
 
     return 0;
@@ -537,6 +558,82 @@ static AddressSpace *memory_region_to_address_space(MemoryRegion *mr)
     return NULL;
 }
 
+/* Return the index of the first range of @view ending after @addr. */
+static unsigned flatview_find(FlatView *view, Int128 addr)
+{
+    unsigned left = 0, right = view->nr, mid;
+
+    while (left < right) {
+        mid = left + (right - left) / 2;
+        if (int128_le(addrrange_end(view->ranges[mid].addr), addr)) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+
+    return left;
+}
+
+static void render_memory_region(FlatView *view,
+                                 MemoryRegion *mr,
+                                 Int128 base,
+                                 AddrRange clip,
+                                 bool readonly);
+
+static int subregion_addr_cmp(const void *a, const void *b)
+{
+    const MemoryRegion *r1 = *(MemoryRegion *const *)a;
+    const MemoryRegion *r2 = *(MemoryRegion *const *)b;
+
+    return r1->addr < r2->addr ? -1 : r1->addr > r2->addr;
+}
+
+/* Subregions that do not overlap render the same in any order, and
+ * rendering them by address puts each one right after the ranges of the
+ * previous one, instead of among the ranges of all those rendered before.
+ * Return false, having rendered nothing, if some of them overlap.
+ */
+static bool render_subregions_by_addr(FlatView *view,
+                                      MemoryRegion *mr,
+                                      Int128 base,
+                                      AddrRange clip,
+                                      bool readonly)
+{
+    MemoryRegion *subregion, **sorted;
+    unsigned i, n = 0;
+
+    QTAILQ_FOREACH(subregion, &mr->subregions, subregions_link) {
+        ++n;
+    }
+    if (n < 2) {
+        return false;
+    }
+
+    sorted = g_new(MemoryRegion *, n);
+    n = 0;
+    QTAILQ_FOREACH(subregion, &mr->subregions, subregions_link) {
+        sorted[n++] = subregion;
+    }
+    qsort(sorted, n, sizeof(*sorted), subregion_addr_cmp);
+
+    for (i = 1; i < n; ++i) {
+        if (int128_gt(int128_add(int128_make64(sorted[i - 1]->addr),
+                                 sorted[i - 1]->size),
+                      int128_make64(sorted[i]->addr))) {
+            g_free(sorted);
+            return false;
+        }
+    }
+
+    for (i = 0; i < n; ++i) {
+        render_memory_region(view, sorted[i], base, clip, readonly);
+    }
+    g_free(sorted);
+
+    return true;
+}
+
 /* Render a memory region into the global view.  Ranges in @view obscure
  * ranges in @mr.
  */
@@ -577,8 +674,10 @@ static void render_memory_region(FlatView *view,
     }
 
     /* Render subregions in priority order. */
-    QTAILQ_FOREACH(subregion, &mr->subregions, subregions_link) {
-        render_memory_region(view, subregion, base, clip, readonly);
+    if (!render_subregions_by_addr(view, mr, base, clip, readonly)) {
+        QTAILQ_FOREACH(subregion, &mr->subregions, subregions_link) {
+            render_memory_region(view, subregion, base, clip, readonly);
+        }
     }
 
     if (!mr->terminates) {
@@ -595,7 +694,7 @@ static void render_memory_region(FlatView *view,
     fr.readonly = readonly;
 
     /* Render the region itself into any gaps left by the current view. */
-    for (i = 0; i < view->nr && int128_nz(remain); ++i) {
+    for (i = flatview_find(view, base); i < view->nr && int128_nz(remain); ++i) {
         if (int128_ge(base, addrrange_end(view->ranges[i].addr))) {
             continue;
         }
@@ -761,6 +860,11 @@ void memory_region_transaction_commit(struct uc_struct *uc)
             MEMORY_LISTENER_CALL_GLOBAL(commit, Forward);
         }
         memory_region_clear_pending(uc);
+
+        // the regions unmapped in the batch are out of the flat views now
+        while (uc->unmapped_block_count) {
+            memory_region_free_unmapped(uc->unmapped_blocks[--uc->unmapped_block_count]);
+        }
    }
 }
 
@@ -1093,9 +1197,8 @@ void memory_region_init_ram(struct uc_struct *uc, MemoryRegion *mr,
 {
     memory_region_init(uc, mr, owner, name, size);
     mr->ram = true;
-    if (!(perms & UC_PROT_WRITE)) {
-        mr->readonly = true;
-    }
+    // writes are checked against the permissions of each page when the
+    // TLB is filled, not against the region being read-only
     mr->perms = perms;
     mr->terminates = true;
     mr->destructor = memory_region_destructor_ram;
@@ -1195,6 +1298,10 @@ uint64_t memory_region_size(MemoryRegion *mr)
 
 const char *memory_region_name(const MemoryRegion *mr)
 {
+    // Unicorn: mapped regions are unnamed, and not children of any object
+    if (!mr->name && !OBJECT(mr)->parent) {
+        return "";
+    }
     if (!mr->name) {
         ((MemoryRegion *)mr)->name =
             object_get_canonical_path_component(OBJECT(mr));
@@ -1277,13 +1384,16 @@ void *memory_region_get_ram_ptr(MemoryRegion *mr)
 
 static void memory_region_update_container_subregions(MemoryRegion *subregion)
 {
-    hwaddr offset = subregion->addr;
     MemoryRegion *mr = subregion->container;
     MemoryRegion *other;
 
     memory_region_transaction_begin(mr->uc);
 
     memory_region_ref(subregion);
+    // the collision check only warned, and scanned all the subregions for
+    // every one added
+#if 0
+    hwaddr offset = subregion->addr;
     QTAILQ_FOREACH(other, &mr->subregions, subregions_link) {
         if (subregion->may_overlap || other->may_overlap) {
             continue;
@@ -1294,7 +1404,6 @@ static void memory_region_update_container_subregions(MemoryRegion *subregion)
                          int128_make64(other->addr))) {
             continue;
         }
-#if 0
         printf("warning: subregion collision %llx/%llx (%s) "
                "vs %llx/%llx (%s)\n",
                (unsigned long long)offset,
@@ -1303,8 +1412,8 @@ static void memory_region_update_container_subregions(MemoryRegion *subregion)
                (unsigned long long)other->addr,
                (unsigned long long)int128_get64(other->size),
                other->name);
-#endif
     }
+#endif
     QTAILQ_FOREACH(other, &mr->subregions, subregions_link) {
         if (subregion->priority >= other->priority) {
             QTAILQ_INSERT_BEFORE(other, subregion, subregions_link);
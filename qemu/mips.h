@@ -1,8 +1,8 @@
 /* Autogen header for Unicorn Engine - DONOT MODIFY */
 #ifndef UNICORN_AUTOGEN_MIPS_H
 #define UNICORN_AUTOGEN_MIPS_H
-#define tci_tb_ptr tci_tb_ptr_mips
 #define tcg_qemu_tb_exec tcg_qemu_tb_exec_mips
+#define tci_op_entry tci_op_entry_mips
 #define arm_release arm_release_mips
 #define aarch64_tb_set_jmp_target aarch64_tb_set_jmp_target_mips
 #define ppc_tb_set_jmp_target ppc_tb_set_jmp_target_mips
@@ -2049,6 +2049,7 @@
 #define memory_region_is_iommu memory_region_is_iommu_mips
 #define memory_region_is_logging memory_region_is_logging_mips
 #define memory_region_is_mapped memory_region_is_mapped_mips
+#define memory_region_is_prealloc memory_region_is_prealloc_mips
 #define memory_region_is_ram memory_region_is_ram_mips
 #define memory_region_is_rom memory_region_is_rom_mips
 #define memory_region_is_romd memory_region_is_romd_mips
@@ -2647,6 +2648,8 @@
 #define tb_add_jump tb_add_jump_mips
 #define tb_alloc tb_alloc_mips
 #define tb_alloc_page tb_alloc_page_mips
+#define tb_cache_query tb_cache_query_mips
+#define tb_cache_resize tb_cache_resize_mips
 #define tb_check_watchpoint tb_check_watchpoint_mips
 #define tb_find_fast tb_find_fast_mips
 #define tb_find_pc tb_find_pc_mips
@@ -1,8 +1,8 @@
 /* Autogen header for Unicorn Engine - DONOT MODIFY */
 #ifndef UNICORN_AUTOGEN_MIPS64_H
 #define UNICORN_AUTOGEN_MIPS64_H
-#define tci_tb_ptr tci_tb_ptr_mips64
 #define tcg_qemu_tb_exec tcg_qemu_tb_exec_mips64
+#define tci_op_entry tci_op_entry_mips64
 #define arm_release arm_release_mips64
 #define aarch64_tb_set_jmp_target aarch64_tb_set_jmp_target_mips64
 #define ppc_tb_set_jmp_target ppc_tb_set_jmp_target_mips64
@@ -2049,6 +2049,7 @@
 #define memory_region_is_iommu memory_region_is_iommu_mips64
 #define memory_region_is_logging memory_region_is_logging_mips64
 #define memory_region_is_mapped memory_region_is_mapped_mips64
+#define memory_region_is_prealloc memory_region_is_prealloc_mips64
 #define memory_region_is_ram memory_region_is_ram_mips64
 #define memory_region_is_rom memory_region_is_rom_mips64
 #define memory_region_is_romd memory_region_is_romd_mips64
@@ -2647,6 +2648,8 @@
 #define tb_add_jump tb_add_jump_mips64
 #define tb_alloc tb_alloc_mips64
 #define tb_alloc_page tb_alloc_page_mips64
+#define tb_cache_query tb_cache_query_mips64
+#define tb_cache_resize tb_cache_resize_mips64
 #define tb_check_watchpoint tb_check_watchpoint_mips64
 #define tb_find_fast tb_find_fast_mips64
 #define tb_find_pc tb_find_pc_mips64
@@ -1,8 +1,8 @@
 /* Autogen header for Unicorn Engine - DONOT MODIFY */
 #ifndef UNICORN_AUTOGEN_MIPSEL_H
 #define UNICORN_AUTOGEN_MIPSEL_H
-#define tci_tb_ptr tci_tb_ptr_mipsel
 #define tcg_qemu_tb_exec tcg_qemu_tb_exec_mipsel
+#define tci_op_entry tci_op_entry_mipsel
 #define arm_release arm_release_mipsel
 #define aarch64_tb_set_jmp_target aarch64_tb_set_jmp_target_mipsel
 #define ppc_tb_set_jmp_target ppc_tb_set_jmp_target_mipsel
@@ -2049,6 +2049,7 @@
 #define memory_region_is_iommu memory_region_is_iommu_mipsel
 #define memory_region_is_logging memory_region_is_logging_mipsel
 #define memory_region_is_mapped memory_region_is_mapped_mipsel
+#define memory_region_is_prealloc memory_region_is_prealloc_mipsel
 #define memory_region_is_ram memory_region_is_ram_mipsel
 #define memory_region_is_rom memory_region_is_rom_mipsel
 #define memory_region_is_romd memory_region_is_romd_mipsel
@@ -2647,6 +2648,8 @@
 #define tb_add_jump tb_add_jump_mipsel
 #define tb_alloc tb_alloc_mipsel
 #define tb_alloc_page tb_alloc_page_mipsel
+#define tb_cache_query tb_cache_query_mipsel
+#define tb_cache_resize tb_cache_resize_mipsel
 #define tb_check_watchpoint tb_check_watchpoint_mipsel
 #define tb_find_fast tb_find_fast_mipsel
 #define tb_find_pc tb_find_pc_mipsel
@@ -77,6 +77,14 @@
 #define ADDR_READ addr_read
 #endif
 
+/* Unicorn: code is fetched while translating, data is accessed from a
+   running block which must stop at the faulting instruction */
+#ifdef SOFTMMU_CODE_ACCESS
+# define MEM_FAULT_EXIT(env, retaddr) cpu_exit(ENV_GET_CPU(env))
+#else
+# define MEM_FAULT_EXIT(env, retaddr) uc_mem_access_fault(env, retaddr)
+#endif
+
 #if DATA_SIZE == 8
 # define BSWAP(X)  bswap64(X)
 #elif DATA_SIZE == 4
@@ -155,6 +163,62 @@ static inline bool victim_tlb_hit_write(CPUArchState *env, target_ulong addr, in
 }
 #endif // victim_tlb_hit_funcs
 
+#ifndef tlb_hit_ram_funcs
+#define tlb_hit_ram_funcs
+/* Unicorn: tlb_set_page() keeps RAM without UC_PROT_READ out of the read
+   TLB and non-writable RAM behind TLB_MMIO, so an access hitting a plain
+   RAM entry is mapped and allowed by the region permissions: the helpers
+   look the region up only when they miss. */
+static inline bool tlb_hit_ram_read(CPUArchState *env, target_ulong addr, int mmu_idx, int index)
+{
+    CPUTLBEntry *te = &env->tlb_table[mmu_idx][index];
+
+    return te->addr_read == (addr & TARGET_PAGE_MASK) && te->addend != -1;
+}
+
+static inline bool tlb_hit_ram_write(CPUArchState *env, target_ulong addr, int mmu_idx, int index)
+{
+    CPUTLBEntry *te = &env->tlb_table[mmu_idx][index];
+
+    return (te->addr_write & ~TLB_NOTDIRTY) == (addr & TARGET_PAGE_MASK) && te->addend != -1;
+}
+
+/* Unicorn: permissions of the page of @addr in @mr, as memory_mapping()
+   found it */
+static inline uint32_t uc_page_perms(struct uc_struct *uc, MemoryRegion *mr, target_ulong addr)
+{
+    uint64_t address = addr;
+
+    if (mr->page_perms == NULL) {
+        return mr->perms;
+    }
+    if (uc->mem_redirect) {
+        address = uc->mem_redirect(address);
+    }
+    return memory_region_page_perms(mr, address - mr->addr);
+}
+
+/* Unicorn: stop at an invalid data access. Blocks check for an exit
+   request after their memory accesses only when a hook or an MMIO callback
+   may stop emulation there, so unwind to the faulting instruction instead
+   of returning into the rest of the block. */
+static inline void uc_mem_access_fault(CPUArchState *env, uintptr_t retaddr)
+{
+    CPUState *cpu = ENV_GET_CPU(env);
+
+    if (cpu->current_tb == NULL) {
+        // not running a block, e.g. a helper called by uc_reg_write()
+        cpu_exit(cpu);
+        return;
+    }
+    if (retaddr) {
+        cpu_restore_state(cpu, retaddr);
+    }
+    cpu->exception_index = EXCP_INTERRUPT;
+    cpu_loop_exit(cpu);
+}
+#endif // tlb_hit_ram_funcs
+
 #ifndef SOFTMMU_CODE_ACCESS
 static inline DATA_TYPE glue(io_read, SUFFIX)(CPUArchState *env,
                                               hwaddr physaddr,
@@ -191,31 +255,32 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
     int error_code;
     struct hook *hook;
     bool handled;
-    HOOK_FOREACH_VAR_DECLARE;
+    HOOK_FOREACH_ADDR_VAR_DECLARE;
 
     struct uc_struct *uc = env->uc;
-    MemoryRegion *mr = memory_mapping(uc, addr);
+#if defined(SOFTMMU_CODE_ACCESS)
+    bool tlb_hit = false;   // code TLB entries do not follow UC_PROT_EXEC
+#else
+    bool tlb_hit = tlb_hit_ram_read(env, addr, mmu_idx, index);
+#endif
+    MemoryRegion *mr = tlb_hit ? NULL : memory_mapping(uc, addr);
 
     // memory might be still unmapped while reading or fetching
-    if (mr == NULL) {
+    if (mr == NULL && !tlb_hit) {
         handled = false;
 #if defined(SOFTMMU_CODE_ACCESS)
         error_code = UC_ERR_FETCH_UNMAPPED;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_FETCH_UNMAPPED) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_FETCH_UNMAPPED, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_FETCH_UNMAPPED, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
 #else
         error_code = UC_ERR_READ_UNMAPPED;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ_UNMAPPED) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_READ_UNMAPPED, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_READ_UNMAPPED, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
@@ -227,20 +292,18 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
             env->invalid_addr = addr;
             env->invalid_error = error_code;
             // printf("***** Invalid fetch (unmapped memory) at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return 0;
         }
     }
 
 #if defined(SOFTMMU_CODE_ACCESS)
     // Unicorn: callback on fetch from NX
-    if (mr != NULL && !(mr->perms & UC_PROT_EXEC)) {  // non-executable
+    if (mr != NULL && !(uc_page_perms(uc, mr, addr) & UC_PROT_EXEC)) {  // non-executable
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_FETCH_PROT) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_FETCH_PROT, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_FETCH_PROT, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
@@ -251,7 +314,7 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_FETCH_PROT;
             // printf("***** Invalid fetch (non-executable) at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return 0;
         }
     }
@@ -264,24 +327,20 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
     // about successful read
     if (READ_ACCESS_TYPE == MMU_DATA_LOAD) {
         if (!uc->size_recur_mem) { // disabling read callback if in recursive call
-            HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ) {
+            HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_READ, addr) {
               if (hook->to_delete)
                   continue;
-              if (!HOOK_BOUND_CHECK(hook, addr))
-                    continue;
                 ((uc_cb_hookmem_t)hook->callback)(env->uc, UC_MEM_READ, addr, DATA_SIZE, 0, hook->user_data);
             }
         }
     }
 
     // Unicorn: callback on non-readable memory
-    if (READ_ACCESS_TYPE == MMU_DATA_LOAD && mr != NULL && !(mr->perms & UC_PROT_READ)) {  //non-readable
+    if (READ_ACCESS_TYPE == MMU_DATA_LOAD && mr != NULL && !(uc_page_perms(uc, mr, addr) & UC_PROT_READ)) {  //non-readable
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ_PROT) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_READ_PROT, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_READ_PROT, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
@@ -292,7 +351,7 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_READ_PROT;
             // printf("***** Invalid memory read (non-readable) at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return 0;
         }
     }
@@ -316,7 +375,7 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
 #else
             env->invalid_error = UC_ERR_READ_UNALIGNED;
 #endif
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return 0;
         }
 #endif
@@ -325,6 +384,13 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
                      mmu_idx, retaddr);
         }
         tlb_addr = env->tlb_table[mmu_idx][index].ADDR_READ;
+#if !defined(SOFTMMU_CODE_ACCESS)
+        // Unicorn: non-readable RAM stays out of the TLB (see tlb_set_page),
+        // a UC_HOOK_MEM_READ_PROT callback allowed this read above
+        if (tlb_addr == -1 && mr != NULL && memory_region_is_ram(mr)) {
+            tlb_addr = addr & TARGET_PAGE_MASK;
+        }
+#endif
     }
 
     /* Handle an IO access.  */
@@ -338,7 +404,7 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_READ_UNMAPPED;
             // printf("Invalid memory read at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(env->uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return 0;
         } else {
             env->invalid_error = UC_ERR_OK;
@@ -368,7 +434,7 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
 #else
         env->invalid_error = UC_ERR_READ_UNALIGNED;
 #endif
-        cpu_exit(uc->current_cpu);
+        MEM_FAULT_EXIT(env, retaddr);
         return 0;
 #endif
         addr1 = addr & ~(DATA_SIZE - 1);
@@ -398,7 +464,7 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
 #else
         env->invalid_error = UC_ERR_READ_UNALIGNED;
 #endif
-        cpu_exit(uc->current_cpu);
+        MEM_FAULT_EXIT(env, retaddr);
         return 0;
     }
 #endif
@@ -414,11 +480,9 @@ _out:
     // Unicorn: callback on successful read
     if (READ_ACCESS_TYPE == MMU_DATA_LOAD) {
         if (!uc->size_recur_mem) { // disabling read callback if in recursive call
-            HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ_AFTER) {
+            HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_READ_AFTER, addr) {
               if (hook->to_delete)
                   continue;
-              if (!HOOK_BOUND_CHECK(hook, addr))
-                    continue;
                 ((uc_cb_hookmem_t)hook->callback)(env->uc, UC_MEM_READ_AFTER, addr, DATA_SIZE, res, hook->user_data);
             }
         }
@@ -441,31 +505,32 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
     int error_code;
     struct hook *hook;
     bool handled;
-    HOOK_FOREACH_VAR_DECLARE;
+    HOOK_FOREACH_ADDR_VAR_DECLARE;
 
     struct uc_struct *uc = env->uc;
-    MemoryRegion *mr = memory_mapping(uc, addr);
+#if defined(SOFTMMU_CODE_ACCESS)
+    bool tlb_hit = false;   // code TLB entries do not follow UC_PROT_EXEC
+#else
+    bool tlb_hit = tlb_hit_ram_read(env, addr, mmu_idx, index);
+#endif
+    MemoryRegion *mr = tlb_hit ? NULL : memory_mapping(uc, addr);
 
     // memory can be unmapped while reading or fetching
-    if (mr == NULL) {
+    if (mr == NULL && !tlb_hit) {
         handled = false;
 #if defined(SOFTMMU_CODE_ACCESS)
         error_code = UC_ERR_FETCH_UNMAPPED;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_FETCH_UNMAPPED) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_FETCH_UNMAPPED, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_FETCH_UNMAPPED, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
 #else
         error_code = UC_ERR_READ_UNMAPPED;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ_UNMAPPED) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_READ_UNMAPPED, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_READ_UNMAPPED, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
@@ -477,20 +542,18 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
             env->invalid_addr = addr;
             env->invalid_error = error_code;
             // printf("***** Invalid fetch (unmapped memory) at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return 0;
         }
     }
 
 #if defined(SOFTMMU_CODE_ACCESS)
     // Unicorn: callback on fetch from NX
-    if (mr != NULL && !(mr->perms & UC_PROT_EXEC)) {  // non-executable
+    if (mr != NULL && !(uc_page_perms(uc, mr, addr) & UC_PROT_EXEC)) {  // non-executable
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_FETCH_PROT) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_FETCH_PROT, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_FETCH_PROT, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
@@ -501,7 +564,7 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_FETCH_PROT;
             // printf("***** Invalid fetch (non-executable) at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return 0;
         }
     }
@@ -514,24 +577,20 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
     // about successful read
     if (READ_ACCESS_TYPE == MMU_DATA_LOAD) {
         if (!uc->size_recur_mem) { // disabling read callback if in recursive call
-            HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ) {
+            HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_READ, addr) {
               if (hook->to_delete)
                   continue;
-              if (!HOOK_BOUND_CHECK(hook, addr))
-                    continue;
                 ((uc_cb_hookmem_t)hook->callback)(env->uc, UC_MEM_READ, addr, DATA_SIZE, 0, hook->user_data);
             }
         }
     }
 
     // Unicorn: callback on non-readable memory
-    if (READ_ACCESS_TYPE == MMU_DATA_LOAD && mr != NULL && !(mr->perms & UC_PROT_READ)) {  //non-readable
+    if (READ_ACCESS_TYPE == MMU_DATA_LOAD && mr != NULL && !(uc_page_perms(uc, mr, addr) & UC_PROT_READ)) {  //non-readable
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ_PROT) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_READ_PROT, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_READ_PROT, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
@@ -542,7 +601,7 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_READ_PROT;
             // printf("***** Invalid memory read (non-readable) at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return 0;
         }
     }
@@ -566,7 +625,7 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
 #else
             env->invalid_error = UC_ERR_READ_UNALIGNED;
 #endif
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return 0;
         }
 #endif
@@ -575,6 +634,13 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
                      mmu_idx, retaddr);
         }
         tlb_addr = env->tlb_table[mmu_idx][index].ADDR_READ;
+#if !defined(SOFTMMU_CODE_ACCESS)
+        // Unicorn: non-readable RAM stays out of the TLB (see tlb_set_page),
+        // a UC_HOOK_MEM_READ_PROT callback allowed this read above
+        if (tlb_addr == -1 && mr != NULL && memory_region_is_ram(mr)) {
+            tlb_addr = addr & TARGET_PAGE_MASK;
+        }
+#endif
     }
 
     /* Handle an IO access.  */
@@ -589,7 +655,7 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_READ_UNMAPPED;
             // printf("Invalid memory read at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(env->uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return 0;
         }
 
@@ -617,7 +683,7 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
 #else
         env->invalid_error = UC_ERR_READ_UNALIGNED;
 #endif
-        cpu_exit(uc->current_cpu);
+        MEM_FAULT_EXIT(env, retaddr);
         return 0;
 #endif
         addr1 = addr & ~(DATA_SIZE - 1);
@@ -647,7 +713,7 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
 #else
         env->invalid_error = UC_ERR_READ_UNALIGNED;
 #endif
-        cpu_exit(uc->current_cpu);
+        MEM_FAULT_EXIT(env, retaddr);
         return 0;
     }
 #endif
@@ -659,11 +725,9 @@ _out:
     // Unicorn: callback on successful read
     if (READ_ACCESS_TYPE == MMU_DATA_LOAD) {
         if (!uc->size_recur_mem) { // disabling read callback if in recursive call
-            HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ_AFTER) {
+            HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_READ_AFTER, addr) {
               if (hook->to_delete)
                   continue;
-              if (!HOOK_BOUND_CHECK(hook, addr))
-                    continue;
                 ((uc_cb_hookmem_t)hook->callback)(env->uc, UC_MEM_READ_AFTER, addr, DATA_SIZE, res, hook->user_data);
             }
         }
@@ -728,30 +792,27 @@ void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
     uintptr_t haddr;
     struct hook *hook;
     bool handled;
-    HOOK_FOREACH_VAR_DECLARE;
+    HOOK_FOREACH_ADDR_VAR_DECLARE;
 
     struct uc_struct *uc = env->uc;
-    MemoryRegion *mr = memory_mapping(uc, addr);
+    bool tlb_hit = tlb_hit_ram_write(env, addr, mmu_idx, index);
+    MemoryRegion *mr = tlb_hit ? NULL : memory_mapping(uc, addr);
 
     if (!uc->size_recur_mem) { // disabling write callback if in recursive call
         // Unicorn: callback on memory write
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_WRITE) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_WRITE, addr) {
           if (hook->to_delete)
               continue;
-          if (!HOOK_BOUND_CHECK(hook, addr))
-              continue;
             ((uc_cb_hookmem_t)hook->callback)(uc, UC_MEM_WRITE, addr, DATA_SIZE, val, hook->user_data);
         }
     }
 
     // Unicorn: callback on invalid memory
-    if (mr == NULL) {
+    if (mr == NULL && !tlb_hit) {
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_WRITE_UNMAPPED) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_WRITE_UNMAPPED, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_WRITE_UNMAPPED, addr, DATA_SIZE, val, hook->user_data)))
                 break;
         }
@@ -761,7 +822,7 @@ void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_WRITE_UNMAPPED;
             // printf("***** Invalid memory write at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return;
         } else {
             env->invalid_error = UC_ERR_OK;
@@ -770,13 +831,11 @@ void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
     }
 
     // Unicorn: callback on non-writable memory
-    if (mr != NULL && !(mr->perms & UC_PROT_WRITE)) {  //non-writable
+    if (mr != NULL && !(uc_page_perms(uc, mr, addr) & UC_PROT_WRITE)) {  //non-writable
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_WRITE_PROT) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_WRITE_PROT, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_WRITE_PROT, addr, DATA_SIZE, val, hook->user_data)))
                 break;
         }
@@ -787,7 +846,7 @@ void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_WRITE_PROT;
             // printf("***** Invalid memory write (ro) at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return;
         }
     }
@@ -804,7 +863,7 @@ void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
             //                     mmu_idx, retaddr);
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_WRITE_UNALIGNED;
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return;
         }
 #endif
@@ -825,7 +884,7 @@ void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_WRITE_UNMAPPED;
             // printf("***** Invalid memory write at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(env->uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return;
         }
 
@@ -847,7 +906,7 @@ void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
                              mmu_idx, retaddr);
         env->invalid_addr = addr;
         env->invalid_error = UC_ERR_WRITE_UNALIGNED;
-        cpu_exit(uc->current_cpu);
+        MEM_FAULT_EXIT(env, retaddr);
         return;
 #endif
         /* XXX: not efficient, but simple */
@@ -876,7 +935,7 @@ void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
                              mmu_idx, retaddr);
         env->invalid_addr = addr;
         env->invalid_error = UC_ERR_WRITE_UNALIGNED;
-        cpu_exit(uc->current_cpu);
+        MEM_FAULT_EXIT(env, retaddr);
         return;
     }
 #endif
@@ -898,30 +957,27 @@ void helper_be_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
     uintptr_t haddr;
     struct hook *hook;
     bool handled;
-    HOOK_FOREACH_VAR_DECLARE;
+    HOOK_FOREACH_ADDR_VAR_DECLARE;
 
     struct uc_struct *uc = env->uc;
-    MemoryRegion *mr = memory_mapping(uc, addr);
+    bool tlb_hit = tlb_hit_ram_write(env, addr, mmu_idx, index);
+    MemoryRegion *mr = tlb_hit ? NULL : memory_mapping(uc, addr);
 
     if (!uc->size_recur_mem) { // disabling write callback if in recursive call
         // Unicorn: callback on memory write
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_WRITE) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_WRITE, addr) {
           if (hook->to_delete)
               continue;
-          if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             ((uc_cb_hookmem_t)hook->callback)(uc, UC_MEM_WRITE, addr, DATA_SIZE, val, hook->user_data);
         }
     }
 
     // Unicorn: callback on invalid memory
-    if (mr == NULL) {
+    if (mr == NULL && !tlb_hit) {
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_WRITE_UNMAPPED) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_WRITE_UNMAPPED, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_WRITE_UNMAPPED, addr, DATA_SIZE, val, hook->user_data)))
                 break;
         }
@@ -931,7 +987,7 @@ void helper_be_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_WRITE_UNMAPPED;
             // printf("***** Invalid memory write at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return;
         } else {
             env->invalid_error = UC_ERR_OK;
@@ -940,13 +996,11 @@ void helper_be_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
     }
 
     // Unicorn: callback on non-writable memory
-    if (mr != NULL && !(mr->perms & UC_PROT_WRITE)) {  //non-writable
+    if (mr != NULL && !(uc_page_perms(uc, mr, addr) & UC_PROT_WRITE)) {  //non-writable
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_WRITE_PROT) {
+        HOOK_FOREACH_ADDR(uc, hook, UC_HOOK_MEM_WRITE_PROT, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
             if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_WRITE_PROT, addr, DATA_SIZE, val, hook->user_data)))
                 break;
         }
@@ -957,7 +1011,7 @@ void helper_be_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_WRITE_PROT;
             // printf("***** Invalid memory write (ro) at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return;
         }
     }
@@ -974,7 +1028,7 @@ void helper_be_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
                                  mmu_idx, retaddr);
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_WRITE_UNALIGNED;
-            cpu_exit(uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return;
         }
 #endif
@@ -995,7 +1049,7 @@ void helper_be_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
             env->invalid_addr = addr;
             env->invalid_error = UC_ERR_WRITE_UNMAPPED;
             // printf("***** Invalid memory write at " TARGET_FMT_lx "\n", addr);
-            cpu_exit(env->uc->current_cpu);
+            MEM_FAULT_EXIT(env, retaddr);
             return;
         }
 
@@ -1017,7 +1071,7 @@ void helper_be_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
                              mmu_idx, retaddr);
         env->invalid_addr = addr;
         env->invalid_error = UC_ERR_WRITE_UNALIGNED;
-        cpu_exit(uc->current_cpu);
+        MEM_FAULT_EXIT(env, retaddr);
         return;
 #endif
         /* XXX: not efficient, but simple */
@@ -1046,7 +1100,7 @@ void helper_be_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
                              mmu_idx, retaddr);
         env->invalid_addr = addr;
         env->invalid_error = UC_ERR_WRITE_UNALIGNED;
-        cpu_exit(uc->current_cpu);
+        MEM_FAULT_EXIT(env, retaddr);
         return;
     }
 #endif
@@ -1066,6 +1120,7 @@ glue(glue(helper_st, SUFFIX), MMUSUFFIX)(CPUArchState *env, target_ulong addr,
 #endif /* !defined(SOFTMMU_CODE_ACCESS) */
 
 #undef READ_ACCESS_TYPE
+#undef MEM_FAULT_EXIT
 #undef SHIFT
 #undef DATA_TYPE
 #undef SUFFIX
@@ -1,8 +1,8 @@
 /* Autogen header for Unicorn Engine - DONOT MODIFY */
 #ifndef UNICORN_AUTOGEN_SPARC64_H
 #define UNICORN_AUTOGEN_SPARC64_H
-#define tci_tb_ptr tci_tb_ptr_sparc64
 #define tcg_qemu_tb_exec tcg_qemu_tb_exec_sparc64
+#define tci_op_entry tci_op_entry_sparc64
 #define arm_release arm_release_sparc64
 #define aarch64_tb_set_jmp_target aarch64_tb_set_jmp_target_sparc64
 #define ppc_tb_set_jmp_target ppc_tb_set_jmp_target_sparc64
@@ -2049,6 +2049,7 @@
 #define memory_region_is_iommu memory_region_is_iommu_sparc64
 #define memory_region_is_logging memory_region_is_logging_sparc64
 #define memory_region_is_mapped memory_region_is_mapped_sparc64
+#define memory_region_is_prealloc memory_region_is_prealloc_sparc64
 #define memory_region_is_ram memory_region_is_ram_sparc64
 #define memory_region_is_rom memory_region_is_rom_sparc64
 #define memory_region_is_romd memory_region_is_romd_sparc64
@@ -2647,6 +2648,8 @@
 #define tb_add_jump tb_add_jump_sparc64
 #define tb_alloc tb_alloc_sparc64
 #define tb_alloc_page tb_alloc_page_sparc64
+#define tb_cache_query tb_cache_query_sparc64
+#define tb_cache_resize tb_cache_resize_sparc64
 #define tb_check_watchpoint tb_check_watchpoint_sparc64
 #define tb_find_fast tb_find_fast_sparc64
 #define tb_find_pc tb_find_pc_sparc64
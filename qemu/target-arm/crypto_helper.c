@@ -15,6 +15,7 @@
 #include "exec/exec-all.h"
 #include "exec/helper-proto.h"
 #include "qemu/aes.h"
+#include "qemu/host-crypto.h"
 
 union CRYPTO_STATE {
     uint8_t    bytes[16];
@@ -39,13 +40,17 @@ void HELPER(crypto_aese)(CPUARMState *env, uint32_t rd, uint32_t rm,
 
     assert(decrypt < 2);
 
-    /* xor state vector with round key */
-    rk.l[0] ^= st.l[0];
-    rk.l[1] ^= st.l[1];
+    if (host_crypto_aes) {
+        host_aes_sub_shift(st.bytes, st.bytes, rk.bytes, decrypt);
+    } else {
+        /* xor state vector with round key */
+        rk.l[0] ^= st.l[0];
+        rk.l[1] ^= st.l[1];
 
-    /* combine ShiftRows operation and sbox substitution */
-    for (i = 0; i < 16; i++) {
-        st.bytes[i] = sbox[decrypt][rk.bytes[shift[decrypt][i]]];
+        /* combine ShiftRows operation and sbox substitution */
+        for (i = 0; i < 16; i++) {
+            st.bytes[i] = sbox[decrypt][rk.bytes[shift[decrypt][i]]];
+        }
     }
 
     env->vfp.regs[rd] = make_float64(st.l[0]);
@@ -195,12 +200,16 @@ void HELPER(crypto_aesmc)(CPUARMState *env, uint32_t rd, uint32_t rm,
 
     assert(decrypt < 2);
 
-    for (i = 0; i < 16; i += 4) {
-        st.words[i >> 2] = cpu_to_le32(
-            mc[decrypt][st.bytes[i]] ^
-            rol32(mc[decrypt][st.bytes[i + 1]], 8) ^
-            rol32(mc[decrypt][st.bytes[i + 2]], 16) ^
-            rol32(mc[decrypt][st.bytes[i + 3]], 24));
+    if (host_crypto_aes) {
+        host_aes_mix_columns(st.bytes, st.bytes, decrypt);
+    } else {
+        for (i = 0; i < 16; i += 4) {
+            st.words[i >> 2] = cpu_to_le32(
+                mc[decrypt][st.bytes[i]] ^
+                rol32(mc[decrypt][st.bytes[i + 1]], 8) ^
+                rol32(mc[decrypt][st.bytes[i + 2]], 16) ^
+                rol32(mc[decrypt][st.bytes[i + 3]], 24));
+        }
     }
 
     env->vfp.regs[rd] = make_float64(st.l[0]);
@@ -242,6 +251,8 @@ void HELPER(crypto_sha1_3reg)(CPUARMState *env, uint32_t rd, uint32_t rn,
     if (op == 3) { /* sha1su0 */
         d.l[0] ^= d.l[1] ^ m.l[0];
         d.l[1] ^= n.l[0] ^ m.l[1];
+    } else if (host_crypto_sha) {
+        host_sha1_rounds4(d.words, n.words[0], m.words, op);
     } else {
         int i;
 
@@ -344,21 +355,25 @@ void HELPER(crypto_sha256h)(CPUARMState *env, uint32_t rd, uint32_t rn,
     m.l[0] = float64_val(env->vfp.regs[rm]);
     m.l[1] = float64_val(env->vfp.regs[rm + 1]);
 
-    for (i = 0; i < 4; i++) {
-        uint32_t t = cho(n.words[0], n.words[1], n.words[2]) + n.words[3]
-                     + S1(n.words[0]) + m.words[i];
+    if (host_crypto_sha) {
+        host_sha256_rounds4(d.words, n.words, m.words);
+    } else {
+        for (i = 0; i < 4; i++) {
+            uint32_t t = cho(n.words[0], n.words[1], n.words[2]) + n.words[3]
+                         + S1(n.words[0]) + m.words[i];
 
-        n.words[3] = n.words[2];
-        n.words[2] = n.words[1];
-        n.words[1] = n.words[0];
-        n.words[0] = d.words[3] + t;
+            n.words[3] = n.words[2];
+            n.words[2] = n.words[1];
+            n.words[1] = n.words[0];
+            n.words[0] = d.words[3] + t;
 
-        t += maj(d.words[0], d.words[1], d.words[2]) + S0(d.words[0]);
+            t += maj(d.words[0], d.words[1], d.words[2]) + S0(d.words[0]);
 
-        d.words[3] = d.words[2];
-        d.words[2] = d.words[1];
-        d.words[1] = d.words[0];
-        d.words[0] = t;
+            d.words[3] = d.words[2];
+            d.words[2] = d.words[1];
+            d.words[1] = d.words[0];
+            d.words[0] = t;
+        }
     }
 
     env->vfp.regs[rd] = make_float64(d.l[0]);
@@ -380,14 +395,19 @@ void HELPER(crypto_sha256h2)(CPUARMState *env, uint32_t rd, uint32_t rn,
     m.l[0] = float64_val(env->vfp.regs[rm]);
     m.l[1] = float64_val(env->vfp.regs[rm + 1]);
 
-    for (i = 0; i < 4; i++) {
-        uint32_t t = cho(d.words[0], d.words[1], d.words[2]) + d.words[3]
-                     + S1(d.words[0]) + m.words[i];
+    if (host_crypto_sha) {
+        /* the new E to H, from the A to D that SHA256H started with */
+        host_sha256_rounds4(n.words, d.words, m.words);
+    } else {
+        for (i = 0; i < 4; i++) {
+            uint32_t t = cho(d.words[0], d.words[1], d.words[2]) + d.words[3]
+                         + S1(d.words[0]) + m.words[i];
 
-        d.words[3] = d.words[2];
-        d.words[2] = d.words[1];
-        d.words[1] = d.words[0];
-        d.words[0] = n.words[3 - i] + t;
+            d.words[3] = d.words[2];
+            d.words[2] = d.words[1];
+            d.words[1] = d.words[0];
+            d.words[0] = n.words[3 - i] + t;
+        }
     }
 
     env->vfp.regs[rd] = make_float64(d.l[0]);
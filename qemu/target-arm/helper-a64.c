@@ -24,6 +24,7 @@
 #include "qemu/bitops.h"
 #include "internals.h"
 #include "qemu/crc32c.h"
+#include "qemu/host-simd.h"
 
 /* C2.4.7 Multiply and divide */
 /* special cases for 0 and LLONG_MIN are mandated by the standard */
@@ -167,6 +168,18 @@ uint64_t HELPER(simd_tbl)(CPUARMState *env, uint64_t result, uint64_t indices,
      */
     int shift;
 
+#ifdef HOST_SIMD
+    if (host_simd_shuffle) {
+        int i;
+
+        for (i = 0; i < numregs; i++) {
+            result = simd_lookup8(result, indices, &env->vfp.regs[((rn + i) % 32) * 2],
+                                  i * 16, 16);
+        }
+        return result;
+    }
+#endif
+
     for (shift = 0; shift < 64; shift += 8) {
         int index = extract64(indices, shift, 8);
         if (index < 16 * numregs) {
@@ -12,6 +12,8 @@
 #include "cpu.h"
 #include "exec/exec-all.h"
 #include "exec/helper-proto.h"
+#include "qemu/host-crypto.h"
+#include "qemu/host-simd.h"
 
 #define SIGNBIT (uint32_t)0x80000000
 #define SIGNBIT64 ((uint64_t)1 << 63)
@@ -129,8 +131,7 @@ NEON_VOP_BODY(vtype, n)
     NEON_FN(vdest.v3, vsrc2.v1, vsrc2.v2); \
     NEON_FN(vdest.v4, vsrc2.v3, vsrc2.v4); \
 
-#define NEON_POP(name, vtype, n) \
-uint32_t HELPER(glue(neon_,name))(uint32_t arg1, uint32_t arg2) \
+#define NEON_POP_BODY(vtype, n) \
 { \
     uint32_t res; \
     vtype vsrc1; \
@@ -143,6 +144,10 @@ uint32_t HELPER(glue(neon_,name))(uint32_t arg1, uint32_t arg2) \
     return res; \
 }
 
+#define NEON_POP(name, vtype, n) \
+uint32_t HELPER(glue(neon_,name))(uint32_t arg1, uint32_t arg2) \
+NEON_POP_BODY(vtype, n)
+
 /* Unary operators.  */
 #define NEON_VOP1(name, vtype, n) \
 uint32_t HELPER(glue(neon_,name))(uint32_t arg) \
@@ -155,6 +160,237 @@ uint32_t HELPER(glue(neon_,name))(uint32_t arg) \
     return arg; \
 }
 
+/* Host SIMD forms of the operations.  When the host has them, the helpers
+   below return the value of 'simd', built from the neon_simd_* kernels,
+   instead of going through the lanes one at a time.  The kernels must give
+   exactly the result and the QC flag of the C code.  */
+#ifdef HOST_SIMD
+#define NEON_SIMD_IF(cond, simd) do { \
+    if (host_simd && (cond)) { \
+        return (simd); \
+    }} while (0)
+#else
+#define NEON_SIMD_IF(cond, simd) do { } while (0)
+#endif
+#define NEON_SIMD(simd) NEON_SIMD_IF(true, simd)
+
+#define NEON_VOP_SIMD_IF(name, vtype, n, cond, simd) \
+uint32_t HELPER(glue(neon_,name))(uint32_t arg1, uint32_t arg2) \
+{ \
+    NEON_SIMD_IF(cond, simd); \
+    NEON_VOP_BODY(vtype, n) \
+}
+
+#define NEON_VOP_SIMD(name, vtype, n, simd) \
+    NEON_VOP_SIMD_IF(name, vtype, n, true, simd)
+
+#define NEON_VOP_ENV_SIMD(name, vtype, n, simd) \
+uint32_t HELPER(glue(neon_,name))(CPUARMState *env, uint32_t arg1, uint32_t arg2) \
+{ \
+    NEON_SIMD(simd); \
+    NEON_VOP_BODY(vtype, n) \
+}
+
+#define NEON_POP_SIMD(name, vtype, n, simd) \
+uint32_t HELPER(glue(neon_,name))(uint32_t arg1, uint32_t arg2) \
+{ \
+    NEON_SIMD(simd); \
+    NEON_POP_BODY(vtype, n) \
+}
+
+#ifdef HOST_SIMD
+#define NEON_SIMD_OP(name, op) \
+static HOST_SIMD_FN uint32_t neon_simd_##name(uint32_t a, uint32_t b) \
+{ \
+    simd_vec va = simd_from32(a); \
+    simd_vec vb = simd_from32(b); \
+    return simd_to32(op); \
+}
+
+/* Saturating operations set QC when a lane differs from the wrapped one.  */
+#define NEON_SIMD_SAT(name, op, wrap) \
+static HOST_SIMD_FN uint32_t neon_simd_##name(CPUARMState *env, uint32_t a, uint32_t b) \
+{ \
+    simd_vec va = simd_from32(a); \
+    simd_vec vb = simd_from32(b); \
+    uint32_t res = simd_to32(simd_##op(va, vb)); \
+    if (res != simd_to32(simd_##wrap(va, vb))) { \
+        SET_QC(); \
+    } \
+    return res; \
+}
+
+NEON_SIMD_SAT(qadd_u8, adds_u8, add8)
+NEON_SIMD_SAT(qadd_s8, adds_s8, add8)
+NEON_SIMD_SAT(qadd_u16, adds_u16, add16)
+NEON_SIMD_SAT(qadd_s16, adds_s16, add16)
+NEON_SIMD_SAT(qsub_u8, subs_u8, sub8)
+NEON_SIMD_SAT(qsub_s8, subs_s8, sub8)
+NEON_SIMD_SAT(qsub_u16, subs_u16, sub16)
+NEON_SIMD_SAT(qsub_s16, subs_s16, sub16)
+
+/* Halving adds round up in the host; the signed ones are the unsigned ones
+   on inputs with the sign bit flipped.  */
+#define NEON_SIMD_HADD(bits, round, fn, bias) \
+    NEON_SIMD_OP(fn, simd_xor(simd_sub##bits( \
+        simd_avgr_u##bits(simd_xor(va, simd_splat##bits(bias)), \
+                          simd_xor(vb, simd_splat##bits(bias))), \
+        round ? simd_splat##bits(0) : \
+                simd_and(simd_xor(va, vb), simd_splat##bits(1))), \
+        simd_splat##bits(bias)))
+NEON_SIMD_HADD(8, 0, hadd_u8, 0)
+NEON_SIMD_HADD(8, 0, hadd_s8, 0x80)
+NEON_SIMD_HADD(16, 0, hadd_u16, 0)
+NEON_SIMD_HADD(16, 0, hadd_s16, 0x8000)
+NEON_SIMD_HADD(8, 1, rhadd_u8, 0)
+NEON_SIMD_HADD(8, 1, rhadd_s8, 0x80)
+NEON_SIMD_HADD(16, 1, rhadd_u16, 0)
+NEON_SIMD_HADD(16, 1, rhadd_s16, 0x8000)
+#undef NEON_SIMD_HADD
+
+#define NEON_SIMD_CMP(type) \
+    NEON_SIMD_OP(cgt_##type, simd_cmpgt_##type(va, vb)) \
+    NEON_SIMD_OP(cge_##type, simd_not(simd_cmpgt_##type(vb, va))) \
+    NEON_SIMD_OP(min_##type, simd_min_##type(va, vb)) \
+    NEON_SIMD_OP(max_##type, simd_max_##type(va, vb)) \
+    NEON_SIMD_OP(abd_##type, simd_sub8(simd_max_##type(va, vb), simd_min_##type(va, vb)))
+NEON_SIMD_CMP(s8)
+NEON_SIMD_CMP(u8)
+#undef NEON_SIMD_CMP
+#define NEON_SIMD_CMP(type) \
+    NEON_SIMD_OP(cgt_##type, simd_cmpgt_##type(va, vb)) \
+    NEON_SIMD_OP(cge_##type, simd_not(simd_cmpgt_##type(vb, va))) \
+    NEON_SIMD_OP(min_##type, simd_min_##type(va, vb)) \
+    NEON_SIMD_OP(max_##type, simd_max_##type(va, vb)) \
+    NEON_SIMD_OP(abd_##type, simd_sub16(simd_max_##type(va, vb), simd_min_##type(va, vb)))
+NEON_SIMD_CMP(s16)
+NEON_SIMD_CMP(u16)
+#undef NEON_SIMD_CMP
+
+NEON_SIMD_OP(ceq_u8, simd_cmpeq8(va, vb))
+NEON_SIMD_OP(ceq_u16, simd_cmpeq16(va, vb))
+NEON_SIMD_OP(tst_u8, simd_not(simd_cmpeq8(simd_and(va, vb), simd_splat8(0))))
+NEON_SIMD_OP(tst_u16, simd_not(simd_cmpeq16(simd_and(va, vb), simd_splat16(0))))
+NEON_SIMD_OP(mul_u16, simd_mul16(va, vb))
+NEON_SIMD_OP(mul_u8, simd_narrow_s16_u8(simd_and(
+    simd_mul16(simd_widen_u8(va), simd_widen_u8(vb)), simd_splat16(0xff))))
+
+/* Pairwise operations on the 8 lanes of 'a' and 'b' side by side, split
+   into their even and odd lanes as 16-bit values.  */
+#define NEON_SIMD_POP8(name, op, narrow, even, odd) \
+static HOST_SIMD_FN uint32_t neon_simd_##name(uint32_t a, uint32_t b) \
+{ \
+    simd_vec v = simd_from64(a | (uint64_t)b << 32); \
+    return simd_to32(simd_##narrow(simd_##op(even, odd))); \
+}
+NEON_SIMD_POP8(pmin_u8, min_s16, narrow_s16_u8,
+               simd_and(v, simd_splat16(0xff)), simd_shr_u16(v, 8))
+NEON_SIMD_POP8(pmax_u8, max_s16, narrow_s16_u8,
+               simd_and(v, simd_splat16(0xff)), simd_shr_u16(v, 8))
+NEON_SIMD_POP8(pmin_s8, min_s16, narrow_s16_s8,
+               simd_shr_s16(simd_shl16(v, 8), 8), simd_shr_s16(v, 8))
+NEON_SIMD_POP8(pmax_s8, max_s16, narrow_s16_s8,
+               simd_shr_s16(simd_shl16(v, 8), 8), simd_shr_s16(v, 8))
+#undef NEON_SIMD_POP8
+
+static HOST_SIMD_FN uint32_t neon_simd_padd_u8(uint32_t a, uint32_t b)
+{
+    simd_vec v = simd_from64(a | (uint64_t)b << 32);
+
+    v = simd_add16(v, simd_shr_u16(v, 8));
+    return simd_to32(simd_narrow_s16_u8(simd_and(v, simd_splat16(0xff))));
+}
+
+/* Shifts by a register go through the lanes one at a time unless all the
+   lanes shift by the same count, as they do for the shifts by an immediate.  */
+#define NEON_SHIFT_SAME8(s) ((s) == ((s) & 0xff) * 0x01010101u)
+#define NEON_SHIFT_SAME16(s) ((((s) ^ ((s) >> 16)) & 0xff) == 0)
+
+static HOST_SIMD_FN uint32_t neon_simd_shl_u8(uint32_t val, uint32_t shiftop)
+{
+    int8_t shift = shiftop;
+    simd_vec v = simd_from32(val);
+
+    if (shift >= 8 || shift <= -8) {
+        return 0;
+    } else if (shift < 0) {
+        v = simd_and(simd_shr_u16(v, -shift), simd_splat8(0xff >> -shift));
+    } else {
+        v = simd_and(simd_shl16(v, shift), simd_splat8(0xff << shift));
+    }
+    return simd_to32(v);
+}
+
+static HOST_SIMD_FN uint32_t neon_simd_shl_u16(uint32_t val, uint32_t shiftop)
+{
+    int8_t shift = shiftop;
+    simd_vec v = simd_from32(val);
+
+    return simd_to32(shift < 0 ? simd_shr_u16(v, -shift) : simd_shl16(v, shift));
+}
+
+static HOST_SIMD_FN uint32_t neon_simd_shl_s16(uint32_t val, uint32_t shiftop)
+{
+    int8_t shift = shiftop;
+    simd_vec v = simd_from32(val);
+
+    return simd_to32(shift < 0 ? simd_shr_s16(v, -shift) : simd_shl16(v, shift));
+}
+
+/* The doubled high half of the product only saturates for -0x8000 squared.  */
+static HOST_SIMD_FN uint32_t neon_simd_qdmulh_s16(CPUARMState *env, uint32_t a, uint32_t b,
+                                                  bool round)
+{
+    simd_vec v = simd_mull_s16(simd_from32(a), simd_from32(b));
+
+    if (round) {
+        v = simd_add32(v, simd_from64(0x0000400000004000ull));
+    }
+    if (((a & 0xffff) == 0x8000 && (b & 0xffff) == 0x8000) ||
+        ((a >> 16) == 0x8000 && (b >> 16) == 0x8000)) {
+        SET_QC();
+    }
+    return simd_to32(simd_narrow_s32_s16(simd_shr_s32(v, 15)));
+}
+
+/* Widening operations give 64 bits.  */
+#define NEON_SIMD_OPL(name, op) \
+static HOST_SIMD_FN uint64_t neon_simd_##name(uint32_t a, uint32_t b) \
+{ \
+    simd_vec va = simd_from32(a); \
+    simd_vec vb = simd_from32(b); \
+    return simd_to64(op); \
+}
+NEON_SIMD_OPL(mull_u8, simd_mul16(simd_widen_u8(va), simd_widen_u8(vb)))
+NEON_SIMD_OPL(mull_s8, simd_mul16(simd_widen_s8(va), simd_widen_s8(vb)))
+NEON_SIMD_OPL(mull_u16, simd_mull_u16(va, vb))
+NEON_SIMD_OPL(mull_s16, simd_mull_s16(va, vb))
+NEON_SIMD_OPL(abdl_u16, simd_widen_u8(simd_sub8(simd_max_u8(va, vb), simd_min_u8(va, vb))))
+NEON_SIMD_OPL(abdl_s16, simd_widen_u8(simd_sub8(simd_max_s8(va, vb), simd_min_s8(va, vb))))
+NEON_SIMD_OPL(abdl_u32, simd_widen_u16(simd_sub16(simd_max_u16(va, vb), simd_min_u16(va, vb))))
+NEON_SIMD_OPL(abdl_s32, simd_widen_u16(simd_sub16(simd_max_s16(va, vb), simd_min_s16(va, vb))))
+#undef NEON_SIMD_OPL
+
+/* Saturating narrows set QC when the lanes do not widen back to the input.  */
+#define NEON_SIMD_NARROW(name, narrow, widen) \
+static HOST_SIMD_FN uint32_t neon_simd_##name(CPUARMState *env, uint64_t x) \
+{ \
+    simd_vec r = narrow; \
+    if (simd_to64(simd_##widen(r)) != x) { \
+        SET_QC(); \
+    } \
+    return simd_to32(r); \
+}
+NEON_SIMD_NARROW(narrow_sat_s8, simd_narrow_s16_s8(simd_from64(x)), widen_s8)
+NEON_SIMD_NARROW(narrow_sat_u8, simd_narrow_s16_u8(
+    simd_min_u16(simd_from64(x), simd_splat16(0xff))), widen_u8)
+NEON_SIMD_NARROW(unarrow_sat8, simd_narrow_s16_u8(simd_from64(x)), widen_u8)
+NEON_SIMD_NARROW(narrow_sat_s16, simd_narrow_s32_s16(simd_from64(x)), widen_s16)
+#undef NEON_SIMD_NARROW
+#undef NEON_SIMD_SAT
+#undef NEON_SIMD_OP
+#endif
+
 
 #define NEON_USAT(dest, src1, src2, type) do { \
     uint32_t tmp = (uint32_t)src1 + (uint32_t)src2; \
@@ -165,10 +401,10 @@ uint32_t HELPER(glue(neon_,name))(uint32_t arg) \
         dest = tmp; \
     }} while(0)
 #define NEON_FN(dest, src1, src2) NEON_USAT(dest, src1, src2, uint8_t)
-NEON_VOP_ENV(qadd_u8, neon_u8, 4)
+NEON_VOP_ENV_SIMD(qadd_u8, neon_u8, 4, neon_simd_qadd_u8(env, arg1, arg2))
 #undef NEON_FN
 #define NEON_FN(dest, src1, src2) NEON_USAT(dest, src1, src2, uint16_t)
-NEON_VOP_ENV(qadd_u16, neon_u16, 2)
+NEON_VOP_ENV_SIMD(qadd_u16, neon_u16, 2, neon_simd_qadd_u16(env, arg1, arg2))
 #undef NEON_FN
 #undef NEON_USAT
 
@@ -207,10 +443,10 @@ uint64_t HELPER(neon_qadd_u64)(CPUARMState *env, uint64_t src1, uint64_t src2)
     dest = tmp; \
     } while(0)
 #define NEON_FN(dest, src1, src2) NEON_SSAT(dest, src1, src2, int8_t)
-NEON_VOP_ENV(qadd_s8, neon_s8, 4)
+NEON_VOP_ENV_SIMD(qadd_s8, neon_s8, 4, neon_simd_qadd_s8(env, arg1, arg2))
 #undef NEON_FN
 #define NEON_FN(dest, src1, src2) NEON_SSAT(dest, src1, src2, int16_t)
-NEON_VOP_ENV(qadd_s16, neon_s16, 2)
+NEON_VOP_ENV_SIMD(qadd_s16, neon_s16, 2, neon_simd_qadd_s16(env, arg1, arg2))
 #undef NEON_FN
 #undef NEON_SSAT
 
@@ -410,10 +646,10 @@ uint64_t HELPER(neon_sqadd_u64)(CPUARMState *env, uint64_t a, uint64_t b)
         dest = tmp; \
     }} while(0)
 #define NEON_FN(dest, src1, src2) NEON_USAT(dest, src1, src2, uint8_t)
-NEON_VOP_ENV(qsub_u8, neon_u8, 4)
+NEON_VOP_ENV_SIMD(qsub_u8, neon_u8, 4, neon_simd_qsub_u8(env, arg1, arg2))
 #undef NEON_FN
 #define NEON_FN(dest, src1, src2) NEON_USAT(dest, src1, src2, uint16_t)
-NEON_VOP_ENV(qsub_u16, neon_u16, 2)
+NEON_VOP_ENV_SIMD(qsub_u16, neon_u16, 2, neon_simd_qsub_u16(env, arg1, arg2))
 #undef NEON_FN
 #undef NEON_USAT
 
@@ -453,10 +689,10 @@ uint64_t HELPER(neon_qsub_u64)(CPUARMState *env, uint64_t src1, uint64_t src2)
     dest = tmp; \
     } while(0)
 #define NEON_FN(dest, src1, src2) NEON_SSAT(dest, src1, src2, int8_t)
-NEON_VOP_ENV(qsub_s8, neon_s8, 4)
+NEON_VOP_ENV_SIMD(qsub_s8, neon_s8, 4, neon_simd_qsub_s8(env, arg1, arg2))
 #undef NEON_FN
 #define NEON_FN(dest, src1, src2) NEON_SSAT(dest, src1, src2, int16_t)
-NEON_VOP_ENV(qsub_s16, neon_s16, 2)
+NEON_VOP_ENV_SIMD(qsub_s16, neon_s16, 2, neon_simd_qsub_s16(env, arg1, arg2))
 #undef NEON_FN
 #undef NEON_SSAT
 
@@ -483,10 +719,10 @@ uint64_t HELPER(neon_qsub_s64)(CPUARMState *env, uint64_t src1, uint64_t src2)
 }
 
 #define NEON_FN(dest, src1, src2) dest = (src1 + src2) >> 1
-NEON_VOP(hadd_s8, neon_s8, 4)
-NEON_VOP(hadd_u8, neon_u8, 4)
-NEON_VOP(hadd_s16, neon_s16, 2)
-NEON_VOP(hadd_u16, neon_u16, 2)
+NEON_VOP_SIMD(hadd_s8, neon_s8, 4, neon_simd_hadd_s8(arg1, arg2))
+NEON_VOP_SIMD(hadd_u8, neon_u8, 4, neon_simd_hadd_u8(arg1, arg2))
+NEON_VOP_SIMD(hadd_s16, neon_s16, 2, neon_simd_hadd_s16(arg1, arg2))
+NEON_VOP_SIMD(hadd_u16, neon_u16, 2, neon_simd_hadd_u16(arg1, arg2))
 #undef NEON_FN
 
 int32_t HELPER(neon_hadd_s32)(int32_t src1, int32_t src2)
@@ -510,10 +746,10 @@ uint32_t HELPER(neon_hadd_u32)(uint32_t src1, uint32_t src2)
 }
 
 #define NEON_FN(dest, src1, src2) dest = (src1 + src2 + 1) >> 1
-NEON_VOP(rhadd_s8, neon_s8, 4)
-NEON_VOP(rhadd_u8, neon_u8, 4)
-NEON_VOP(rhadd_s16, neon_s16, 2)
-NEON_VOP(rhadd_u16, neon_u16, 2)
+NEON_VOP_SIMD(rhadd_s8, neon_s8, 4, neon_simd_rhadd_s8(arg1, arg2))
+NEON_VOP_SIMD(rhadd_u8, neon_u8, 4, neon_simd_rhadd_u8(arg1, arg2))
+NEON_VOP_SIMD(rhadd_s16, neon_s16, 2, neon_simd_rhadd_s16(arg1, arg2))
+NEON_VOP_SIMD(rhadd_u16, neon_u16, 2, neon_simd_rhadd_u16(arg1, arg2))
 #undef NEON_FN
 
 int32_t HELPER(neon_rhadd_s32)(int32_t src1, int32_t src2)
@@ -564,55 +800,55 @@ uint32_t HELPER(neon_hsub_u32)(uint32_t src1, uint32_t src2)
 }
 
 #define NEON_FN(dest, src1, src2) dest = (src1 > src2) ? ~0 : 0
-NEON_VOP(cgt_s8, neon_s8, 4)
-NEON_VOP(cgt_u8, neon_u8, 4)
-NEON_VOP(cgt_s16, neon_s16, 2)
-NEON_VOP(cgt_u16, neon_u16, 2)
+NEON_VOP_SIMD(cgt_s8, neon_s8, 4, neon_simd_cgt_s8(arg1, arg2))
+NEON_VOP_SIMD(cgt_u8, neon_u8, 4, neon_simd_cgt_u8(arg1, arg2))
+NEON_VOP_SIMD(cgt_s16, neon_s16, 2, neon_simd_cgt_s16(arg1, arg2))
+NEON_VOP_SIMD(cgt_u16, neon_u16, 2, neon_simd_cgt_u16(arg1, arg2))
 NEON_VOP(cgt_s32, neon_s32, 1)
 NEON_VOP(cgt_u32, neon_u32, 1)
 #undef NEON_FN
 
 #define NEON_FN(dest, src1, src2) dest = (src1 >= src2) ? ~0 : 0
-NEON_VOP(cge_s8, neon_s8, 4)
-NEON_VOP(cge_u8, neon_u8, 4)
-NEON_VOP(cge_s16, neon_s16, 2)
-NEON_VOP(cge_u16, neon_u16, 2)
+NEON_VOP_SIMD(cge_s8, neon_s8, 4, neon_simd_cge_s8(arg1, arg2))
+NEON_VOP_SIMD(cge_u8, neon_u8, 4, neon_simd_cge_u8(arg1, arg2))
+NEON_VOP_SIMD(cge_s16, neon_s16, 2, neon_simd_cge_s16(arg1, arg2))
+NEON_VOP_SIMD(cge_u16, neon_u16, 2, neon_simd_cge_u16(arg1, arg2))
 NEON_VOP(cge_s32, neon_s32, 1)
 NEON_VOP(cge_u32, neon_u32, 1)
 #undef NEON_FN
 
 #define NEON_FN(dest, src1, src2) dest = (src1 < src2) ? src1 : src2
-NEON_VOP(min_s8, neon_s8, 4)
-NEON_VOP(min_u8, neon_u8, 4)
-NEON_VOP(min_s16, neon_s16, 2)
-NEON_VOP(min_u16, neon_u16, 2)
+NEON_VOP_SIMD(min_s8, neon_s8, 4, neon_simd_min_s8(arg1, arg2))
+NEON_VOP_SIMD(min_u8, neon_u8, 4, neon_simd_min_u8(arg1, arg2))
+NEON_VOP_SIMD(min_s16, neon_s16, 2, neon_simd_min_s16(arg1, arg2))
+NEON_VOP_SIMD(min_u16, neon_u16, 2, neon_simd_min_u16(arg1, arg2))
 NEON_VOP(min_s32, neon_s32, 1)
 NEON_VOP(min_u32, neon_u32, 1)
-NEON_POP(pmin_s8, neon_s8, 4)
-NEON_POP(pmin_u8, neon_u8, 4)
+NEON_POP_SIMD(pmin_s8, neon_s8, 4, neon_simd_pmin_s8(arg1, arg2))
+NEON_POP_SIMD(pmin_u8, neon_u8, 4, neon_simd_pmin_u8(arg1, arg2))
 NEON_POP(pmin_s16, neon_s16, 2)
 NEON_POP(pmin_u16, neon_u16, 2)
 #undef NEON_FN
 
 #define NEON_FN(dest, src1, src2) dest = (src1 > src2) ? src1 : src2
-NEON_VOP(max_s8, neon_s8, 4)
-NEON_VOP(max_u8, neon_u8, 4)
-NEON_VOP(max_s16, neon_s16, 2)
-NEON_VOP(max_u16, neon_u16, 2)
+NEON_VOP_SIMD(max_s8, neon_s8, 4, neon_simd_max_s8(arg1, arg2))
+NEON_VOP_SIMD(max_u8, neon_u8, 4, neon_simd_max_u8(arg1, arg2))
+NEON_VOP_SIMD(max_s16, neon_s16, 2, neon_simd_max_s16(arg1, arg2))
+NEON_VOP_SIMD(max_u16, neon_u16, 2, neon_simd_max_u16(arg1, arg2))
 NEON_VOP(max_s32, neon_s32, 1)
 NEON_VOP(max_u32, neon_u32, 1)
-NEON_POP(pmax_s8, neon_s8, 4)
-NEON_POP(pmax_u8, neon_u8, 4)
+NEON_POP_SIMD(pmax_s8, neon_s8, 4, neon_simd_pmax_s8(arg1, arg2))
+NEON_POP_SIMD(pmax_u8, neon_u8, 4, neon_simd_pmax_u8(arg1, arg2))
 NEON_POP(pmax_s16, neon_s16, 2)
 NEON_POP(pmax_u16, neon_u16, 2)
 #undef NEON_FN
 
 #define NEON_FN(dest, src1, src2) \
     dest = (src1 > src2) ? ((int64_t)src1 - (int64_t)src2) : ((int64_t)src2 - (int64_t)src1)
-NEON_VOP(abd_s8, neon_s8, 4)
-NEON_VOP(abd_u8, neon_u8, 4)
-NEON_VOP(abd_s16, neon_s16, 2)
-NEON_VOP(abd_u16, neon_u16, 2)
+NEON_VOP_SIMD(abd_s8, neon_s8, 4, neon_simd_abd_s8(arg1, arg2))
+NEON_VOP_SIMD(abd_u8, neon_u8, 4, neon_simd_abd_u8(arg1, arg2))
+NEON_VOP_SIMD(abd_s16, neon_s16, 2, neon_simd_abd_s16(arg1, arg2))
+NEON_VOP_SIMD(abd_u16, neon_u16, 2, neon_simd_abd_u16(arg1, arg2))
 NEON_VOP(abd_s32, neon_s32, 1)
 NEON_VOP(abd_u32, neon_u32, 1)
 #undef NEON_FN
@@ -628,8 +864,10 @@ NEON_VOP(abd_u32, neon_u32, 1)
     } else { \
         dest = src1 << tmp; \
     }} while (0)
-NEON_VOP(shl_u8, neon_u8, 4)
-NEON_VOP(shl_u16, neon_u16, 2)
+NEON_VOP_SIMD_IF(shl_u8, neon_u8, 4, NEON_SHIFT_SAME8(arg2),
+                 neon_simd_shl_u8(arg1, arg2))
+NEON_VOP_SIMD_IF(shl_u16, neon_u16, 2, NEON_SHIFT_SAME16(arg2),
+                 neon_simd_shl_u16(arg1, arg2))
 NEON_VOP(shl_u32, neon_u32, 1)
 #undef NEON_FN
 
@@ -659,7 +897,8 @@ uint64_t HELPER(neon_shl_u64)(uint64_t val, uint64_t shiftop)
         dest = src1 << tmp; \
     }} while (0)
 NEON_VOP(shl_s8, neon_s8, 4)
-NEON_VOP(shl_s16, neon_s16, 2)
+NEON_VOP_SIMD_IF(shl_s16, neon_s16, 2, NEON_SHIFT_SAME16(arg2),
+                 neon_simd_shl_s16(arg1, arg2))
 NEON_VOP(shl_s32, neon_s32, 1)
 #undef NEON_FN
 
@@ -1161,7 +1400,7 @@ uint32_t HELPER(neon_add_u16)(uint32_t a, uint32_t b)
 }
 
 #define NEON_FN(dest, src1, src2) dest = src1 + src2
-NEON_POP(padd_u8, neon_u8, 4)
+NEON_POP_SIMD(padd_u8, neon_u8, 4, neon_simd_padd_u8(arg1, arg2))
 NEON_POP(padd_u16, neon_u16, 2)
 #undef NEON_FN
 
@@ -1171,8 +1410,8 @@ NEON_VOP(sub_u16, neon_u16, 2)
 #undef NEON_FN
 
 #define NEON_FN(dest, src1, src2) dest = (int64_t)src1 * src2
-NEON_VOP(mul_u8, neon_u8, 4)
-NEON_VOP(mul_u16, neon_u16, 2)
+NEON_VOP_SIMD(mul_u8, neon_u8, 4, neon_simd_mul_u8(arg1, arg2))
+NEON_VOP_SIMD(mul_u16, neon_u16, 2, neon_simd_mul_u16(arg1, arg2))
 #undef NEON_FN
 
 /* Polynomial multiplication is like integer multiplication except the
@@ -1230,14 +1469,14 @@ uint64_t HELPER(neon_mull_p8)(uint32_t op1, uint32_t op2)
 }
 
 #define NEON_FN(dest, src1, src2) dest = (src1 & src2) ? -1 : 0
-NEON_VOP(tst_u8, neon_u8, 4)
-NEON_VOP(tst_u16, neon_u16, 2)
+NEON_VOP_SIMD(tst_u8, neon_u8, 4, neon_simd_tst_u8(arg1, arg2))
+NEON_VOP_SIMD(tst_u16, neon_u16, 2, neon_simd_tst_u16(arg1, arg2))
 NEON_VOP(tst_u32, neon_u32, 1)
 #undef NEON_FN
 
 #define NEON_FN(dest, src1, src2) dest = (src1 == src2) ? -1 : 0
-NEON_VOP(ceq_u8, neon_u8, 4)
-NEON_VOP(ceq_u16, neon_u16, 2)
+NEON_VOP_SIMD(ceq_u8, neon_u8, 4, neon_simd_ceq_u8(arg1, arg2))
+NEON_VOP_SIMD(ceq_u16, neon_u16, 2, neon_simd_ceq_u16(arg1, arg2))
 NEON_VOP(ceq_u32, neon_u32, 1)
 #undef NEON_FN
 
@@ -1329,10 +1568,10 @@ uint32_t HELPER(neon_rbit_u8)(uint32_t x)
     dest = tmp >> 16; \
     } while(0)
 #define NEON_FN(dest, src1, src2) NEON_QDMULH16(dest, src1, src2, 0)
-NEON_VOP_ENV(qdmulh_s16, neon_s16, 2)
+NEON_VOP_ENV_SIMD(qdmulh_s16, neon_s16, 2, neon_simd_qdmulh_s16(env, arg1, arg2, false))
 #undef NEON_FN
 #define NEON_FN(dest, src1, src2) NEON_QDMULH16(dest, src1, src2, 1)
-NEON_VOP_ENV(qrdmulh_s16, neon_s16, 2)
+NEON_VOP_ENV_SIMD(qrdmulh_s16, neon_s16, 2, neon_simd_qdmulh_s16(env, arg1, arg2, true))
 #undef NEON_FN
 #undef NEON_QDMULH16
 
@@ -1404,6 +1643,9 @@ uint32_t HELPER(neon_unarrow_sat8)(CPUARMState *env, uint64_t x)
     uint16_t s;
     uint8_t d;
     uint32_t res = 0;
+
+    NEON_SIMD(neon_simd_unarrow_sat8(env, x));
+
 #define SAT8(n) \
     s = x >> n; \
     if (s & 0x8000) { \
@@ -1431,6 +1673,9 @@ uint32_t HELPER(neon_narrow_sat_u8)(CPUARMState *env, uint64_t x)
     uint16_t s;
     uint8_t d;
     uint32_t res = 0;
+
+    NEON_SIMD(neon_simd_narrow_sat_u8(env, x));
+
 #define SAT8(n) \
     s = x >> n; \
     if (s > 0xff) { \
@@ -1454,6 +1699,9 @@ uint32_t HELPER(neon_narrow_sat_s8)(CPUARMState *env, uint64_t x)
     int16_t s;
     uint8_t d;
     uint32_t res = 0;
+
+    NEON_SIMD(neon_simd_narrow_sat_s8(env, x));
+
 #define SAT8(n) \
     s = x >> n; \
     if (s != (int8_t)s) { \
@@ -1516,6 +1764,9 @@ uint32_t HELPER(neon_narrow_sat_s16)(CPUARMState *env, uint64_t x)
 {
     int32_t low;
     int32_t high;
+
+    NEON_SIMD(neon_simd_narrow_sat_s16(env, x));
+
     low = x;
     if (low != (int16_t)low) {
         low = (low >> 31) ^ 0x7fff;
@@ -1706,6 +1957,9 @@ uint64_t HELPER(neon_abdl_u16)(uint32_t a, uint32_t b)
 {
     uint64_t tmp;
     uint64_t result;
+
+    NEON_SIMD(neon_simd_abdl_u16(a, b));
+
     DO_ABD(result, a, b, uint8_t, uint32_t);
     DO_ABD(tmp, a >> 8, b >> 8, uint8_t, uint32_t);
     result |= tmp << 16;
@@ -1720,6 +1974,9 @@ uint64_t HELPER(neon_abdl_s16)(uint32_t a, uint32_t b)
 {
     uint64_t tmp;
     uint64_t result;
+
+    NEON_SIMD(neon_simd_abdl_s16(a, b));
+
     DO_ABD(result, a, b, int8_t, int32_t);
     DO_ABD(tmp, a >> 8, b >> 8, int8_t, int32_t);
     result |= tmp << 16;
@@ -1734,6 +1991,9 @@ uint64_t HELPER(neon_abdl_u32)(uint32_t a, uint32_t b)
 {
     uint64_t tmp;
     uint64_t result;
+
+    NEON_SIMD(neon_simd_abdl_u32(a, b));
+
     DO_ABD(result, a, b, uint16_t, uint32_t);
     DO_ABD(tmp, a >> 16, b >> 16, uint16_t, uint32_t);
     return result | (tmp << 32);
@@ -1743,6 +2003,9 @@ uint64_t HELPER(neon_abdl_s32)(uint32_t a, uint32_t b)
 {
     uint64_t tmp;
     uint64_t result;
+
+    NEON_SIMD(neon_simd_abdl_s32(a, b));
+
     DO_ABD(result, a, b, int16_t, int32_t);
     DO_ABD(tmp, a >> 16, b >> 16, int16_t, int32_t);
     return result | (tmp << 32);
@@ -1775,6 +2038,8 @@ uint64_t HELPER(neon_mull_u8)(uint32_t a, uint32_t b)
     uint64_t tmp;
     uint64_t result;
 
+    NEON_SIMD(neon_simd_mull_u8(a, b));
+
     DO_MULL(result, a, b, uint8_t, uint16_t);
     DO_MULL(tmp, a >> 8, b >> 8, uint8_t, uint16_t);
     result |= tmp << 16;
@@ -1790,6 +2055,8 @@ uint64_t HELPER(neon_mull_s8)(uint32_t a, uint32_t b)
     uint64_t tmp;
     uint64_t result;
 
+    NEON_SIMD(neon_simd_mull_s8(a, b));
+
     DO_MULL(result, a, b, int8_t, uint16_t);
     DO_MULL(tmp, a >> 8, b >> 8, int8_t, uint16_t);
     result |= tmp << 16;
@@ -1805,6 +2072,8 @@ uint64_t HELPER(neon_mull_u16)(uint32_t a, uint32_t b)
     uint64_t tmp;
     uint64_t result;
 
+    NEON_SIMD(neon_simd_mull_u16(a, b));
+
     DO_MULL(result, a, b, uint16_t, uint32_t);
     DO_MULL(tmp, a >> 16, b >> 16, uint16_t, uint32_t);
     return result | (tmp << 32);
@@ -1815,6 +2084,8 @@ uint64_t HELPER(neon_mull_s16)(uint32_t a, uint32_t b)
     uint64_t tmp;
     uint64_t result;
 
+    NEON_SIMD(neon_simd_mull_s16(a, b));
+
     DO_MULL(result, a, b, int16_t, uint32_t);
     DO_MULL(tmp, a >> 16, b >> 16, int16_t, uint32_t);
     return result | (tmp << 32);
@@ -2221,6 +2492,12 @@ uint64_t HELPER(neon_pmull_64_lo)(uint64_t op1, uint64_t op2)
     int bitnum;
     uint64_t res = 0;
 
+    if (host_crypto_clmul) {
+        uint64_t hi;
+
+        host_clmul(&res, &hi, op1, op2);
+        return res;
+    }
     for (bitnum = 0; bitnum < 64; bitnum++) {
         if (op1 & (1ULL << bitnum)) {
             res ^= op2 << bitnum;
@@ -2233,6 +2510,12 @@ uint64_t HELPER(neon_pmull_64_hi)(uint64_t op1, uint64_t op2)
     int bitnum;
     uint64_t res = 0;
 
+    if (host_crypto_clmul) {
+        uint64_t lo;
+
+        host_clmul(&lo, &res, op1, op2);
+        return res;
+    }
     /* bit 0 of op1 can't influence the high 64 bits at all */
     for (bitnum = 1; bitnum < 64; bitnum++) {
         if (op1 & (1ULL << bitnum)) {
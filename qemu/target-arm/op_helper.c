@@ -20,6 +20,7 @@
 #include "exec/helper-proto.h"
 #include "internals.h"
 #include "exec/cpu_ldst.h"
+#include "qemu/host-simd.h"
 
 #define SIGNBIT (uint32_t)0x80000000
 #define SIGNBIT64 ((uint64_t)1 << 63)
@@ -42,6 +43,16 @@ uint32_t HELPER(neon_tbl)(CPUARMState *env, uint32_t ireg, uint32_t def,
     int shift;
     uint64_t *table;
     table = (uint64_t *)&env->vfp.regs[rn];
+#ifdef HOST_SIMD
+    if (host_simd_shuffle) {
+        /* the table is 8 to 32 bytes, the lanes past its end keep 'def' */
+        val = simd_lookup8(def, ireg, table, 0, MIN(maxindex, 16));
+        if (maxindex > 16) {
+            val = simd_lookup8(val, ireg, table + 2, 16, maxindex - 16);
+        }
+        return val;
+    }
+#endif
     val = 0;
     for (shift = 0; shift < 32; shift += 8) {
         index = (ireg >> shift) & 0xff;
@@ -11120,20 +11120,20 @@ void gen_intermediate_code_internal_a64(ARMCPU *cpu,
         goto tb_end;
     }
 
+    gen_tb_start(tcg_ctx);
+
     // Unicorn: trace this block on request
     // Only hook this block if it is not broken from previous translation due to
     // full translation cache
     if (!env->uc->block_full && HOOK_EXISTS_BOUNDED(env->uc, UC_HOOK_BLOCK, pc_start)) {
         // save block address to see if we need to patch block size later
         env->uc->block_addr = pc_start;
-        env->uc->size_arg = tcg_ctx->gen_opparam_buf - tcg_ctx->gen_opparam_ptr + 1;
+        env->uc->size_arg = tcg_ctx->gen_opparam_ptr - tcg_ctx->gen_opparam_buf + 1;
         gen_uc_tracecode(tcg_ctx, 0xf8f8f8f8, UC_HOOK_BLOCK_IDX, env->uc, pc_start);
     } else {
         env->uc->size_arg = -1;
     }
 
-    gen_tb_start(tcg_ctx);
-
     do {
         if (unlikely(!QTAILQ_EMPTY(&cs->breakpoints))) {
             QTAILQ_FOREACH(bp, &cs->breakpoints, entry) {
@@ -11157,7 +11157,7 @@ void gen_intermediate_code_internal_a64(ARMCPU *cpu,
             }
             tcg_ctx->gen_opc_pc[lj] = dc->pc;
             tcg_ctx->gen_opc_instr_start[lj] = 1;
-            //tcg_ctx->gen_opc_icount[lj] = num_insns;
+            tcg_ctx->gen_opc_icount[lj] = num_insns;
         }
 
         //if (num_insns + 1 == max_insns && (tb->cflags & CF_LAST_IO)) {
@@ -71,6 +71,12 @@ DEF_HELPER_1(set_inhibit_irq, void, env)
 DEF_HELPER_1(reset_inhibit_irq, void, env)
 DEF_HELPER_3(boundw, void, env, tl, int)
 DEF_HELPER_3(boundl, void, env, tl, int)
+DEF_HELPER_5(rep_movs, void, env, tl, tl, int, tl)
+DEF_HELPER_4(rep_stos, void, env, tl, int, tl)
+DEF_HELPER_4(repz_scas, void, env, tl, int, tl)
+DEF_HELPER_4(repnz_scas, void, env, tl, int, tl)
+DEF_HELPER_5(repz_cmps, void, env, tl, tl, int, tl)
+DEF_HELPER_5(repnz_cmps, void, env, tl, tl, int, tl)
 DEF_HELPER_1(rsm, void, env)
 DEF_HELPER_2(into, void, env, int)
 DEF_HELPER_2(cmpxchg8b, void, env, tl)
@@ -104,6 +104,208 @@ void helper_boundl(CPUX86State *env, target_ulong a0, int v)
     }
 }
 
+/* Unicorn: bulk REP string instructions.  Translated code calls these
+   helpers before doing one element of a REP MOVS, STOS, SCAS or CMPS the
+   usual way.  They do at once the elements that lie in plain RAM pages of
+   the TLB, up to the end of the page, and leave the rest to the translated
+   code: pages missing the TLB, MMIO, code pages, and the last element, which
+   sets the flags and ends the instruction.  'shift' is log2 of the element
+   size, 'mask' the mask of the address size. */
+
+/* host address of 'addr' if its page is plain RAM in the TLB, else NULL */
+static uint8_t *rep_ram_ptr(CPUX86State *env, target_ulong addr, int is_write)
+{
+    int mmu_idx = cpu_mmu_index(env);
+    int index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    CPUTLBEntry *te = &env->tlb_table[mmu_idx][index];
+    target_ulong tlb_addr = is_write ? te->addr_write : te->addr_read;
+
+    if (tlb_addr != (addr & TARGET_PAGE_MASK) || te->addend == -1) {
+        return NULL;
+    }
+    return (uint8_t *)((uintptr_t)addr + te->addend);
+}
+
+/* bytes from 'addr' to the end of its page, or to the wrap of 'reg' */
+static target_ulong rep_span(target_ulong addr, target_ulong reg, target_ulong mask)
+{
+    target_ulong page_left = TARGET_PAGE_SIZE - (addr & ~TARGET_PAGE_MASK);
+
+    return MIN(page_left - 1, mask - (reg & mask)) + 1;
+}
+
+/* elements of 'bytes' the helper may do, keeping the last one of ECX */
+static target_ulong rep_count(CPUX86State *env, target_ulong bytes,
+                              int shift, target_ulong mask)
+{
+    target_ulong count = env->regs[R_ECX] & mask;
+
+    if (env->df != 1 || count == 0) {
+        return 0;
+    }
+    return MIN(bytes >> shift, count - 1);
+}
+
+static void rep_add_reg(CPUX86State *env, int reg, target_ulong v, target_ulong mask)
+{
+    target_ulong r = env->regs[reg] + v;
+
+    if (mask == 0xffff) {
+        env->regs[reg] = (env->regs[reg] & ~mask) | (r & mask);
+    } else {
+        env->regs[reg] = r & mask;
+    }
+}
+
+static target_ulong rep_ld(const uint8_t *p, int shift)
+{
+    switch (shift) {
+    case 0:
+        return ldub_p(p);
+    case 1:
+        return lduw_le_p(p);
+    case 2:
+        return (uint32_t)ldl_le_p(p);
+    default:
+        return ldq_le_p(p);
+    }
+}
+
+static void rep_st(uint8_t *p, target_ulong v, int shift)
+{
+    switch (shift) {
+    case 0:
+        stb_p(p, v);
+        break;
+    case 1:
+        stw_le_p(p, v);
+        break;
+    case 2:
+        stl_le_p(p, v);
+        break;
+    default:
+        stq_le_p(p, v);
+        break;
+    }
+}
+
+void helper_rep_movs(CPUX86State *env, target_ulong src, target_ulong dst,
+                     int shift, target_ulong mask)
+{
+    uint8_t *s, *d;
+    target_ulong n, bytes;
+
+    n = rep_count(env, MIN(rep_span(src, env->regs[R_ESI], mask),
+                           rep_span(dst, env->regs[R_EDI], mask)), shift, mask);
+    if (n == 0 || !(s = rep_ram_ptr(env, src, 0)) || !(d = rep_ram_ptr(env, dst, 1))) {
+        return;
+    }
+    bytes = n << shift;
+    if (d > s && d < s + bytes) {
+        /* the elements copied forward repeat the overlap */
+        n = (d - s) >> shift;
+        if (n == 0) {
+            return;
+        }
+        bytes = n << shift;
+    }
+    memmove(d, s, bytes);
+    rep_add_reg(env, R_ECX, -n, mask);
+    rep_add_reg(env, R_ESI, bytes, mask);
+    rep_add_reg(env, R_EDI, bytes, mask);
+}
+
+void helper_rep_stos(CPUX86State *env, target_ulong dst, int shift, target_ulong mask)
+{
+    target_ulong n, i, v = env->regs[R_EAX];
+    uint8_t *d;
+
+    n = rep_count(env, rep_span(dst, env->regs[R_EDI], mask), shift, mask);
+    if (n == 0 || !(d = rep_ram_ptr(env, dst, 1))) {
+        return;
+    }
+    if (shift == 0) {
+        memset(d, (uint8_t)v, n);
+    } else {
+        for (i = 0; i < n; i++) {
+            rep_st(d + (i << shift), v, shift);
+        }
+    }
+    rep_add_reg(env, R_ECX, -n, mask);
+    rep_add_reg(env, R_EDI, n << shift, mask);
+}
+
+/* skip the elements equal ('nz' = 0) or different ('nz' = 1) to EAX */
+static void rep_scas(CPUX86State *env, target_ulong dst, int shift,
+                     target_ulong mask, int nz)
+{
+    target_ulong n, i, v;
+    uint8_t *d, *found;
+
+    n = rep_count(env, rep_span(dst, env->regs[R_EDI], mask), shift, mask);
+    if (n == 0 || !(d = rep_ram_ptr(env, dst, 0))) {
+        return;
+    }
+    v = env->regs[R_EAX] & (((target_ulong)2 << ((8 << shift) - 1)) - 1);
+    if (shift == 0 && nz) {
+        found = memchr(d, (uint8_t)v, n);
+        i = found ? found - d : n;
+    } else {
+        for (i = 0; i < n; i++) {
+            if ((rep_ld(d + (i << shift), shift) == v) == nz) {
+                break;
+            }
+        }
+    }
+    rep_add_reg(env, R_ECX, -i, mask);
+    rep_add_reg(env, R_EDI, i << shift, mask);
+}
+
+void helper_repz_scas(CPUX86State *env, target_ulong dst, int shift, target_ulong mask)
+{
+    rep_scas(env, dst, shift, mask, 0);
+}
+
+void helper_repnz_scas(CPUX86State *env, target_ulong dst, int shift, target_ulong mask)
+{
+    rep_scas(env, dst, shift, mask, 1);
+}
+
+/* skip the elements equal ('nz' = 0) or different ('nz' = 1) in both strings */
+static void rep_cmps(CPUX86State *env, target_ulong src, target_ulong dst,
+                     int shift, target_ulong mask, int nz)
+{
+    target_ulong n, i;
+    uint8_t *s, *d;
+
+    n = rep_count(env, MIN(rep_span(src, env->regs[R_ESI], mask),
+                           rep_span(dst, env->regs[R_EDI], mask)), shift, mask);
+    if (n == 0 || !(s = rep_ram_ptr(env, src, 0)) || !(d = rep_ram_ptr(env, dst, 0))) {
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        if ((rep_ld(s + (i << shift), shift) ==
+             rep_ld(d + (i << shift), shift)) == nz) {
+            break;
+        }
+    }
+    rep_add_reg(env, R_ECX, -i, mask);
+    rep_add_reg(env, R_ESI, i << shift, mask);
+    rep_add_reg(env, R_EDI, i << shift, mask);
+}
+
+void helper_repz_cmps(CPUX86State *env, target_ulong src, target_ulong dst,
+                      int shift, target_ulong mask)
+{
+    rep_cmps(env, src, dst, shift, mask, 0);
+}
+
+void helper_repnz_cmps(CPUX86State *env, target_ulong src, target_ulong dst,
+                       int shift, target_ulong mask)
+{
+    rep_cmps(env, src, dst, shift, mask, 1);
+}
+
 #if !defined(CONFIG_USER_ONLY)
 /* try to fill the TLB and return an exception if error. If retaddr is
  * NULL, it means that the function was called in C code (i.e. not
@@ -19,6 +19,7 @@
  */
 
 #include "qemu/aes.h"
+#include "qemu/host-crypto.h"
 
 #if SHIFT == 0
 #define Reg MMXReg
@@ -2232,6 +2233,10 @@ void glue(helper_pclmulqdq, SUFFIX)(CPUX86State *env, Reg *d, Reg *s,
     b = s->Q((ctrl & 16) != 0);
     resh = resl = 0;
 
+    if (host_crypto_clmul) {
+        host_clmul(&resl, &resh, al, b);
+        b = 0;
+    }
     while (b) {
         if (b & 1) {
             resl ^= al;
@@ -2252,6 +2257,10 @@ void glue(helper_aesdec, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
     Reg st = *d;
     Reg rk = *s;
 
+    if (host_crypto_aes) {
+        host_aes_dec_round((uint8_t *)d, (uint8_t *)&st, (uint8_t *)&rk, false);
+        return;
+    }
     for (i = 0 ; i < 4 ; i++) {
         d->L(i) = rk.L(i) ^ bswap32(AES_Td0[st.B(AES_ishifts[4*i+0])] ^
                                     AES_Td1[st.B(AES_ishifts[4*i+1])] ^
@@ -2266,6 +2275,10 @@ void glue(helper_aesdeclast, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
     Reg st = *d;
     Reg rk = *s;
 
+    if (host_crypto_aes) {
+        host_aes_dec_round((uint8_t *)d, (uint8_t *)&st, (uint8_t *)&rk, true);
+        return;
+    }
     for (i = 0; i < 16; i++) {
         d->B(i) = rk.B(i) ^ (AES_Td4[st.B(AES_ishifts[i])] & 0xff);
     }
@@ -2277,6 +2290,10 @@ void glue(helper_aesenc, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
     Reg st = *d;
     Reg rk = *s;
 
+    if (host_crypto_aes) {
+        host_aes_enc_round((uint8_t *)d, (uint8_t *)&st, (uint8_t *)&rk, false);
+        return;
+    }
     for (i = 0 ; i < 4 ; i++) {
         d->L(i) = rk.L(i) ^ bswap32(AES_Te0[st.B(AES_shifts[4*i+0])] ^
                                     AES_Te1[st.B(AES_shifts[4*i+1])] ^
@@ -2291,6 +2308,10 @@ void glue(helper_aesenclast, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
     Reg st = *d;
     Reg rk = *s;
 
+    if (host_crypto_aes) {
+        host_aes_enc_round((uint8_t *)d, (uint8_t *)&st, (uint8_t *)&rk, true);
+        return;
+    }
     for (i = 0; i < 16; i++) {
         d->B(i) = rk.B(i) ^ (AES_Te4[st.B(AES_shifts[i])] & 0xff);
     }
@@ -2302,6 +2323,10 @@ void glue(helper_aesimc, SUFFIX)(CPUX86State *env, Reg *d, Reg *s)
     int i;
     Reg tmp = *s;
 
+    if (host_crypto_aes) {
+        host_aes_mix_columns((uint8_t *)d, (uint8_t *)&tmp, true);
+        return;
+    }
     for (i = 0 ; i < 4 ; i++) {
         d->L(i) = bswap32(AES_Td0[AES_Te4[tmp.B(4*i+0)] & 0xff] ^
                           AES_Td1[AES_Te4[tmp.B(4*i+1)] & 0xff] ^
@@ -947,12 +947,10 @@ void helper_syscall(CPUX86State *env, int next_eip_addend)
 {
     // Unicorn: call registered syscall hooks
     struct hook *hook;
-    HOOK_FOREACH_VAR_DECLARE;
-    HOOK_FOREACH(env->uc, hook, UC_HOOK_INSN) {
+    HOOK_FOREACH_ADDR_VAR_DECLARE;
+    HOOK_FOREACH_ADDR(env->uc, hook, UC_HOOK_INSN, env->eip) {
         if (hook->to_delete)
             continue;
-        if (!HOOK_BOUND_CHECK(hook, env->eip))
-            continue;
         if (hook->insn == UC_X86_INS_SYSCALL)
             ((uc_cb_insn_syscall_t)hook->callback)(env->uc, hook->user_data);
     }
@@ -2389,12 +2387,10 @@ void helper_sysenter(CPUX86State *env, int next_eip_addend)
 {
     // Unicorn: call registered SYSENTER hooks
     struct hook *hook;
-    HOOK_FOREACH_VAR_DECLARE;
-    HOOK_FOREACH(env->uc, hook, UC_HOOK_INSN) {
+    HOOK_FOREACH_ADDR_VAR_DECLARE;
+    HOOK_FOREACH_ADDR(env->uc, hook, UC_HOOK_INSN, env->eip) {
         if (hook->to_delete)
             continue;
-        if (!HOOK_BOUND_CHECK(hook, env->eip))
-            continue;
         if (hook->insn == UC_X86_INS_SYSENTER)
             ((uc_cb_insn_syscall_t)hook->callback)(env->uc, hook->user_data);
     }
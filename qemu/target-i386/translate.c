@@ -1453,6 +1453,100 @@ GEN_REPZ(outs)
 GEN_REPZ2(scas)
 GEN_REPZ2(cmps)
 
+/* Unicorn: REP MOVS, STOS, SCAS and CMPS first do the elements they can in
+   RAM at once with a helper, see helper_rep_movs(), then loop on one element
+   as above.  Instruction counts and code hooks see each trip of that loop,
+   and memory hooks each element, so the helpers are only used without them. */
+static bool gen_rep_bulk(DisasContext *s, target_ulong pc_start)
+{
+    return !s->uc->icount &&
+        !HOOK_EXISTS_BOUNDED(s->uc, UC_HOOK_CODE, pc_start) &&
+        !HOOK_EXISTS(s->uc, UC_HOOK_MEM_READ) &&
+        !HOOK_EXISTS(s->uc, UC_HOOK_MEM_READ_AFTER) &&
+        !HOOK_EXISTS(s->uc, UC_HOOK_MEM_WRITE);
+}
+
+static TCGv gen_rep_addr_mask(DisasContext *s)
+{
+    TCGContext *tcg_ctx = s->uc->tcg_ctx;
+
+    switch (s->aflag) {
+    case MO_16:
+        return tcg_const_tl(tcg_ctx, 0xffff);
+    case MO_32:
+        return tcg_const_tl(tcg_ctx, 0xffffffff);
+    default:
+        return tcg_const_tl(tcg_ctx, -1);
+    }
+}
+
+/* A0 = EDI, 'src' = ESI if not NULL, with their segments */
+static void gen_rep_addrs(DisasContext *s, TCGv src)
+{
+    TCGContext *tcg_ctx = s->uc->tcg_ctx;
+    TCGv cpu_A0 = *(TCGv *)tcg_ctx->cpu_A0;
+
+    if (src) {
+        gen_string_movl_A0_ESI(s);
+        tcg_gen_mov_tl(tcg_ctx, src, cpu_A0);
+    }
+    gen_string_movl_A0_EDI(s);
+}
+
+static void gen_rep_bulk_movs(DisasContext *s, TCGMemOp ot)
+{
+    TCGContext *tcg_ctx = s->uc->tcg_ctx;
+    TCGv cpu_A0 = *(TCGv *)tcg_ctx->cpu_A0;
+    TCGv src = tcg_temp_new(tcg_ctx);
+
+    gen_rep_addrs(s, src);
+    gen_helper_rep_movs(tcg_ctx, tcg_ctx->cpu_env, src, cpu_A0,
+                        tcg_const_i32(tcg_ctx, ot), gen_rep_addr_mask(s));
+    tcg_temp_free(tcg_ctx, src);
+}
+
+static void gen_rep_bulk_stos(DisasContext *s, TCGMemOp ot)
+{
+    TCGContext *tcg_ctx = s->uc->tcg_ctx;
+    TCGv cpu_A0 = *(TCGv *)tcg_ctx->cpu_A0;
+
+    gen_rep_addrs(s, NULL);
+    gen_helper_rep_stos(tcg_ctx, tcg_ctx->cpu_env, cpu_A0,
+                        tcg_const_i32(tcg_ctx, ot), gen_rep_addr_mask(s));
+}
+
+static void gen_rep_bulk_scas(DisasContext *s, TCGMemOp ot, int nz)
+{
+    TCGContext *tcg_ctx = s->uc->tcg_ctx;
+    TCGv cpu_A0 = *(TCGv *)tcg_ctx->cpu_A0;
+
+    gen_rep_addrs(s, NULL);
+    if (nz) {
+        gen_helper_repnz_scas(tcg_ctx, tcg_ctx->cpu_env, cpu_A0,
+                              tcg_const_i32(tcg_ctx, ot), gen_rep_addr_mask(s));
+    } else {
+        gen_helper_repz_scas(tcg_ctx, tcg_ctx->cpu_env, cpu_A0,
+                             tcg_const_i32(tcg_ctx, ot), gen_rep_addr_mask(s));
+    }
+}
+
+static void gen_rep_bulk_cmps(DisasContext *s, TCGMemOp ot, int nz)
+{
+    TCGContext *tcg_ctx = s->uc->tcg_ctx;
+    TCGv cpu_A0 = *(TCGv *)tcg_ctx->cpu_A0;
+    TCGv src = tcg_temp_new(tcg_ctx);
+
+    gen_rep_addrs(s, src);
+    if (nz) {
+        gen_helper_repnz_cmps(tcg_ctx, tcg_ctx->cpu_env, src, cpu_A0,
+                              tcg_const_i32(tcg_ctx, ot), gen_rep_addr_mask(s));
+    } else {
+        gen_helper_repz_cmps(tcg_ctx, tcg_ctx->cpu_env, src, cpu_A0,
+                             tcg_const_i32(tcg_ctx, ot), gen_rep_addr_mask(s));
+    }
+    tcg_temp_free(tcg_ctx, src);
+}
+
 static void gen_helper_fp_arith_ST0_FT0(TCGContext *s, int op)
 {
     switch (op) {
@@ -6886,6 +6980,9 @@ static target_ulong disas_insn(CPUX86State *env, DisasContext *s,
     case 0xa5:
         ot = mo_b_d(b, dflag);
         if (prefixes & (PREFIX_REPZ | PREFIX_REPNZ)) {
+            if (gen_rep_bulk(s, pc_start)) {
+                gen_rep_bulk_movs(s, ot);
+            }
             gen_repz_movs(s, ot, pc_start - s->cs_base, s->pc - s->cs_base);
         } else {
             gen_movs(s, ot);
@@ -6896,6 +6993,9 @@ static target_ulong disas_insn(CPUX86State *env, DisasContext *s,
     case 0xab:
         ot = mo_b_d(b, dflag);
         if (prefixes & (PREFIX_REPZ | PREFIX_REPNZ)) {
+            if (gen_rep_bulk(s, pc_start)) {
+                gen_rep_bulk_stos(s, ot);
+            }
             gen_repz_stos(s, ot, pc_start - s->cs_base, s->pc - s->cs_base);
         } else {
             gen_stos(s, ot);
@@ -6914,8 +7014,14 @@ static target_ulong disas_insn(CPUX86State *env, DisasContext *s,
     case 0xaf:
         ot = mo_b_d(b, dflag);
         if (prefixes & PREFIX_REPNZ) {
+            if (gen_rep_bulk(s, pc_start)) {
+                gen_rep_bulk_scas(s, ot, 1);
+            }
             gen_repz_scas(s, ot, pc_start - s->cs_base, s->pc - s->cs_base, 1);
         } else if (prefixes & PREFIX_REPZ) {
+            if (gen_rep_bulk(s, pc_start)) {
+                gen_rep_bulk_scas(s, ot, 0);
+            }
             gen_repz_scas(s, ot, pc_start - s->cs_base, s->pc - s->cs_base, 0);
         } else {
             gen_scas(s, ot);
@@ -6926,8 +7032,14 @@ static target_ulong disas_insn(CPUX86State *env, DisasContext *s,
     case 0xa7:
         ot = mo_b_d(b, dflag);
         if (prefixes & PREFIX_REPNZ) {
+            if (gen_rep_bulk(s, pc_start)) {
+                gen_rep_bulk_cmps(s, ot, 1);
+            }
             gen_repz_cmps(s, ot, pc_start - s->cs_base, s->pc - s->cs_base, 1);
         } else if (prefixes & PREFIX_REPZ) {
+            if (gen_rep_bulk(s, pc_start)) {
+                gen_rep_bulk_cmps(s, ot, 0);
+            }
             gen_repz_cmps(s, ot, pc_start - s->cs_base, s->pc - s->cs_base, 0);
         } else {
             gen_cmps(s, ot);
@@ -8692,17 +8804,18 @@ static inline void gen_intermediate_code_internal(uint8_t *gen_opc_cc_op,
     if (max_insns == 0)
         max_insns = CF_COUNT_MASK;
 
+    gen_tb_start(tcg_ctx);
+
     // Unicorn: trace this block on request
     // Only hook this block if the previous block was not truncated due to space
     if (!env->uc->block_full && HOOK_EXISTS_BOUNDED(env->uc, UC_HOOK_BLOCK, pc_start)) {
         env->uc->block_addr = pc_start;
-        env->uc->size_arg = tcg_ctx->gen_opparam_buf - tcg_ctx->gen_opparam_ptr + 1;
+        env->uc->size_arg = tcg_ctx->gen_opparam_ptr - tcg_ctx->gen_opparam_buf + 1;
         gen_uc_tracecode(tcg_ctx, 0xf8f8f8f8, UC_HOOK_BLOCK_IDX, env->uc, pc_start);
     } else {
         env->uc->size_arg = -1;
     }
 
-    gen_tb_start(tcg_ctx);
     for(;;) {
         if (unlikely(!QTAILQ_EMPTY(&cs->breakpoints))) {
             QTAILQ_FOREACH(bp, &cs->breakpoints, entry) {
@@ -8723,7 +8836,7 @@ static inline void gen_intermediate_code_internal(uint8_t *gen_opc_cc_op,
             tcg_ctx->gen_opc_pc[lj] = pc_ptr;
             gen_opc_cc_op[lj] = dc->cc_op;
             tcg_ctx->gen_opc_instr_start[lj] = 1;
-            // tcg_ctx->gen_opc_icount[lj] = num_insns;
+            tcg_ctx->gen_opc_icount[lj] = num_insns;
         }
         //if (num_insns + 1 == max_insns && (tb->cflags & CF_LAST_IO))
         //    gen_io_start();
@@ -8777,6 +8890,7 @@ done_generating:
 
     if (!search_pc) {
         tb->size = pc_ptr - pc_start;
+        tb->icount = num_insns;
     }
 
     env->uc->block_full = block_full;
@@ -19214,19 +19214,20 @@ gen_intermediate_code_internal(MIPSCPU *cpu, TranslationBlock *tb,
         goto done_generating;
     }
 
+    gen_tb_start(tcg_ctx);
+
     // Unicorn: trace this block on request
     // Only hook this block if it is not broken from previous translation due to
     // full translation cache
     if (!env->uc->block_full && HOOK_EXISTS_BOUNDED(env->uc, UC_HOOK_BLOCK, pc_start)) {
         // save block address to see if we need to patch block size later
         env->uc->block_addr = pc_start;
-        env->uc->size_arg = tcg_ctx->gen_opparam_buf - tcg_ctx->gen_opparam_ptr + 1;
+        env->uc->size_arg = tcg_ctx->gen_opparam_ptr - tcg_ctx->gen_opparam_buf + 1;
         gen_uc_tracecode(tcg_ctx, 0xf8f8f8f8, UC_HOOK_BLOCK_IDX, env->uc, pc_start);
     } else {
         env->uc->size_arg = -1;
     }
 
-    gen_tb_start(tcg_ctx);
     while (ctx.bstate == BS_NONE) {
         // printf(">>> mips pc = %x\n", ctx.pc);
         if (unlikely(!QTAILQ_EMPTY(&cs->breakpoints))) {
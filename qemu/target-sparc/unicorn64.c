@@ -28,6 +28,14 @@ static void sparc_set_pc(struct uc_struct *uc, uint64_t address)
     ((CPUSPARCState *)uc->current_cpu->env_ptr)->npc = address + 4;
 }
 
+// registers copied from another engine point to its register windows
+static void sparc_context_copied(struct uc_struct *uc)
+{
+    CPUArchState *env = uc->cpu->env_ptr;
+
+    env->regwptr = env->regbase + (env->cwp * 16);
+}
+
 void sparc_reg_reset(struct uc_struct *uc)
 {
     CPUArchState *env = uc->cpu->env_ptr;
@@ -109,6 +117,7 @@ void sparc64_uc_init(struct uc_struct* uc)
     uc->reg_read = sparc_reg_read;
     uc->reg_write = sparc_reg_write;
     uc->reg_reset = sparc_reg_reset;
+    uc->context_copied = sparc_context_copied;
     uc->set_pc = sparc_set_pc;
     uc->stop_interrupt = sparc_stop_interrupt;
     uc_common_init(uc);
@@ -959,6 +959,16 @@ void check_exit_request(TCGContext *tcg_ctx)
     tcg_temp_free_i32(tcg_ctx, flag);
 }
 
+// check for an exit request after a data access, only if a memory hook or
+// an MMIO callback could stop emulation there when the block was translated
+// (see tb_gen_code). Invalid accesses unwind to the faulting instruction
+// themselves (see softmmu_template.h).
+static inline void check_mem_exit_request(TCGContext *tcg_ctx)
+{
+    if (tcg_ctx->mem_exit_check)
+        check_exit_request(tcg_ctx);
+}
+
 void tcg_gen_qemu_ld_i32(struct uc_struct *uc, TCGv_i32 val, TCGv addr, TCGArg idx, TCGMemOp memop)
 {
     TCGContext *tcg_ctx = uc->tcg_ctx;
@@ -971,7 +981,7 @@ void tcg_gen_qemu_ld_i32(struct uc_struct *uc, TCGv_i32 val, TCGv addr, TCGArg i
     *tcg_ctx->gen_opparam_ptr++ = memop;
     *tcg_ctx->gen_opparam_ptr++ = idx;
 
-    check_exit_request(tcg_ctx);
+    check_mem_exit_request(tcg_ctx);
 }
 
 void tcg_gen_qemu_st_i32(struct uc_struct *uc, TCGv_i32 val, TCGv addr, TCGArg idx, TCGMemOp memop)
@@ -986,7 +996,7 @@ void tcg_gen_qemu_st_i32(struct uc_struct *uc, TCGv_i32 val, TCGv addr, TCGArg i
     *tcg_ctx->gen_opparam_ptr++ = memop;
     *tcg_ctx->gen_opparam_ptr++ = idx;
 
-    check_exit_request(tcg_ctx);
+    check_mem_exit_request(tcg_ctx);
 }
 
 void tcg_gen_qemu_ld_i64(struct uc_struct *uc, TCGv_i64 val, TCGv addr, TCGArg idx, TCGMemOp memop)
@@ -1004,7 +1014,7 @@ void tcg_gen_qemu_ld_i64(struct uc_struct *uc, TCGv_i64 val, TCGv addr, TCGArg i
             tcg_gen_movi_i32(tcg_ctx, TCGV_HIGH(val), 0);
         }
 
-        check_exit_request(tcg_ctx);
+        check_mem_exit_request(tcg_ctx);
         return;
     }
 #endif
@@ -1015,7 +1025,7 @@ void tcg_gen_qemu_ld_i64(struct uc_struct *uc, TCGv_i64 val, TCGv addr, TCGArg i
     *tcg_ctx->gen_opparam_ptr++ = memop;
     *tcg_ctx->gen_opparam_ptr++ = idx;
 
-    check_exit_request(tcg_ctx);
+    check_mem_exit_request(tcg_ctx);
 }
 
 void tcg_gen_qemu_st_i64(struct uc_struct *uc, TCGv_i64 val, TCGv addr, TCGArg idx, TCGMemOp memop)
@@ -1027,7 +1037,7 @@ void tcg_gen_qemu_st_i64(struct uc_struct *uc, TCGv_i64 val, TCGv addr, TCGArg i
 #if TCG_TARGET_REG_BITS == 32
     if ((memop & MO_SIZE) < MO_64) {
         tcg_gen_qemu_st_i32(uc, TCGV_LOW(val), addr, idx, memop);
-        check_exit_request(tcg_ctx);
+        check_mem_exit_request(tcg_ctx);
         return;
     }
 #endif
@@ -1038,7 +1048,7 @@ void tcg_gen_qemu_st_i64(struct uc_struct *uc, TCGv_i64 val, TCGv addr, TCGArg i
     *tcg_ctx->gen_opparam_ptr++ = memop;
     *tcg_ctx->gen_opparam_ptr++ = idx;
 
-    check_exit_request(tcg_ctx);
+    check_mem_exit_request(tcg_ctx);
 }
 
 static void tcg_reg_alloc_start(TCGContext *s)
@@ -2635,6 +2645,10 @@ static inline int tcg_gen_code_common(TCGContext *s,
         case INDEX_op_set_label:
             tcg_reg_alloc_bb_end(s, s->reserved_regs);
             tcg_out_label(s, args[0], s->code_ptr);
+#if defined(CONFIG_TCG_INTERPRETER)
+            /* branches land here, keep the next op a separate instruction */
+            s->tci_fuse_ptr = NULL;
+#endif
             break;
         case INDEX_op_call:
             ret = tcg_reg_alloc_call(s, def, opc, args,
@@ -136,6 +136,18 @@ typedef enum TCGOpcode {
     NB_OPS,
 } TCGOpcode;
 
+#if defined(CONFIG_TCG_INTERPRETER)
+/* Opcodes of the interpreter superinstructions, numbered after the TCG
+   ones. See TCI_FUSED_OPS in tcg/tci/tcg-target.h. */
+typedef enum TCIFusedOpcode {
+    TCI_FUSED_BEFORE_FIRST = NB_OPS - 1,
+#define FUSED(name, first, second) INDEX_op_tci_ ## name,
+    TCI_FUSED_OPS(FUSED)
+#undef FUSED
+    TCI_NB_OPS,
+} TCIFusedOpcode;
+#endif
+
 #define tcg_regset_clear(d) (d) = 0
 #define tcg_regset_set(d, s) (d) = (s)
 #define tcg_regset_set32(d, reg, val32) (d) |= (val32) << (reg)
@@ -592,6 +604,17 @@ struct TCGContext {
     /* tells in which temporary a given register is. It does not take
        into account fixed registers */
     int reg_to_temp[TCG_TARGET_NB_REGS];
+#if defined(CONFIG_TCG_INTERPRETER)
+    /* register file of the interpreter, bytecode operands point into it */
+    tcg_target_ulong tci_regs[TCG_TARGET_NB_REGS];
+    /* last instruction emitted, which the next one may be fused into */
+    tcg_insn_unit *tci_fuse_ptr;
+    int tci_fuse_opc;
+#ifdef CONFIG_TCI_PROFILE
+    /* TCI_NB_OPS x TCI_NB_OPS counts of consecutive instructions run */
+    uint64_t *tci_profile;
+#endif
+#endif
     TCGRegSet reserved_regs;
     intptr_t current_frame_offset;
     intptr_t frame_start;
@@ -648,6 +671,10 @@ struct TCGContext {
     /* threshold to flush the translated code buffer */
     size_t code_gen_buffer_max_size;
     void *code_gen_ptr;
+    /* Unicorn: buffer replaced by a bigger one, with its TBs */
+    void *code_gen_buffer_retired;
+    size_t code_gen_buffer_retired_size;
+    TranslationBlock *tbs_retired;
 
     TBContext tb_ctx;
 
@@ -759,6 +786,9 @@ struct TCGContext {
     void *cpu_wim;
 
     int exitreq_label;  // gen_tb_start()
+    int icount_label;   // gen_tb_start() when counting instructions
+    TCGArg *icount_arg; // instruction count of the block, set by gen_tb_end()
+    bool mem_exit_check;    // check for exit requests after memory accesses
 };
 
 typedef struct TCGTargetOpDef {
@@ -937,6 +967,15 @@ static inline size_t tcg_current_code_size(TCGContext *s)
     ((uintptr_t (*)(void *, void *))tcg_ctx->code_gen_prologue)(env, tb_ptr)
 #endif
 
+#if defined(CONFIG_TCG_INTERPRETER)
+/* First bytecode slot of an instruction for opc, a TCGOpcode or a
+   TCIFusedOpcode. See tcg/tci/tcg-target.c. */
+tcg_target_ulong tci_op_entry(int opc);
+#ifdef CONFIG_TCI_PROFILE
+void tci_profile_dump(TCGContext *s);
+#endif
+#endif
+
 /*
  * Memory helpers that will be used by TCG generated code.
  */
@@ -397,6 +397,19 @@ void tci_disas(uint8_t opc)
 }
 #endif
 
+/* The bytecode is a sequence of tcg_target_ulong slots. An instruction
+   starts with the entry of its opcode (see tci_op_entry()), followed by
+   one slot per operand:
+
+   - registers hold the address of the register in s->tci_regs,
+   - register-or-constant operands take two slots: the address of the
+     value, then the constant itself. A constant points at its own second
+     slot, a register leaves the second slot unused,
+   - immediates (offsets, conditions, memops, labels, ...) hold the value.
+
+   So every opcode has a fixed size and tci.c reads any operand with a
+   single load. */
+
 /* Write value (native size). */
 static void tcg_out_i(TCGContext *s, tcg_target_ulong v)
 {
@@ -407,57 +420,67 @@ static void tcg_out_i(TCGContext *s, tcg_target_ulong v)
     }
 }
 
-/* Write opcode. */
-static void tcg_out_op_t(TCGContext *s, TCGOpcode op)
+/* Overwrite value (native size). */
+static void tcg_patch_i(tcg_insn_unit *p, tcg_target_ulong v)
 {
-    tcg_out8(s, op);
-    tcg_out8(s, 0);
+    if (TCG_TARGET_REG_BITS == 32) {
+        tcg_patch32(p, v);
+    } else {
+        tcg_patch64(p, v);
+    }
 }
 
-/* Write register. */
-static void tcg_out_r(TCGContext *s, TCGArg t0)
+/* Superinstruction running first then second, or -1. */
+static int tci_fused_op(int first, TCGOpcode second)
 {
-    assert(t0 < TCG_TARGET_NB_REGS);
-    tcg_out8(s, t0);
+#define FUSED(name, a, b) \
+    if (first == (a) && second == (b)) { \
+        return INDEX_op_tci_ ## name; \
+    }
+    TCI_FUSED_OPS(FUSED)
+#undef FUSED
+    return -1;
 }
 
-/* Write register or constant (native size). */
-static void tcg_out_ri(TCGContext *s, int const_arg, TCGArg arg)
+/* Write opcode. If the previous instruction and op form a superinstruction,
+   turn the previous one into it instead: the operands of op then directly
+   follow those of the previous instruction. */
+static void tcg_out_op_t(TCGContext *s, TCGOpcode op)
 {
-    if (const_arg) {
-        assert(const_arg == 1);
-        tcg_out8(s, TCG_CONST);
-        tcg_out_i(s, arg);
+    int fused = -1;
+
+    if (s->tci_fuse_ptr != NULL && s->code_ptr != s->code_buf) {
+        fused = tci_fused_op(s->tci_fuse_opc, op);
+    }
+    if (fused >= 0) {
+        tcg_patch_i(s->tci_fuse_ptr, tci_op_entry(fused));
+        s->tci_fuse_opc = fused;
     } else {
-        tcg_out_r(s, arg);
+        s->tci_fuse_ptr = s->code_ptr;
+        s->tci_fuse_opc = op;
+        tcg_out_i(s, tci_op_entry(op));
     }
 }
 
-/* Write register or constant (32 bit). */
-static void tcg_out_ri32(TCGContext *s, int const_arg, TCGArg arg)
+/* Write register. */
+static void tcg_out_r(TCGContext *s, TCGArg t0)
 {
-    if (const_arg) {
-        assert(const_arg == 1);
-        tcg_out8(s, TCG_CONST);
-        tcg_out32(s, arg);
-    } else {
-        tcg_out_r(s, arg);
-    }
+    assert(t0 < TCG_TARGET_NB_REGS);
+    tcg_out_i(s, (uintptr_t)&s->tci_regs[t0]);
 }
 
-#if TCG_TARGET_REG_BITS == 64
-/* Write register or constant (64 bit). */
-static void tcg_out_ri64(TCGContext *s, int const_arg, TCGArg arg)
+/* Write register or constant. */
+static void tcg_out_ri(TCGContext *s, int const_arg, TCGArg arg)
 {
     if (const_arg) {
         assert(const_arg == 1);
-        tcg_out8(s, TCG_CONST);
-        tcg_out64(s, arg);
+        tcg_out_i(s, (uintptr_t)(s->code_ptr + sizeof(tcg_target_ulong)));
+        tcg_out_i(s, arg);
     } else {
         tcg_out_r(s, arg);
+        tcg_out_i(s, 0);
     }
 }
-#endif
 
 /* Write label. */
 static void tci_out_label(TCGContext *s, TCGArg arg)
@@ -475,30 +498,26 @@ static void tci_out_label(TCGContext *s, TCGArg arg)
 static void tcg_out_ld(TCGContext *s, TCGType type, TCGReg ret, TCGReg arg1,
                        intptr_t arg2)
 {
-    uint8_t *old_code_ptr = s->code_ptr;
     if (type == TCG_TYPE_I32) {
         tcg_out_op_t(s, INDEX_op_ld_i32);
         tcg_out_r(s, ret);
         tcg_out_r(s, arg1);
-        tcg_out32(s, arg2);
+        tcg_out_i(s, arg2);
     } else {
         assert(type == TCG_TYPE_I64);
 #if TCG_TARGET_REG_BITS == 64
         tcg_out_op_t(s, INDEX_op_ld_i64);
         tcg_out_r(s, ret);
         tcg_out_r(s, arg1);
-        assert(arg2 == (int32_t)arg2);
-        tcg_out32(s, arg2);
+        tcg_out_i(s, arg2);
 #else
         TODO();
 #endif
     }
-    old_code_ptr[1] = s->code_ptr - old_code_ptr;
 }
 
 static void tcg_out_mov(TCGContext *s, TCGType type, TCGReg ret, TCGReg arg)
 {
-    uint8_t *old_code_ptr = s->code_ptr;
     assert(ret != arg);
 #if TCG_TARGET_REG_BITS == 32
     tcg_out_op_t(s, INDEX_op_mov_i32);
@@ -507,56 +526,50 @@ static void tcg_out_mov(TCGContext *s, TCGType type, TCGReg ret, TCGReg arg)
 #endif
     tcg_out_r(s, ret);
     tcg_out_r(s, arg);
-    old_code_ptr[1] = s->code_ptr - old_code_ptr;
 }
 
 static void tcg_out_movi(TCGContext *s, TCGType type,
                          TCGReg t0, tcg_target_long arg)
 {
-    uint8_t *old_code_ptr = s->code_ptr;
     uint32_t arg32 = arg;
     if (type == TCG_TYPE_I32 || arg == arg32) {
         tcg_out_op_t(s, INDEX_op_movi_i32);
         tcg_out_r(s, t0);
-        tcg_out32(s, arg32);
+        tcg_out_i(s, arg32);
     } else {
         assert(type == TCG_TYPE_I64);
 #if TCG_TARGET_REG_BITS == 64
         tcg_out_op_t(s, INDEX_op_movi_i64);
         tcg_out_r(s, t0);
-        tcg_out64(s, arg);
+        tcg_out_i(s, arg);
 #else
         TODO();
 #endif
     }
-    old_code_ptr[1] = s->code_ptr - old_code_ptr;
 }
 
 static inline void tcg_out_call(TCGContext *s, tcg_insn_unit *arg)
 {
-    uint8_t *old_code_ptr = s->code_ptr;
     tcg_out_op_t(s, INDEX_op_call);
-    tcg_out_ri(s, 1, (uintptr_t)arg);
-    old_code_ptr[1] = s->code_ptr - old_code_ptr;
+    tcg_out_i(s, (uintptr_t)arg);
 }
 
 static void tcg_out_op(TCGContext *s, TCGOpcode opc, const TCGArg *args,
                        const int *const_args)
 {
-    uint8_t *old_code_ptr = s->code_ptr;
-
     tcg_out_op_t(s, opc);
 
     switch (opc) {
     case INDEX_op_exit_tb:
-        tcg_out64(s, args[0]);
+        tcg_out_i(s, args[0]);
         break;
     case INDEX_op_goto_tb:
         if (s->tb_jmp_offset) {
-            /* Direct jump method. */
+            /* Direct jump method: the slot holds the bytecode address to
+               continue at, the following exit_tb until the TB is chained. */
             assert(args[0] < ARRAY_SIZE(s->tb_jmp_offset));
             s->tb_jmp_offset[args[0]] = tcg_current_code_size(s);
-            tcg_out32(s, 0);
+            tcg_out_i(s, (uintptr_t)(s->code_ptr + sizeof(tcg_target_ulong)));
         } else {
             /* Indirect jump method. */
             TODO();
@@ -570,8 +583,8 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc, const TCGArg *args,
     case INDEX_op_setcond_i32:
         tcg_out_r(s, args[0]);
         tcg_out_r(s, args[1]);
-        tcg_out_ri32(s, const_args[2], args[2]);
-        tcg_out8(s, args[3]);   /* condition */
+        tcg_out_ri(s, const_args[2], args[2]);
+        tcg_out_i(s, args[3]);  /* condition */
         break;
 #if TCG_TARGET_REG_BITS == 32
     case INDEX_op_setcond2_i32:
@@ -579,16 +592,16 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc, const TCGArg *args,
         tcg_out_r(s, args[0]);
         tcg_out_r(s, args[1]);
         tcg_out_r(s, args[2]);
-        tcg_out_ri32(s, const_args[3], args[3]);
-        tcg_out_ri32(s, const_args[4], args[4]);
-        tcg_out8(s, args[5]);   /* condition */
+        tcg_out_ri(s, const_args[3], args[3]);
+        tcg_out_ri(s, const_args[4], args[4]);
+        tcg_out_i(s, args[5]);  /* condition */
         break;
 #elif TCG_TARGET_REG_BITS == 64
     case INDEX_op_setcond_i64:
         tcg_out_r(s, args[0]);
         tcg_out_r(s, args[1]);
-        tcg_out_ri64(s, const_args[2], args[2]);
-        tcg_out8(s, args[3]);   /* condition */
+        tcg_out_ri(s, const_args[2], args[2]);
+        tcg_out_i(s, args[3]);  /* condition */
         break;
 #endif
     case INDEX_op_ld8u_i32:
@@ -612,8 +625,7 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc, const TCGArg *args,
     case INDEX_op_st_i64:
         tcg_out_r(s, args[0]);
         tcg_out_r(s, args[1]);
-        assert(args[2] == (int32_t)args[2]);
-        tcg_out32(s, args[2]);
+        tcg_out_i(s, args[2]);
         break;
     case INDEX_op_add_i32:
     case INDEX_op_sub_i32:
@@ -632,17 +644,15 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc, const TCGArg *args,
     case INDEX_op_rotl_i32:     /* Optional (TCG_TARGET_HAS_rot_i32). */
     case INDEX_op_rotr_i32:     /* Optional (TCG_TARGET_HAS_rot_i32). */
         tcg_out_r(s, args[0]);
-        tcg_out_ri32(s, const_args[1], args[1]);
-        tcg_out_ri32(s, const_args[2], args[2]);
+        tcg_out_ri(s, const_args[1], args[1]);
+        tcg_out_ri(s, const_args[2], args[2]);
         break;
     case INDEX_op_deposit_i32:  /* Optional (TCG_TARGET_HAS_deposit_i32). */
         tcg_out_r(s, args[0]);
         tcg_out_r(s, args[1]);
         tcg_out_r(s, args[2]);
-        assert(args[3] <= UINT8_MAX);
-        tcg_out8(s, args[3]);
-        assert(args[4] <= UINT8_MAX);
-        tcg_out8(s, args[4]);
+        tcg_out_i(s, args[3]);  /* position */
+        tcg_out_i(s, args[4]);  /* length */
         break;
 
 #if TCG_TARGET_REG_BITS == 64
@@ -663,17 +673,15 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc, const TCGArg *args,
     case INDEX_op_rotl_i64:     /* Optional (TCG_TARGET_HAS_rot_i64). */
     case INDEX_op_rotr_i64:     /* Optional (TCG_TARGET_HAS_rot_i64). */
         tcg_out_r(s, args[0]);
-        tcg_out_ri64(s, const_args[1], args[1]);
-        tcg_out_ri64(s, const_args[2], args[2]);
+        tcg_out_ri(s, const_args[1], args[1]);
+        tcg_out_ri(s, const_args[2], args[2]);
         break;
     case INDEX_op_deposit_i64:  /* Optional (TCG_TARGET_HAS_deposit_i64). */
         tcg_out_r(s, args[0]);
         tcg_out_r(s, args[1]);
         tcg_out_r(s, args[2]);
-        assert(args[3] <= UINT8_MAX);
-        tcg_out8(s, args[3]);
-        assert(args[4] <= UINT8_MAX);
-        tcg_out8(s, args[4]);
+        tcg_out_i(s, args[3]);  /* position */
+        tcg_out_i(s, args[4]);  /* length */
         break;
     case INDEX_op_div_i64:      /* Optional (TCG_TARGET_HAS_div_i64). */
     case INDEX_op_divu_i64:     /* Optional (TCG_TARGET_HAS_div_i64). */
@@ -687,8 +695,8 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc, const TCGArg *args,
         break;
     case INDEX_op_brcond_i64:
         tcg_out_r(s, args[0]);
-        tcg_out_ri64(s, const_args[1], args[1]);
-        tcg_out8(s, args[2]);           /* condition */
+        tcg_out_ri(s, const_args[1], args[1]);
+        tcg_out_i(s, args[2]);          /* condition */
         tci_out_label(s, args[3]);
         break;
     case INDEX_op_bswap16_i64:  /* Optional (TCG_TARGET_HAS_bswap16_i64). */
@@ -719,8 +727,8 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc, const TCGArg *args,
     case INDEX_op_rem_i32:      /* Optional (TCG_TARGET_HAS_div_i32). */
     case INDEX_op_remu_i32:     /* Optional (TCG_TARGET_HAS_div_i32). */
         tcg_out_r(s, args[0]);
-        tcg_out_ri32(s, const_args[1], args[1]);
-        tcg_out_ri32(s, const_args[2], args[2]);
+        tcg_out_r(s, args[1]);
+        tcg_out_r(s, args[2]);
         break;
     case INDEX_op_div2_i32:     /* Optional (TCG_TARGET_HAS_div2_i32). */
     case INDEX_op_divu2_i32:    /* Optional (TCG_TARGET_HAS_div2_i32). */
@@ -739,9 +747,9 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc, const TCGArg *args,
     case INDEX_op_brcond2_i32:
         tcg_out_r(s, args[0]);
         tcg_out_r(s, args[1]);
-        tcg_out_ri32(s, const_args[2], args[2]);
-        tcg_out_ri32(s, const_args[3], args[3]);
-        tcg_out8(s, args[4]);           /* condition */
+        tcg_out_ri(s, const_args[2], args[2]);
+        tcg_out_ri(s, const_args[3], args[3]);
+        tcg_out_i(s, args[4]);          /* condition */
         tci_out_label(s, args[5]);
         break;
     case INDEX_op_mulu2_i32:
@@ -753,8 +761,8 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc, const TCGArg *args,
 #endif
     case INDEX_op_brcond_i32:
         tcg_out_r(s, args[0]);
-        tcg_out_ri32(s, const_args[1], args[1]);
-        tcg_out8(s, args[2]);           /* condition */
+        tcg_out_ri(s, const_args[1], args[1]);
+        tcg_out_i(s, args[2]);          /* condition */
         tci_out_label(s, args[3]);
         break;
     case INDEX_op_qemu_ld_i32:
@@ -815,30 +823,27 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc, const TCGArg *args,
     default:
         tcg_abort();
     }
-    old_code_ptr[1] = s->code_ptr - old_code_ptr;
 }
 
 static void tcg_out_st(TCGContext *s, TCGType type, TCGReg arg, TCGReg arg1,
                        intptr_t arg2)
 {
-    uint8_t *old_code_ptr = s->code_ptr;
     if (type == TCG_TYPE_I32) {
         tcg_out_op_t(s, INDEX_op_st_i32);
         tcg_out_r(s, arg);
         tcg_out_r(s, arg1);
-        tcg_out32(s, arg2);
+        tcg_out_i(s, arg2);
     } else {
         assert(type == TCG_TYPE_I64);
 #if TCG_TARGET_REG_BITS == 64
         tcg_out_op_t(s, INDEX_op_st_i64);
         tcg_out_r(s, arg);
         tcg_out_r(s, arg1);
-        tcg_out32(s, arg2);
+        tcg_out_i(s, arg2);
 #else
         TODO();
 #endif
     }
-    old_code_ptr[1] = s->code_ptr - old_code_ptr;
 }
 
 /* Test if a constant matches the constraint. */
@@ -858,9 +863,6 @@ static void tcg_target_init(TCGContext *s)
     }
 #endif
 
-    /* The current code uses uint8_t for tcg operations. */
-    assert(ARRAY_SIZE(tcg_op_defs) <= UINT8_MAX);
-
     /* Registers available for 32 bit operations. */
     tcg_regset_set32(s->tcg_target_available_regs[TCG_TYPE_I32], 0,
                      BIT(TCG_TARGET_NB_REGS) - 1);
@@ -52,289 +52,49 @@ typedef uint64_t (*helper_function)(tcg_target_ulong, tcg_target_ulong,
                                     tcg_target_ulong);
 #endif
 
-/* Targets which don't use GETPC also don't need tci_tb_ptr
-   which makes them a little faster. */
-#if defined(GETPC)
-uintptr_t tci_tb_ptr;
-#endif
-
-static tcg_target_ulong tci_reg[TCG_TARGET_NB_REGS];
-
-static tcg_target_ulong tci_read_reg(TCGReg index)
-{
-    assert(index < ARRAY_SIZE(tci_reg));
-    return tci_reg[index];
-}
-
-#if TCG_TARGET_HAS_ext8s_i32 || TCG_TARGET_HAS_ext8s_i64
-static int8_t tci_read_reg8s(TCGReg index)
-{
-    return (int8_t)tci_read_reg(index);
-}
-#endif
-
-#if TCG_TARGET_HAS_ext16s_i32 || TCG_TARGET_HAS_ext16s_i64
-static int16_t tci_read_reg16s(TCGReg index)
-{
-    return (int16_t)tci_read_reg(index);
-}
-#endif
-
-#if TCG_TARGET_REG_BITS == 64
-static int32_t tci_read_reg32s(TCGReg index)
-{
-    return (int32_t)tci_read_reg(index);
-}
-#endif
-
-static uint8_t tci_read_reg8(TCGReg index)
-{
-    return (uint8_t)tci_read_reg(index);
-}
-
-static uint16_t tci_read_reg16(TCGReg index)
-{
-    return (uint16_t)tci_read_reg(index);
-}
+/* Bytecode format (see tcg/tci/tcg-target.c): an instruction is a run of
+   tcg_target_ulong slots, the entry of its opcode first. Register operands
+   and register-or-constant operands both hold the address of their value,
+   either in the register file of the engine or in the slot following the
+   operand, so every operand is read with a single indirection and every
+   opcode has a fixed size. */
 
-static uint32_t tci_read_reg32(TCGReg index)
-{
-    return (uint32_t)tci_read_reg(index);
-}
-
-#if TCG_TARGET_REG_BITS == 64
-static uint64_t tci_read_reg64(TCGReg index)
-{
-    return tci_read_reg(index);
-}
-#endif
-
-static void tci_write_reg(TCGReg index, tcg_target_ulong value)
-{
-    assert(index < ARRAY_SIZE(tci_reg));
-    assert(index != TCG_AREG0);
-    assert(index != TCG_REG_CALL_STACK);
-    tci_reg[index] = value;
-}
-
-#if TCG_TARGET_REG_BITS == 64
-static void tci_write_reg32s(TCGReg index, int32_t value)
-{
-    tci_write_reg(index, value);
-}
-#endif
-
-static void tci_write_reg8(TCGReg index, uint8_t value)
-{
-    tci_write_reg(index, value);
-}
-
-static void tci_write_reg32(TCGReg index, uint32_t value)
-{
-    tci_write_reg(index, value);
-}
-
-#if TCG_TARGET_REG_BITS == 32
-static void tci_write_reg64(uint32_t high_index, uint32_t low_index,
-                            uint64_t value)
-{
-    tci_write_reg(low_index, value);
-    tci_write_reg(high_index, value >> 32);
-}
-#elif TCG_TARGET_REG_BITS == 64
-static void tci_write_reg64(TCGReg index, uint64_t value)
-{
-    tci_write_reg(index, value);
-}
-#endif
+/* Register (or register-or-constant) operand n of the instruction at pc. */
+#define tci_reg(n)      (*(tcg_target_ulong *)pc[n])
 
 #if TCG_TARGET_REG_BITS == 32
 /* Create a 64 bit value from two 32 bit values. */
-static uint64_t tci_uint64(uint32_t high, uint32_t low)
+static inline uint64_t tci_uint64(uint32_t high, uint32_t low)
 {
     return ((uint64_t)high << 32) + low;
 }
-#endif
 
-/* Read constant (native size) from bytecode. */
-static tcg_target_ulong tci_read_i(uint8_t **tb_ptr)
-{
-    tcg_target_ulong value = UNALIGNED_READ32_LE(*tb_ptr);
-    *tb_ptr += sizeof(value);
-    return value;
-}
-
-/* Read unsigned constant (32 bit) from bytecode. */
-static uint32_t tci_read_i32(uint8_t **tb_ptr)
-{
-    uint32_t value = UNALIGNED_READ32_LE(*tb_ptr);
-    *tb_ptr += sizeof(value);
-    return value;
-}
-
-/* Read signed constant (32 bit) from bytecode. */
-static int32_t tci_read_s32(uint8_t **tb_ptr)
-{
-    int32_t value = UNALIGNED_READ32_LE(*tb_ptr);
-    *tb_ptr += sizeof(value);
-    return value;
-}
-
-#if TCG_TARGET_REG_BITS == 64
-/* Read constant (64 bit) from bytecode. */
-static uint64_t tci_read_i64(uint8_t **tb_ptr)
-{
-    uint64_t value = *(uint64_t *)(*tb_ptr);
-    *tb_ptr += sizeof(value);
-    return value;
-}
-#endif
-
-/* Read indexed register (native size) from bytecode. */
-static tcg_target_ulong tci_read_r(uint8_t **tb_ptr)
-{
-    tcg_target_ulong value = tci_read_reg(**tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-
-/* Read indexed register (8 bit) from bytecode. */
-static uint8_t tci_read_r8(uint8_t **tb_ptr)
-{
-    uint8_t value = tci_read_reg8(**tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-
-#if TCG_TARGET_HAS_ext8s_i32 || TCG_TARGET_HAS_ext8s_i64
-/* Read indexed register (8 bit signed) from bytecode. */
-static int8_t tci_read_r8s(uint8_t **tb_ptr)
-{
-    int8_t value = tci_read_reg8s(**tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-#endif
-
-/* Read indexed register (16 bit) from bytecode. */
-static uint16_t tci_read_r16(uint8_t **tb_ptr)
-{
-    uint16_t value = tci_read_reg16(**tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-
-#if TCG_TARGET_HAS_ext16s_i32 || TCG_TARGET_HAS_ext16s_i64
-/* Read indexed register (16 bit signed) from bytecode. */
-static int16_t tci_read_r16s(uint8_t **tb_ptr)
-{
-    int16_t value = tci_read_reg16s(**tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-#endif
-
-/* Read indexed register (32 bit) from bytecode. */
-static uint32_t tci_read_r32(uint8_t **tb_ptr)
-{
-    uint32_t value = tci_read_reg32(**tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-
-#if TCG_TARGET_REG_BITS == 32
-/* Read two indexed registers (2 * 32 bit) from bytecode. */
-static uint64_t tci_read_r64(uint8_t **tb_ptr)
-{
-    uint32_t low = tci_read_r32(tb_ptr);
-    return tci_uint64(tci_read_r32(tb_ptr), low);
-}
-#elif TCG_TARGET_REG_BITS == 64
-/* Read indexed register (32 bit signed) from bytecode. */
-static int32_t tci_read_r32s(uint8_t **tb_ptr)
-{
-    int32_t value = tci_read_reg32s(**tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
-
-/* Read indexed register (64 bit) from bytecode. */
-static uint64_t tci_read_r64(uint8_t **tb_ptr)
-{
-    uint64_t value = tci_read_reg64(**tb_ptr);
-    *tb_ptr += 1;
-    return value;
-}
+/* Register pair at operands n (low) and n + 1 (high). */
+# define tci_reg64(n)   tci_uint64(tci_reg((n) + 1), tci_reg(n))
+/* Register-or-constant pair at operands n (low) and n + 2 (high). */
+# define tci_ri64(n)    tci_uint64(tci_reg((n) + 2), tci_reg(n))
+# define TCI_R64_SLOTS  2
+#else
+# define tci_reg64(n)   ((uint64_t)tci_reg(n))
+# define TCI_R64_SLOTS  1
 #endif
 
-/* Read indexed register(s) with target address from bytecode. */
-static target_ulong tci_read_ulong(uint8_t **tb_ptr)
-{
-    target_ulong taddr = tci_read_r(tb_ptr);
+/* Guest address at operand n, a register pair if the guest is wider. */
 #if TARGET_LONG_BITS > TCG_TARGET_REG_BITS
-    taddr += (uint64_t)tci_read_r(tb_ptr) << 32;
+# define tci_addr(n)    ((target_ulong)tci_reg64(n))
+# define TCI_ADDR_SLOTS 2
+#else
+# define tci_addr(n)    ((target_ulong)tci_reg(n))
+# define TCI_ADDR_SLOTS 1
 #endif
-    return taddr;
-}
 
-/* Read indexed register or constant (native size) from bytecode. */
-static tcg_target_ulong tci_read_ri(uint8_t **tb_ptr)
-{
-    tcg_target_ulong value;
-    TCGReg r = **tb_ptr;
-    *tb_ptr += 1;
-    if (r == TCG_CONST) {
-        value = tci_read_i(tb_ptr);
-    } else {
-        value = tci_read_reg(r);
-    }
-    return value;
-}
-
-/* Read indexed register or constant (32 bit) from bytecode. */
-static uint32_t tci_read_ri32(uint8_t **tb_ptr)
-{
-    uint32_t value;
-    TCGReg r = **tb_ptr;
-    *tb_ptr += 1;
-    if (r == TCG_CONST) {
-        value = tci_read_i32(tb_ptr);
-    } else {
-        value = tci_read_reg32(r);
-    }
-    return value;
-}
-
-#if TCG_TARGET_REG_BITS == 32
-/* Read two indexed registers or constants (2 * 32 bit) from bytecode. */
-static uint64_t tci_read_ri64(uint8_t **tb_ptr)
-{
-    uint32_t low = tci_read_ri32(tb_ptr);
-    return tci_uint64(tci_read_ri32(tb_ptr), low);
-}
-#elif TCG_TARGET_REG_BITS == 64
-/* Read indexed register or constant (64 bit) from bytecode. */
-static uint64_t tci_read_ri64(uint8_t **tb_ptr)
-{
-    uint64_t value;
-    TCGReg r = **tb_ptr;
-    *tb_ptr += 1;
-    if (r == TCG_CONST) {
-        value = tci_read_i64(tb_ptr);
-    } else {
-        value = tci_read_reg64(r);
-    }
-    return value;
-}
+/* Guest loads and stores carry the memop, and the MMU index for softmmu. */
+#ifdef CONFIG_SOFTMMU
+# define TCI_MMU_SLOTS  1
+#else
+# define TCI_MMU_SLOTS  0
 #endif
 
-static tcg_target_ulong tci_read_label(uint8_t **tb_ptr)
-{
-    tcg_target_ulong label = tci_read_i(tb_ptr);
-    assert(label != 0);
-    return label;
-}
-
 static bool tci_compare32(uint32_t u0, uint32_t u1, TCGCond condition)
 {
     bool result = false;
@@ -420,35 +180,91 @@ static bool tci_compare64(uint64_t u0, uint64_t u1, TCGCond condition)
 }
 
 #ifdef CONFIG_SOFTMMU
-# define mmuidx          tci_read_i(&tb_ptr)
+/* Unicorn: the softmmu TLB fast path, done inline. Return the host address
+   of a guest access hitting the TLB, or NULL when the access must go
+   through the softmmu helpers: TLB miss, MMIO or not-dirty page, access
+   crossing a page, or memory hooks to call. tlb_set_page() keeps pages
+   without UC_PROT_READ out of the read TLB and non-writable pages behind
+   TLB_MMIO, so a hit is always allowed by the region permissions. */
+static inline uint8_t *tci_tlb_haddr(CPUArchState *env, target_ulong taddr,
+                                     TCGMemOp memop, int mmu_idx, bool store)
+{
+    struct uc_struct *uc = env->uc;
+    unsigned size = 1 << (memop & MO_SIZE);
+    int index = (taddr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    CPUTLBEntry *te = &env->tlb_table[mmu_idx][index];
+
+    if (store) {
+        if (te->addr_write != (taddr & TARGET_PAGE_MASK) ||
+            HOOK_EXISTS(uc, UC_HOOK_MEM_WRITE)) {
+            return NULL;
+        }
+    } else {
+        if (te->addr_read != (taddr & TARGET_PAGE_MASK) ||
+            HOOK_EXISTS(uc, UC_HOOK_MEM_READ) ||
+            HOOK_EXISTS(uc, UC_HOOK_MEM_READ_AFTER)) {
+            return NULL;
+        }
+    }
+#ifdef ALIGNED_ONLY
+    if (taddr & (size - 1)) {
+        return NULL;
+    }
+#endif
+    if ((taddr & ~TARGET_PAGE_MASK) + size > TARGET_PAGE_SIZE) {
+        return NULL;
+    }
+    return (uint8_t *)(uintptr_t)(taddr + te->addend);
+}
+
 # define qemu_ld_ub \
-    helper_ret_ldub_mmu(env, taddr, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? (uint8_t)ldub_p(haddr) : \
+     helper_ret_ldub_mmu(env, taddr, mmuidx, (uintptr_t)pc))
 # define qemu_ld_leuw \
-    helper_le_lduw_mmu(env, taddr, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? (uint16_t)lduw_le_p(haddr) : \
+     helper_le_lduw_mmu(env, taddr, mmuidx, (uintptr_t)pc))
 # define qemu_ld_leul \
-    helper_le_ldul_mmu(env, taddr, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? (uint32_t)ldl_le_p(haddr) : \
+     helper_le_ldul_mmu(env, taddr, mmuidx, (uintptr_t)pc))
 # define qemu_ld_leq \
-    helper_le_ldq_mmu(env, taddr, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? ldq_le_p(haddr) : \
+     helper_le_ldq_mmu(env, taddr, mmuidx, (uintptr_t)pc))
 # define qemu_ld_beuw \
-    helper_be_lduw_mmu(env, taddr, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? (uint16_t)lduw_be_p(haddr) : \
+     helper_be_lduw_mmu(env, taddr, mmuidx, (uintptr_t)pc))
 # define qemu_ld_beul \
-    helper_be_ldul_mmu(env, taddr, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? (uint32_t)ldl_be_p(haddr) : \
+     helper_be_ldul_mmu(env, taddr, mmuidx, (uintptr_t)pc))
 # define qemu_ld_beq \
-    helper_be_ldq_mmu(env, taddr, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? ldq_be_p(haddr) : \
+     helper_be_ldq_mmu(env, taddr, mmuidx, (uintptr_t)pc))
 # define qemu_st_b(X) \
-    helper_ret_stb_mmu(env, taddr, X, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? stb_p(haddr, X) : \
+     helper_ret_stb_mmu(env, taddr, X, mmuidx, (uintptr_t)pc))
 # define qemu_st_lew(X) \
-    helper_le_stw_mmu(env, taddr, X, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? stw_le_p(haddr, X) : \
+     helper_le_stw_mmu(env, taddr, X, mmuidx, (uintptr_t)pc))
 # define qemu_st_lel(X) \
-    helper_le_stl_mmu(env, taddr, X, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? stl_le_p(haddr, X) : \
+     helper_le_stl_mmu(env, taddr, X, mmuidx, (uintptr_t)pc))
 # define qemu_st_leq(X) \
-    helper_le_stq_mmu(env, taddr, X, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? stq_le_p(haddr, X) : \
+     helper_le_stq_mmu(env, taddr, X, mmuidx, (uintptr_t)pc))
 # define qemu_st_bew(X) \
-    helper_be_stw_mmu(env, taddr, X, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? stw_be_p(haddr, X) : \
+     helper_be_stw_mmu(env, taddr, X, mmuidx, (uintptr_t)pc))
 # define qemu_st_bel(X) \
-    helper_be_stl_mmu(env, taddr, X, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? stl_be_p(haddr, X) : \
+     helper_be_stl_mmu(env, taddr, X, mmuidx, (uintptr_t)pc))
 # define qemu_st_beq(X) \
-    helper_be_stq_mmu(env, taddr, X, mmuidx, (uintptr_t)tb_ptr)
+    (haddr ? stq_be_p(haddr, X) : \
+     helper_be_stq_mmu(env, taddr, X, mmuidx, (uintptr_t)pc))
+/* Read the MMU index at operand n and look the access up. */
+# define tci_qemu_ldst_prepare(n, store) \
+    do { \
+        mmuidx = pc[n]; \
+        haddr = tci_tlb_haddr(env, taddr, memop, mmuidx, store); \
+    } while (0)
 #else
 # define qemu_ld_ub      ldub_p(g2h(taddr))
 # define qemu_ld_leuw    lduw_le_p(g2h(taddr))
@@ -464,805 +280,877 @@ static bool tci_compare64(uint64_t u0, uint64_t u1, TCGCond condition)
 # define qemu_st_bew(X)  stw_be_p(g2h(taddr), X)
 # define qemu_st_bel(X)  stl_be_p(g2h(taddr), X)
 # define qemu_st_beq(X)  stq_be_p(g2h(taddr), X)
+# define tci_qemu_ldst_prepare(n, store) do { } while (0)
+#endif
+
+/* The interpreter dispatches with computed gotos where the compiler has
+   them: the first slot of an instruction is then the address of its
+   handler, and moving on to the next instruction is one indirect jump.
+   Other compilers run the same handlers as the cases of a switch on the
+   opcode number stored in that slot instead, as do profiling builds, which
+   need the opcode numbers. */
+#if defined(__GNUC__) && !defined(CONFIG_TCI_SWITCH_DISPATCH) && \
+    !defined(CONFIG_TCI_PROFILE)
+# define TCI_THREADED
+#endif
+
+#ifdef TCI_THREADED
+# define TCI_OP(op)         glue(tci_, op):
+# define TCI_DISPATCH()     goto *(void *)pc[0]
+#else
+# define TCI_OP(op)         case op:
+# define TCI_DISPATCH()     continue
+#endif
+/* Step over the n slots of the current instruction and run the next one. */
+#ifdef CONFIG_TCI_PROFILE
+# define TCI_NEXT(n)        { profile[pc[0] * TCI_NB_OPS + pc[n]]++; \
+                              pc += (n); TCI_DISPATCH(); }
+#else
+# define TCI_NEXT(n)        { pc += (n); TCI_DISPATCH(); }
+#endif
+/* Run the instruction at bytecode address addr. */
+#define TCI_JUMP(addr)      { pc = (const tcg_target_ulong *)(addr); TCI_DISPATCH(); }
+
+/* Ops which superinstructions are made of. Their operands start at slot
+   o + 1: o is 0 when the op is an instruction of its own, and the number
+   of operand slots of the ops before it in a superinstruction. */
+#define tci_env_ptr(o)      ((void *)(tci_reg((o) + 2) + (tcg_target_long)pc[(o) + 3]))
+#define TCI_LD_I32(o)       tci_reg((o) + 1) = (uint32_t)ldl_he_p(tci_env_ptr(o))
+#define TCI_ST_I32(o)       stl_he_p(tci_env_ptr(o), tci_reg((o) + 1))
+#define TCI_ADD_I32(o) \
+    tci_reg((o) + 1) = (uint32_t)(tci_reg((o) + 2) + tci_reg((o) + 4))
+#define TCI_SETCOND_I32(o) \
+    tci_reg((o) + 1) = tci_compare32(tci_reg((o) + 2), tci_reg((o) + 3), \
+                                     pc[(o) + 5])
+#define TCI_BRCOND_I32(o) \
+    if (tci_compare32(tci_reg((o) + 1), tci_reg((o) + 2), pc[(o) + 4])) { \
+        TCI_JUMP(pc[(o) + 5]); \
+    }
+#if TCG_TARGET_REG_BITS == 64
+#define TCI_LD_I64(o)       tci_reg((o) + 1) = ldq_he_p(tci_env_ptr(o))
+#define TCI_ST_I64(o)       stq_he_p(tci_env_ptr(o), tci_reg((o) + 1))
+#define TCI_ADD_I64(o)      tci_reg((o) + 1) = tci_reg((o) + 2) + tci_reg((o) + 4)
+#define TCI_EXT32U_I64(o)   tci_reg((o) + 1) = (uint32_t)tci_reg((o) + 2)
+#define TCI_SETCOND_I64(o) \
+    tci_reg((o) + 1) = tci_compare64(tci_reg((o) + 2), tci_reg((o) + 3), \
+                                     pc[(o) + 5])
 #endif
 
 /* Interpret pseudo code in tb. */
 uintptr_t tcg_qemu_tb_exec(CPUArchState *env, uint8_t *tb_ptr)
 {
+#ifdef TCI_THREADED
+# define TCI_HANDLER(op)    [op] = &&glue(tci_, op)
+    static const void *const handlers[TCI_NB_OPS] = {
+        [0 ... TCI_NB_OPS - 1] = &&tci_invalid,
+        TCI_HANDLER(INDEX_op_call),
+        TCI_HANDLER(INDEX_op_br),
+        TCI_HANDLER(INDEX_op_exit_tb),
+        TCI_HANDLER(INDEX_op_goto_tb),
+        TCI_HANDLER(INDEX_op_setcond_i32),
+#if TCG_TARGET_REG_BITS == 32
+        TCI_HANDLER(INDEX_op_setcond2_i32),
+#elif TCG_TARGET_REG_BITS == 64
+        TCI_HANDLER(INDEX_op_setcond_i64),
+#endif
+        TCI_HANDLER(INDEX_op_mov_i32),
+        TCI_HANDLER(INDEX_op_movi_i32),
+        TCI_HANDLER(INDEX_op_ld8u_i32),
+        TCI_HANDLER(INDEX_op_ld8s_i32),
+        TCI_HANDLER(INDEX_op_ld16u_i32),
+        TCI_HANDLER(INDEX_op_ld16s_i32),
+        TCI_HANDLER(INDEX_op_ld_i32),
+        TCI_HANDLER(INDEX_op_st8_i32),
+        TCI_HANDLER(INDEX_op_st16_i32),
+        TCI_HANDLER(INDEX_op_st_i32),
+        TCI_HANDLER(INDEX_op_add_i32),
+        TCI_HANDLER(INDEX_op_sub_i32),
+        TCI_HANDLER(INDEX_op_mul_i32),
+#if TCG_TARGET_HAS_div_i32
+        TCI_HANDLER(INDEX_op_div_i32),
+        TCI_HANDLER(INDEX_op_divu_i32),
+        TCI_HANDLER(INDEX_op_rem_i32),
+        TCI_HANDLER(INDEX_op_remu_i32),
+#endif
+        TCI_HANDLER(INDEX_op_and_i32),
+        TCI_HANDLER(INDEX_op_or_i32),
+        TCI_HANDLER(INDEX_op_xor_i32),
+        TCI_HANDLER(INDEX_op_shl_i32),
+        TCI_HANDLER(INDEX_op_shr_i32),
+        TCI_HANDLER(INDEX_op_sar_i32),
+#if TCG_TARGET_HAS_rot_i32
+        TCI_HANDLER(INDEX_op_rotl_i32),
+        TCI_HANDLER(INDEX_op_rotr_i32),
+#endif
+#if TCG_TARGET_HAS_deposit_i32
+        TCI_HANDLER(INDEX_op_deposit_i32),
+#endif
+        TCI_HANDLER(INDEX_op_brcond_i32),
+#if TCG_TARGET_REG_BITS == 32
+        TCI_HANDLER(INDEX_op_add2_i32),
+        TCI_HANDLER(INDEX_op_sub2_i32),
+        TCI_HANDLER(INDEX_op_brcond2_i32),
+        TCI_HANDLER(INDEX_op_mulu2_i32),
+#endif
+#if TCG_TARGET_HAS_ext8s_i32
+        TCI_HANDLER(INDEX_op_ext8s_i32),
+#endif
+#if TCG_TARGET_HAS_ext16s_i32
+        TCI_HANDLER(INDEX_op_ext16s_i32),
+#endif
+#if TCG_TARGET_HAS_ext8u_i32
+        TCI_HANDLER(INDEX_op_ext8u_i32),
+#endif
+#if TCG_TARGET_HAS_ext16u_i32
+        TCI_HANDLER(INDEX_op_ext16u_i32),
+#endif
+#if TCG_TARGET_HAS_bswap16_i32
+        TCI_HANDLER(INDEX_op_bswap16_i32),
+#endif
+#if TCG_TARGET_HAS_bswap32_i32
+        TCI_HANDLER(INDEX_op_bswap32_i32),
+#endif
+#if TCG_TARGET_HAS_not_i32
+        TCI_HANDLER(INDEX_op_not_i32),
+#endif
+#if TCG_TARGET_HAS_neg_i32
+        TCI_HANDLER(INDEX_op_neg_i32),
+#endif
+#if TCG_TARGET_REG_BITS == 64
+        TCI_HANDLER(INDEX_op_mov_i64),
+        TCI_HANDLER(INDEX_op_movi_i64),
+        TCI_HANDLER(INDEX_op_ld8u_i64),
+        TCI_HANDLER(INDEX_op_ld8s_i64),
+        TCI_HANDLER(INDEX_op_ld16u_i64),
+        TCI_HANDLER(INDEX_op_ld16s_i64),
+        TCI_HANDLER(INDEX_op_ld32u_i64),
+        TCI_HANDLER(INDEX_op_ld32s_i64),
+        TCI_HANDLER(INDEX_op_ld_i64),
+        TCI_HANDLER(INDEX_op_st8_i64),
+        TCI_HANDLER(INDEX_op_st16_i64),
+        TCI_HANDLER(INDEX_op_st32_i64),
+        TCI_HANDLER(INDEX_op_st_i64),
+        TCI_HANDLER(INDEX_op_add_i64),
+        TCI_HANDLER(INDEX_op_sub_i64),
+        TCI_HANDLER(INDEX_op_mul_i64),
+        TCI_HANDLER(INDEX_op_and_i64),
+        TCI_HANDLER(INDEX_op_or_i64),
+        TCI_HANDLER(INDEX_op_xor_i64),
+        TCI_HANDLER(INDEX_op_shl_i64),
+        TCI_HANDLER(INDEX_op_shr_i64),
+        TCI_HANDLER(INDEX_op_sar_i64),
+#if TCG_TARGET_HAS_rot_i64
+        TCI_HANDLER(INDEX_op_rotl_i64),
+        TCI_HANDLER(INDEX_op_rotr_i64),
+#endif
+#if TCG_TARGET_HAS_deposit_i64
+        TCI_HANDLER(INDEX_op_deposit_i64),
+#endif
+        TCI_HANDLER(INDEX_op_brcond_i64),
+#if TCG_TARGET_HAS_ext8u_i64
+        TCI_HANDLER(INDEX_op_ext8u_i64),
+#endif
+#if TCG_TARGET_HAS_ext8s_i64
+        TCI_HANDLER(INDEX_op_ext8s_i64),
+#endif
+#if TCG_TARGET_HAS_ext16s_i64
+        TCI_HANDLER(INDEX_op_ext16s_i64),
+#endif
+#if TCG_TARGET_HAS_ext16u_i64
+        TCI_HANDLER(INDEX_op_ext16u_i64),
+#endif
+#if TCG_TARGET_HAS_ext32s_i64
+        TCI_HANDLER(INDEX_op_ext32s_i64),
+#endif
+#if TCG_TARGET_HAS_ext32u_i64
+        TCI_HANDLER(INDEX_op_ext32u_i64),
+#endif
+#if TCG_TARGET_HAS_bswap16_i64
+        TCI_HANDLER(INDEX_op_bswap16_i64),
+#endif
+#if TCG_TARGET_HAS_bswap32_i64
+        TCI_HANDLER(INDEX_op_bswap32_i64),
+#endif
+#if TCG_TARGET_HAS_bswap64_i64
+        TCI_HANDLER(INDEX_op_bswap64_i64),
+#endif
+#if TCG_TARGET_HAS_not_i64
+        TCI_HANDLER(INDEX_op_not_i64),
+#endif
+#if TCG_TARGET_HAS_neg_i64
+        TCI_HANDLER(INDEX_op_neg_i64),
+#endif
+#endif /* TCG_TARGET_REG_BITS == 64 */
+        TCI_HANDLER(INDEX_op_qemu_ld_i32),
+        TCI_HANDLER(INDEX_op_qemu_ld_i64),
+        TCI_HANDLER(INDEX_op_qemu_st_i32),
+        TCI_HANDLER(INDEX_op_qemu_st_i64),
+#define FUSED(name, first, second) TCI_HANDLER(INDEX_op_tci_ ## name),
+        TCI_FUSED_OPS(FUSED)
+#undef FUSED
+    };
+# undef TCI_HANDLER
+#endif
+    CPUState *cpu;
+    tcg_target_ulong *regs;
+    const tcg_target_ulong *pc = (const tcg_target_ulong *)tb_ptr;
     long tcg_temps[CPU_TEMP_BUF_NLONGS];
     uintptr_t sp_value = (uintptr_t)(tcg_temps + CPU_TEMP_BUF_NLONGS);
-    uintptr_t next_tb = 0;
+    uint64_t tmp64;
+    target_ulong taddr;
+    TCGMemOp memop;
+#ifdef CONFIG_SOFTMMU
+    int mmuidx;
+    uint8_t *haddr;
+#endif
+#ifdef CONFIG_TCI_PROFILE
+    uint64_t *profile;
+#endif
 
-    tci_reg[TCG_AREG0] = (tcg_target_ulong)env;
-    tci_reg[TCG_REG_CALL_STACK] = sp_value;
+#ifdef TCI_THREADED
+    if (env == NULL) {
+        /* tci_op_entry() asks for the handler addresses */
+        return (uintptr_t)handlers;
+    }
+#endif
+
+    cpu = ENV_GET_CPU(env);
+    /* The register file belongs to the engine, bytecode operands point
+       into it. */
+    regs = ((TCGContext *)env->uc->tcg_ctx)->tci_regs;
+    regs[TCG_AREG0] = (tcg_target_ulong)env;
+    regs[TCG_REG_CALL_STACK] = sp_value;
     assert(tb_ptr);
+#ifdef CONFIG_TCI_PROFILE
+    profile = ((TCGContext *)env->uc->tcg_ctx)->tci_profile;
+    if (profile == NULL) {
+        profile = g_new0(uint64_t, TCI_NB_OPS * TCI_NB_OPS);
+        ((TCGContext *)env->uc->tcg_ctx)->tci_profile = profile;
+    }
+#endif
 
+#ifdef TCI_THREADED
+    TCI_DISPATCH();
+#else
     for (;;) {
-        TCGOpcode opc = tb_ptr[0];
-#if !defined(NDEBUG)
-        uint8_t op_size = tb_ptr[1];
-        uint8_t *old_code_ptr = tb_ptr;
-#endif
-        tcg_target_ulong t0;
-        tcg_target_ulong t1;
-        tcg_target_ulong t2;
-        tcg_target_ulong label;
-        TCGCond condition;
-        target_ulong taddr;
-        uint8_t tmp8;
-        uint16_t tmp16;
-        uint32_t tmp32;
-        uint64_t tmp64;
-#if TCG_TARGET_REG_BITS == 32
-        uint64_t v64;
+        switch ((TCGOpcode)pc[0]) {
 #endif
-        TCGMemOp memop;
 
+    TCI_OP(INDEX_op_call)
 #if defined(GETPC)
-        tci_tb_ptr = (uintptr_t)tb_ptr;
+        /* Helpers find their bytecode position through GETRA(). */
+        cpu->tci_tb_ptr = (uintptr_t)pc;
 #endif
-
-        /* Skip opcode and size entry. */
-        tb_ptr += 2;
-
-        switch (opc) {
-        case INDEX_op_end:
-        case INDEX_op_nop:
-            break;
-        case INDEX_op_nop1:
-        case INDEX_op_nop2:
-        case INDEX_op_nop3:
-        case INDEX_op_nopn:
-        case INDEX_op_discard:
-            TODO();
-            break;
-        case INDEX_op_set_label:
-            TODO();
-            break;
-        case INDEX_op_call:
-            t0 = tci_read_ri(&tb_ptr);
 #if TCG_TARGET_REG_BITS == 32
-            tmp64 = ((helper_function)t0)(tci_read_reg(TCG_REG_R0),
-                                          tci_read_reg(TCG_REG_R1),
-                                          tci_read_reg(TCG_REG_R2),
-                                          tci_read_reg(TCG_REG_R3),
-                                          tci_read_reg(TCG_REG_R5),
-                                          tci_read_reg(TCG_REG_R6),
-                                          tci_read_reg(TCG_REG_R7),
-                                          tci_read_reg(TCG_REG_R8),
-                                          tci_read_reg(TCG_REG_R9),
-                                          tci_read_reg(TCG_REG_R10));
-            tci_write_reg(TCG_REG_R0, tmp64);
-            tci_write_reg(TCG_REG_R1, tmp64 >> 32);
+        tmp64 = ((helper_function)pc[1])(regs[TCG_REG_R0], regs[TCG_REG_R1],
+                                         regs[TCG_REG_R2], regs[TCG_REG_R3],
+                                         regs[TCG_REG_R5], regs[TCG_REG_R6],
+                                         regs[TCG_REG_R7], regs[TCG_REG_R8],
+                                         regs[TCG_REG_R9], regs[TCG_REG_R10]);
+        regs[TCG_REG_R0] = (uint32_t)tmp64;
+        regs[TCG_REG_R1] = tmp64 >> 32;
 #else
-            tmp64 = ((helper_function)t0)(tci_read_reg(TCG_REG_R0),
-                                          tci_read_reg(TCG_REG_R1),
-                                          tci_read_reg(TCG_REG_R2),
-                                          tci_read_reg(TCG_REG_R3),
-                                          tci_read_reg(TCG_REG_R5));
-            tci_write_reg(TCG_REG_R0, tmp64);
+        tmp64 = ((helper_function)pc[1])(regs[TCG_REG_R0], regs[TCG_REG_R1],
+                                         regs[TCG_REG_R2], regs[TCG_REG_R3],
+                                         regs[TCG_REG_R5]);
+        regs[TCG_REG_R0] = tmp64;
 #endif
-            break;
-        case INDEX_op_br:
-            label = tci_read_label(&tb_ptr);
-            assert(tb_ptr == old_code_ptr + op_size);
-            tb_ptr = (uint8_t *)label;
-            continue;
-        case INDEX_op_setcond_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            condition = *tb_ptr++;
-            tci_write_reg32(t0, tci_compare32(t1, t2, condition));
-            break;
+        TCI_NEXT(2);
+    TCI_OP(INDEX_op_br)
+        TCI_JUMP(pc[1]);
+    TCI_OP(INDEX_op_exit_tb)
+        return pc[1];
+    TCI_OP(INDEX_op_goto_tb)
+        /* Patched by tb_set_jmp_target() to chain to the next block. */
+        TCI_JUMP(pc[1]);
+    TCI_OP(INDEX_op_setcond_i32)
+        TCI_SETCOND_I32(0);
+        TCI_NEXT(6);
 #if TCG_TARGET_REG_BITS == 32
-        case INDEX_op_setcond2_i32:
-            t0 = *tb_ptr++;
-            tmp64 = tci_read_r64(&tb_ptr);
-            v64 = tci_read_ri64(&tb_ptr);
-            condition = *tb_ptr++;
-            tci_write_reg32(t0, tci_compare64(tmp64, v64, condition));
-            break;
+    TCI_OP(INDEX_op_setcond2_i32)
+        tci_reg(1) = tci_compare64(tci_reg64(2), tci_ri64(4), pc[8]);
+        TCI_NEXT(9);
 #elif TCG_TARGET_REG_BITS == 64
-        case INDEX_op_setcond_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r64(&tb_ptr);
-            t2 = tci_read_ri64(&tb_ptr);
-            condition = *tb_ptr++;
-            tci_write_reg64(t0, tci_compare64(t1, t2, condition));
-            break;
+    TCI_OP(INDEX_op_setcond_i64)
+        TCI_SETCOND_I64(0);
+        TCI_NEXT(6);
 #endif
-        case INDEX_op_mov_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(&tb_ptr);
-            tci_write_reg32(t0, t1);
-            break;
-        case INDEX_op_movi_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_i32(&tb_ptr);
-            tci_write_reg32(t0, t1);
-            break;
+    TCI_OP(INDEX_op_mov_i32)
+        tci_reg(1) = (uint32_t)tci_reg(2);
+        TCI_NEXT(3);
+    TCI_OP(INDEX_op_movi_i32)
+        tci_reg(1) = (uint32_t)pc[2];
+        TCI_NEXT(3);
 
-            /* Load/store operations (32 bit). */
+        /* Load/store operations (32 bit). */
 
-        case INDEX_op_ld8u_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg8(t0, *(uint8_t *)(t1 + t2));
-            break;
-        case INDEX_op_ld8s_i32:
-        case INDEX_op_ld16u_i32:
-            TODO();
-            break;
-        case INDEX_op_ld16s_i32:
-            TODO();
-            break;
-        case INDEX_op_ld_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg32(t0, UNALIGNED_READ32_LE(t1 + t2));
-            break;
-        case INDEX_op_st8_i32:
-            t0 = tci_read_r8(&tb_ptr);
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            *(uint8_t *)(t1 + t2) = t0;
-            break;
-        case INDEX_op_st16_i32:
-            t0 = tci_read_r16(&tb_ptr);
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            UNALIGNED_WRITE16_LE(t1 + t2, t0);
-            break;
-        case INDEX_op_st_i32:
-            t0 = tci_read_r32(&tb_ptr);
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            assert(t1 != sp_value || (int32_t)t2 < 0);
-            UNALIGNED_WRITE32_LE(t1 + t2, t0);
-            break;
+    TCI_OP(INDEX_op_ld8u_i32)
+        tci_reg(1) = ldub_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_ld8s_i32)
+        tci_reg(1) = (uint32_t)ldsb_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_ld16u_i32)
+        tci_reg(1) = lduw_he_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_ld16s_i32)
+        tci_reg(1) = (uint32_t)ldsw_he_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_ld_i32)
+        TCI_LD_I32(0);
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_st8_i32)
+        stb_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]), tci_reg(1));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_st16_i32)
+        stw_he_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]), tci_reg(1));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_st_i32)
+        assert(tci_reg(2) != sp_value || (tcg_target_long)pc[3] < 0);
+        TCI_ST_I32(0);
+        TCI_NEXT(4);
 
-            /* Arithmetic operations (32 bit). */
+        /* Arithmetic operations (32 bit). */
 
-        case INDEX_op_add_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, t1 + t2);
-            break;
-        case INDEX_op_sub_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, t1 - t2);
-            break;
-        case INDEX_op_mul_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, t1 * t2);
-            break;
+    TCI_OP(INDEX_op_add_i32)
+        TCI_ADD_I32(0);
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_sub_i32)
+        tci_reg(1) = (uint32_t)(tci_reg(2) - tci_reg(4));
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_mul_i32)
+        tci_reg(1) = (uint32_t)(tci_reg(2) * tci_reg(4));
+        TCI_NEXT(6);
 #if TCG_TARGET_HAS_div_i32
-        case INDEX_op_div_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, (int32_t)t1 / (int32_t)t2);
-            break;
-        case INDEX_op_divu_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, t1 / t2);
-            break;
-        case INDEX_op_rem_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, (int32_t)t1 % (int32_t)t2);
-            break;
-        case INDEX_op_remu_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, t1 % t2);
-            break;
-#elif TCG_TARGET_HAS_div2_i32
-        case INDEX_op_div2_i32:
-        case INDEX_op_divu2_i32:
-            TODO();
-            break;
+    TCI_OP(INDEX_op_div_i32)
+        tci_reg(1) = (uint32_t)((int32_t)tci_reg(2) / (int32_t)tci_reg(3));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_divu_i32)
+        tci_reg(1) = (uint32_t)tci_reg(2) / (uint32_t)tci_reg(3);
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_rem_i32)
+        tci_reg(1) = (uint32_t)((int32_t)tci_reg(2) % (int32_t)tci_reg(3));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_remu_i32)
+        tci_reg(1) = (uint32_t)tci_reg(2) % (uint32_t)tci_reg(3);
+        TCI_NEXT(4);
 #endif
-        case INDEX_op_and_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, t1 & t2);
-            break;
-        case INDEX_op_or_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, t1 | t2);
-            break;
-        case INDEX_op_xor_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, t1 ^ t2);
-            break;
+    TCI_OP(INDEX_op_and_i32)
+        tci_reg(1) = (uint32_t)(tci_reg(2) & tci_reg(4));
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_or_i32)
+        tci_reg(1) = (uint32_t)(tci_reg(2) | tci_reg(4));
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_xor_i32)
+        tci_reg(1) = (uint32_t)(tci_reg(2) ^ tci_reg(4));
+        TCI_NEXT(6);
 
-            /* Shift/rotate operations (32 bit). */
+        /* Shift/rotate operations (32 bit). */
 
-        case INDEX_op_shl_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, t1 << (t2 & 31));
-            break;
-        case INDEX_op_shr_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, t1 >> (t2 & 31));
-            break;
-        case INDEX_op_sar_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, ((int32_t)t1 >> (t2 & 31)));
-            break;
+    TCI_OP(INDEX_op_shl_i32)
+        tci_reg(1) = (uint32_t)tci_reg(2) << (tci_reg(4) & 31);
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_shr_i32)
+        tci_reg(1) = (uint32_t)tci_reg(2) >> (tci_reg(4) & 31);
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_sar_i32)
+        tci_reg(1) = (uint32_t)((int32_t)tci_reg(2) >> (tci_reg(4) & 31));
+        TCI_NEXT(6);
 #if TCG_TARGET_HAS_rot_i32
-        case INDEX_op_rotl_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, rol32(t1, t2 & 31));
-            break;
-        case INDEX_op_rotr_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri32(&tb_ptr);
-            t2 = tci_read_ri32(&tb_ptr);
-            tci_write_reg32(t0, ror32(t1, t2 & 31));
-            break;
+    TCI_OP(INDEX_op_rotl_i32)
+        tci_reg(1) = rol32(tci_reg(2), tci_reg(4) & 31);
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_rotr_i32)
+        tci_reg(1) = ror32(tci_reg(2), tci_reg(4) & 31);
+        TCI_NEXT(6);
 #endif
 #if TCG_TARGET_HAS_deposit_i32
-        case INDEX_op_deposit_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(&tb_ptr);
-            t2 = tci_read_r32(&tb_ptr);
-            tmp16 = *tb_ptr++;
-            tmp8 = *tb_ptr++;
-            tmp32 = (((1 << tmp8) - 1) << tmp16);
-            tci_write_reg32(t0, (t1 & ~tmp32) | ((t2 << tmp16) & tmp32));
-            break;
+    TCI_OP(INDEX_op_deposit_i32)
+        {
+            uint32_t mask = ((1U << pc[5]) - 1) << pc[4];
+            tci_reg(1) = ((uint32_t)tci_reg(2) & ~mask) |
+                         (((uint32_t)tci_reg(3) << pc[4]) & mask);
+        }
+        TCI_NEXT(6);
 #endif
-        case INDEX_op_brcond_i32:
-            t0 = tci_read_r32(&tb_ptr);
-            t1 = tci_read_ri32(&tb_ptr);
-            condition = *tb_ptr++;
-            label = tci_read_label(&tb_ptr);
-            if (tci_compare32(t0, t1, condition)) {
-                assert(tb_ptr == old_code_ptr + op_size);
-                tb_ptr = (uint8_t *)label;
-                continue;
-            }
-            break;
+    TCI_OP(INDEX_op_brcond_i32)
+        TCI_BRCOND_I32(0);
+        TCI_NEXT(6);
 #if TCG_TARGET_REG_BITS == 32
-        case INDEX_op_add2_i32:
-            t0 = *tb_ptr++;
-            t1 = *tb_ptr++;
-            tmp64 = tci_read_r64(&tb_ptr);
-            tmp64 += tci_read_r64(&tb_ptr);
-            tci_write_reg64(t1, t0, tmp64);
-            break;
-        case INDEX_op_sub2_i32:
-            t0 = *tb_ptr++;
-            t1 = *tb_ptr++;
-            tmp64 = tci_read_r64(&tb_ptr);
-            tmp64 -= tci_read_r64(&tb_ptr);
-            tci_write_reg64(t1, t0, tmp64);
-            break;
-        case INDEX_op_brcond2_i32:
-            tmp64 = tci_read_r64(&tb_ptr);
-            v64 = tci_read_ri64(&tb_ptr);
-            condition = *tb_ptr++;
-            label = tci_read_label(&tb_ptr);
-            if (tci_compare64(tmp64, v64, condition)) {
-                assert(tb_ptr == old_code_ptr + op_size);
-                tb_ptr = (uint8_t *)label;
-                continue;
-            }
-            break;
-        case INDEX_op_mulu2_i32:
-            t0 = *tb_ptr++;
-            t1 = *tb_ptr++;
-            t2 = tci_read_r32(&tb_ptr);
-            tmp64 = tci_read_r32(&tb_ptr);
-            tci_write_reg64(t1, t0, t2 * tmp64);
-            break;
+    TCI_OP(INDEX_op_add2_i32)
+        tmp64 = tci_reg64(3) + tci_reg64(5);
+        tci_reg(1) = (uint32_t)tmp64;
+        tci_reg(2) = tmp64 >> 32;
+        TCI_NEXT(7);
+    TCI_OP(INDEX_op_sub2_i32)
+        tmp64 = tci_reg64(3) - tci_reg64(5);
+        tci_reg(1) = (uint32_t)tmp64;
+        tci_reg(2) = tmp64 >> 32;
+        TCI_NEXT(7);
+    TCI_OP(INDEX_op_brcond2_i32)
+        if (tci_compare64(tci_reg64(1), tci_ri64(3), pc[7])) {
+            TCI_JUMP(pc[8]);
+        }
+        TCI_NEXT(9);
+    TCI_OP(INDEX_op_mulu2_i32)
+        tmp64 = (uint64_t)(uint32_t)tci_reg(3) * (uint32_t)tci_reg(4);
+        tci_reg(1) = (uint32_t)tmp64;
+        tci_reg(2) = tmp64 >> 32;
+        TCI_NEXT(5);
 #endif /* TCG_TARGET_REG_BITS == 32 */
 #if TCG_TARGET_HAS_ext8s_i32
-        case INDEX_op_ext8s_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r8s(&tb_ptr);
-            tci_write_reg32(t0, t1);
-            break;
+    TCI_OP(INDEX_op_ext8s_i32)
+        tci_reg(1) = (uint32_t)(int8_t)tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_ext16s_i32
-        case INDEX_op_ext16s_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r16s(&tb_ptr);
-            tci_write_reg32(t0, t1);
-            break;
+    TCI_OP(INDEX_op_ext16s_i32)
+        tci_reg(1) = (uint32_t)(int16_t)tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_ext8u_i32
-        case INDEX_op_ext8u_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r8(&tb_ptr);
-            tci_write_reg32(t0, t1);
-            break;
+    TCI_OP(INDEX_op_ext8u_i32)
+        tci_reg(1) = (uint8_t)tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_ext16u_i32
-        case INDEX_op_ext16u_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r16(&tb_ptr);
-            tci_write_reg32(t0, t1);
-            break;
+    TCI_OP(INDEX_op_ext16u_i32)
+        tci_reg(1) = (uint16_t)tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_bswap16_i32
-        case INDEX_op_bswap16_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r16(&tb_ptr);
-            tci_write_reg32(t0, bswap16(t1));
-            break;
+    TCI_OP(INDEX_op_bswap16_i32)
+        tci_reg(1) = bswap16(tci_reg(2));
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_bswap32_i32
-        case INDEX_op_bswap32_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(&tb_ptr);
-            tci_write_reg32(t0, bswap32(t1));
-            break;
+    TCI_OP(INDEX_op_bswap32_i32)
+        tci_reg(1) = bswap32(tci_reg(2));
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_not_i32
-        case INDEX_op_not_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(&tb_ptr);
-            tci_write_reg32(t0, ~t1);
-            break;
+    TCI_OP(INDEX_op_not_i32)
+        tci_reg(1) = (uint32_t)~tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_neg_i32
-        case INDEX_op_neg_i32:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(&tb_ptr);
-            tci_write_reg32(t0, -t1);
-            break;
+    TCI_OP(INDEX_op_neg_i32)
+        tci_reg(1) = (uint32_t)-tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_REG_BITS == 64
-        case INDEX_op_mov_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r64(&tb_ptr);
-            tci_write_reg64(t0, t1);
-            break;
-        case INDEX_op_movi_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_i64(&tb_ptr);
-            tci_write_reg64(t0, t1);
-            break;
+    TCI_OP(INDEX_op_mov_i64)
+        tci_reg(1) = tci_reg(2);
+        TCI_NEXT(3);
+    TCI_OP(INDEX_op_movi_i64)
+        tci_reg(1) = pc[2];
+        TCI_NEXT(3);
 
-            /* Load/store operations (64 bit). */
+        /* Load/store operations (64 bit). */
 
-        case INDEX_op_ld8u_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg8(t0, *(uint8_t *)(t1 + t2));
-            break;
-        case INDEX_op_ld8s_i64:
-        case INDEX_op_ld16u_i64:
-        case INDEX_op_ld16s_i64:
-            TODO();
-            break;
-        case INDEX_op_ld32u_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg32(t0, UNALIGNED_READ32_LE(t1 + t2));
-            break;
-        case INDEX_op_ld32s_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg32s(t0, (int32_t)UNALIGNED_READ32_LE(t1 + t2));
-            break;
-        case INDEX_op_ld_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            tci_write_reg64(t0, UNALIGNED_READ64_LE(t1 + t2));
-            break;
-        case INDEX_op_st8_i64:
-            t0 = tci_read_r8(&tb_ptr);
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            *(uint8_t *)(t1 + t2) = t0;
-            break;
-        case INDEX_op_st16_i64:
-            t0 = tci_read_r16(&tb_ptr);
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            UNALIGNED_WRITE16_LE(t1 + t2, t0);
-            break;
-        case INDEX_op_st32_i64:
-            t0 = tci_read_r32(&tb_ptr);
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            UNALIGNED_WRITE32_LE(t1 + t2, t0);
-            break;
-        case INDEX_op_st_i64:
-            t0 = tci_read_r64(&tb_ptr);
-            t1 = tci_read_r(&tb_ptr);
-            t2 = tci_read_s32(&tb_ptr);
-            assert(t1 != sp_value || (int32_t)t2 < 0);
-            UNALIGNED_WRITE64_LE(t1 + t2, t0);
-            break;
+    TCI_OP(INDEX_op_ld8u_i64)
+        tci_reg(1) = ldub_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_ld8s_i64)
+        tci_reg(1) = (int64_t)ldsb_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_ld16u_i64)
+        tci_reg(1) = lduw_he_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_ld16s_i64)
+        tci_reg(1) = (int64_t)ldsw_he_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_ld32u_i64)
+        tci_reg(1) = (uint32_t)ldl_he_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_ld32s_i64)
+        tci_reg(1) = (int64_t)ldl_he_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_ld_i64)
+        TCI_LD_I64(0);
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_st8_i64)
+        stb_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]), tci_reg(1));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_st16_i64)
+        stw_he_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]), tci_reg(1));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_st32_i64)
+        stl_he_p((void *)(tci_reg(2) + (tcg_target_long)pc[3]), tci_reg(1));
+        TCI_NEXT(4);
+    TCI_OP(INDEX_op_st_i64)
+        assert(tci_reg(2) != sp_value || (tcg_target_long)pc[3] < 0);
+        TCI_ST_I64(0);
+        TCI_NEXT(4);
 
-            /* Arithmetic operations (64 bit). */
+        /* Arithmetic operations (64 bit). */
 
-        case INDEX_op_add_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(&tb_ptr);
-            t2 = tci_read_ri64(&tb_ptr);
-            tci_write_reg64(t0, t1 + t2);
-            break;
-        case INDEX_op_sub_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(&tb_ptr);
-            t2 = tci_read_ri64(&tb_ptr);
-            tci_write_reg64(t0, t1 - t2);
-            break;
-        case INDEX_op_mul_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(&tb_ptr);
-            t2 = tci_read_ri64(&tb_ptr);
-            tci_write_reg64(t0, t1 * t2);
-            break;
-#if TCG_TARGET_HAS_div_i64
-        case INDEX_op_div_i64:
-        case INDEX_op_divu_i64:
-        case INDEX_op_rem_i64:
-        case INDEX_op_remu_i64:
-            TODO();
-            break;
-#elif TCG_TARGET_HAS_div2_i64
-        case INDEX_op_div2_i64:
-        case INDEX_op_divu2_i64:
-            TODO();
-            break;
-#endif
-        case INDEX_op_and_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(&tb_ptr);
-            t2 = tci_read_ri64(&tb_ptr);
-            tci_write_reg64(t0, t1 & t2);
-            break;
-        case INDEX_op_or_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(&tb_ptr);
-            t2 = tci_read_ri64(&tb_ptr);
-            tci_write_reg64(t0, t1 | t2);
-            break;
-        case INDEX_op_xor_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(&tb_ptr);
-            t2 = tci_read_ri64(&tb_ptr);
-            tci_write_reg64(t0, t1 ^ t2);
-            break;
+    TCI_OP(INDEX_op_add_i64)
+        TCI_ADD_I64(0);
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_sub_i64)
+        tci_reg(1) = tci_reg(2) - tci_reg(4);
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_mul_i64)
+        tci_reg(1) = tci_reg(2) * tci_reg(4);
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_and_i64)
+        tci_reg(1) = tci_reg(2) & tci_reg(4);
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_or_i64)
+        tci_reg(1) = tci_reg(2) | tci_reg(4);
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_xor_i64)
+        tci_reg(1) = tci_reg(2) ^ tci_reg(4);
+        TCI_NEXT(6);
 
-            /* Shift/rotate operations (64 bit). */
+        /* Shift/rotate operations (64 bit). */
 
-        case INDEX_op_shl_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(&tb_ptr);
-            t2 = tci_read_ri64(&tb_ptr);
-            tci_write_reg64(t0, t1 << (t2 & 63));
-            break;
-        case INDEX_op_shr_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(&tb_ptr);
-            t2 = tci_read_ri64(&tb_ptr);
-            tci_write_reg64(t0, t1 >> (t2 & 63));
-            break;
-        case INDEX_op_sar_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(&tb_ptr);
-            t2 = tci_read_ri64(&tb_ptr);
-            tci_write_reg64(t0, ((int64_t)t1 >> (t2 & 63)));
-            break;
+    TCI_OP(INDEX_op_shl_i64)
+        tci_reg(1) = tci_reg(2) << (tci_reg(4) & 63);
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_shr_i64)
+        tci_reg(1) = tci_reg(2) >> (tci_reg(4) & 63);
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_sar_i64)
+        tci_reg(1) = (int64_t)tci_reg(2) >> (tci_reg(4) & 63);
+        TCI_NEXT(6);
 #if TCG_TARGET_HAS_rot_i64
-        case INDEX_op_rotl_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(&tb_ptr);
-            t2 = tci_read_ri64(&tb_ptr);
-            tci_write_reg64(t0, rol64(t1, t2 & 63));
-            break;
-        case INDEX_op_rotr_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_ri64(&tb_ptr);
-            t2 = tci_read_ri64(&tb_ptr);
-            tci_write_reg64(t0, ror64(t1, t2 & 63));
-            break;
+    TCI_OP(INDEX_op_rotl_i64)
+        tci_reg(1) = rol64(tci_reg(2), tci_reg(4) & 63);
+        TCI_NEXT(6);
+    TCI_OP(INDEX_op_rotr_i64)
+        tci_reg(1) = ror64(tci_reg(2), tci_reg(4) & 63);
+        TCI_NEXT(6);
 #endif
 #if TCG_TARGET_HAS_deposit_i64
-        case INDEX_op_deposit_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r64(&tb_ptr);
-            t2 = tci_read_r64(&tb_ptr);
-            tmp16 = *tb_ptr++;
-            tmp8 = *tb_ptr++;
-            tmp64 = (((1ULL << tmp8) - 1) << tmp16);
-            tci_write_reg64(t0, (t1 & ~tmp64) | ((t2 << tmp16) & tmp64));
-            break;
+    TCI_OP(INDEX_op_deposit_i64)
+        tmp64 = ((1ULL << pc[5]) - 1) << pc[4];
+        tci_reg(1) = (tci_reg(2) & ~tmp64) | ((tci_reg(3) << pc[4]) & tmp64);
+        TCI_NEXT(6);
 #endif
-        case INDEX_op_brcond_i64:
-            t0 = tci_read_r64(&tb_ptr);
-            t1 = tci_read_ri64(&tb_ptr);
-            condition = *tb_ptr++;
-            label = tci_read_label(&tb_ptr);
-            if (tci_compare64(t0, t1, condition)) {
-                assert(tb_ptr == old_code_ptr + op_size);
-                tb_ptr = (uint8_t *)label;
-                continue;
-            }
-            break;
+    TCI_OP(INDEX_op_brcond_i64)
+        if (tci_compare64(tci_reg(1), tci_reg(2), pc[4])) {
+            TCI_JUMP(pc[5]);
+        }
+        TCI_NEXT(6);
 #if TCG_TARGET_HAS_ext8u_i64
-        case INDEX_op_ext8u_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r8(&tb_ptr);
-            tci_write_reg64(t0, t1);
-            break;
+    TCI_OP(INDEX_op_ext8u_i64)
+        tci_reg(1) = (uint8_t)tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_ext8s_i64
-        case INDEX_op_ext8s_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r8s(&tb_ptr);
-            tci_write_reg64(t0, t1);
-            break;
+    TCI_OP(INDEX_op_ext8s_i64)
+        tci_reg(1) = (int8_t)tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_ext16s_i64
-        case INDEX_op_ext16s_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r16s(&tb_ptr);
-            tci_write_reg64(t0, t1);
-            break;
+    TCI_OP(INDEX_op_ext16s_i64)
+        tci_reg(1) = (int16_t)tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_ext16u_i64
-        case INDEX_op_ext16u_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r16(&tb_ptr);
-            tci_write_reg64(t0, t1);
-            break;
+    TCI_OP(INDEX_op_ext16u_i64)
+        tci_reg(1) = (uint16_t)tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_ext32s_i64
-        case INDEX_op_ext32s_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32s(&tb_ptr);
-            tci_write_reg64(t0, t1);
-            break;
+    TCI_OP(INDEX_op_ext32s_i64)
+        tci_reg(1) = (int32_t)tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_ext32u_i64
-        case INDEX_op_ext32u_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(&tb_ptr);
-            tci_write_reg64(t0, t1);
-            break;
+    TCI_OP(INDEX_op_ext32u_i64)
+        TCI_EXT32U_I64(0);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_bswap16_i64
-        case INDEX_op_bswap16_i64:
-            TODO();
-            t0 = *tb_ptr++;
-            t1 = tci_read_r16(&tb_ptr);
-            tci_write_reg64(t0, bswap16(t1));
-            break;
+    TCI_OP(INDEX_op_bswap16_i64)
+        tci_reg(1) = bswap16(tci_reg(2));
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_bswap32_i64
-        case INDEX_op_bswap32_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r32(&tb_ptr);
-            tci_write_reg64(t0, bswap32(t1));
-            break;
+    TCI_OP(INDEX_op_bswap32_i64)
+        tci_reg(1) = bswap32(tci_reg(2));
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_bswap64_i64
-        case INDEX_op_bswap64_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r64(&tb_ptr);
-            tci_write_reg64(t0, bswap64(t1));
-            break;
+    TCI_OP(INDEX_op_bswap64_i64)
+        tci_reg(1) = bswap64(tci_reg(2));
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_not_i64
-        case INDEX_op_not_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r64(&tb_ptr);
-            tci_write_reg64(t0, ~t1);
-            break;
+    TCI_OP(INDEX_op_not_i64)
+        tci_reg(1) = ~tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #if TCG_TARGET_HAS_neg_i64
-        case INDEX_op_neg_i64:
-            t0 = *tb_ptr++;
-            t1 = tci_read_r64(&tb_ptr);
-            tci_write_reg64(t0, -t1);
-            break;
+    TCI_OP(INDEX_op_neg_i64)
+        tci_reg(1) = -tci_reg(2);
+        TCI_NEXT(3);
 #endif
 #endif /* TCG_TARGET_REG_BITS == 64 */
 
-            /* QEMU specific operations. */
+        /* Superinstructions (TCI_FUSED_OPS). */
 
-#if TARGET_LONG_BITS > TCG_TARGET_REG_BITS
-        case INDEX_op_debug_insn_start:
-            TODO();
+    TCI_OP(INDEX_op_tci_ld_brcond_i32)
+        TCI_LD_I32(0);
+        TCI_BRCOND_I32(3);
+        TCI_NEXT(9);
+    TCI_OP(INDEX_op_tci_ld_add_i32)
+        TCI_LD_I32(0);
+        TCI_ADD_I32(3);
+        TCI_NEXT(9);
+    TCI_OP(INDEX_op_tci_ld_add_st_i32)
+        TCI_LD_I32(0);
+        TCI_ADD_I32(3);
+        TCI_ST_I32(8);
+        TCI_NEXT(12);
+    TCI_OP(INDEX_op_tci_st_ld_i32)
+        TCI_ST_I32(0);
+        TCI_LD_I32(3);
+        TCI_NEXT(7);
+    TCI_OP(INDEX_op_tci_setcond_st_i32)
+        TCI_SETCOND_I32(0);
+        TCI_ST_I32(5);
+        TCI_NEXT(9);
+#if TCG_TARGET_REG_BITS == 64
+    TCI_OP(INDEX_op_tci_ld_add_i64)
+        TCI_LD_I64(0);
+        TCI_ADD_I64(3);
+        TCI_NEXT(9);
+    TCI_OP(INDEX_op_tci_ld_add_ext32u_i64)
+        TCI_LD_I64(0);
+        TCI_ADD_I64(3);
+        TCI_EXT32U_I64(8);
+        TCI_NEXT(11);
+    TCI_OP(INDEX_op_tci_ld_add_ext32u_st_i64)
+        TCI_LD_I64(0);
+        TCI_ADD_I64(3);
+        TCI_EXT32U_I64(8);
+        TCI_ST_I64(10);
+        TCI_NEXT(14);
+    TCI_OP(INDEX_op_tci_st_ld_i64)
+        TCI_ST_I64(0);
+        TCI_LD_I64(3);
+        TCI_NEXT(7);
+    TCI_OP(INDEX_op_tci_setcond_st_i64)
+        TCI_SETCOND_I64(0);
+        TCI_ST_I64(5);
+        TCI_NEXT(9);
+#endif
+
+        /* QEMU specific operations. */
+
+    TCI_OP(INDEX_op_qemu_ld_i32)
+        taddr = tci_addr(2);
+        memop = pc[2 + TCI_ADDR_SLOTS];
+        tci_qemu_ldst_prepare(3 + TCI_ADDR_SLOTS, false);
+        switch (memop) {
+        case MO_UB:
+            tci_reg(1) = (uint32_t)qemu_ld_ub;
             break;
-#else
-        case INDEX_op_debug_insn_start:
-            TODO();
+        case MO_SB:
+            tci_reg(1) = (uint32_t)(int8_t)qemu_ld_ub;
+            break;
+        case MO_LEUW:
+            tci_reg(1) = (uint32_t)qemu_ld_leuw;
+            break;
+        case MO_LESW:
+            tci_reg(1) = (uint32_t)(int16_t)qemu_ld_leuw;
+            break;
+        case MO_LEUL:
+            tci_reg(1) = (uint32_t)qemu_ld_leul;
+            break;
+        case MO_BEUW:
+            tci_reg(1) = (uint32_t)qemu_ld_beuw;
+            break;
+        case MO_BESW:
+            tci_reg(1) = (uint32_t)(int16_t)qemu_ld_beuw;
+            break;
+        case MO_BEUL:
+            tci_reg(1) = (uint32_t)qemu_ld_beul;
+            break;
+        default:
+            tcg_abort();
+        }
+        TCI_NEXT(3 + TCI_ADDR_SLOTS + TCI_MMU_SLOTS);
+    TCI_OP(INDEX_op_qemu_ld_i64)
+        taddr = tci_addr(1 + TCI_R64_SLOTS);
+        memop = pc[1 + TCI_R64_SLOTS + TCI_ADDR_SLOTS];
+        tci_qemu_ldst_prepare(2 + TCI_R64_SLOTS + TCI_ADDR_SLOTS, false);
+        switch (memop) {
+        case MO_UB:
+            tmp64 = qemu_ld_ub;
+            break;
+        case MO_SB:
+            tmp64 = (int8_t)qemu_ld_ub;
+            break;
+        case MO_LEUW:
+            tmp64 = qemu_ld_leuw;
+            break;
+        case MO_LESW:
+            tmp64 = (int16_t)qemu_ld_leuw;
+            break;
+        case MO_LEUL:
+            tmp64 = qemu_ld_leul;
+            break;
+        case MO_LESL:
+            tmp64 = (int32_t)qemu_ld_leul;
+            break;
+        case MO_LEQ:
+            tmp64 = qemu_ld_leq;
+            break;
+        case MO_BEUW:
+            tmp64 = qemu_ld_beuw;
+            break;
+        case MO_BESW:
+            tmp64 = (int16_t)qemu_ld_beuw;
             break;
+        case MO_BEUL:
+            tmp64 = qemu_ld_beul;
+            break;
+        case MO_BESL:
+            tmp64 = (int32_t)qemu_ld_beul;
+            break;
+        case MO_BEQ:
+            tmp64 = qemu_ld_beq;
+            break;
+        default:
+            tcg_abort();
+        }
+        tci_reg(1) = tmp64;
+#if TCG_TARGET_REG_BITS == 32
+        tci_reg(2) = tmp64 >> 32;
 #endif
-        case INDEX_op_exit_tb:
-            next_tb = UNALIGNED_READ64_LE(tb_ptr);
-            goto exit;
+        TCI_NEXT(2 + TCI_R64_SLOTS + TCI_ADDR_SLOTS + TCI_MMU_SLOTS);
+    TCI_OP(INDEX_op_qemu_st_i32)
+        taddr = tci_addr(2);
+        memop = pc[2 + TCI_ADDR_SLOTS];
+        tci_qemu_ldst_prepare(3 + TCI_ADDR_SLOTS, true);
+        switch (memop) {
+        case MO_UB:
+            qemu_st_b(tci_reg(1));
             break;
-        case INDEX_op_goto_tb:
-            t0 = tci_read_i32(&tb_ptr);
-            assert(tb_ptr == old_code_ptr + op_size);
-            tb_ptr += (int32_t)t0;
-            continue;
-        case INDEX_op_qemu_ld_i32:
-            t0 = *tb_ptr++;
-            taddr = tci_read_ulong(&tb_ptr);
-            memop = tci_read_i(&tb_ptr);
-            switch (memop) {
-            case MO_UB:
-                tmp32 = qemu_ld_ub;
-                break;
-            case MO_SB:
-                tmp32 = (int8_t)qemu_ld_ub;
-                break;
-            case MO_LEUW:
-                tmp32 = qemu_ld_leuw;
-                break;
-            case MO_LESW:
-                tmp32 = (int16_t)qemu_ld_leuw;
-                break;
-            case MO_LEUL:
-                tmp32 = qemu_ld_leul;
-                break;
-            case MO_BEUW:
-                tmp32 = qemu_ld_beuw;
-                break;
-            case MO_BESW:
-                tmp32 = (int16_t)qemu_ld_beuw;
-                break;
-            case MO_BEUL:
-                tmp32 = qemu_ld_beul;
-                break;
-            default:
-                tcg_abort();
-            }
-            tci_write_reg(t0, tmp32);
+        case MO_LEUW:
+            qemu_st_lew(tci_reg(1));
             break;
-        case INDEX_op_qemu_ld_i64:
-            t0 = *tb_ptr++;
-            if (TCG_TARGET_REG_BITS == 32) {
-                t1 = *tb_ptr++;
-            }
-            taddr = tci_read_ulong(&tb_ptr);
-            memop = tci_read_i(&tb_ptr);
-            switch (memop) {
-            case MO_UB:
-                tmp64 = qemu_ld_ub;
-                break;
-            case MO_SB:
-                tmp64 = (int8_t)qemu_ld_ub;
-                break;
-            case MO_LEUW:
-                tmp64 = qemu_ld_leuw;
-                break;
-            case MO_LESW:
-                tmp64 = (int16_t)qemu_ld_leuw;
-                break;
-            case MO_LEUL:
-                tmp64 = qemu_ld_leul;
-                break;
-            case MO_LESL:
-                tmp64 = (int32_t)qemu_ld_leul;
-                break;
-            case MO_LEQ:
-                tmp64 = qemu_ld_leq;
-                break;
-            case MO_BEUW:
-                tmp64 = qemu_ld_beuw;
-                break;
-            case MO_BESW:
-                tmp64 = (int16_t)qemu_ld_beuw;
-                break;
-            case MO_BEUL:
-                tmp64 = qemu_ld_beul;
-                break;
-            case MO_BESL:
-                tmp64 = (int32_t)qemu_ld_beul;
-                break;
-            case MO_BEQ:
-                tmp64 = qemu_ld_beq;
-                break;
-            default:
-                tcg_abort();
-            }
-            tci_write_reg(t0, tmp64);
-            if (TCG_TARGET_REG_BITS == 32) {
-                tci_write_reg(t1, tmp64 >> 32);
-            }
+        case MO_LEUL:
+            qemu_st_lel(tci_reg(1));
             break;
-        case INDEX_op_qemu_st_i32:
-            t0 = tci_read_r(&tb_ptr);
-            taddr = tci_read_ulong(&tb_ptr);
-            memop = tci_read_i(&tb_ptr);
-            switch (memop) {
-            case MO_UB:
-                qemu_st_b(t0);
-                break;
-            case MO_LEUW:
-                qemu_st_lew(t0);
-                break;
-            case MO_LEUL:
-                qemu_st_lel(t0);
-                break;
-            case MO_BEUW:
-                qemu_st_bew(t0);
-                break;
-            case MO_BEUL:
-                qemu_st_bel(t0);
-                break;
-            default:
-                tcg_abort();
-            }
+        case MO_BEUW:
+            qemu_st_bew(tci_reg(1));
             break;
-        case INDEX_op_qemu_st_i64:
-            tmp64 = tci_read_r64(&tb_ptr);
-            taddr = tci_read_ulong(&tb_ptr);
-            memop = tci_read_i(&tb_ptr);
-            switch (memop) {
-            case MO_UB:
-                qemu_st_b(tmp64);
-                break;
-            case MO_LEUW:
-                qemu_st_lew(tmp64);
-                break;
-            case MO_LEUL:
-                qemu_st_lel(tmp64);
-                break;
-            case MO_LEQ:
-                qemu_st_leq(tmp64);
-                break;
-            case MO_BEUW:
-                qemu_st_bew(tmp64);
-                break;
-            case MO_BEUL:
-                qemu_st_bel(tmp64);
-                break;
-            case MO_BEQ:
-                qemu_st_beq(tmp64);
-                break;
-            default:
-                tcg_abort();
-            }
+        case MO_BEUL:
+            qemu_st_bel(tci_reg(1));
             break;
+        default:
+            tcg_abort();
+        }
+        TCI_NEXT(3 + TCI_ADDR_SLOTS + TCI_MMU_SLOTS);
+    TCI_OP(INDEX_op_qemu_st_i64)
+        tmp64 = tci_reg64(1);
+        taddr = tci_addr(1 + TCI_R64_SLOTS);
+        memop = pc[1 + TCI_R64_SLOTS + TCI_ADDR_SLOTS];
+        tci_qemu_ldst_prepare(2 + TCI_R64_SLOTS + TCI_ADDR_SLOTS, true);
+        switch (memop) {
+        case MO_UB:
+            qemu_st_b(tmp64);
+            break;
+        case MO_LEUW:
+            qemu_st_lew(tmp64);
+            break;
+        case MO_LEUL:
+            qemu_st_lel(tmp64);
+            break;
+        case MO_LEQ:
+            qemu_st_leq(tmp64);
+            break;
+        case MO_BEUW:
+            qemu_st_bew(tmp64);
+            break;
+        case MO_BEUL:
+            qemu_st_bel(tmp64);
+            break;
+        case MO_BEQ:
+            qemu_st_beq(tmp64);
+            break;
+        default:
+            tcg_abort();
+        }
+        TCI_NEXT(2 + TCI_R64_SLOTS + TCI_ADDR_SLOTS + TCI_MMU_SLOTS);
+
+#ifdef TCI_THREADED
+    tci_invalid:
+        TODO();
+#else
         default:
             TODO();
+        }
+    }
+#endif
+    return 0;
+}
+
+/* Return the first bytecode slot of an instruction for opc: the address
+   of its handler when the interpreter is threaded, else the opcode. */
+tcg_target_ulong tci_op_entry(int opc)
+{
+#ifdef TCI_THREADED
+    const void *const *handlers = (const void *const *)tcg_qemu_tb_exec(NULL, NULL);
+    return (uintptr_t)handlers[opc];
+#else
+    return opc;
+#endif
+}
+
+#ifdef CONFIG_TCI_PROFILE
+static const char *tci_op_name(TCGContext *s, int opc)
+{
+    static const char *const fused_names[TCI_NB_OPS - NB_OPS] = {
+#define FUSED(name, first, second) "tci_" #name,
+        TCI_FUSED_OPS(FUSED)
+#undef FUSED
+    };
+
+    if (opc < NB_OPS) {
+        return s->tcg_op_defs[opc].name;
+    }
+    return fused_names[opc - NB_OPS];
+}
+
+/* Print the most frequent pairs of consecutive instructions run by the
+   engine, with their share of all the instructions followed by another. */
+void tci_profile_dump(TCGContext *s)
+{
+    uint64_t *profile = s->tci_profile;
+    uint64_t total = 0, count;
+    int i, n, best;
+
+    if (profile == NULL) {
+        return;
+    }
+    for (i = 0; i < TCI_NB_OPS * TCI_NB_OPS; i++) {
+        total += profile[i];
+    }
+    fprintf(stderr, "TCI profile: %" PRIu64 " instruction pairs\n", total);
+    for (n = 0; n < 40 && total; n++) {
+        best = 0;
+        for (i = 1; i < TCI_NB_OPS * TCI_NB_OPS; i++) {
+            if (profile[i] > profile[best]) {
+                best = i;
+            }
+        }
+        count = profile[best];
+        if (count == 0) {
             break;
         }
-        assert(tb_ptr == old_code_ptr + op_size);
+        fprintf(stderr, "%12" PRIu64 " %5.2f%%  %s %s\n", count,
+                100.0 * count / total, tci_op_name(s, best / TCI_NB_OPS),
+                tci_op_name(s, best % TCI_NB_OPS));
+        profile[best] = 0;
     }
-exit:
-    return next_tb;
+    g_free(profile);
+    s->tci_profile = NULL;
 }
+#endif
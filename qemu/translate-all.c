@@ -209,6 +209,7 @@ static int cpu_gen_code(CPUArchState *env, TranslationBlock *tb, int *gen_code_s
     ti = profile_getclock();
 #endif
     tcg_func_start(s);
+    s->mem_exit_check = tb->mem_exit_check;
 
     gen_intermediate_code(env, tb);
 
@@ -267,6 +268,10 @@ static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
     TCGContext *s = cpu->uc->tcg_ctx;
     int j;
     uintptr_t tc_ptr;
+#ifdef CONFIG_TCG_INTERPRETER
+    uintptr_t jmp_target[2] = { 0, 0 };
+    int n;
+#endif
 #ifdef CONFIG_PROFILER
     int64_t ti;
 #endif
@@ -275,6 +280,7 @@ static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
     ti = profile_getclock();
 #endif
     tcg_func_start(s);
+    s->mem_exit_check = tb->mem_exit_check;
 
     gen_intermediate_code_pc(env, tb);
 
@@ -290,16 +296,36 @@ static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
 #else
     s->tb_jmp_offset = NULL;
     s->tb_next = tb->tb_next;
+#endif
+#ifdef CONFIG_TCG_INTERPRETER
+    /* Regenerating the code writes the goto_tb slots back to their
+       fall-through default; save the links made by tb_add_jump() so the
+       TB stays chained (jmp_next[] keeps tb_add_jump() from redoing it). */
+    for (n = 0; n < 2; n++) {
+        if (tb->tb_next_offset[n] != 0xffff) {
+            jmp_target[n] = *(uintptr_t *)(tc_ptr + tb->tb_jmp_offset[n]);
+        }
+    }
 #endif
     j = tcg_gen_code_search_pc(s, (tcg_insn_unit *)tc_ptr,
                                searched_pc - tc_ptr);
+#ifdef CONFIG_TCG_INTERPRETER
+    for (n = 0; n < 2; n++) {
+        if (tb->tb_next_offset[n] != 0xffff) {
+            tb_set_jmp_target1(tc_ptr + tb->tb_jmp_offset[n], jmp_target[n]);
+        }
+    }
+#endif
     if (j < 0)
         return -1;
     /* now find start of instruction before */
     while (s->gen_opc_instr_start[j] == 0) {
         j--;
     }
-    cpu->icount_decr.u16.low -= s->gen_opc_icount[j];
+    // Unicorn: give back the instructions of the block which did not run
+    if (cpu->uc->icount) {
+        cpu->icount_decr.u16.low += tb->icount - s->gen_opc_icount[j];
+    }
 
     restore_state_to_opc(env, tb, j);
 
@@ -516,6 +542,10 @@ static inline PageDesc *page_find(struct uc_struct *uc, tb_page_addr_t index)
    but not so small that we can't have a fair number of TB's live.  */
 #define MIN_CODE_GEN_BUFFER_SIZE     (1024u * 1024)
 
+/* Room stolen at the end of the code gen buffer for the prologue, which
+   code_gen_buffer_size does not count.  */
+#define CODE_GEN_PROLOGUE_SIZE       1024
+
 /* Maximum size of the code gen buffer we'd like to use.  Unless otherwise
    indicated, this is constrained by the range of direct branches on the
    host cpu, as used by the TCG implementation of goto_tb.  */
@@ -544,25 +574,24 @@ static inline PageDesc *page_find(struct uc_struct *uc, tb_page_addr_t index)
   (DEFAULT_CODE_GEN_BUFFER_SIZE_1 < MAX_CODE_GEN_BUFFER_SIZE \
    ? DEFAULT_CODE_GEN_BUFFER_SIZE_1 : MAX_CODE_GEN_BUFFER_SIZE)
 
+/* Unicorn: engines start with the smallest buffer, which grows when it
+   fills up, up to uc->tb_cache_max.  */
 static inline size_t size_code_gen_buffer(struct uc_struct *uc, size_t tb_size)
 {
     TCGContext *tcg_ctx = uc->tcg_ctx;
 
     /* Size the buffer.  */
     if (tb_size == 0) {
-#ifdef USE_STATIC_CODE_GEN_BUFFER
-        tb_size = DEFAULT_CODE_GEN_BUFFER_SIZE;
-#else
-        /* ??? Needs adjustments.  */
-        /* ??? If we relax the requirement that CONFIG_USER_ONLY use the
-           static buffer, we could size this on RESERVED_VA, on the text
-           segment size of the executable, or continue to use the default.  */
-        tb_size = (unsigned long)DEFAULT_CODE_GEN_BUFFER_SIZE;
-#endif
+        tb_size = MIN_CODE_GEN_BUFFER_SIZE;
     }
     if (tb_size < MIN_CODE_GEN_BUFFER_SIZE) {
         tb_size = MIN_CODE_GEN_BUFFER_SIZE;
     }
+#ifdef USE_STATIC_CODE_GEN_BUFFER
+    if (tb_size > DEFAULT_CODE_GEN_BUFFER_SIZE) {
+        tb_size = DEFAULT_CODE_GEN_BUFFER_SIZE;
+    }
+#endif
     if (tb_size > MAX_CODE_GEN_BUFFER_SIZE) {
         tb_size = MAX_CODE_GEN_BUFFER_SIZE;
     }
@@ -601,7 +630,7 @@ static inline void *split_cross_256mb(struct uc_struct *uc, void *buf1, size_t s
 #ifdef USE_STATIC_CODE_GEN_BUFFER
 static uint8_t QEMU_ALIGN(CODE_GEN_ALIGN, static_code_gen_buffer[DEFAULT_CODE_GEN_BUFFER_SIZE]);
 
-void free_code_gen_buffer(struct uc_struct *uc)
+static void code_gen_buffer_free(void *buf, size_t size)
 {
     // Do nothing, we use a static buffer.
 }
@@ -619,11 +648,9 @@ static inline void *alloc_code_gen_buffer(struct uc_struct *uc)
     return buf;
 }
 #elif defined(USE_MMAP)
-void free_code_gen_buffer(struct uc_struct *uc)
+static void code_gen_buffer_free(void *buf, size_t size)
 {
-    TCGContext *tcg_ctx = uc->tcg_ctx;
-    if (tcg_ctx->code_gen_buffer)
-        munmap(tcg_ctx->code_gen_buffer, tcg_ctx->code_gen_buffer_size);
+    munmap(buf, size);
 }
 
 static inline void *alloc_code_gen_buffer(struct uc_struct *uc)
@@ -698,11 +725,9 @@ static inline void *alloc_code_gen_buffer(struct uc_struct *uc)
     return buf;
 }
 #else
-void free_code_gen_buffer(struct uc_struct *uc)
+static void code_gen_buffer_free(void *buf, size_t size)
 {
-    TCGContext *tcg_ctx = uc->tcg_ctx;
-    if (tcg_ctx->code_gen_buffer)
-        g_free(tcg_ctx->code_gen_buffer);
+    g_free(buf);
 }
 
 static inline void *alloc_code_gen_buffer(struct uc_struct *uc)
@@ -735,15 +760,69 @@ static inline void *alloc_code_gen_buffer(struct uc_struct *uc)
 }
 #endif /* USE_STATIC_CODE_GEN_BUFFER, USE_MMAP */
 
-static inline void code_gen_alloc(struct uc_struct *uc, size_t tb_size)
+// Unicorn: free the buffer replaced by code_gen_alloc(), if any
+static void free_retired_code_gen_buffer(TCGContext *tcg_ctx)
+{
+    if (tcg_ctx->code_gen_buffer_retired) {
+        code_gen_buffer_free(tcg_ctx->code_gen_buffer_retired,
+                tcg_ctx->code_gen_buffer_retired_size);
+        g_free(tcg_ctx->tbs_retired);
+        tcg_ctx->code_gen_buffer_retired = NULL;
+        tcg_ctx->tbs_retired = NULL;
+    }
+}
+
+// Unicorn: for cleaning up memory later.
+void free_code_gen_buffer(struct uc_struct *uc)
+{
+    TCGContext *tcg_ctx = uc->tcg_ctx;
+
+    // the prologue was stolen from the end of the buffer
+    if (tcg_ctx->code_gen_buffer)
+        code_gen_buffer_free(tcg_ctx->code_gen_buffer,
+                tcg_ctx->code_gen_buffer_size + CODE_GEN_PROLOGUE_SIZE);
+    free_retired_code_gen_buffer(tcg_ctx);
+}
+
+/* Allocate the translation buffer, or replace it with one of tb_size bytes.
+   The buffer replaced is freed at once if 'retire' is false, or kept until
+   the next replacement otherwise: the block being executed may still be in
+   it.  The TBs of the old buffer must have been flushed.  Returns false,
+   keeping the old buffer, if the new one cannot be allocated.  */
+static bool code_gen_alloc(struct uc_struct *uc, size_t tb_size, bool retire)
 {
     TCGContext *tcg_ctx = uc->tcg_ctx;
+    void *old_buffer = tcg_ctx->code_gen_buffer;
+    size_t old_size = tcg_ctx->code_gen_buffer_size;
+    TranslationBlock *tbs = NULL;
+    int max_blocks = 0;
 
     tcg_ctx->code_gen_buffer_size = size_code_gen_buffer(uc, tb_size);
     tcg_ctx->code_gen_buffer = alloc_code_gen_buffer(uc);
-    if (tcg_ctx->code_gen_buffer == NULL) {
-        fprintf(stderr, "Could not allocate dynamic translator buffer\n");
-        exit(1);
+    if (tcg_ctx->code_gen_buffer != NULL) {
+        max_blocks = (tcg_ctx->code_gen_buffer_size - CODE_GEN_PROLOGUE_SIZE) /
+                CODE_GEN_AVG_BLOCK_SIZE;
+        tbs = g_try_malloc0(max_blocks * sizeof(TranslationBlock));
+        if (tbs == NULL) {
+            code_gen_buffer_free(tcg_ctx->code_gen_buffer, tcg_ctx->code_gen_buffer_size);
+        }
+    }
+    if (tbs == NULL) {
+        tcg_ctx->code_gen_buffer = old_buffer;
+        tcg_ctx->code_gen_buffer_size = old_size;
+        return false;
+    }
+
+    if (old_buffer) {
+        free_retired_code_gen_buffer(tcg_ctx);
+        if (retire) {
+            tcg_ctx->code_gen_buffer_retired = old_buffer;
+            tcg_ctx->code_gen_buffer_retired_size = old_size + CODE_GEN_PROLOGUE_SIZE;
+            tcg_ctx->tbs_retired = tcg_ctx->tb_ctx.tbs;
+        } else {
+            code_gen_buffer_free(old_buffer, old_size + CODE_GEN_PROLOGUE_SIZE);
+            g_free(tcg_ctx->tb_ctx.tbs);
+        }
     }
 
     //qemu_madvise(tcg_ctx.code_gen_buffer, tcg_ctx.code_gen_buffer_size,
@@ -755,15 +834,19 @@ static inline void code_gen_alloc(struct uc_struct *uc, size_t tb_size)
        that we don't need to mark (additional) portions of the data segment
        as executable.  */
     tcg_ctx->code_gen_prologue = (char*)tcg_ctx->code_gen_buffer +
-            tcg_ctx->code_gen_buffer_size - 1024;
-    tcg_ctx->code_gen_buffer_size -= 1024;
+            tcg_ctx->code_gen_buffer_size - CODE_GEN_PROLOGUE_SIZE;
+    tcg_ctx->code_gen_buffer_size -= CODE_GEN_PROLOGUE_SIZE;
 
     tcg_ctx->code_gen_buffer_max_size = tcg_ctx->code_gen_buffer_size -
         (TCG_MAX_OP_SIZE * OPC_BUF_SIZE);
-    tcg_ctx->code_gen_max_blocks = tcg_ctx->code_gen_buffer_size /
-            CODE_GEN_AVG_BLOCK_SIZE;
-    tcg_ctx->tb_ctx.tbs =
-            g_malloc(tcg_ctx->code_gen_max_blocks * sizeof(TranslationBlock));
+    tcg_ctx->code_gen_max_blocks = max_blocks;
+    tcg_ctx->tb_ctx.tbs = tbs;
+    tcg_ctx->code_gen_ptr = tcg_ctx->code_gen_buffer;
+
+    if (old_buffer) {
+        tcg_prologue_init(tcg_ctx);
+    }
+    return true;
 }
 
 /* Must be called before using the QEMU cpus. 'tb_size' is the size
@@ -774,10 +857,15 @@ void tcg_exec_init(struct uc_struct *uc, unsigned long tb_size)
     TCGContext *tcg_ctx;
 
     cpu_gen_init(uc);
-    code_gen_alloc(uc, tb_size);
+    if (!code_gen_alloc(uc, tb_size, false)) {
+        fprintf(stderr, "Could not allocate dynamic translator buffer\n");
+        exit(1);
+    }
     tcg_ctx = uc->tcg_ctx;
-    tcg_ctx->code_gen_ptr = tcg_ctx->code_gen_buffer;
     tcg_ctx->uc = uc;
+    if (uc->tb_cache_max == 0) {
+        uc->tb_cache_max = DEFAULT_CODE_GEN_BUFFER_SIZE;
+    }
     page_init();
 #if !defined(CONFIG_USER_ONLY) || !defined(CONFIG_USE_GUEST_BASE)
     /* There's no guest base to take into account, so go ahead and
@@ -786,6 +874,26 @@ void tcg_exec_init(struct uc_struct *uc, unsigned long tb_size)
 #endif
 }
 
+/* Unicorn: flush the translation cache and reallocate it with tb_size bytes.
+   Must not be called during emulation.  */
+bool tb_cache_resize(struct uc_struct *uc, size_t tb_size)
+{
+    tb_flush(uc->cpu->env_ptr);
+    return code_gen_alloc(uc, tb_size, false);
+}
+
+/* Unicorn: size and use of the translation cache, in bytes, and number of
+   flushes.  */
+void tb_cache_query(struct uc_struct *uc, size_t *size, size_t *used,
+                    size_t *flushes)
+{
+    TCGContext *tcg_ctx = uc->tcg_ctx;
+
+    *size = tcg_ctx->code_gen_buffer_size + CODE_GEN_PROLOGUE_SIZE;
+    *used = (char *)tcg_ctx->code_gen_ptr - (char *)tcg_ctx->code_gen_buffer;
+    *flushes = tcg_ctx->tb_ctx.tb_flush_count;
+}
+
 bool tcg_enabled(struct uc_struct *uc)
 {
     TCGContext *tcg_ctx = uc->tcg_ctx;
@@ -807,6 +915,7 @@ static TranslationBlock *tb_alloc(struct uc_struct *uc, target_ulong pc)
     tb = &tcg_ctx->tb_ctx.tbs[tcg_ctx->tb_ctx.nb_tbs++];
     tb->pc = pc;
     tb->cflags = 0;
+    tb->partial = false;
     return tb;
 }
 
@@ -1021,6 +1130,8 @@ void tb_phys_invalidate(struct uc_struct *uc,
     tb_page_addr_t phys_pc;
     TranslationBlock *tb1, *tb2;
 
+    tb->partial = false;
+
     /* remove the TB from the hash list */
     phys_pc = tb->page_addr[0] + (tb->pc & ~TARGET_PAGE_MASK);
     h = tb_phys_hash_func(phys_pc);
@@ -1134,12 +1245,18 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb_page_addr_t phys_pc, phys_page2;
     int code_gen_size;
     int ret;
+    bool block_full = env->uc->block_full;
 
     phys_pc = get_page_addr_code(env, pc);
     tb = tb_alloc(env->uc, pc);
     if (!tb) {
         /* flush must be done */
         tb_flush(env);
+        // Unicorn: grow the buffer rather than filling it up again
+        if (tcg_ctx->code_gen_buffer_size + CODE_GEN_PROLOGUE_SIZE < env->uc->tb_cache_max) {
+            code_gen_alloc(env->uc, MIN((tcg_ctx->code_gen_buffer_size + CODE_GEN_PROLOGUE_SIZE) * 2,
+                    env->uc->tb_cache_max), true);
+        }
         /* cannot fail at this point */
         tb = tb_alloc(env->uc, pc);
         /* Don't forget to invalidate previous TB info.  */
@@ -1149,6 +1266,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb->cs_base = cs_base;
     tb->flags = flags;
     tb->cflags = cflags;
+    tb->mem_exit_check = uc_mem_access_can_stop(env->uc);
     ret = cpu_gen_code(env, tb, &code_gen_size);  // qq
     if (ret == -1) {
         tb_free(env->uc, tb);
@@ -1156,6 +1274,17 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     }
     tcg_ctx->code_gen_ptr = (void *)(((uintptr_t)tcg_ctx->code_gen_ptr +
             code_gen_size + CODE_GEN_ALIGN - 1) & ~(CODE_GEN_ALIGN - 1));
+    env->uc->tb_translated++;
+
+    // Unicorn: the translation cache outlives uc_emu_start(), so remember
+    // blocks that only make sense for this run: code fetch failed in the
+    // middle of the block, single instruction blocks generated for SMC, and
+    // blocks following a full block which skipped the block hook.
+    if (env->invalid_error != UC_ERR_OK || (cflags & CF_COUNT_MASK) == 1 ||
+            (block_full && HOOK_EXISTS_BOUNDED(env->uc, UC_HOOK_BLOCK, pc))) {
+        tb->partial = true;
+        env->uc->tb_partial = true;
+    }
 
     phys_page2 = -1;
     /* check next page if needed */
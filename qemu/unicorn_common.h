@@ -2,6 +2,7 @@
 #define UNICORN_COMMON_H_
 
 #include "tcg.h"
+#include "exec/ram_addr.h"
 
 // This header define common patterns/codes that will be included in all arch-sepcific
 // codes for unicorns purposes.
@@ -33,6 +34,9 @@ static void release_common(void *t)
 
     // Clean TCG.
     TCGOpDef* def = &s->tcg_op_defs[0];
+#ifdef CONFIG_TCI_PROFILE
+    tci_profile_dump(s);
+#endif
     g_free(def->args_ct);
     g_free(def->sorted_args);
     g_free(s->tcg_op_defs);
@@ -67,6 +71,209 @@ static void release_common(void *t)
 #endif
 }
 
+static void uc_tb_flush(struct uc_struct *uc)
+{
+    tb_flush(uc->cpu->env_ptr);
+}
+
+static void uc_tlb_flush(struct uc_struct *uc)
+{
+    tlb_flush(uc->cpu, 1);
+}
+
+// invalidate the translated blocks of guest memory [start, start + len)
+static void uc_invalidate_tb(struct uc_struct *uc, uint64_t start, size_t len)
+{
+    MemoryRegion *mr;
+    uint64_t addr = start, end = start + len, chunk_end;
+
+    while (addr < end) {
+        mr = memory_mapping(uc, addr);
+        if (mr == NULL)
+            break;
+        chunk_end = MIN(end, mr->end);
+        if (memory_region_is_ram(mr)) {
+            tb_invalidate_phys_range(uc, mr->ram_addr + (addr - mr->addr),
+                    mr->ram_addr + (chunk_end - mr->addr), 0);
+        }
+        addr = chunk_end;
+    }
+}
+
+// copy @len bytes at @offset in the RAM region @mr to @buf
+static void uc_read_ram(struct uc_struct *uc, MemoryRegion *mr,
+        uint64_t offset, uint8_t *buf, size_t len)
+{
+    memcpy(buf, (uint8_t *)memory_region_get_ram_ptr(mr) + offset, len);
+}
+
+// @len bytes at @offset in the RAM region @mr were written by the host: as
+// for a write of the guest, drop the code translated from these bytes and
+// mark their pages written
+static void uc_ram_written(struct uc_struct *uc, MemoryRegion *mr,
+        uint64_t offset, size_t len)
+{
+    invalidate_and_set_dirty(uc, mr->ram_addr + offset, len);
+}
+
+// copy @buf to @len bytes at @offset in the RAM region @mr
+static void uc_write_ram(struct uc_struct *uc, MemoryRegion *mr,
+        uint64_t offset, const uint8_t *buf, size_t len)
+{
+    memcpy((uint8_t *)memory_region_get_ram_ptr(mr) + offset, buf, len);
+    uc_ram_written(uc, mr, offset, len);
+}
+
+// return the host address of @offset in the RAM region @mr, and cut *@len
+// down to the bytes of its block from there
+static void *uc_get_ram_ptr(struct uc_struct *uc, MemoryRegion *mr,
+        uint64_t offset, size_t *len)
+{
+    hwaddr size = *len;
+    void *ptr = qemu_ram_ptr_length(uc, mr->ram_addr + offset, &size);
+
+    *len = (size_t)size;
+    return ptr;
+}
+
+// open (@begin) or close a batch of changes to the memory map: the flat
+// view and the TLB are rebuilt once, when the batch is closed
+static void uc_memory_batch(struct uc_struct *uc, bool begin)
+{
+    if (begin)
+        memory_region_transaction_begin(uc);
+    else
+        memory_region_transaction_commit(uc);
+}
+
+// copy the content of @mr into @data and track the pages written from now on
+static void uc_snapshot_save(struct uc_struct *uc, MemoryRegion *mr, uint8_t *data)
+{
+    ram_addr_t size = int128_get64(mr->size);
+
+    memcpy(data, memory_region_get_ram_ptr(mr), size);
+    cpu_physical_memory_reset_dirty(uc, mr->ram_addr, size, DIRTY_MEMORY_SNAPSHOT);
+}
+
+// first page from @page on that uc_snapshot_reset() copies back
+static unsigned long snapshot_next_page(unsigned long *bitmap, const uint8_t *pages,
+        bool all, unsigned long first, unsigned long end, unsigned long page)
+{
+    if (all)
+        return page;
+    if (pages == NULL)
+        return find_next_bit(bitmap, end, page);
+    while (page < end && !(pages[(page - first) / 8] & (1 << ((page - first) % 8))))
+        page++;
+    return page;
+}
+
+// copy back from @data the pages of guest memory [address, address + len) in
+// @mr written since they were saved or last reset, or all of them if @all is
+// set, or else those set in @pages if not NULL, one bit per page
+static void uc_snapshot_reset(struct uc_struct *uc, MemoryRegion *mr,
+        uint64_t address, size_t len, const uint8_t *data, bool all, const uint8_t *pages)
+{
+    unsigned long *bitmap = uc->ram_list.dirty_memory[DIRTY_MEMORY_SNAPSHOT];
+    ram_addr_t start = mr->ram_addr + (address - mr->addr), offset;
+    unsigned long first = start >> TARGET_PAGE_BITS;
+    unsigned long end = (start + len) >> TARGET_PAGE_BITS;
+    unsigned long page = snapshot_next_page(bitmap, pages, all, first, end, first);
+    uint8_t *host = (uint8_t *)memory_region_get_ram_ptr(mr) + (address - mr->addr);
+
+    // nothing written since the last reset
+    if (page >= end)
+        return;
+
+    while (page < end) {
+        offset = (page - first) << TARGET_PAGE_BITS;
+        memcpy(host + offset, data + offset, TARGET_PAGE_SIZE);
+        set_bit(page, uc->ram_list.dirty_memory[DIRTY_MEMORY_LOG]);
+        set_bit(page, uc->ram_list.dirty_memory[DIRTY_MEMORY_FILE]);
+        if (cpu_physical_memory_get_clean(uc, start + offset, TARGET_PAGE_SIZE,
+                    DIRTY_MEMORY_CODE)) {
+            tb_invalidate_phys_range(uc, start + offset,
+                    start + offset + TARGET_PAGE_SIZE, 0);
+        }
+        page = snapshot_next_page(bitmap, pages, all, first, end, page + 1);
+    }
+    cpu_physical_memory_reset_dirty(uc, start, len, DIRTY_MEMORY_SNAPSHOT);
+}
+
+// start (@enable) or stop logging the pages of guest memory
+// [address, address + len) in @mr written from now on
+static void uc_dirty_log_enable(struct uc_struct *uc, MemoryRegion *mr,
+        uint64_t address, size_t len, bool enable)
+{
+    ram_addr_t start = mr->ram_addr + (address - mr->addr);
+
+    if (enable) {
+        // the first write to each page takes the slow path to mark it
+        cpu_physical_memory_reset_dirty(uc, start, len, DIRTY_MEMORY_LOG);
+    } else {
+        qemu_bitmap_set(uc->ram_list.dirty_memory[DIRTY_MEMORY_LOG],
+                start >> TARGET_PAGE_BITS, len >> TARGET_PAGE_BITS);
+    }
+}
+
+// set bit @bit + n of @bitmap for each page n of guest memory
+// [address, address + len) in @mr written since its logging started or was
+// last cleared, then clear them if @clear is set
+static void uc_dirty_log_sync(struct uc_struct *uc, MemoryRegion *mr,
+        uint64_t address, size_t len, uint8_t *bitmap, uint64_t bit, bool clear)
+{
+    unsigned long *dirty = uc->ram_list.dirty_memory[DIRTY_MEMORY_LOG];
+    ram_addr_t start = mr->ram_addr + (address - mr->addr);
+    unsigned long first = start >> TARGET_PAGE_BITS;
+    unsigned long end = (start + len) >> TARGET_PAGE_BITS;
+    unsigned long page = find_next_bit(dirty, end, first);
+    uint64_t n;
+
+    // nothing written since the last clear
+    if (page >= end)
+        return;
+
+    while (page < end) {
+        n = bit + (page - first);
+        bitmap[n / 8] |= 1 << (n % 8);
+        page = find_next_bit(dirty, end, page + 1);
+    }
+    if (clear)
+        cpu_physical_memory_reset_dirty(uc, start, len, DIRTY_MEMORY_LOG);
+}
+
+// get (@get) the pages of guest memory [address, address + len) in @mr
+// written since it was mapped from a file, as bits @bit and up of @bitmap,
+// or set them from these bits: the other pages are marked not written, all
+// of them if @bitmap is NULL
+static void uc_file_written(struct uc_struct *uc, MemoryRegion *mr,
+        uint64_t address, size_t len, uint8_t *bitmap, uint64_t bit, bool get)
+{
+    unsigned long *written = uc->ram_list.dirty_memory[DIRTY_MEMORY_FILE];
+    ram_addr_t start = mr->ram_addr + (address - mr->addr);
+    unsigned long first = start >> TARGET_PAGE_BITS;
+    unsigned long end = (start + len) >> TARGET_PAGE_BITS;
+    unsigned long page;
+    uint64_t n;
+
+    if (get) {
+        for (page = find_next_bit(written, end, first); page < end;
+                page = find_next_bit(written, end, page + 1)) {
+            n = bit + (page - first);
+            bitmap[n / 8] |= 1 << (n % 8);
+        }
+        return;
+    }
+
+    // the first write to each page not written takes the slow path to mark it
+    cpu_physical_memory_reset_dirty(uc, start, len, DIRTY_MEMORY_FILE);
+    for (page = first; bitmap != NULL && page < end; page++) {
+        n = bit + (page - first);
+        if (bitmap[n / 8] & (1 << (n % 8)))
+            set_bit(page, written);
+    }
+}
+
 static inline void uc_common_init(struct uc_struct* uc)
 {
     memory_register_types(uc);
@@ -81,6 +288,22 @@ static inline void uc_common_init(struct uc_struct* uc)
     uc->memory_map_ptr = memory_map_ptr;
     uc->memory_unmap = memory_unmap;
     uc->readonly_mem = memory_region_set_readonly;
+    uc->memory_region_is_prealloc = memory_region_is_prealloc;
+    uc->read_ram = uc_read_ram;
+    uc->write_ram = uc_write_ram;
+    uc->get_ram_ptr = uc_get_ram_ptr;
+    uc->ram_written = uc_ram_written;
+    uc->memory_batch = uc_memory_batch;
+    uc->tb_flush = uc_tb_flush;
+    uc->uc_invalidate_tb = uc_invalidate_tb;
+    uc->uc_tlb_flush = uc_tlb_flush;
+    uc->snapshot_save = uc_snapshot_save;
+    uc->snapshot_reset = uc_snapshot_reset;
+    uc->dirty_log_enable = uc_dirty_log_enable;
+    uc->dirty_log_sync = uc_dirty_log_sync;
+    uc->file_written = uc_file_written;
+    uc->tb_cache_resize = tb_cache_resize;
+    uc->tb_cache_query = tb_cache_query;
 
     uc->target_page_size = TARGET_PAGE_SIZE;
     uc->target_page_align = TARGET_PAGE_SIZE - 1;
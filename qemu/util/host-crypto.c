@@ -0,0 +1,202 @@
+/*
+ * Guest crypto instructions on the crypto instructions of the host
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/host-crypto.h"
+
+bool host_crypto_aes;
+bool host_crypto_clmul;
+bool host_crypto_sha;
+
+#if defined(CONFIG_CPUID_H) && (defined(__x86_64__) || defined(__i386__)) && \
+    !defined(_MSC_VER) && (QEMU_GNUC_PREREQ(4, 9) || defined(__clang__))
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+/* %ecx of leaf 1 */
+#ifndef bit_PCLMUL
+#define bit_PCLMUL (1 << 1)
+#endif
+#ifndef bit_AES
+#define bit_AES    (1 << 25)
+#endif
+/* %ebx of leaf 7 */
+#ifndef bit_SHA
+#define bit_SHA    (1 << 29)
+#endif
+
+static void __attribute__((constructor)) host_crypto_init(void)
+{
+    unsigned a, b, c, d;
+
+    if (getenv("UNICORN_NO_HOST_CRYPTO") || !__get_cpuid(1, &a, &b, &c, &d)) {
+        return;
+    }
+    /* all of them need SSE2 too, which SSE4.1 implies */
+    if (!(c & bit_SSE4_1)) {
+        return;
+    }
+    host_crypto_aes = (c & bit_AES) != 0;
+    host_crypto_clmul = (c & bit_PCLMUL) != 0;
+    if (__get_cpuid_max(0, NULL) >= 7) {
+        __cpuid_count(7, 0, a, b, c, d);
+        host_crypto_sha = (b & bit_SHA) != 0;
+    }
+}
+
+#define HOST_AES __attribute__((target("sse4.1,aes")))
+#define HOST_CLMUL __attribute__((target("sse4.1,pclmul")))
+#define HOST_SHA __attribute__((target("sse4.1,sha")))
+
+HOST_AES
+void host_aes_enc_round(uint8_t *d, const uint8_t *st, const uint8_t *rk, bool last)
+{
+    __m128i s = _mm_loadu_si128((const __m128i *)st);
+    __m128i k = _mm_loadu_si128((const __m128i *)rk);
+
+    s = last ? _mm_aesenclast_si128(s, k) : _mm_aesenc_si128(s, k);
+    _mm_storeu_si128((__m128i *)d, s);
+}
+
+HOST_AES
+void host_aes_dec_round(uint8_t *d, const uint8_t *st, const uint8_t *rk, bool last)
+{
+    __m128i s = _mm_loadu_si128((const __m128i *)st);
+    __m128i k = _mm_loadu_si128((const __m128i *)rk);
+
+    s = last ? _mm_aesdeclast_si128(s, k) : _mm_aesdec_si128(s, k);
+    _mm_storeu_si128((__m128i *)d, s);
+}
+
+HOST_AES
+void host_aes_sub_shift(uint8_t *d, const uint8_t *st, const uint8_t *rk, bool decrypt)
+{
+    __m128i s = _mm_loadu_si128((const __m128i *)st);
+    __m128i k = _mm_loadu_si128((const __m128i *)rk);
+    __m128i z = _mm_setzero_si128();
+
+    s = _mm_xor_si128(s, k);
+    s = decrypt ? _mm_aesdeclast_si128(s, z) : _mm_aesenclast_si128(s, z);
+    _mm_storeu_si128((__m128i *)d, s);
+}
+
+HOST_AES
+void host_aes_mix_columns(uint8_t *d, const uint8_t *st, bool inverse)
+{
+    __m128i s = _mm_loadu_si128((const __m128i *)st);
+    __m128i z = _mm_setzero_si128();
+
+    if (inverse) {
+        s = _mm_aesimc_si128(s);
+    } else {
+        /* AESENC redoes the SubBytes and ShiftRows AESDECLAST undid */
+        s = _mm_aesenc_si128(_mm_aesdeclast_si128(s, z), z);
+    }
+    _mm_storeu_si128((__m128i *)d, s);
+}
+
+HOST_CLMUL
+void host_clmul(uint64_t *lo, uint64_t *hi, uint64_t a, uint64_t b)
+{
+    __m128i r = _mm_clmulepi64_si128(_mm_set_epi64x(0, a), _mm_set_epi64x(0, b), 0);
+    uint64_t q[2];
+
+    _mm_storeu_si128((__m128i *)q, r);
+    *lo = q[0];
+    *hi = q[1];
+}
+
+HOST_SHA
+void host_sha1_rounds4(uint32_t *abcd, uint32_t e, const uint32_t *wk, int f)
+{
+    /* SHA1RNDS4 adds the round constant itself */
+    static const uint32_t k[3] = { 0x5a827999, 0x6ed9eba1, 0x8f1bbcdc };
+    __m128i s = _mm_set_epi32(abcd[0], abcd[1], abcd[2], abcd[3]);
+    __m128i w = _mm_set_epi32(wk[0] - k[f] + e, wk[1] - k[f],
+                              wk[2] - k[f], wk[3] - k[f]);
+
+    switch (f) {
+    case 0:
+        s = _mm_sha1rnds4_epu32(s, w, 0);
+        break;
+    case 1:
+        s = _mm_sha1rnds4_epu32(s, w, 1);
+        break;
+    default:
+        s = _mm_sha1rnds4_epu32(s, w, 2);
+        break;
+    }
+    abcd[0] = _mm_extract_epi32(s, 3);
+    abcd[1] = _mm_extract_epi32(s, 2);
+    abcd[2] = _mm_extract_epi32(s, 1);
+    abcd[3] = _mm_extract_epi32(s, 0);
+}
+
+HOST_SHA
+void host_sha256_rounds4(uint32_t *abcd, uint32_t *efgh, const uint32_t *wk)
+{
+    /* SHA256RNDS2 does two rounds on the state as ABEF and CDGH */
+    __m128i abef = _mm_set_epi32(abcd[0], abcd[1], efgh[0], efgh[1]);
+    __m128i cdgh = _mm_set_epi32(abcd[2], abcd[3], efgh[2], efgh[3]);
+    __m128i w = _mm_loadu_si128((const __m128i *)wk);
+    __m128i abef2;
+
+    abef2 = _mm_sha256rnds2_epu32(cdgh, abef, w);
+    cdgh = abef;
+    abef = _mm_sha256rnds2_epu32(cdgh, abef2, _mm_srli_si128(w, 8));
+    cdgh = abef2;
+
+    abcd[0] = _mm_extract_epi32(abef, 3);
+    abcd[1] = _mm_extract_epi32(abef, 2);
+    abcd[2] = _mm_extract_epi32(cdgh, 3);
+    abcd[3] = _mm_extract_epi32(cdgh, 2);
+    efgh[0] = _mm_extract_epi32(abef, 1);
+    efgh[1] = _mm_extract_epi32(abef, 0);
+    efgh[2] = _mm_extract_epi32(cdgh, 1);
+    efgh[3] = _mm_extract_epi32(cdgh, 0);
+}
+
+#else
+
+/* no crypto instructions known on this host: the flags stay clear */
+
+void host_aes_enc_round(uint8_t *d, const uint8_t *st, const uint8_t *rk, bool last)
+{
+    abort();
+}
+
+void host_aes_dec_round(uint8_t *d, const uint8_t *st, const uint8_t *rk, bool last)
+{
+    abort();
+}
+
+void host_aes_sub_shift(uint8_t *d, const uint8_t *st, const uint8_t *rk, bool decrypt)
+{
+    abort();
+}
+
+void host_aes_mix_columns(uint8_t *d, const uint8_t *st, bool inverse)
+{
+    abort();
+}
+
+void host_clmul(uint64_t *lo, uint64_t *hi, uint64_t a, uint64_t b)
+{
+    abort();
+}
+
+void host_sha1_rounds4(uint32_t *abcd, uint32_t e, const uint32_t *wk, int f)
+{
+    abort();
+}
+
+void host_sha256_rounds4(uint32_t *abcd, uint32_t *efgh, const uint32_t *wk)
+{
+    abort();
+}
+
+#endif
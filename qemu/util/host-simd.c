@@ -0,0 +1,51 @@
+/*
+ * Host SIMD kernels for the vector helpers of the targets
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/host-simd.h"
+
+bool host_simd;
+bool host_simd_shuffle;
+
+#ifdef HOST_SIMD
+
+#include <cpuid.h>
+#include <tmmintrin.h>
+
+/* %edx and %ecx of leaf 1 */
+#ifndef bit_SSE2
+#define bit_SSE2  (1 << 26)
+#endif
+#ifndef bit_SSSE3
+#define bit_SSSE3 (1 << 9)
+#endif
+
+static void __attribute__((constructor)) host_simd_init(void)
+{
+    unsigned a, b, c, d;
+
+    if (getenv("UNICORN_NO_HOST_SIMD") || !__get_cpuid(1, &a, &b, &c, &d)) {
+        return;
+    }
+    host_simd = (d & bit_SSE2) != 0;
+    host_simd_shuffle = host_simd && (c & bit_SSSE3) != 0;
+}
+
+__attribute__((target("ssse3")))
+uint64_t simd_lookup8(uint64_t res, uint64_t idx, const void *table,
+                      uint8_t base, uint8_t count)
+{
+    simd_vec t = _mm_loadu_si128((const __m128i *)table);
+    simd_vec i = _mm_sub_epi8(_mm_loadl_epi64((const __m128i *)&idx), _mm_set1_epi8(base));
+    simd_vec in = _mm_cmpeq_epi8(_mm_min_epu8(i, _mm_set1_epi8(count - 1)), i);
+    simd_vec r = _mm_loadl_epi64((const __m128i *)&res);
+
+    r = _mm_or_si128(_mm_and_si128(in, _mm_shuffle_epi8(t, i)), _mm_andnot_si128(in, r));
+    _mm_storel_epi64((__m128i *)&res, r);
+    return res;
+}
+
+#endif
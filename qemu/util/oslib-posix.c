@@ -103,10 +103,21 @@ void *qemu_memalign(size_t alignment, size_t size)
 void *qemu_anon_ram_alloc(size_t size, uint64_t *alignment)
 {
     size_t align = QEMU_VMALLOC_ALIGN;
-    size_t total = size + align - getpagesize();
-    void *ptr = mmap(0, total, PROT_READ | PROT_WRITE,
-                     MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    size_t offset = QEMU_ALIGN_UP((uintptr_t)ptr, align) - (uintptr_t)ptr;
+    size_t total;
+    void *ptr;
+    size_t offset;
+
+    /* Unicorn: a block smaller than a huge page has no use for its
+     * alignment. Blocks aligned apart cannot share a kernel mapping, and a
+     * process only has some 65000 of those for all the blocks mapped.
+     */
+    if (size < align) {
+        align = getpagesize();
+    }
+    total = size + align - getpagesize();
+    ptr = mmap(0, total, PROT_READ | PROT_WRITE,
+               MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    offset = QEMU_ALIGN_UP((uintptr_t)ptr, align) - (uintptr_t)ptr;
 
     if (ptr == MAP_FAILED) {
         return NULL;
@@ -4,12 +4,13 @@
 // memory address where emulation starts
 #define ADDRESS 0x1000000
 
-uc_engine *uc;
+uc_engine *template;
 int initialized = 0;
 FILE * outfile = NULL;
 
 
 int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
+    uc_engine *uc;
     uc_err err;
 
     if (initialized == 0) {
@@ -23,20 +24,27 @@ int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
             }
         }
 
+        // Initialize emulator in supplied mode, once: every input runs
+        // in a clone of this engine
+        err = uc_open(UC_ARCH_ARM, UC_MODE_THUMB, &template);
+        if (err != UC_ERR_OK) {
+            printf("Failed on uc_open() with error returned: %u\n", err);
+            abort();
+        }
+
+        // map 4MB memory for this emulation
+        uc_mem_map(template, ADDRESS, 4 * 1024 * 1024, UC_PROT_ALL);
+
         initialized = 1;
     }
 
-    // Not global as we must reset this structure
-    // Initialize emulator in supplied mode
-    err = uc_open(UC_ARCH_ARM, UC_MODE_THUMB, &uc);
+    // Not the template as we must reset the engine for each input
+    err = uc_clone(template, &uc);
     if (err != UC_ERR_OK) {
-        printf("Failed on uc_open() with error returned: %u\n", err);
+        printf("Failed on uc_clone() with error returned: %u\n", err);
         abort();
     }
 
-    // map 4MB memory for this emulation
-    uc_mem_map(uc, ADDRESS, 4 * 1024 * 1024, UC_PROT_ALL);
-
     // write machine code to be emulated to memory
     if (uc_mem_write(uc, ADDRESS, Data, Size)) {
         printf("Failed to write emulation code to memory, quit!\n");
@@ -50,6 +58,7 @@ int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
         fprintf(outfile, "Failed on uc_emu_start() with error returned %u: %s\n", err, uc_strerror(err));
     }
 
+    // the closed clone is reset from the template for the next input
     uc_close(uc);
 
     return 0;
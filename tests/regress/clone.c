@@ -0,0 +1,196 @@
+/*
+Test for uc_clone().
+
+A clone starts with the memory, the registers and the hooks of its template
+and runs independently of it. A closed clone is handed out again by the next
+uc_clone(), with the pages it wrote reset from the template, and must see
+the changes made to the template in between.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x200000
+#define PTR_ADDR 0x300000
+#define MMIO_ADDR 0x400000
+#define NEW_ADDR 0x500000
+
+/*
+bits 32
+
+    mov eax, [DATA_ADDR]
+    inc eax
+    mov [DATA_ADDR], eax
+*/
+static const unsigned char PROGRAM[] = "\xa1\x00\x00\x20\x00\x40\xa3\x00\x00\x20\x00";
+#define END (CODE_ADDR + sizeof(PROGRAM) - 1)
+
+/*
+bits 32
+
+    mov eax, [MMIO_ADDR]
+*/
+static const unsigned char MMIO_PROGRAM[] = "\xa1\x00\x00\x40\x00";
+
+static int code_calls;
+static uc_engine *mmio_uc;
+
+static uint32_t data(uc_engine *uc, uint64_t addr)
+{
+    uint32_t v = 0xdeadbeef;
+
+    uc_mem_read(uc, addr, &v, sizeof(v));
+    return v;
+}
+
+static uint32_t reg(uc_engine *uc, int regid)
+{
+    uint32_t v = 0;
+
+    uc_reg_read(uc, regid, &v);
+    return v;
+}
+
+static int run(uc_engine *uc)
+{
+    return uc_emu_start(uc, CODE_ADDR, END, 0, 0) == UC_ERR_OK;
+}
+
+static void hook_code(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    code_calls++;
+}
+
+static uint64_t mmio_read(uc_engine *uc, uint64_t offset, unsigned size, void *user_data)
+{
+    mmio_uc = uc;
+    return (uint64_t)(uintptr_t)user_data;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc, *clone, *other;
+    uc_hook hh;
+    uint32_t esi = 0x1234, value = 41;
+    uint8_t *ptr, bitmap;
+    size_t cache_size = 0, size = 0;
+    int i, ok;
+
+    printf("# engines cloned from a template\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    ptr = calloc(1, 0x1000);
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+    uc_mem_map(uc, DATA_ADDR, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_write(uc, DATA_ADDR, &value, sizeof(value));
+    uc_mem_map_ptr(uc, PTR_ADDR, 0x1000, UC_PROT_READ | UC_PROT_WRITE, ptr);
+    uc_mmio_map(uc, MMIO_ADDR, 0x1000, mmio_read, (void *)0x55, NULL, (void *)0x55);
+    uc_reg_write(uc, UC_X86_REG_ESI, &esi);
+    uc_hook_add(uc, &hh, UC_HOOK_CODE, hook_code, NULL, 1, 0, 0);
+
+    check(uc_clone(uc, &clone) == UC_ERR_OK, "clone an engine");
+    check(data(clone, DATA_ADDR) == 41 && reg(clone, UC_X86_REG_ESI) == 0x1234,
+            "clone has the memory and registers of the template");
+    code_calls = 0;
+    check(run(clone) && data(clone, DATA_ADDR) == 42 && code_calls == 3,
+            "clone runs with the hooks of the template");
+    check(data(uc, DATA_ADDR) == 41, "template memory is unchanged");
+
+    run(uc);
+    check(data(uc, DATA_ADDR) == 42 && data(clone, DATA_ADDR) == 42,
+            "clone memory is unchanged by the template");
+
+    uc_mem_write(clone, PTR_ADDR, "\x01", 1);
+    check(ptr[0] == 0, "memory of uc_mem_map_ptr() is copied, not shared");
+
+    uc_mem_write(clone, CODE_ADDR, MMIO_PROGRAM, sizeof(MMIO_PROGRAM) - 1);
+    check(uc_emu_start(clone, CODE_ADDR, CODE_ADDR + sizeof(MMIO_PROGRAM) - 1, 0, 0) == UC_ERR_OK &&
+            reg(clone, UC_X86_REG_EAX) == 0x55 && mmio_uc == clone,
+            "MMIO callbacks run for the clone");
+
+    // the closed clone is reset from the template, which ran once since
+    other = clone;
+    check(uc_close(clone) == UC_ERR_OK && uc_clone(uc, &clone) == UC_ERR_OK,
+            "close the clone and clone again");
+    check(clone == other, "closed clone is handed out again");
+    check(data(clone, DATA_ADDR) == 42 && data(clone, PTR_ADDR) == 0,
+            "memory is reset from the template");
+    code_calls = 0;
+    check(run(clone) && data(clone, DATA_ADDR) == 43 && code_calls == 3,
+            "code rewritten by the closed clone is reset");
+
+    ok = 1;
+    for (i = 0; i < 100; i++) {
+        ok &= uc_close(clone) == UC_ERR_OK && uc_clone(uc, &clone) == UC_ERR_OK;
+        ok &= clone == other && data(clone, DATA_ADDR) == 42;
+        ok &= run(clone) && data(clone, DATA_ADDR) == 43;
+    }
+    check(ok, "repeated clones and runs");
+
+    // changes of the template between clones
+    uc_close(clone);
+    ptr[0] = 7;
+    value = 100;
+    uc_mem_write(uc, DATA_ADDR, &value, sizeof(value));
+    uc_clone(uc, &clone);
+    check(data(clone, DATA_ADDR) == 100 && data(clone, PTR_ADDR) == 7,
+            "clone sees memory written in the template");
+    uc_close(clone);
+    uc_mem_map(uc, NEW_ADDR, 0x1000, UC_PROT_ALL);
+    uc_clone(uc, &clone);
+    check(uc_mem_write(clone, NEW_ADDR, "\x01", 1) == UC_ERR_OK,
+            "clone sees memory mapped in the template");
+    uc_close(clone);
+    uc_hook_del(uc, hh);
+    uc_clone(uc, &clone);
+    code_calls = 0;
+    check(run(clone) && code_calls == 0, "clone sees hooks deleted in the template");
+
+    // a clone changed by the user is not handed out again
+    uc_hook_add(clone, &hh, UC_HOOK_CODE, hook_code, NULL, 1, 0, 0);
+    uc_close(clone);
+    uc_clone(uc, &clone);
+    code_calls = 0;
+    check(run(clone) && code_calls == 0, "hooks added to a closed clone are dropped");
+
+    uc_mem_dirty_log_start(clone, DATA_ADDR, 0x1000);
+    uc_close(clone);
+    uc_clone(uc, &clone);
+    bitmap = 0;
+    check(run(clone) && uc_mem_dirty_log_get(clone, DATA_ADDR, 0x1000, &bitmap, false) == UC_ERR_OK &&
+            bitmap == 0, "dirty logging of a closed clone is dropped");
+
+    uc_query(clone, UC_QUERY_TB_CACHE_SIZE, &cache_size);
+    uc_tb_cache_resize(clone, cache_size * 2, cache_size * 2);
+    run(clone);
+    uc_close(clone);
+    uc_clone(uc, &clone);
+    run(clone);
+    uc_query(clone, UC_QUERY_TB_CACHE_SIZE, &size);
+    check(size == cache_size, "cache size of a closed clone is dropped");
+
+    // MMIO permissions changed in the template
+    uc_close(clone);
+    uc_mem_protect(uc, MMIO_ADDR, 0x1000, UC_PROT_NONE);
+    uc_clone(uc, &clone);
+    uc_mem_write(clone, CODE_ADDR, MMIO_PROGRAM, sizeof(MMIO_PROGRAM) - 1);
+    check(uc_emu_start(clone, CODE_ADDR, CODE_ADDR + sizeof(MMIO_PROGRAM) - 1, 0, 0) == UC_ERR_READ_PROT,
+            "clone has the MMIO permissions of the template");
+    uc_mem_write(clone, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+
+    check(uc_clone(uc, &other) == UC_ERR_OK && other != clone, "two clones at once");
+    check(uc_close(uc) == UC_ERR_OK, "close the template first");
+    check(run(clone) && uc_close(clone) == UC_ERR_OK && uc_close(other) == UC_ERR_OK,
+            "clones outlive the template");
+
+    free(ptr);
+    return failed;
+}
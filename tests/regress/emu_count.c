@@ -0,0 +1,110 @@
+/*
+Test for uc_emu_start() with an instruction count.
+
+The translated code counts the instructions itself: emulation must stop
+right after @count instructions, in the middle of a block too, with the
+pc on the next instruction and without calling the hooks of instructions
+that do not run.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+
+/*
+bits 32
+
+loop:
+    inc eax
+    inc eax
+    inc eax
+    dec ecx
+    jnz loop
+*/
+static const unsigned char PROGRAM[] = "\x40\x40\x40\x49\x75\xfa";
+#define LOOP_INSNS 5
+#define LOOP_INCS 3
+
+static int code_calls, block_calls;
+
+static void hook_code(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    code_calls++;
+}
+
+static void hook_block(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    block_calls++;
+}
+
+/* Run @count instructions, check eax and eip against the program. */
+static int run(uc_engine *uc, size_t count)
+{
+    uint32_t eax = 0, ecx = 0x7fffffff, eip;
+    uint32_t incs = count / LOOP_INSNS * LOOP_INCS;
+
+    if (count % LOOP_INSNS < LOOP_INCS)
+        incs += count % LOOP_INSNS;
+    else
+        incs += LOOP_INCS;
+
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_write(uc, UC_X86_REG_ECX, &ecx);
+    if (uc_emu_start(uc, CODE_ADDR, 0, 0, count) != UC_ERR_OK)
+        return 0;
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_read(uc, UC_X86_REG_EIP, &eip);
+    return eax == incs && eip == CODE_ADDR + count % LOOP_INSNS;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_hook hc, hb;
+    uint32_t eax;
+    size_t count;
+    int ok;
+
+    printf("# instruction count of uc_emu_start()\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+
+    ok = 1;
+    for (count = 1; count <= 3 * LOOP_INSNS; count++)
+        ok &= run(uc, count);
+    check(ok, "stop after each instruction of a block");
+
+    check(run(uc, 200003), "count larger than the 16-bit decrementer");
+    check(run(uc, 7) && run(uc, 1000) && run(uc, 7), "counts in a row");
+
+    uc_hook_add(uc, &hc, UC_HOOK_CODE, hook_code, NULL, 1, 0, 0);
+    uc_hook_add(uc, &hb, UC_HOOK_BLOCK, hook_block, NULL, 1, 0, 0);
+    code_calls = block_calls = 0;
+    check(run(uc, 12), "count with code and block hooks");
+    check(code_calls == 12, "code hook runs once per counted instruction");
+    check(block_calls == 3, "block hook runs once per block entered");
+    uc_hook_del(uc, hc);
+    uc_hook_del(uc, hb);
+
+    eax = 0;
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_write(uc, UC_X86_REG_ECX, "\x0a\x00\x00\x00");
+    check(uc_emu_start(uc, CODE_ADDR, CODE_ADDR + sizeof(PROGRAM) - 1, 0, 0) == UC_ERR_OK,
+            "run without a count");
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    check(eax == 10 * LOOP_INCS, "all iterations run without a count");
+
+    check(run(uc, 4), "count again after a run without one");
+
+    uc_close(uc);
+    return failed;
+}
@@ -0,0 +1,84 @@
+/*
+Test for uc_emu_start() with a timeout.
+
+The execution loop checks the deadline itself, so an endless loop of
+chained blocks must stop close to the timeout, report it through
+uc_query(UC_QUERY_TIMEOUT), and leave the engine usable for the next run.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+
+/*
+bits 32
+
+loop:
+    inc eax
+    jmp loop
+*/
+static const unsigned char PROGRAM[] = "\x40\xeb\xfd";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uint32_t eax = 0, eip;
+    size_t timed_out = 0, late = 0;
+    double start, elapsed;
+    int i, ok;
+
+    printf("# timeout of uc_emu_start()\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    start = now();
+    check(uc_emu_start(uc, CODE_ADDR, 0, 100 * UC_MILISECOND_SCALE, 0) == UC_ERR_OK,
+            "endless loop with a timeout");
+    elapsed = now() - start;
+    uc_query(uc, UC_QUERY_TIMEOUT, &timed_out);
+    uc_query(uc, UC_QUERY_TIMEOUT_PRECISION, &late);
+    check(timed_out == 1, "UC_QUERY_TIMEOUT reports the timeout");
+    check(elapsed >= 0.1 && elapsed < 1.0, "emulation stops near the deadline");
+    check(late < 100 * UC_MILISECOND_SCALE, "UC_QUERY_TIMEOUT_PRECISION reports the delay");
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_read(uc, UC_X86_REG_EIP, &eip);
+    check(eax > 0 && (eip == CODE_ADDR || eip == CODE_ADDR + 1),
+            "pc is left on an instruction of the loop");
+
+    ok = 1;
+    for (i = 0; i < 1000; i++) {
+        uc_emu_start(uc, CODE_ADDR, CODE_ADDR + 1, UC_SECOND_SCALE, 0);
+        uc_query(uc, UC_QUERY_TIMEOUT, &timed_out);
+        ok &= timed_out == 0;
+    }
+    check(ok, "short runs with a timeout finish without timing out");
+
+    eax = 0;
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_emu_start(uc, CODE_ADDR, 0, UC_SECOND_SCALE, 20001);
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    uc_query(uc, UC_QUERY_TIMEOUT, &timed_out);
+    check(eax == 10001 && timed_out == 0, "count reached before the timeout");
+
+    uc_close(uc);
+    return failed;
+}
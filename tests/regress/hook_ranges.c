@@ -0,0 +1,144 @@
+/*
+Test for many hooks with narrow address ranges.
+
+Hooks are dispatched through an index of their address ranges. Each hook
+must run exactly for the addresses in its range, in the order of the hook
+list, and a hook deleted by a callback must not run afterwards.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x200000
+#define NOPS 256
+#define WIDE_BEGIN (CODE_ADDR + 16)
+#define WIDE_END (CODE_ADDR + 31)
+#define ORDER_ADDR (CODE_ADDR + 20)
+#define DEL_ADDR (CODE_ADDR + 40)
+
+/*
+bits 32
+
+    times NOPS nop
+    mov [ebx], eax
+    mov [ebx+0x40], eax
+*/
+static unsigned char program[NOPS + 5];
+#define END (CODE_ADDR + sizeof(program))
+
+static int narrow_calls[NOPS];
+static int wide_calls, all_calls, deleted_calls;
+static int write_calls[2];
+static char order[8];
+static int order_len;
+static uc_hook deleted;
+
+static void log_order(uint64_t address, char c)
+{
+    if (address == ORDER_ADDR && order_len < (int)sizeof(order) - 1)
+        order[order_len++] = c;
+}
+
+static void hook_all(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    all_calls++;
+    log_order(address, 'a');
+}
+
+static void hook_narrow(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    int i = (int)(uintptr_t)user_data;
+
+    if (address == CODE_ADDR + i)
+        narrow_calls[i]++;
+    else
+        narrow_calls[i] += 1000;
+    log_order(address, 'n');
+}
+
+static void hook_wide(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    if (address >= WIDE_BEGIN && address <= WIDE_END)
+        wide_calls++;
+    log_order(address, 'w');
+}
+
+static void hook_deleter(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    uc_hook_del(uc, deleted);
+}
+
+static void hook_deleted(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    deleted_calls++;
+}
+
+static void hook_write(uc_engine *uc, uc_mem_type type,
+        uint64_t address, int size, int64_t value, void *user_data)
+{
+    write_calls[(uintptr_t)user_data]++;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_hook hh;
+    uint32_t ebx = DATA_ADDR;
+    int i, ok;
+
+    printf("# hooks with narrow address ranges\n");
+
+    memset(program, 0x90, NOPS);
+    memcpy(program + NOPS, "\x89\x03\x89\x43\x40", 5);
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, program, sizeof(program));
+
+    uc_hook_add(uc, &hh, UC_HOOK_CODE, hook_all, NULL, 1, 0, 0);
+    ok = 1;
+    for (i = 0; i < NOPS; i++) {
+        ok &= uc_hook_add(uc, &hh, UC_HOOK_CODE, hook_narrow, (void *)(uintptr_t)i,
+                CODE_ADDR + i, CODE_ADDR + i, 0) == UC_ERR_OK;
+    }
+    check(ok, "add a hook for each instruction");
+    uc_hook_add(uc, &hh, UC_HOOK_CODE, hook_wide, NULL, WIDE_BEGIN, WIDE_END, 0);
+    uc_hook_add(uc, &hh, UC_HOOK_CODE, hook_deleter, NULL, DEL_ADDR, DEL_ADDR, 0);
+    uc_hook_add(uc, &deleted, UC_HOOK_CODE, hook_deleted, NULL, DEL_ADDR, DEL_ADDR + 8, 0);
+    uc_hook_add(uc, &hh, UC_HOOK_MEM_WRITE, hook_write, (void *)0, DATA_ADDR, DATA_ADDR, 0);
+    uc_hook_add(uc, &hh, UC_HOOK_MEM_WRITE, hook_write, (void *)1,
+            DATA_ADDR + 0x40, DATA_ADDR + 0x43, 0);
+    uc_hook_add(uc, &hh, UC_HOOK_MEM_WRITE, hook_write, (void *)1,
+            DATA_ADDR + 0x80, DATA_ADDR + 0x1000, 0);
+
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    check(uc_emu_start(uc, CODE_ADDR, END, 0, 0) == UC_ERR_OK, "run the program");
+
+    ok = 1;
+    for (i = 0; i < NOPS; i++)
+        ok &= narrow_calls[i] == 1;
+    check(ok, "each narrow hook runs once, on its own address");
+    check(wide_calls == WIDE_END - WIDE_BEGIN + 1, "overlapping hook runs over its range");
+    check(all_calls == NOPS + 2, "unbounded hook runs on every instruction");
+    check(strcmp(order, "anw") == 0, "hooks run in the order they were added");
+    check(deleted_calls == 0, "hook deleted by an earlier callback does not run");
+    check(write_calls[0] == 1 && write_calls[1] == 1, "memory hooks run for their range only");
+
+    memset(narrow_calls, 0, sizeof(narrow_calls));
+    uc_hook_del(uc, hh);
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    uc_emu_start(uc, CODE_ADDR, END, 0, 0);
+    check(narrow_calls[0] == 1 && narrow_calls[NOPS - 1] == 1 && write_calls[1] == 2,
+            "hooks still run after deleting another one");
+
+    uc_close(uc);
+    return failed;
+}
@@ -0,0 +1,402 @@
+/*
+Test for the crypto instructions.
+
+x86 AESENC, AESENCLAST, AESDEC, AESDECLAST, AESIMC and PCLMULQDQ, and arm64
+AESE, AESD, AESMC, AESIMC, SHA1C/P/M, SHA256H/H2 and PMULL use the crypto
+instructions of the host when it has them. They must give the results of
+the portable helpers, which the test checks by running itself again with
+UNICORN_NO_HOST_CRYPTO set.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x200000
+#define TRIALS 64
+
+/* FIPS-197 appendix B: AES-128 round keys, plaintext and ciphertext */
+static const unsigned char KEYS[11][16] = {
+    "\x2b\x7e\x15\x16\x28\xae\xd2\xa6\xab\xf7\x15\x88\x09\xcf\x4f\x3c",
+    "\xa0\xfa\xfe\x17\x88\x54\x2c\xb1\x23\xa3\x39\x39\x2a\x6c\x76\x05",
+    "\xf2\xc2\x95\xf2\x7a\x96\xb9\x43\x59\x35\x80\x7a\x73\x59\xf6\x7f",
+    "\x3d\x80\x47\x7d\x47\x16\xfe\x3e\x1e\x23\x7e\x44\x6d\x7a\x88\x3b",
+    "\xef\x44\xa5\x41\xa8\x52\x5b\x7f\xb6\x71\x25\x3b\xdb\x0b\xad\x00",
+    "\xd4\xd1\xc6\xf8\x7c\x83\x9d\x87\xca\xf2\xb8\xbc\x11\xf9\x15\xbc",
+    "\x6d\x88\xa3\x7a\x11\x0b\x3e\xfd\xdb\xf9\x86\x41\xca\x00\x93\xfd",
+    "\x4e\x54\xf7\x0e\x5f\x5f\xc9\xf3\x84\xa6\x4f\xb2\x4e\xa6\xdc\x4f",
+    "\xea\xd2\x73\x21\xb5\x8d\xba\xd2\x31\x2b\xf5\x60\x7f\x8d\x29\x2f",
+    "\xac\x77\x66\xf3\x19\xfa\xdc\x21\x28\xd1\x29\x41\x57\x5c\x00\x6e",
+    "\xd0\x14\xf9\xa8\xc9\xee\x25\x89\xe1\x3f\x0c\xc8\xb6\x63\x0c\xa6",
+};
+static const unsigned char PLAIN[16] =
+    "\x32\x43\xf6\xa8\x88\x5a\x30\x8d\x31\x31\x98\xa2\xe0\x37\x07\x34";
+static const unsigned char CIPHER[16] =
+    "\x39\x25\x84\x1d\x02\xdc\x09\xfb\xdc\x11\x85\x97\x19\x6a\x0b\x32";
+
+/*
+bits 64
+
+    movdqa xmm5, xmm3
+    pclmulqdq xmm5, xmm4, 0x00
+    movdqa xmm6, xmm3
+    pclmulqdq xmm6, xmm4, 0x11
+    movdqa xmm7, xmm3
+    pclmulqdq xmm7, xmm4, 0x10
+*/
+static const unsigned char X86_PCLMUL[] =
+    "\x66\x0f\x6f\xeb\x66\x0f\x3a\x44\xec\x00\x66\x0f\x6f\xf3\x66\x0f"
+    "\x3a\x44\xf4\x11\x66\x0f\x6f\xfb\x66\x0f\x3a\x44\xfc\x10";
+
+/* arm64 encodings */
+#define AESE(d, n)      (0x4e284800 | (n) << 5 | (d))
+#define AESD(d, n)      (0x4e285800 | (n) << 5 | (d))
+#define AESMC(d, n)     (0x4e286800 | (n) << 5 | (d))
+#define AESIMC(d, n)    (0x4e287800 | (n) << 5 | (d))
+#define EOR(d, n, m)    (0x6e201c00 | (m) << 16 | (n) << 5 | (d))
+#define SHA1C(d, n, m)  (0x5e000000 | (m) << 16 | (n) << 5 | (d))
+#define SHA1P(d, n, m)  (0x5e001000 | (m) << 16 | (n) << 5 | (d))
+#define SHA1M(d, n, m)  (0x5e002000 | (m) << 16 | (n) << 5 | (d))
+#define SHA256H(d, n, m)  (0x5e004000 | (m) << 16 | (n) << 5 | (d))
+#define SHA256H2(d, n, m) (0x5e005000 | (m) << 16 | (n) << 5 | (d))
+#define PMULL(d, n, m)  (0x0ee0e000 | (m) << 16 | (n) << 5 | (d))
+#define PMULL2(d, n, m) (0x4ee0e000 | (m) << 16 | (n) << 5 | (d))
+
+typedef union {
+    unsigned char b[16];
+    uint32_t w[4];
+    uint64_t q[2];
+} vec;
+
+static uint64_t seed = 0x0123456789abcdefULL;
+
+static uint64_t rnd(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+static void rnd_vec(vec *v)
+{
+    v->q[0] = rnd();
+    v->q[1] = rnd();
+}
+
+static uint32_t rol32(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static uint32_t ror32(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static void clmul(uint64_t a, uint64_t b, uint64_t *lo, uint64_t *hi)
+{
+    int i;
+
+    *lo = *hi = 0;
+    for (i = 0; i < 64; i++) {
+        if (a & (1ULL << i)) {
+            *lo ^= b << i;
+            if (i)
+                *hi ^= b >> (64 - i);
+        }
+    }
+}
+
+/* SHA1C, SHA1P and SHA1M as the Arm ARM gives them */
+static void sha1_ref(vec *d, uint32_t e, const vec *m, int op)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        uint32_t x = d->w[1], y = d->w[2], z = d->w[3], t;
+
+        if (op == 0)
+            t = (x & (y ^ z)) ^ z;
+        else if (op == 1)
+            t = x ^ y ^ z;
+        else
+            t = (x & y) | ((x | y) & z);
+        t += rol32(d->w[0], 5) + e + m->w[i];
+        e = d->w[3];
+        d->w[3] = d->w[2];
+        d->w[2] = ror32(d->w[1], 2);
+        d->w[1] = d->w[0];
+        d->w[0] = t;
+    }
+}
+
+/* SHA256H when 'h2' is clear, else SHA256H2 */
+static void sha256_ref(vec *d, vec *n, const vec *m, int h2)
+{
+    vec x = h2 ? *n : *d, y = h2 ? *d : *n;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        uint32_t t = ((y.w[0] & (y.w[1] ^ y.w[2])) ^ y.w[2]) + y.w[3] +
+            (ror32(y.w[0], 6) ^ ror32(y.w[0], 11) ^ ror32(y.w[0], 25)) + m->w[i];
+
+        y.w[3] = y.w[2];
+        y.w[2] = y.w[1];
+        y.w[1] = y.w[0];
+        y.w[0] = x.w[3] + t;
+        t += ((x.w[0] & x.w[1]) | ((x.w[0] | x.w[1]) & x.w[2])) +
+            (ror32(x.w[0], 2) ^ ror32(x.w[0], 13) ^ ror32(x.w[0], 22));
+        x.w[3] = x.w[2];
+        x.w[2] = x.w[1];
+        x.w[1] = x.w[0];
+        x.w[0] = t;
+    }
+    *d = h2 ? y : x;
+}
+
+static void emit(unsigned char *code, size_t *size, const char *bytes, size_t n)
+{
+    memcpy(code + *size, bytes, n);
+    *size += n;
+}
+
+/* opcode bytes and ModRM of an instruction on [rsi + disp32] */
+static void emit_rsi(unsigned char *code, size_t *size, const char *op, size_t n, uint32_t disp)
+{
+    emit(code, size, op, n);
+    emit(code, size, (const char *)&disp, 4);
+}
+
+static void test_x86(void)
+{
+    uc_engine *uc;
+    unsigned char code[512];
+    size_t size = 0;
+    vec v, a, b, r5, r6, r7;
+    uint64_t rsi = DATA_ADDR, lo, hi;
+    int i, r, ok;
+
+    if (!uc_arch_supported(UC_ARCH_X86)) {
+        printf("# x86 not built in, skipped\n");
+        return;
+    }
+    if (uc_open(UC_ARCH_X86, UC_MODE_64, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        failed = 1;
+        return;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA_ADDR, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_write(uc, DATA_ADDR, KEYS, sizeof(KEYS));
+    uc_reg_write(uc, UC_X86_REG_RSI, &rsi);
+
+    /* xmm0: encrypt with aesenc, xmm1: decrypt with aesimc and aesdec */
+    emit_rsi(code, &size, "\x66\x0f\xef\x86", 4, 0);                   // pxor xmm0, [rsi]
+    for (r = 1; r < 10; r++)
+        emit_rsi(code, &size, "\x66\x0f\x38\xdc\x86", 5, 16 * r);     // aesenc xmm0, [rsi + 16 * r]
+    emit_rsi(code, &size, "\x66\x0f\x38\xdd\x86", 5, 160);            // aesenclast xmm0, [rsi + 160]
+    emit_rsi(code, &size, "\x66\x0f\xef\x8e", 4, 160);                 // pxor xmm1, [rsi + 160]
+    for (r = 9; r > 0; r--) {
+        emit_rsi(code, &size, "\xf3\x0f\x6f\x96", 4, 16 * r);         // movdqu xmm2, [rsi + 16 * r]
+        emit(code, &size, "\x66\x0f\x38\xdb\xd2", 5);                  // aesimc xmm2, xmm2
+        emit(code, &size, "\x66\x0f\x38\xde\xca", 5);                  // aesdec xmm1, xmm2
+    }
+    emit_rsi(code, &size, "\x66\x0f\x38\xdf\x8e", 5, 0);              // aesdeclast xmm1, [rsi]
+
+    uc_mem_write(uc, CODE_ADDR, code, size);
+    uc_reg_write(uc, UC_X86_REG_XMM0, PLAIN);
+    uc_reg_write(uc, UC_X86_REG_XMM1, CIPHER);
+    ok = uc_emu_start(uc, CODE_ADDR, CODE_ADDR + size, 0, 0) == UC_ERR_OK;
+    uc_reg_read(uc, UC_X86_REG_XMM0, &v);
+    check(ok && memcmp(v.b, CIPHER, 16) == 0, "x86 aesenc and aesenclast encrypt the FIPS-197 block");
+    uc_reg_read(uc, UC_X86_REG_XMM1, &v);
+    check(ok && memcmp(v.b, PLAIN, 16) == 0, "x86 aesimc, aesdec and aesdeclast decrypt it");
+
+    uc_mem_write(uc, CODE_ADDR, X86_PCLMUL, sizeof(X86_PCLMUL) - 1);
+    ok = 1;
+    for (i = 0; i < TRIALS && ok; i++) {
+        rnd_vec(&a);
+        rnd_vec(&b);
+        uc_reg_write(uc, UC_X86_REG_XMM3, &a);
+        uc_reg_write(uc, UC_X86_REG_XMM4, &b);
+        ok = uc_emu_start(uc, CODE_ADDR, CODE_ADDR + sizeof(X86_PCLMUL) - 1, 0, 0) == UC_ERR_OK;
+        uc_reg_read(uc, UC_X86_REG_XMM5, &r5);
+        uc_reg_read(uc, UC_X86_REG_XMM6, &r6);
+        uc_reg_read(uc, UC_X86_REG_XMM7, &r7);
+        clmul(a.q[0], b.q[0], &lo, &hi);
+        ok = ok && r5.q[0] == lo && r5.q[1] == hi;
+        clmul(a.q[1], b.q[1], &lo, &hi);
+        ok = ok && r6.q[0] == lo && r6.q[1] == hi;
+        clmul(a.q[0], b.q[1], &lo, &hi);
+        ok = ok && r7.q[0] == lo && r7.q[1] == hi;
+    }
+    check(ok, "x86 pclmulqdq gives the carry-less products");
+
+    uc_close(uc);
+}
+
+static void test_arm64(void)
+{
+    uc_engine *uc;
+    uint32_t code[64];
+    size_t size = 0;
+    vec v, zero, abcd, e, wk, efgh, a, b, want, want2;
+    uint64_t cpacr = 3 << 20, lo, hi;
+    int i, r, ok;
+
+    if (!uc_arch_supported(UC_ARCH_ARM64)) {
+        printf("# arm64 not built in, skipped\n");
+        return;
+    }
+    if (uc_open(UC_ARCH_ARM64, UC_MODE_ARM, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        failed = 1;
+        return;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    /* enable the FP and SIMD registers */
+    uc_reg_write(uc, UC_ARM64_REG_CPACR_EL1, &cpacr);
+
+    /* v0: encrypt with aese and aesmc, v12: decrypt with aesd and aesimc */
+    for (r = 0; r < 9; r++) {
+        code[size++] = AESE(0, 1 + r);
+        code[size++] = AESMC(0, 0);
+    }
+    code[size++] = AESE(0, 10);
+    code[size++] = EOR(0, 0, 11);
+    code[size++] = AESD(12, 11);
+    for (r = 9; r > 0; r--) {
+        code[size++] = EOR(12, 12, 1 + r);
+        code[size++] = AESIMC(12, 12);
+        code[size++] = AESD(12, 31);
+    }
+    code[size++] = EOR(12, 12, 1);
+
+    uc_mem_write(uc, CODE_ADDR, code, size * 4);
+    for (r = 0; r < 11; r++)
+        uc_reg_write(uc, UC_ARM64_REG_Q1 + r, KEYS[r]);
+    memset(&zero, 0, sizeof(zero));
+    uc_reg_write(uc, UC_ARM64_REG_Q31, &zero);
+    uc_reg_write(uc, UC_ARM64_REG_Q0, PLAIN);
+    uc_reg_write(uc, UC_ARM64_REG_Q12, CIPHER);
+    ok = uc_emu_start(uc, CODE_ADDR, CODE_ADDR + size * 4, 0, 0) == UC_ERR_OK;
+    uc_reg_read(uc, UC_ARM64_REG_Q0, &v);
+    check(ok && memcmp(v.b, CIPHER, 16) == 0, "arm64 aese and aesmc encrypt the FIPS-197 block");
+    uc_reg_read(uc, UC_ARM64_REG_Q12, &v);
+    check(ok && memcmp(v.b, PLAIN, 16) == 0, "arm64 aesd and aesimc decrypt it");
+
+    size = 0;
+    code[size++] = SHA1C(20, 21, 22);
+    code[size++] = SHA1P(17, 21, 22);
+    code[size++] = SHA1M(18, 21, 22);
+    code[size++] = SHA256H(23, 24, 22);
+    code[size++] = SHA256H2(25, 26, 22);
+    code[size++] = PMULL(27, 28, 29);
+    code[size++] = PMULL2(30, 28, 29);
+    uc_mem_write(uc, CODE_ADDR, code, size * 4);
+
+    for (i = 0; i < TRIALS; i++) {
+        rnd_vec(&abcd);
+        rnd_vec(&e);
+        rnd_vec(&wk);
+        rnd_vec(&efgh);
+        rnd_vec(&a);
+        rnd_vec(&b);
+        uc_reg_write(uc, UC_ARM64_REG_Q20, &abcd);
+        uc_reg_write(uc, UC_ARM64_REG_Q17, &abcd);
+        uc_reg_write(uc, UC_ARM64_REG_Q18, &abcd);
+        uc_reg_write(uc, UC_ARM64_REG_Q21, &e);
+        uc_reg_write(uc, UC_ARM64_REG_Q22, &wk);
+        uc_reg_write(uc, UC_ARM64_REG_Q23, &abcd);
+        uc_reg_write(uc, UC_ARM64_REG_Q24, &efgh);
+        uc_reg_write(uc, UC_ARM64_REG_Q25, &efgh);
+        uc_reg_write(uc, UC_ARM64_REG_Q26, &abcd);
+        uc_reg_write(uc, UC_ARM64_REG_Q28, &a);
+        uc_reg_write(uc, UC_ARM64_REG_Q29, &b);
+        if (uc_emu_start(uc, CODE_ADDR, CODE_ADDR + size * 4, 0, 0) != UC_ERR_OK) {
+            check(0, "arm64 sha1, sha256 and pmull run");
+            break;
+        }
+
+        for (r = 0; r < 3; r++) {
+            want = abcd;
+            sha1_ref(&want, e.w[0], &wk, r);
+            uc_reg_read(uc, r == 0 ? UC_ARM64_REG_Q20 : UC_ARM64_REG_Q16 + r, &v);
+            if (memcmp(&v, &want, 16))
+                break;
+        }
+        if (r < 3) {
+            check(0, r == 0 ? "arm64 sha1c" : r == 1 ? "arm64 sha1p" : "arm64 sha1m");
+            break;
+        }
+
+        want = abcd;
+        want2 = efgh;
+        sha256_ref(&want, &want2, &wk, 0);
+        uc_reg_read(uc, UC_ARM64_REG_Q23, &v);
+        if (memcmp(&v, &want, 16)) {
+            check(0, "arm64 sha256h");
+            break;
+        }
+        want = efgh;
+        want2 = abcd;
+        sha256_ref(&want, &want2, &wk, 1);
+        uc_reg_read(uc, UC_ARM64_REG_Q25, &v);
+        if (memcmp(&v, &want, 16)) {
+            check(0, "arm64 sha256h2");
+            break;
+        }
+
+        clmul(a.q[0], b.q[0], &lo, &hi);
+        uc_reg_read(uc, UC_ARM64_REG_Q27, &v);
+        if (v.q[0] != lo || v.q[1] != hi) {
+            check(0, "arm64 pmull");
+            break;
+        }
+        clmul(a.q[1], b.q[1], &lo, &hi);
+        uc_reg_read(uc, UC_ARM64_REG_Q30, &v);
+        if (v.q[0] != lo || v.q[1] != hi) {
+            check(0, "arm64 pmull2");
+            break;
+        }
+    }
+    if (i == TRIALS)
+        check(1, "arm64 sha1c, sha1p, sha1m, sha256h, sha256h2 and pmull give the reference results");
+
+    uc_close(uc);
+}
+
+int main(int argc, char **argv)
+{
+    pid_t pid;
+    int status;
+
+    printf("# Crypto instructions\n");
+
+    test_x86();
+    test_arm64();
+
+    /* the same checks on the portable helpers */
+    if (!getenv("UNICORN_NO_HOST_CRYPTO")) {
+        fflush(stdout);
+        pid = fork();
+        if (pid == 0) {
+            setenv("UNICORN_NO_HOST_CRYPTO", "1", 1);
+            if (freopen("/dev/null", "w", stdout))
+                execv(argv[0], argv);
+            _exit(127);
+        }
+        check(pid > 0 && waitpid(pid, &status, 0) == pid &&
+                WIFEXITED(status) && WEXITSTATUS(status) == 0,
+                "the portable helpers give the same results");
+    }
+
+    return failed;
+}
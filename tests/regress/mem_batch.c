@@ -0,0 +1,178 @@
+/*
+Test for batches of changes to the memory map.
+
+Between uc_mem_batch_begin() and uc_mem_batch_commit(), regions are mapped,
+unmapped and protected without rebuilding the view the guest accesses
+memory through. The host must see every change at once, the guest once the
+batch is committed or emulation starts, even for pages it already accessed,
+and the regions unmapped in the batch must not be reached through the view
+they are still in.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x1000000
+#define MMIO_ADDR 0x2000000
+#define SPLIT_ADDR 0x3000000
+#define PAGES 256
+
+// mov eax, [ebx]
+static const unsigned char LOAD[] = "\x8b\x03";
+// mov [ebx], eax
+static const unsigned char STORE[] = "\x89\x03";
+// mov eax, 0x11111111 / mov eax, 0x22222222
+static const unsigned char SET_1[] = "\xb8\x11\x11\x11\x11";
+static const unsigned char SET_2[] = "\xb8\x22\x22\x22\x22";
+
+static uint32_t page_addr(uint32_t i)
+{
+    return DATA_ADDR + i * 0x2000;
+}
+
+/* Run the code at @addr with eax = @eax and ebx = @ebx; return eax. */
+static uint32_t run(uc_engine *uc, uint64_t addr, size_t len, uint32_t eax, uint32_t ebx, uc_err *err)
+{
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    *err = uc_emu_start(uc, addr, addr + len, 0, 0);
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    return eax;
+}
+
+static uint64_t mmio_read(uc_engine *uc, uint64_t offset, unsigned size, void *user_data)
+{
+    return 0x12345678;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_mem_region *regions;
+    uc_err err;
+    uint32_t count, i, ok, value;
+
+    printf("# batches of changes to the memory map\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, LOAD, sizeof(LOAD) - 1);
+    uc_mem_write(uc, CODE_ADDR + 0x10, STORE, sizeof(STORE) - 1);
+
+    check(uc_mem_batch_commit(uc) == UC_ERR_ARG, "commit without a batch fails");
+
+    check(uc_mem_batch_begin(uc) == UC_ERR_OK, "begin a batch");
+    ok = 1;
+    for (i = 0; i < PAGES; i++) {
+        ok &= uc_mem_map(uc, page_addr(i), 0x1000, UC_PROT_READ | UC_PROT_WRITE) == UC_ERR_OK;
+        ok &= uc_mem_write(uc, page_addr(i), &i, sizeof(i)) == UC_ERR_OK;
+    }
+    check(ok, "map and fill pages in the batch");
+    ok = 1;
+    for (i = 0; i < PAGES; i++) {
+        value = 0xffffffff;
+        ok &= uc_mem_read(uc, page_addr(i), &value, sizeof(value)) == UC_ERR_OK && value == i;
+    }
+    check(ok, "the host reads them back before the commit");
+    uc_mem_regions(uc, &regions, &count);
+    uc_free(regions);
+    check(count == 1 + PAGES, "uc_mem_regions() lists them");
+    check(uc_mem_batch_commit(uc) == UC_ERR_OK, "commit the batch");
+
+    check(run(uc, CODE_ADDR, sizeof(LOAD) - 1, 0, page_addr(PAGES - 1), &err) == PAGES - 1 && err == UC_ERR_OK,
+            "the guest reads a page mapped in the batch");
+
+    // unmap, map again and protect in the same batch
+    uc_mem_batch_begin(uc);
+    uc_mem_unmap(uc, page_addr(1), 0x1000);
+    uc_mem_map(uc, page_addr(1), 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    value = 0xa5a5a5a5;
+    uc_mem_write(uc, page_addr(1), &value, sizeof(value));
+    uc_mem_unmap(uc, page_addr(2), 0x1000);
+    uc_mem_protect(uc, page_addr(3), 0x1000, UC_PROT_READ);
+    value = 0x33333333;
+    check(uc_mem_write(uc, page_addr(3), &value, sizeof(value)) == UC_ERR_OK, "the host writes a page protected in the batch");
+    check(uc_mem_batch_commit(uc) == UC_ERR_OK, "commit the changes");
+
+    check(run(uc, CODE_ADDR, sizeof(LOAD) - 1, 0, page_addr(1), &err) == 0xa5a5a5a5,
+            "the guest reads the page mapped again");
+    run(uc, CODE_ADDR, sizeof(LOAD) - 1, 0, page_addr(2), &err);
+    check(err == UC_ERR_READ_UNMAPPED, "the guest faults on the page unmapped");
+    run(uc, CODE_ADDR + 0x10, sizeof(STORE) - 1, 0, page_addr(3), &err);
+    value = 0;
+    uc_mem_read(uc, page_addr(3), &value, sizeof(value));
+    check(err == UC_ERR_WRITE_PROT && value == 0x33333333, "the guest cannot write the page protected");
+
+    // nested batches apply on the last commit, and emulation applies them
+    // without closing the batch
+    uc_mem_batch_begin(uc);
+    uc_mem_batch_begin(uc);
+    uc_mem_unmap(uc, page_addr(4), 0x1000);
+    check(uc_mem_batch_commit(uc) == UC_ERR_OK, "commit a nested batch");
+    run(uc, CODE_ADDR, sizeof(LOAD) - 1, 0, page_addr(4), &err);
+    check(err == UC_ERR_READ_UNMAPPED, "emulation in the batch sees the page unmapped");
+    uc_mem_map(uc, page_addr(4), 0x1000, UC_PROT_READ);
+    value = 0x44444444;
+    uc_mem_write(uc, page_addr(4), &value, sizeof(value));
+    check(run(uc, CODE_ADDR, sizeof(LOAD) - 1, 0, page_addr(4), &err) == value, "and the page mapped in its place");
+    check(uc_mem_batch_commit(uc) == UC_ERR_OK && uc_mem_batch_commit(uc) == UC_ERR_ARG, "commit the outer batch");
+
+    // and a page protected in the batch, whose TLB entry must go
+    run(uc, CODE_ADDR + 0x10, sizeof(STORE) - 1, 0x55555555, page_addr(5), &err);
+    check(err == UC_ERR_OK && run(uc, CODE_ADDR, sizeof(LOAD) - 1, 0, page_addr(5), &err) == 0x55555555,
+            "the guest writes a page");
+    uc_mem_batch_begin(uc);
+    uc_mem_protect(uc, page_addr(5), 0x1000, UC_PROT_READ);
+    run(uc, CODE_ADDR + 0x10, sizeof(STORE) - 1, 0x66666666, page_addr(5), &err);
+    check(err == UC_ERR_WRITE_PROT, "emulation in the batch cannot write it once protected");
+    uc_mem_batch_commit(uc);
+
+    // code of a region unmapped in a batch does not survive into the region
+    // mapped in its place
+    uc_mem_map(uc, CODE_ADDR + 0x1000, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR + 0x1000, SET_1, sizeof(SET_1) - 1);
+    check(run(uc, CODE_ADDR + 0x1000, sizeof(SET_1) - 1, 0, 0, &err) == 0x11111111, "run code from a page");
+    uc_mem_batch_begin(uc);
+    uc_mem_unmap(uc, CODE_ADDR + 0x1000, 0x1000);
+    uc_mem_map(uc, CODE_ADDR + 0x1000, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR + 0x1000, SET_2, sizeof(SET_2) - 1);
+    uc_mem_batch_commit(uc);
+    check(run(uc, CODE_ADDR + 0x1000, sizeof(SET_2) - 1, 0, 0, &err) == 0x22222222,
+            "the page mapped in its place runs its own code");
+
+    // MMIO is reached through the view
+    uc_mem_batch_begin(uc);
+    uc_mmio_map(uc, MMIO_ADDR, 0x1000, mmio_read, NULL, NULL, NULL);
+    value = 0;
+    check(uc_mem_read(uc, MMIO_ADDR, &value, sizeof(value)) == UC_ERR_OK && value == 0x12345678,
+            "the host reads MMIO mapped in the batch");
+
+    // splitting a region copies its contents within the batch
+    uc_mem_map(uc, SPLIT_ADDR, 0x3000, UC_PROT_READ | UC_PROT_WRITE);
+    for (i = 0; i < 3; i++) {
+        value = 0x50 + i;
+        uc_mem_write(uc, SPLIT_ADDR + i * 0x1000, &value, sizeof(value));
+    }
+    uc_mem_protect(uc, SPLIT_ADDR + 0x1000, 0x1000, UC_PROT_READ);
+    uc_mem_batch_commit(uc);
+    ok = 1;
+    for (i = 0; i < 3; i++)
+        ok &= run(uc, CODE_ADDR, sizeof(LOAD) - 1, 0, SPLIT_ADDR + i * 0x1000, &err) == 0x50 + i;
+    check(ok, "a region split in the batch keeps its contents");
+
+    // the regions unmapped in a batch left open are freed on close
+    uc_mem_batch_begin(uc);
+    for (i = 0; i < PAGES; i += 2)
+        uc_mem_unmap(uc, page_addr(i), 0x1000);
+    check(uc_close(uc) == UC_ERR_OK, "close with a batch open");
+
+    return failed;
+}
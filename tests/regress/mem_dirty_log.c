@@ -0,0 +1,143 @@
+/*
+Test for uc_mem_dirty_log_start(), uc_mem_dirty_log_get() and
+uc_mem_dirty_log_stop().
+
+The log must hold exactly the logged pages written by the guest or by
+uc_mem_write() since the logging started or was last cleared, across
+adjacent regions, and pages must be logged again after a clear even when
+their TLB entries were already writable.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x1000000
+#define DATA_PAGES 64
+#define OTHER_ADDR (DATA_ADDR + DATA_PAGES * 0x1000)
+#define OTHER_PAGES 16
+
+/*
+bits 32
+
+loop:
+    mov [ebx], eax
+    add ebx, edx
+    dec ecx
+    jnz loop
+*/
+static const unsigned char PROGRAM[] =
+    "\x89\x03\x01\xd3\x49\x75\xf9";
+#define END (CODE_ADDR + sizeof(PROGRAM) - 1)
+
+/* Write to the first word of @pages pages from @addr, @stride pages apart. */
+static int run(uc_engine *uc, uint32_t addr, uint32_t pages, uint32_t stride)
+{
+    uint32_t step = stride * 0x1000;
+
+    uc_reg_write(uc, UC_X86_REG_EBX, &addr);
+    uc_reg_write(uc, UC_X86_REG_ECX, &pages);
+    uc_reg_write(uc, UC_X86_REG_EDX, &step);
+    return uc_emu_start(uc, CODE_ADDR, END, 0, 0) == UC_ERR_OK;
+}
+
+/* The log of @pages pages from @addr has the bits of @want set, and no other. */
+static int log_is(uc_engine *uc, uint32_t addr, uint32_t pages, const uint8_t *want, int clear)
+{
+    uint8_t bitmap[(DATA_PAGES + OTHER_PAGES) / 8];
+
+    memset(bitmap, 0xaa, sizeof(bitmap));
+    if (uc_mem_dirty_log_get(uc, addr, pages * 0x1000, bitmap, clear) != UC_ERR_OK)
+        return 0;
+    return memcmp(bitmap, want, (pages + 7) / 8) == 0;
+}
+
+static void set_page(uint8_t *bitmap, uint32_t page)
+{
+    bitmap[page / 8] |= 1 << (page % 8);
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_snapshot *snap;
+    uint8_t want[(DATA_PAGES + OTHER_PAGES) / 8];
+    uint32_t i, value = 0x12345678;
+
+    printf("# log of the pages written in a range of memory\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+    uc_mem_map(uc, DATA_ADDR, DATA_PAGES * 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_map(uc, OTHER_ADDR, OTHER_PAGES * 0x1000, UC_PROT_ALL);
+    uc_reg_write(uc, UC_X86_REG_EAX, &value);
+
+    // writes before the logging starts are not in the log
+    check(run(uc, DATA_ADDR, DATA_PAGES, 1), "guest writes all the pages");
+    check(uc_mem_dirty_log_start(uc, DATA_ADDR, (DATA_PAGES + OTHER_PAGES) * 0x1000) == UC_ERR_OK,
+            "logging starts on two adjacent regions");
+    memset(want, 0, sizeof(want));
+    check(log_is(uc, DATA_ADDR, DATA_PAGES + OTHER_PAGES, want, 0), "the log starts empty");
+
+    // every third page, across the boundary of the regions
+    check(run(uc, DATA_ADDR + 0x1000, (DATA_PAGES + OTHER_PAGES + 1) / 3, 3), "guest writes every third page");
+    for (i = 1; i < DATA_PAGES + OTHER_PAGES; i += 3)
+        set_page(want, i);
+    check(log_is(uc, DATA_ADDR, DATA_PAGES + OTHER_PAGES, want, 0), "the log holds the written pages");
+    check(log_is(uc, DATA_ADDR, DATA_PAGES + OTHER_PAGES, want, 1), "fetching the log again gives the same pages");
+    memset(want, 0, sizeof(want));
+    check(log_is(uc, DATA_ADDR, DATA_PAGES + OTHER_PAGES, want, 0), "the log is empty after it was cleared");
+
+    // the TLB entries of these pages were writable before the clear
+    check(run(uc, DATA_ADDR + 0x1000, 2, 3), "guest writes two of these pages again");
+    set_page(want, 1);
+    set_page(want, 4);
+    check(log_is(uc, DATA_ADDR, DATA_PAGES + OTHER_PAGES, want, 1), "they are logged again after the clear");
+
+    // host writes, and a part of the range
+    value = 0xdeadbeef;
+    uc_mem_write(uc, OTHER_ADDR + 0x2000, &value, sizeof(value));
+    memset(want, 0, sizeof(want));
+    set_page(want, 2);
+    check(log_is(uc, OTHER_ADDR, OTHER_PAGES, want, 0), "uc_mem_write() is logged");
+    check(log_is(uc, OTHER_ADDR + 0x1000, 2, (const uint8_t *)"\x02", 1),
+            "the bits of a part start at its first page");
+
+    // stop logging the middle of the first region
+    check(uc_mem_dirty_log_stop(uc, DATA_ADDR + 16 * 0x1000, 16 * 0x1000) == UC_ERR_OK,
+            "logging stops on a part of the range");
+    check(run(uc, DATA_ADDR, DATA_PAGES, 1), "guest writes all the pages of the first region");
+    memset(want, 0, sizeof(want));
+    for (i = 0; i < DATA_PAGES; i++) {
+        if (i < 16 || i >= 32)
+            set_page(want, i);
+    }
+    check(log_is(uc, DATA_ADDR, DATA_PAGES + OTHER_PAGES, want, 1), "pages no longer logged are not reported");
+
+    // pages copied back by a snapshot were written
+    check(uc_snapshot_take(uc, &snap) == UC_ERR_OK, "take a snapshot");
+    check(run(uc, DATA_ADDR + 40 * 0x1000, 2, 1), "guest writes two pages");
+    memset(want, 0, sizeof(want));
+    set_page(want, 40);
+    set_page(want, 41);
+    check(log_is(uc, DATA_ADDR, DATA_PAGES + OTHER_PAGES, want, 1), "the log holds them");
+    check(uc_snapshot_restore(uc, snap) == UC_ERR_OK, "restore the snapshot");
+    check(log_is(uc, DATA_ADDR, DATA_PAGES + OTHER_PAGES, want, 1), "the pages the restore copied back are logged");
+    uc_snapshot_free(snap);
+
+    check(uc_mem_dirty_log_start(uc, DATA_ADDR + 0x800, 0x1000) == UC_ERR_ARG, "unaligned range is rejected");
+    check(uc_mem_dirty_log_start(uc, OTHER_ADDR, (OTHER_PAGES + 1) * 0x1000) == UC_ERR_NOMEM,
+            "range not entirely mapped is rejected");
+
+    uc_close(uc);
+
+    return failed;
+}
@@ -0,0 +1,135 @@
+/*
+Test for stopping emulation on memory accesses.
+
+Blocks only check for an exit request after their memory accesses when a
+memory hook or an MMIO callback may stop emulation. Invalid accesses must
+still stop on the faulting instruction, and hooks and MMIO callbacks must
+still stop right after the access, including with blocks translated before
+the hook was added.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x200000
+#define MMIO_ADDR 0x300000
+#define UNMAPPED_ADDR 0x400000
+
+/*
+bits 32
+
+    inc eax
+    inc eax
+    mov [ebx], ecx      ; at CODE_ADDR + 2
+    inc eax
+    inc eax
+*/
+static const unsigned char STORE[] = "\x40\x40\x89\x0b\x40\x40";
+
+/*
+bits 32
+
+    inc eax
+    inc eax
+    mov ecx, [ebx]      ; at CODE_ADDR + 2
+    inc eax
+    inc eax
+*/
+static const unsigned char LOAD[] = "\x40\x40\x8b\x0b\x40\x40";
+
+#define END (CODE_ADDR + 6)
+
+static uint32_t reg(uc_engine *uc, int regid)
+{
+    uint32_t v = 0;
+
+    uc_reg_read(uc, regid, &v);
+    return v;
+}
+
+/* Run @code from CODE_ADDR with eax = 0 and ebx = @addr. */
+static uc_err run(uc_engine *uc, const unsigned char *code, uint32_t addr, size_t count)
+{
+    uint32_t eax = 0;
+
+    uc_mem_write(uc, CODE_ADDR, code, 6);
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_write(uc, UC_X86_REG_EBX, &addr);
+    return uc_emu_start(uc, CODE_ADDR, END, 0, count);
+}
+
+static void hook_stop(uc_engine *uc, uc_mem_type type,
+        uint64_t address, int size, int64_t value, void *user_data)
+{
+    uc_emu_stop(uc);
+}
+
+static bool hook_map(uc_engine *uc, uc_mem_type type,
+        uint64_t address, int size, int64_t value, void *user_data)
+{
+    return uc_mem_map(uc, address & ~0xfffULL, 0x1000, UC_PROT_ALL) == UC_ERR_OK;
+}
+
+static uint64_t mmio_read(uc_engine *uc, uint64_t offset, unsigned size, void *user_data)
+{
+    uc_emu_stop(uc);
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_hook hh;
+
+    printf("# stop emulation on memory accesses\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA_ADDR, 0x1000, UC_PROT_READ);
+
+    check(run(uc, LOAD, DATA_ADDR, 0) == UC_ERR_OK && reg(uc, UC_X86_REG_EAX) == 4,
+            "run without faults");
+    check(run(uc, LOAD, UNMAPPED_ADDR, 0) == UC_ERR_READ_UNMAPPED &&
+            reg(uc, UC_X86_REG_EIP) == CODE_ADDR + 2 && reg(uc, UC_X86_REG_EAX) == 2,
+            "stop on the faulting load");
+    check(run(uc, STORE, DATA_ADDR, 0) == UC_ERR_WRITE_PROT &&
+            reg(uc, UC_X86_REG_EIP) == CODE_ADDR + 2 && reg(uc, UC_X86_REG_EAX) == 2,
+            "stop on the faulting store");
+    check(run(uc, STORE, UNMAPPED_ADDR, 10) == UC_ERR_WRITE_UNMAPPED &&
+            reg(uc, UC_X86_REG_EIP) == CODE_ADDR + 2 && reg(uc, UC_X86_REG_EAX) == 2,
+            "stop on the faulting store with an instruction count");
+
+    // the store block is cached without exit checks
+    uc_hook_add(uc, &hh, UC_HOOK_MEM_WRITE, hook_stop, NULL, 1, 0, 0);
+    uc_mem_protect(uc, DATA_ADDR, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    check(run(uc, STORE, DATA_ADDR, 0) == UC_ERR_OK && reg(uc, UC_X86_REG_EAX) == 2,
+            "memory hook added later stops after the access");
+    uc_hook_del(uc, hh);
+    check(run(uc, STORE, DATA_ADDR, 0) == UC_ERR_OK && reg(uc, UC_X86_REG_EAX) == 4,
+            "run again after deleting the hook");
+    uc_mem_protect(uc, DATA_ADDR, 0x1000, UC_PROT_READ);
+    check(run(uc, STORE, DATA_ADDR, 0) == UC_ERR_WRITE_PROT &&
+            reg(uc, UC_X86_REG_EIP) == CODE_ADDR + 2,
+            "stop on the faulting store after deleting the hook");
+    uc_mem_protect(uc, DATA_ADDR, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    check(run(uc, STORE, DATA_ADDR, 0) == UC_ERR_OK && reg(uc, UC_X86_REG_EAX) == 4,
+            "run the block again after the fault");
+
+    uc_hook_add(uc, &hh, UC_HOOK_MEM_READ_UNMAPPED, hook_map, NULL, 1, 0, 0);
+    check(run(uc, LOAD, UNMAPPED_ADDR, 0) == UC_ERR_OK && reg(uc, UC_X86_REG_EAX) == 4,
+            "unmapped access handled by a hook");
+    uc_hook_del(uc, hh);
+
+    uc_mmio_map(uc, MMIO_ADDR, 0x1000, mmio_read, NULL, NULL, NULL);
+    check(run(uc, LOAD, MMIO_ADDR, 0) == UC_ERR_OK && reg(uc, UC_X86_REG_EAX) == 2,
+            "MMIO callback stops after the access");
+
+    uc_close(uc);
+    return failed;
+}
@@ -0,0 +1,133 @@
+/*
+Test for uc_mem_get_ptr() and uc_mem_written().
+
+The host accesses guest RAM in place through the pointer uc_mem_get_ptr()
+returns, which covers the bytes asked for up to the end of their region.
+After uc_mem_written(), the guest runs the code written through the pointer,
+and snapshots and the dirty log see the pages written.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x200000
+#define NEXT_ADDR 0x203000
+#define PTR_ADDR 0x300000
+#define MMIO_ADDR 0x400000
+
+// mov eax, [ebx]
+static const unsigned char LOAD[] = "\x8b\x03";
+// mov eax, 0x11111111
+static const unsigned char SET[] = "\xb8\x11\x11\x11\x11";
+
+/* Run the code at @addr with ebx = @ebx; return eax. */
+static uint32_t run(uc_engine *uc, uint64_t addr, size_t len, uint32_t ebx, uc_err *err)
+{
+    uint32_t eax = 0;
+
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    *err = uc_emu_start(uc, addr, addr + len, 0, 0);
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    return eax;
+}
+
+static uint32_t word_at(uc_engine *uc, uint64_t addr)
+{
+    uint32_t value = 0;
+
+    uc_mem_read(uc, addr, &value, sizeof(value));
+    return value;
+}
+
+static uint64_t mmio_read(uc_engine *uc, uint64_t offset, unsigned size, void *user_data)
+{
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_snapshot *snap;
+    uc_err err;
+    uint8_t *ptr, *buf, bitmap;
+    void *p;
+    size_t len;
+    uint32_t value;
+
+    printf("# guest RAM accessed in place\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x2000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR + 0x1000, LOAD, sizeof(LOAD) - 1);
+    uc_mem_map(uc, DATA_ADDR, 0x3000, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_map(uc, NEXT_ADDR, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    buf = calloc(1, 0x1000);
+    uc_mem_map_ptr(uc, PTR_ADDR, 0x1000, UC_PROT_READ, buf);
+    uc_mmio_map(uc, MMIO_ADDR, 0x1000, mmio_read, NULL, NULL, NULL);
+
+    check(uc_mem_get_ptr(uc, DATA_ADDR + 0x10, 0x100, &p, &len) == UC_ERR_OK && len == 0x100,
+            "get a pointer to a range of bytes");
+    ptr = p;
+    value = 0x12345678;
+    memcpy(ptr, &value, sizeof(value));
+    check(word_at(uc, DATA_ADDR + 0x10) == value, "the host reads the bytes written through it");
+    check(run(uc, CODE_ADDR + 0x1000, sizeof(LOAD) - 1, DATA_ADDR + 0x10, &err) == value && err == UC_ERR_OK,
+            "and so does the guest");
+    value = 0x87654321;
+    uc_mem_write(uc, DATA_ADDR + 0x14, &value, sizeof(value));
+    check(memcmp(ptr + 4, &value, sizeof(value)) == 0, "the pointer sees uc_mem_write()");
+
+    check(uc_mem_get_ptr(uc, DATA_ADDR + 0x2000, 0x2000, &p, &len) == UC_ERR_OK && len == 0x1000
+            && (uint8_t *)p == ptr - 0x10 + 0x2000,
+            "a range across two regions stops at the end of the first");
+    check(uc_mem_get_ptr(uc, PTR_ADDR + 0x20, 0x1000, &p, &len) == UC_ERR_OK && len == 0xfe0 && p == buf + 0x20,
+            "the pointer to memory of uc_mem_map_ptr() is into its buffer");
+    check(uc_mem_get_ptr(uc, 0x900000, 0x10, &p, &len) == UC_ERR_READ_UNMAPPED, "unmapped memory has no pointer");
+    check(uc_mem_get_ptr(uc, MMIO_ADDR, 0x10, &p, &len) == UC_ERR_ARG, "nor has MMIO");
+    check(uc_mem_get_ptr(uc, DATA_ADDR, 0, &p, &len) == UC_ERR_ARG, "nor has an empty range");
+
+    // code patched in place
+    uc_mem_get_ptr(uc, CODE_ADDR, 0x1000, &p, &len);
+    ptr = p;
+    memcpy(ptr, SET, sizeof(SET) - 1);
+    check(uc_mem_written(uc, CODE_ADDR, sizeof(SET) - 1) == UC_ERR_OK, "tell code was written");
+    check(run(uc, CODE_ADDR, sizeof(SET) - 1, 0, &err) == 0x11111111 && err == UC_ERR_OK, "run it");
+    value = 0x22222222;
+    memcpy(ptr + 1, &value, sizeof(value));
+    uc_mem_written(uc, CODE_ADDR + 1, sizeof(value));
+    check(run(uc, CODE_ADDR, sizeof(SET) - 1, 0, &err) == value, "the code patched in place runs");
+
+    check(uc_mem_written(uc, DATA_ADDR + 0x2ff0, 0x1010) == UC_ERR_OK, "tell bytes across two regions were written");
+    check(uc_mem_written(uc, NEXT_ADDR + 0xff0, 0x20) == UC_ERR_WRITE_UNMAPPED, "but not bytes past them");
+
+    // pages written in place are tracked
+    uc_mem_get_ptr(uc, DATA_ADDR, 0x3000, &p, &len);
+    ptr = p;
+    check(uc_mem_dirty_log_start(uc, DATA_ADDR, 0x3000) == UC_ERR_OK, "log the writes to a region");
+    ptr[0x1100] = 0xaa;
+    uc_mem_written(uc, DATA_ADDR + 0x1100, 1);
+    check(uc_mem_dirty_log_get(uc, DATA_ADDR, 0x3000, &bitmap, true) == UC_ERR_OK && bitmap == 2,
+            "the page written in place is logged");
+    uc_mem_dirty_log_stop(uc, DATA_ADDR, 0x3000);
+
+    uc_snapshot_take(uc, &snap);
+    ptr[0x2200] = 0xbb;
+    uc_mem_written(uc, DATA_ADDR + 0x2200, 1);
+    uc_snapshot_restore(uc, snap);
+    check(ptr[0x2200] == 0 && ptr[0x1100] == 0xaa, "a snapshot restore undoes the write in place");
+    uc_snapshot_free(snap);
+
+    uc_close(uc);
+    free(buf);
+
+    return failed;
+}
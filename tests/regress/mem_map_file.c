@@ -0,0 +1,203 @@
+/*
+Test for uc_mem_map_file().
+
+A 1 GB sparse file is mapped in, of which a few pages are touched: only
+these pages are read in. Writes stay in the engine that made them, and never
+reach the file or the other engines mapping it. Clones map the file again:
+only the pages written are copied into them.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define IMAGE_ADDR 0x40000000U
+#define IMAGE_SIZE 0x40000000U
+#define SMALL_ADDR 0x10000000
+#define PART_ADDR 0x20000000
+
+// mov eax, [ebx]
+static const unsigned char LOAD[] = "\x8b\x03";
+// mov [ebx], eax
+static const unsigned char STORE[] = "\x89\x03";
+
+/* Run the code at @addr with eax = @eax and ebx = @ebx; return eax. */
+static uint32_t run(uc_engine *uc, uint64_t addr, size_t len, uint32_t eax, uint32_t ebx, uc_err *err)
+{
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    *err = uc_emu_start(uc, addr, addr + len, 0, 0);
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    return eax;
+}
+
+static uint32_t word_at(uc_engine *uc, uint64_t addr)
+{
+    uint32_t value = 0xdeadbeef;
+
+    uc_mem_read(uc, addr, &value, sizeof(value));
+    return value;
+}
+
+static uint32_t file_word_at(int fd, off_t offset)
+{
+    uint32_t value = 0xdeadbeef;
+
+    if (pread(fd, &value, sizeof(value), offset) != sizeof(value))
+        return 0xdeadbeef;
+    return value;
+}
+
+static void file_write(int fd, off_t offset, uint32_t value)
+{
+    if (pwrite(fd, &value, sizeof(value), offset) != sizeof(value))
+        printf("# pwrite() failed\n");
+}
+
+/* Return the resident memory of the process in KB, or 0 if unknown. */
+static long resident_kb(void)
+{
+    FILE *f = fopen("/proc/self/statm", "r");
+    long size = 0, resident = 0;
+
+    if (f == NULL)
+        return 0;
+    if (fscanf(f, "%ld %ld", &size, &resident) != 2)
+        resident = 0;
+    fclose(f);
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static uc_engine *open_engine(void)
+{
+    uc_engine *uc;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        exit(1);
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, LOAD, sizeof(LOAD) - 1);
+    uc_mem_write(uc, CODE_ADDR + 0x10, STORE, sizeof(STORE) - 1);
+
+    return uc;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    char path[] = "/tmp/uc_mem_map_file_XXXXXX";
+    uc_engine *uc, *other, *clone;
+    uc_err err;
+    long resident;
+    int fd;
+
+    printf("# guest memory mapped from a file\n");
+
+    fd = mkstemp(path);
+    if (fd < 0 || ftruncate(fd, IMAGE_SIZE) != 0) {
+        printf("not ok %d - cannot create a sparse file\n", log_num++);
+        return 1;
+    }
+    unlink(path);
+    file_write(fd, 0, 0x11111111);
+    file_write(fd, IMAGE_SIZE / 2, 0x22222222);
+    file_write(fd, IMAGE_SIZE - 4, 0x33333333);
+
+    uc = open_engine();
+    resident = resident_kb();
+    check(uc_mem_map_file(uc, IMAGE_ADDR, IMAGE_SIZE, UC_PROT_READ | UC_PROT_WRITE, fd, 0) == UC_ERR_OK,
+            "map a 1 GB sparse file");
+    check(word_at(uc, IMAGE_ADDR) == 0x11111111 && word_at(uc, IMAGE_ADDR + IMAGE_SIZE / 2) == 0x22222222,
+            "the host reads it");
+    check(run(uc, CODE_ADDR, sizeof(LOAD) - 1, 0, IMAGE_ADDR + IMAGE_SIZE - 4, &err) == 0x33333333 && err == UC_ERR_OK,
+            "and so does the guest");
+    check(word_at(uc, IMAGE_ADDR + 0x12345000) == 0, "a hole reads as zeros");
+    check(resident == 0 || resident_kb() - resident < 64 * 1024, "only the pages touched are read in");
+
+    run(uc, CODE_ADDR + 0x10, sizeof(STORE) - 1, 0x44444444, IMAGE_ADDR, &err);
+    check(err == UC_ERR_OK && word_at(uc, IMAGE_ADDR) == 0x44444444, "the guest writes a page");
+    check(file_word_at(fd, 0) == 0x11111111, "the write does not reach the file");
+
+    other = open_engine();
+    check(uc_mem_map_file(other, IMAGE_ADDR, IMAGE_SIZE, UC_PROT_READ, fd, 0) == UC_ERR_OK
+            && word_at(other, IMAGE_ADDR) == 0x11111111,
+            "nor another engine mapping the file");
+    run(other, CODE_ADDR + 0x10, sizeof(STORE) - 1, 0x55555555, IMAGE_ADDR + 0x1000, &err);
+    check(err == UC_ERR_WRITE_PROT, "which maps it read-only");
+    uc_close(other);
+
+    // offsets in the file, and memory past its end
+    check(uc_mem_map_file(uc, PART_ADDR, 0x4000, UC_PROT_READ, fd, IMAGE_SIZE / 2) == UC_ERR_OK
+            && word_at(uc, PART_ADDR) == 0x22222222,
+            "map a range of the file");
+    check(uc_mem_map_file(uc, SMALL_ADDR, 0x4000, UC_PROT_READ, fd, IMAGE_SIZE - 0x1000) == UC_ERR_OK
+            && word_at(uc, SMALL_ADDR + 0xffc) == 0x33333333,
+            "map the end of the file");
+    check(word_at(uc, SMALL_ADDR + 0x1000) == 0 && word_at(uc, SMALL_ADDR + 0x3ffc) == 0,
+            "the memory past it reads as zeros");
+    check(run(uc, CODE_ADDR, sizeof(LOAD) - 1, 0, SMALL_ADDR + 0x2000, &err) == 0 && err == UC_ERR_OK,
+            "for the guest too");
+
+    check(uc_mem_map_file(uc, 0x30000000, 0x1000, UC_PROT_READ, fd, 0x10) == UC_ERR_ARG,
+            "an offset not aligned to a page fails");
+    check(uc_mem_map_file(uc, 0x30000000, 0x1000, UC_PROT_READ, -1, 0) == UC_ERR_ARG, "so does a bad file");
+    check(uc_mem_map_file(uc, IMAGE_ADDR + 0x1000, 0x1000, UC_PROT_READ, fd, 0) == UC_ERR_MAP,
+            "and mapping over a region");
+
+    // the file may be closed once mapped
+    close(fd);
+
+    // clones
+    resident = resident_kb();
+    check(uc_clone(uc, &clone) == UC_ERR_OK, "clone the engine");
+    check(word_at(clone, IMAGE_ADDR) == 0x44444444 && word_at(clone, IMAGE_ADDR + IMAGE_SIZE / 2) == 0x22222222
+            && word_at(clone, SMALL_ADDR + 0xffc) == 0x33333333,
+            "the clone has the pages written and those of the file");
+    check(resident == 0 || resident_kb() - resident < 64 * 1024, "without copying the whole file");
+    run(clone, CODE_ADDR + 0x10, sizeof(STORE) - 1, 0x77777777, IMAGE_ADDR + 0x1000, &err);
+    check(err == UC_ERR_OK && word_at(clone, IMAGE_ADDR + 0x1000) == 0x77777777
+            && word_at(uc, IMAGE_ADDR + 0x1000) == 0,
+            "the writes of the clone stay in it");
+    uc_close(clone);
+    run(uc, CODE_ADDR + 0x10, sizeof(STORE) - 1, 0x88888888, IMAGE_ADDR + 0x2000, &err);
+    check(uc_clone(uc, &clone) == UC_ERR_OK && word_at(clone, IMAGE_ADDR + 0x1000) == 0
+            && word_at(clone, IMAGE_ADDR + 0x2000) == 0x88888888,
+            "a clone handed out again undoes its writes and sees those of the engine");
+    uc_close(clone);
+
+    // partial unmap, protection
+    check(uc_mem_unmap(uc, IMAGE_ADDR + 0x100000, 0x100000) == UC_ERR_OK, "unmap part of the region");
+    check(word_at(uc, IMAGE_ADDR) == 0x44444444 && word_at(uc, IMAGE_ADDR + IMAGE_SIZE / 2) == 0x22222222,
+            "the rest keeps its contents");
+    check(uc_clone(uc, &clone) == UC_ERR_OK && word_at(clone, IMAGE_ADDR) == 0x44444444
+            && word_at(clone, IMAGE_ADDR + 0x2000) == 0x88888888
+            && word_at(clone, IMAGE_ADDR + IMAGE_SIZE / 2) == 0x22222222,
+            "and so has a clone");
+    uc_close(clone);
+    run(uc, CODE_ADDR, sizeof(LOAD) - 1, 0, IMAGE_ADDR + 0x100000, &err);
+    check(err == UC_ERR_READ_UNMAPPED, "the guest faults on the part unmapped");
+    check(uc_mem_protect(uc, IMAGE_ADDR + 0x200000, 0x1000, UC_PROT_READ) == UC_ERR_OK, "protect a page");
+    run(uc, CODE_ADDR + 0x10, sizeof(STORE) - 1, 0x66666666, IMAGE_ADDR + 0x200000, &err);
+    check(err == UC_ERR_WRITE_PROT, "the guest cannot write it");
+
+    check(uc_mem_unmap(uc, PART_ADDR, 0x4000) == UC_ERR_OK, "unmap a whole region");
+    uc_mem_batch_begin(uc);
+    check(uc_mem_unmap(uc, IMAGE_ADDR, 0x100000) == UC_ERR_OK
+            && uc_mem_unmap(uc, IMAGE_ADDR + 0x200000, IMAGE_SIZE - 0x200000) == UC_ERR_OK,
+            "unmap the rest in a batch");
+    check(uc_mem_batch_commit(uc) == UC_ERR_OK, "commit it");
+    check(uc_mem_map(uc, IMAGE_ADDR, 0x1000, UC_PROT_READ | UC_PROT_WRITE) == UC_ERR_OK
+            && word_at(uc, IMAGE_ADDR) == 0,
+            "map new memory in its place");
+
+    check(uc_close(uc) == UC_ERR_OK, "close with a file mapped");
+
+    return failed;
+}
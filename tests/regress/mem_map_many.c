@@ -0,0 +1,212 @@
+/*
+Test for the placement and lookup of the RAM blocks of many regions.
+
+Unmapping a region gives its RAM offsets back, and the regions mapped next
+are placed in the gaps. Their contents must stay apart, code translated
+from a region must not survive into the one that reuses its offsets, and
+the blocks of uc_mem_map_ptr() must be found from host pointers even when
+their host memory overlaps. There may be more regions than a page has
+bytes, except for MMIO, which fails past that.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define OTHER_CODE_ADDR 0x180000
+#define DATA_ADDR 0x1000000
+#define PAIR_ADDR 0x8000000
+#define PTR_ADDR 0x9000000
+#define ALIAS_ADDR 0x9100000
+#define MANY_ADDR 0x10000000
+#define MMIO_ADDR 0x40000000
+#define PAGES 1000
+#define MANY_PAGES 10000
+
+/*
+bits 32
+
+loop:
+    inc dword [ebx]
+    add ebx, edx
+    dec ecx
+    jnz loop
+*/
+static const unsigned char PROGRAM[] = "\xff\x03\x01\xd3\x49\x75\xf9";
+
+// mov eax, 0x11111111 / mov eax, 0x22222222
+static const unsigned char SET_1[] = "\xb8\x11\x11\x11\x11";
+static const unsigned char SET_2[] = "\xb8\x22\x22\x22\x22";
+// mov eax, [ebx]
+static const unsigned char LOAD[] = "\x8b\x03";
+
+static uint32_t page_addr(uint32_t i)
+{
+    return DATA_ADDR + i * 0x2000;
+}
+
+static uint32_t word_at(uc_engine *uc, uint64_t addr)
+{
+    uint32_t value = 0xffffffff;
+
+    uc_mem_read(uc, addr, &value, sizeof(value));
+    return value;
+}
+
+/* Run the code at @addr, and return eax. */
+static uint32_t run_set(uc_engine *uc, uint64_t addr)
+{
+    uint32_t eax = 0;
+
+    if (uc_emu_start(uc, addr, addr + sizeof(SET_1) - 1, 0, 0) != UC_ERR_OK)
+        return 0;
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    return eax;
+}
+
+static uint64_t mmio_read(uc_engine *uc, uint64_t offset, unsigned size, void *user_data)
+{
+    return offset;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_mem_region *regions;
+    uint32_t count, i, ok, value, ebx, ecx, edx;
+    size_t page_size;
+    uc_err err;
+    uint8_t *buf;
+
+    printf("# RAM blocks of many regions\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+    uc_mem_write(uc, CODE_ADDR + 0x10, LOAD, sizeof(LOAD) - 1);
+
+    ok = 1;
+    for (i = 0; i < PAGES; i++) {
+        ok &= uc_mem_map(uc, page_addr(i), 0x1000, UC_PROT_READ | UC_PROT_WRITE) == UC_ERR_OK;
+        ok &= uc_mem_write(uc, page_addr(i), &i, sizeof(i)) == UC_ERR_OK;
+    }
+    check(ok, "map and fill many pages apart");
+
+    // every fourth page leaves a gap of one page, pages 4n + 2 and 4n + 3
+    // leave a gap of two pages
+    ok = 1;
+    for (i = 0; i < PAGES; i += 4) {
+        ok &= uc_mem_unmap(uc, page_addr(i), 0x1000) == UC_ERR_OK;
+        ok &= uc_mem_unmap(uc, page_addr(i + 2), 0x1000) == UC_ERR_OK;
+        ok &= uc_mem_unmap(uc, page_addr(i + 3), 0x1000) == UC_ERR_OK;
+    }
+    check(ok, "unmap three pages out of four");
+
+    ok = 1;
+    for (i = 0; i < PAGES; i += 4) {
+        value = 0x10000 + i;
+        ok &= uc_mem_map(uc, PAIR_ADDR + i * 0x1000, 0x2000, UC_PROT_READ | UC_PROT_WRITE) == UC_ERR_OK;
+        ok &= uc_mem_write(uc, PAIR_ADDR + i * 0x1000 + 0x1000, &value, sizeof(value)) == UC_ERR_OK;
+        ok &= uc_mem_map(uc, page_addr(i), 0x1000, UC_PROT_READ | UC_PROT_WRITE) == UC_ERR_OK;
+        ok &= uc_mem_write(uc, page_addr(i), &value, sizeof(value)) == UC_ERR_OK;
+    }
+    check(ok, "map pages and pairs of pages into the gaps");
+
+    ok = 1;
+    for (i = 0; i < PAGES; i++) {
+        if (i % 4 == 0)
+            ok &= word_at(uc, page_addr(i)) == 0x10000 + i && word_at(uc, PAIR_ADDR + i * 0x1000 + 0x1000) == 0x10000 + i
+                && word_at(uc, PAIR_ADDR + i * 0x1000) == 0;
+        else if (i % 4 == 1)
+            ok &= word_at(uc, page_addr(i)) == i;
+    }
+    check(ok, "every region holds its own contents");
+
+    // the guest goes through the TLB to the blocks of all the regions
+    ebx = page_addr(1);
+    ecx = PAGES / 4;
+    edx = 4 * 0x2000;
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    uc_reg_write(uc, UC_X86_REG_ECX, &ecx);
+    uc_reg_write(uc, UC_X86_REG_EDX, &edx);
+    check(uc_emu_start(uc, CODE_ADDR, CODE_ADDR + sizeof(PROGRAM) - 1, 0, 0) == UC_ERR_OK,
+            "guest increments a word in the pages that stayed mapped");
+    ok = 1;
+    for (i = 1; i < PAGES; i += 4)
+        ok &= word_at(uc, page_addr(i)) == i + 1;
+    check(ok, "the increments land in the right pages");
+
+    uc_mem_regions(uc, &regions, &count);
+    uc_free(regions);
+    check(count == 1 + PAGES / 4 * 3, "uc_mem_regions() lists every region");
+
+    // a region reusing the RAM offsets of code must not run the old code
+    uc_mem_map(uc, OTHER_CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, OTHER_CODE_ADDR, SET_1, sizeof(SET_1) - 1);
+    check(run_set(uc, OTHER_CODE_ADDR) == 0x11111111, "run code from a page");
+    uc_mem_unmap(uc, OTHER_CODE_ADDR, 0x1000);
+    uc_mem_map(uc, OTHER_CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, OTHER_CODE_ADDR, SET_2, sizeof(SET_2) - 1);
+    check(run_set(uc, OTHER_CODE_ADDR) == 0x22222222, "the page mapped in its place runs its own code");
+
+    // the block holding the third page of the buffer starts below the
+    // block of its second page
+    buf = calloc(1, 0x3000);
+    memcpy(buf + 0x2000, SET_1, sizeof(SET_1) - 1);
+    check(uc_mem_map_ptr(uc, PTR_ADDR, 0x3000, UC_PROT_ALL, buf) == UC_ERR_OK
+            && uc_mem_map_ptr(uc, ALIAS_ADDR, 0x1000, UC_PROT_ALL, buf + 0x1000) == UC_ERR_OK,
+            "map a buffer, and the middle of it again");
+    check(run_set(uc, PTR_ADDR + 0x2000) == 0x11111111, "run code from the end of the buffer");
+    value = 0x5a5a5a5a;
+    uc_mem_write(uc, ALIAS_ADDR, &value, sizeof(value));
+    check(word_at(uc, PTR_ADDR + 0x1000) == value, "both mappings share the buffer");
+
+    // splitting a region of uc_mem_map_ptr() keeps it on the buffer
+    check(uc_mem_protect(uc, PTR_ADDR, 0x1000, UC_PROT_READ) == UC_ERR_OK, "protect the first page of the buffer");
+    value = 0xa5a5a5a5;
+    memcpy(buf, &value, sizeof(value));
+    memcpy(buf + 0x2000, SET_2, sizeof(SET_2) - 1);
+    uc_mem_unmap(uc, PTR_ADDR + 0x2000, 0x1000);
+    uc_mem_map_ptr(uc, PTR_ADDR + 0x2000, 0x1000, UC_PROT_ALL, buf + 0x2000);
+    check(word_at(uc, PTR_ADDR) == value && run_set(uc, PTR_ADDR + 0x2000) == 0x22222222,
+            "the pieces still map the buffer");
+
+    // more regions than the numbers of their sections fit in a page
+    uc_mem_batch_begin(uc);
+    ok = 1;
+    for (i = 0; i < MANY_PAGES; i++)
+        ok &= uc_mem_map(uc, MANY_ADDR + i * 0x2000, 0x1000, UC_PROT_READ | UC_PROT_WRITE) == UC_ERR_OK;
+    ok &= uc_mem_batch_commit(uc) == UC_ERR_OK;
+    check(ok, "map many more pages in a batch");
+    ebx = MANY_ADDR + (MANY_PAGES - 1) * 0x2000;
+    ecx = 1;
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    uc_reg_write(uc, UC_X86_REG_ECX, &ecx);
+    check(uc_emu_start(uc, CODE_ADDR, CODE_ADDR + sizeof(PROGRAM) - 1, 0, 0) == UC_ERR_OK
+            && word_at(uc, ebx) == 1,
+            "the guest increments a word in the last one");
+
+    uc_query(uc, UC_QUERY_PAGE_SIZE, &page_size);
+    uc_mem_batch_begin(uc);
+    for (i = 0; (err = uc_mmio_map(uc, MMIO_ADDR + i * 0x2000, 0x1000, mmio_read, NULL, NULL, NULL)) == UC_ERR_OK; i++)
+        ;
+    uc_mem_batch_commit(uc);
+    check(err == UC_ERR_NOMEM && i > page_size / 2 && i < page_size, "MMIO fails short of the page size");
+    ebx = MMIO_ADDR + (i - 1) * 0x2000 + 0x40;
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    uc_emu_start(uc, CODE_ADDR + 0x10, CODE_ADDR + 0x10 + sizeof(LOAD) - 1, 0, 0);
+    uc_reg_read(uc, UC_X86_REG_EAX, &value);
+    check(value == 0x40, "the guest reads the last MMIO region mapped");
+
+    uc_close(uc);
+    free(buf);
+
+    return failed;
+}
@@ -0,0 +1,98 @@
+/*
+Test for permission changes on pages already in the TLB.
+
+The interpreter reads and writes guest RAM directly on a TLB hit, so the
+TLB must never hold an entry the region permissions do not allow: removing
+UC_PROT_READ or UC_PROT_WRITE from a page that was just accessed has to
+fault on the next access, and memory hooks added later must still fire.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x200000
+
+/*
+bits 32
+
+    mov eax, [ebx]
+    mov [ebx+4], eax
+*/
+static const unsigned char PROGRAM[] = "\x8b\x03\x89\x43\x04";
+#define LOAD_END (CODE_ADDR + 2)
+#define STORE_END (CODE_ADDR + sizeof(PROGRAM) - 1)
+
+static int hook_calls;
+
+static void hook_mem(uc_engine *uc, uc_mem_type type,
+        uint64_t address, int size, int64_t value, void *user_data)
+{
+    hook_calls++;
+}
+
+static bool hook_allow(uc_engine *uc, uc_mem_type type,
+        uint64_t address, int size, int64_t value, void *user_data)
+{
+    hook_calls++;
+    return true;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_hook hh;
+    uint32_t value = 0x12345678, ebx = DATA_ADDR, eax;
+
+    printf("# permission changes on cached pages\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_READ | UC_PROT_EXEC);
+    uc_mem_map(uc, DATA_ADDR, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+    uc_mem_write(uc, DATA_ADDR, &value, sizeof(value));
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+
+    check(uc_emu_start(uc, CODE_ADDR, STORE_END, 0, 0) == UC_ERR_OK,
+            "load and store on a readable and writable page");
+
+    hook_calls = 0;
+    uc_hook_add(uc, &hh, UC_HOOK_MEM_READ | UC_HOOK_MEM_WRITE, hook_mem, NULL, 1, 0, 0);
+    uc_emu_start(uc, CODE_ADDR, STORE_END, 0, 0);
+    uc_hook_del(uc, hh);
+    check(hook_calls == 2, "memory hooks added later see both accesses");
+
+    uc_mem_protect(uc, DATA_ADDR, 0x1000, UC_PROT_WRITE);
+    check(uc_emu_start(uc, CODE_ADDR, LOAD_END, 0, 0) == UC_ERR_READ_PROT,
+            "load faults once UC_PROT_READ is removed");
+
+    hook_calls = 0;
+    eax = 0;
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_hook_add(uc, &hh, UC_HOOK_MEM_READ_PROT, hook_allow, NULL, 1, 0, 0);
+    check(uc_emu_start(uc, CODE_ADDR, LOAD_END, 0, 0) == UC_ERR_OK,
+            "load allowed by a UC_HOOK_MEM_READ_PROT callback");
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    uc_hook_del(uc, hh);
+    check(hook_calls == 1 && eax == value, "allowed load returns the page content");
+
+    check(uc_emu_start(uc, CODE_ADDR + 2, STORE_END, 0, 0) == UC_ERR_OK,
+            "store on a write-only page");
+    check(uc_emu_start(uc, CODE_ADDR, LOAD_END, 0, 0) == UC_ERR_READ_PROT,
+            "load after a store on a write-only page still faults");
+
+    uc_mem_protect(uc, DATA_ADDR, 0x1000, UC_PROT_READ);
+    check(uc_emu_start(uc, CODE_ADDR, LOAD_END, 0, 0) == UC_ERR_OK,
+            "load on a read-only page");
+    check(uc_emu_start(uc, CODE_ADDR + 2, STORE_END, 0, 0) == UC_ERR_WRITE_PROT,
+            "store faults once UC_PROT_WRITE is removed");
+
+    uc_close(uc);
+    return failed;
+}
@@ -0,0 +1,238 @@
+/*
+Test for uc_mem_protect() on single pages of a region.
+
+The pages of a region keep their own permissions: protecting a few pages of
+a large region neither splits it nor copies it, and the guest must fault on
+exactly the pages it may not access, even code already run from a page that
+only loses UC_PROT_EXEC. The permissions of the pages must survive a partial
+unmap, a snapshot restore and a clone.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x1000000
+#define DATA_PAGES 256
+#define JIT_ADDR 0x2000000
+#define PTR_ADDR 0x3000000
+
+// mov eax, [ebx]
+static const unsigned char LOAD[] = "\x8b\x03";
+// mov [ebx], eax
+static const unsigned char STORE[] = "\x89\x03";
+// mov eax, 0x11111111
+static const unsigned char SET[] = "\xb8\x11\x11\x11\x11";
+
+static uint64_t page(uint32_t i)
+{
+    return DATA_ADDR + i * 0x1000ULL;
+}
+
+/* Run the code at @addr with eax = @eax and ebx = @ebx; return eax. */
+static uint32_t run(uc_engine *uc, uint64_t addr, size_t len, uint32_t eax, uint32_t ebx, uc_err *err)
+{
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    *err = uc_emu_start(uc, addr, addr + len, 0, 0);
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    return eax;
+}
+
+static uc_err load(uc_engine *uc, uint64_t addr)
+{
+    uc_err err;
+
+    run(uc, CODE_ADDR, sizeof(LOAD) - 1, 0, (uint32_t)addr, &err);
+    return err;
+}
+
+static uc_err store(uc_engine *uc, uint64_t addr, uint32_t value)
+{
+    uc_err err;
+
+    run(uc, CODE_ADDR + 0x10, sizeof(STORE) - 1, value, (uint32_t)addr, &err);
+    return err;
+}
+
+static uint32_t word_at(uc_engine *uc, uint64_t addr)
+{
+    uint32_t value = 0;
+
+    uc_mem_read(uc, addr, &value, sizeof(value));
+    return value;
+}
+
+static uint64_t mmio_read(uc_engine *uc, uint64_t offset, unsigned size, void *user_data)
+{
+    return 0;
+}
+
+static void mmio_write(uc_engine *uc, uint64_t offset, unsigned size, uint64_t value, void *user_data)
+{
+}
+
+/* Return the number of regions, and the permissions of the one at @addr. */
+static uint32_t regions_at(uc_engine *uc, uint64_t addr, uint64_t *begin, uint64_t *end, uint32_t *perms)
+{
+    uc_mem_region *regions;
+    uint32_t count, i;
+
+    uc_mem_regions(uc, &regions, &count);
+    for (i = 0; i < count; i++) {
+        if (regions[i].begin <= addr && addr <= regions[i].end) {
+            *begin = regions[i].begin;
+            *end = regions[i].end;
+            *perms = regions[i].perms;
+        }
+    }
+    uc_free(regions);
+
+    return count;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc, *clone;
+    uc_snapshot *snap;
+    uc_err err;
+    uint64_t begin = 0, end = 0;
+    uint32_t perms = 0, i, ok;
+    uint8_t *buf;
+
+    printf("# permissions of single pages\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, LOAD, sizeof(LOAD) - 1);
+    uc_mem_write(uc, CODE_ADDR + 0x10, STORE, sizeof(STORE) - 1);
+    uc_mem_map(uc, DATA_ADDR, DATA_PAGES * 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    for (i = 0; i < DATA_PAGES; i++)
+        uc_mem_write(uc, page(i), &i, sizeof(i));
+
+    check(uc_mem_protect(uc, page(5), 0x1000, UC_PROT_READ) == UC_ERR_OK, "protect a page of a region read-only");
+    check(regions_at(uc, page(5), &begin, &end, &perms) == 4
+            && begin == page(5) && end == page(6) - 1 && perms == UC_PROT_READ,
+            "uc_mem_regions() lists it apart");
+    regions_at(uc, page(6), &begin, &end, &perms);
+    check(begin == page(6) && end == page(DATA_PAGES) - 1 && perms == (UC_PROT_READ | UC_PROT_WRITE),
+            "and the pages after it");
+
+    check(store(uc, page(5), 0x55555555) == UC_ERR_WRITE_PROT && word_at(uc, page(5)) == 5,
+            "the guest cannot write the page");
+    check(store(uc, page(4) + 0xffc, 0x44444444) == UC_ERR_OK && word_at(uc, page(4) + 0xffc) == 0x44444444,
+            "but writes the page before it");
+    check(store(uc, page(6), 0x66666666) == UC_ERR_OK && word_at(uc, page(6)) == 0x66666666,
+            "and the page after it");
+    check(load(uc, page(5)) == UC_ERR_OK, "and reads the page");
+
+    uc_mem_protect(uc, page(7), 0x1000, UC_PROT_NONE);
+    check(load(uc, page(7)) == UC_ERR_READ_PROT, "the guest cannot read a page without permissions");
+    check(load(uc, page(8)) == UC_ERR_OK, "but reads the page after it");
+
+    // the TLB entries of the page are dropped
+    check(load(uc, page(9)) == UC_ERR_OK, "the guest reads a page");
+    uc_mem_protect(uc, page(9), 0x1000, UC_PROT_WRITE);
+    check(load(uc, page(9)) == UC_ERR_READ_PROT, "and faults once it is not readable");
+
+    uc_mem_protect(uc, page(5), 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    check(store(uc, page(5), 0x55555555) == UC_ERR_OK && word_at(uc, page(5)) == 0x55555555,
+            "the guest writes the page made writable again");
+    uc_mem_protect(uc, page(7), 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_protect(uc, page(9), 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    check(regions_at(uc, page(5), &begin, &end, &perms) == 2 && begin == DATA_ADDR && end == page(DATA_PAGES) - 1,
+            "the pages alike are listed as one region again");
+
+    // code written and then run by a JIT, W^X
+    uc_mem_map(uc, JIT_ADDR, 0x10000, UC_PROT_READ | UC_PROT_WRITE);
+    ok = 1;
+    for (i = 0; i < 8; i++) {
+        ok &= uc_mem_write(uc, JIT_ADDR + 0x3000, SET, sizeof(SET) - 1) == UC_ERR_OK;
+        ok &= uc_mem_protect(uc, JIT_ADDR + 0x3000, 0x1000, UC_PROT_READ | UC_PROT_EXEC) == UC_ERR_OK;
+        ok &= run(uc, JIT_ADDR + 0x3000, sizeof(SET) - 1, 0, 0, &err) == 0x11111111 && err == UC_ERR_OK;
+        ok &= uc_mem_protect(uc, JIT_ADDR + 0x3000, 0x1000, UC_PROT_READ | UC_PROT_WRITE) == UC_ERR_OK;
+        run(uc, JIT_ADDR + 0x3000, sizeof(SET) - 1, 0, 0, &err);
+        ok &= err == UC_ERR_FETCH_PROT;
+    }
+    check(ok, "flip a page between writable and executable");
+    check(store(uc, JIT_ADDR + 0x3000, 0x90909090) == UC_ERR_OK, "the guest writes it when writable");
+    run(uc, JIT_ADDR + 0x2000, sizeof(SET) - 1, 0, 0, &err);
+    check(err == UC_ERR_FETCH_PROT, "the pages around it are not executable");
+
+    // code already run on a page that only loses UC_PROT_EXEC
+    uc_mem_protect(uc, JIT_ADDR, 0x2000, UC_PROT_ALL);
+    uc_mem_write(uc, JIT_ADDR, SET, sizeof(SET) - 1);
+    check(run(uc, JIT_ADDR, sizeof(SET) - 1, 0, 0, &err) == 0x11111111 && err == UC_ERR_OK,
+            "the guest runs code on a page");
+    uc_mem_protect(uc, JIT_ADDR, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    run(uc, JIT_ADDR, sizeof(SET) - 1, 0, 0, &err);
+    check(err == UC_ERR_FETCH_PROT, "and faults once the page is not executable");
+
+    // unmapping part of a region keeps the permissions of the rest
+    uc_mem_protect(uc, page(20), 0x1000, UC_PROT_READ);
+    uc_mem_protect(uc, page(30), 0x1000, UC_PROT_READ);
+    check(uc_mem_unmap(uc, page(25), 0x2000) == UC_ERR_OK, "unmap pages in the middle of the region");
+    check(store(uc, page(20), 0) == UC_ERR_WRITE_PROT && store(uc, page(30), 0) == UC_ERR_WRITE_PROT,
+            "the pages on both sides stay read-only");
+    check(store(uc, page(21), 0x21212121) == UC_ERR_OK && store(uc, page(31), 0x31313131) == UC_ERR_OK,
+            "and their neighbours writable");
+    check(word_at(uc, page(20)) == 20 && word_at(uc, page(30)) == 30, "with their contents");
+
+    // snapshots
+    uc_snapshot_take(uc, &snap);
+    uc_mem_protect(uc, page(40), 0x1000, UC_PROT_READ);
+    uc_mem_protect(uc, page(30), 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    check(uc_snapshot_restore(uc, snap) == UC_ERR_OK, "restore a snapshot");
+    check(store(uc, page(40), 0x40404040) == UC_ERR_OK, "a page protected since is writable again");
+    check(store(uc, page(30), 0) == UC_ERR_WRITE_PROT, "a page unprotected since is read-only again");
+    uc_mem_protect(uc, page(26) + 0x1000, (DATA_PAGES - 27) * 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    uc_snapshot_restore(uc, snap);
+    check(store(uc, page(30), 0) == UC_ERR_WRITE_PROT && store(uc, page(31), 0x31313131) == UC_ERR_OK,
+            "after the whole region was unprotected too");
+    uc_snapshot_free(snap);
+
+    // clones
+    check(uc_clone(uc, &clone) == UC_ERR_OK, "clone the engine");
+    check(store(clone, page(20), 0) == UC_ERR_WRITE_PROT && store(clone, page(21), 0x21212121) == UC_ERR_OK,
+            "the clone has the permissions of the pages");
+    uc_close(clone);
+
+    // protect in a batch
+    uc_mem_batch_begin(uc);
+    uc_mem_protect(uc, page(50), 0x1000, UC_PROT_READ);
+    uc_mem_batch_commit(uc);
+    check(store(uc, page(50), 0) == UC_ERR_WRITE_PROT && store(uc, page(51), 0) == UC_ERR_OK,
+            "protect a page in a batch");
+
+    // a range that ends inside an MMIO region changes nothing
+    uc_mmio_map(uc, page(DATA_PAGES), 0x2000, mmio_read, NULL, mmio_write, NULL);
+    check(store(uc, page(DATA_PAGES - 1), 0) == UC_ERR_OK, "the guest writes the page before an MMIO region");
+    check(uc_mem_protect(uc, page(DATA_PAGES - 1), 0x2000, UC_PROT_READ) == UC_ERR_NOMEM,
+            "protecting it and half of the MMIO region fails");
+    regions_at(uc, page(DATA_PAGES - 1), &begin, &end, &perms);
+    check(perms == (UC_PROT_READ | UC_PROT_WRITE), "the page keeps its permissions");
+    check(store(uc, page(DATA_PAGES - 1), 0x12345678) == UC_ERR_OK && word_at(uc, page(DATA_PAGES - 1)) == 0x12345678,
+            "and stays writable");
+    uc_mem_unmap(uc, page(DATA_PAGES), 0x2000);
+
+    // memory of the host
+    buf = calloc(1, 0x4000);
+    uc_mem_map_ptr(uc, PTR_ADDR, 0x4000, UC_PROT_READ | UC_PROT_WRITE, buf);
+    uc_mem_protect(uc, PTR_ADDR + 0x1000, 0x1000, UC_PROT_READ);
+    check(store(uc, PTR_ADDR + 0x1000, 0x12345678) == UC_ERR_WRITE_PROT && buf[0x1000] == 0,
+            "the guest cannot write a read-only page of uc_mem_map_ptr()");
+    check(store(uc, PTR_ADDR + 0x2000, 0x12345678) == UC_ERR_OK && buf[0x2000] == 0x78,
+            "but writes the page after it");
+
+    uc_close(uc);
+    free(buf);
+
+    return failed;
+}
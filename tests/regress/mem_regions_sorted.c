@@ -0,0 +1,130 @@
+/*
+Test for lookups among many mapped regions.
+
+Regions are kept sorted by address and found by binary search. Map them
+out of order, split some with uc_mem_protect() and partial unmaps, and
+check that every page still resolves to the right region.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define BASE 0x1000000
+#define PAGES 512
+
+/* Every mapped page holds its own page number. */
+static int pages_ok(uc_engine *uc, int step)
+{
+    uint32_t i, v;
+
+    for (i = 0; i < PAGES; i++) {
+        uc_err err = uc_mem_read(uc, BASE + i * 0x1000, &v, sizeof(v));
+        if (i % step == 0) {
+            if (err != UC_ERR_OK || v != i)
+                return 0;
+        } else if (err != UC_ERR_READ_UNMAPPED) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int regions_sorted(uc_engine *uc, uint32_t expected)
+{
+    uc_mem_region *regions;
+    uint32_t count, i;
+    int ok = 1;
+
+    if (uc_mem_regions(uc, &regions, &count) != UC_ERR_OK)
+        return 0;
+    for (i = 1; i < count; i++) {
+        if (regions[i].begin <= regions[i - 1].end)
+            ok = 0;
+    }
+    uc_free(regions);
+    return ok && count == expected;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uint32_t i, p, v;
+    int ok;
+
+    printf("# lookups among many mapped regions\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+
+    // every other page, in a scattered order
+    ok = 1;
+    for (i = 0; i < PAGES / 2; i++) {
+        p = ((i * 613) % (PAGES / 2)) * 2;
+        if (uc_mem_map(uc, BASE + p * 0x1000, 0x1000, UC_PROT_ALL) != UC_ERR_OK ||
+                uc_mem_write(uc, BASE + p * 0x1000, &p, sizeof(p)) != UC_ERR_OK)
+            ok = 0;
+    }
+    check(ok, "map regions out of order");
+    check(regions_sorted(uc, PAGES / 2), "uc_mem_regions() lists them by address");
+    check(pages_ok(uc, 2), "every page resolves to its region");
+    check(uc_mem_map(uc, BASE + 0x1000, 0x2000, UC_PROT_ALL) == UC_ERR_MAP,
+            "overlapping map is refused");
+
+    // fill the holes, then split regions of several pages
+    for (i = 1; i < PAGES; i += 2) {
+        uc_mem_map(uc, BASE + i * 0x1000, 0x1000, UC_PROT_ALL);
+        uc_mem_write(uc, BASE + i * 0x1000, &i, sizeof(i));
+    }
+    check(pages_ok(uc, 1), "holes filled");
+
+    check(uc_mem_unmap(uc, BASE + 0x1000, 0x1000) == UC_ERR_OK &&
+            uc_mem_unmap(uc, BASE + (PAGES - 1) * 0x1000, 0x1000) == UC_ERR_OK,
+            "unmap single regions");
+    v = 0;
+    check(uc_mem_read(uc, BASE + 0x1000, &v, sizeof(v)) == UC_ERR_READ_UNMAPPED &&
+            uc_mem_read(uc, BASE + 0x2000, &v, sizeof(v)) == UC_ERR_OK && v == 2,
+            "neighbours of an unmapped region are intact");
+    uc_mem_map(uc, BASE + 0x1000, 0x1000, UC_PROT_ALL);
+    p = 1;
+    uc_mem_write(uc, BASE + 0x1000, &p, sizeof(p));
+    uc_mem_map(uc, BASE + (PAGES - 1) * 0x1000, 0x1000, UC_PROT_ALL);
+    p = PAGES - 1;
+    uc_mem_write(uc, BASE + (PAGES - 1) * 0x1000, &p, sizeof(p));
+
+    check(uc_mem_protect(uc, BASE + 0x10000, 0x1000, UC_PROT_READ) == UC_ERR_OK,
+            "protect one page");
+    check(pages_ok(uc, 1) && regions_sorted(uc, PAGES), "regions unchanged by protect");
+    check(uc_mem_write(uc, BASE + 0x10000, &v, sizeof(v)) == UC_ERR_OK,
+            "host writes to a read-only page");
+
+    uc_close(uc);
+
+    // a split region: map one large block and punch holes into it
+    uc_open(UC_ARCH_X86, UC_MODE_32, &uc);
+    uc_mem_map(uc, BASE, PAGES * 0x1000, UC_PROT_ALL);
+    for (i = 0; i < PAGES; i++)
+        uc_mem_write(uc, BASE + i * 0x1000, &i, sizeof(i));
+    ok = 1;
+    for (i = 1; i < PAGES; i += 4) {
+        if (uc_mem_unmap(uc, BASE + i * 0x1000, 0x1000) != UC_ERR_OK)
+            ok = 0;
+    }
+    check(ok, "unmap pages inside a large region");
+    ok = 1;
+    for (i = 0; i < PAGES; i++) {
+        uc_err err = uc_mem_read(uc, BASE + i * 0x1000, &v, sizeof(v));
+        if (i % 4 == 1 ? err != UC_ERR_READ_UNMAPPED : (err != UC_ERR_OK || v != i))
+            ok = 0;
+    }
+    check(ok, "split pieces resolve to their content");
+    check(uc_mem_protect(uc, BASE + 0x2000, 0x1000, UC_PROT_READ) == UC_ERR_OK &&
+            regions_sorted(uc, PAGES / 4 + 2), "protect splits a piece in place");
+
+    uc_close(uc);
+    return failed;
+}
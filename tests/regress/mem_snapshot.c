@@ -0,0 +1,154 @@
+/*
+Test for uc_snapshot_take() and uc_snapshot_restore().
+
+A snapshot saves the registers and the content of the mapped memory.
+Restoring it must undo the writes of the guest and of uc_mem_write(),
+copy back only the pages written since the snapshot, and drop the blocks
+translated from code that was rewritten in between.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define PTR_ADDR 0x200000
+#define DATA_ADDR 0x1000000
+#define DATA_SIZE (64 * 1024 * 1024)
+#define PAGES 20
+
+/*
+bits 32
+
+    mov eax, 0x11111111     ; immediate at CODE_ADDR + 1
+loop:
+    mov [ebx], eax
+    add ebx, 0x1000
+    dec ecx
+    jnz loop
+*/
+static const unsigned char PROGRAM[] =
+    "\xb8\x11\x11\x11\x11\x89\x03\x81\xc3\x00\x10\x00\x00\x49\x75\xf5";
+#define END (CODE_ADDR + sizeof(PROGRAM) - 1)
+
+/* Write eax to the first word of @pages pages from @addr. */
+static int run(uc_engine *uc, uint32_t addr, uint32_t pages)
+{
+    uc_reg_write(uc, UC_X86_REG_EBX, &addr);
+    uc_reg_write(uc, UC_X86_REG_ECX, &pages);
+    return uc_emu_start(uc, CODE_ADDR, END, 0, 0) == UC_ERR_OK;
+}
+
+/* The first word of @pages pages from @addr holds @value. */
+static int pages_hold(uc_engine *uc, uint32_t addr, uint32_t pages, uint32_t value)
+{
+    uint32_t i, v;
+
+    for (i = 0; i < pages; i++) {
+        if (uc_mem_read(uc, addr + i * 0x1000, &v, sizeof(v)) != UC_ERR_OK || v != value)
+            return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_snapshot *snap, *other;
+    uc_mem_region *regions;
+    uint32_t count, i, eax, ecx, esi;
+    uint8_t *ptr;
+    int ok;
+
+    printf("# snapshot and restore of registers and memory\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    ptr = calloc(2, 0x1000);
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+    uc_mem_map_ptr(uc, PTR_ADDR, 0x2000, UC_PROT_ALL, ptr);
+    uc_mem_map(uc, DATA_ADDR, DATA_SIZE, UC_PROT_READ | UC_PROT_WRITE);
+
+    esi = 0x1234;
+    uc_reg_write(uc, UC_X86_REG_ESI, &esi);
+    check(uc_snapshot_take(uc, &snap) == UC_ERR_OK, "take a snapshot");
+
+    check(run(uc, DATA_ADDR, PAGES) && pages_hold(uc, DATA_ADDR, PAGES, 0x11111111),
+            "guest writes pages");
+    uc_mem_write(uc, DATA_ADDR + DATA_SIZE - 4, "\xff\xff\xff\xff", 4);
+    esi = 0;
+    uc_reg_write(uc, UC_X86_REG_ESI, &esi);
+    check(uc_snapshot_restore(uc, snap) == UC_ERR_OK, "restore the snapshot");
+    uc_reg_read(uc, UC_X86_REG_ESI, &esi);
+    check(esi == 0x1234, "registers are restored");
+    check(pages_hold(uc, DATA_ADDR, PAGES, 0), "pages written by the guest are restored");
+    check(pages_hold(uc, DATA_ADDR + DATA_SIZE - 0x1000, 1, 0) &&
+            uc_mem_read(uc, DATA_ADDR + DATA_SIZE - 4, &eax, sizeof(eax)) == UC_ERR_OK &&
+            eax == 0, "pages written by uc_mem_write() are restored");
+
+    // memory of uc_mem_map_ptr() written directly is not tracked, so it
+    // shows which pages the restore copies back
+    run(uc, PTR_ADDR, 1);
+    ptr[0x1000] = 0xaa;
+    uc_snapshot_restore(uc, snap);
+    check(ptr[0] == 0 && ptr[0x1000] == 0xaa, "only the written pages are copied back");
+    ptr[0x1000] = 0;
+
+    ok = 1;
+    for (i = 0; i < 100; i++) {
+        ok &= run(uc, DATA_ADDR + i * PAGES * 0x1000, PAGES);
+        ok &= uc_snapshot_restore(uc, snap) == UC_ERR_OK;
+        ok &= pages_hold(uc, DATA_ADDR + i * PAGES * 0x1000, PAGES, 0);
+    }
+    check(ok, "repeated runs and restores");
+
+    // code rewritten after the snapshot
+    uc_mem_write(uc, CODE_ADDR + 1, "\x22\x22\x22\x22", 4);
+    run(uc, DATA_ADDR, 1);
+    check(pages_hold(uc, DATA_ADDR, 1, 0x22222222), "code rewritten after the snapshot");
+    uc_snapshot_restore(uc, snap);
+    run(uc, DATA_ADDR, 1);
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    check(eax == 0x11111111, "restored code runs instead of the rewritten one");
+    uc_snapshot_restore(uc, snap);
+
+    // permissions changed after the snapshot
+    uc_mem_protect(uc, DATA_ADDR + 0x1000, 0x1000, UC_PROT_READ);
+    uc_snapshot_restore(uc, snap);
+    ok = uc_mem_regions(uc, &regions, &count) == UC_ERR_OK;
+    for (i = 0; ok && i < count; i++) {
+        if (regions[i].begin >= DATA_ADDR && regions[i].perms != (UC_PROT_READ | UC_PROT_WRITE))
+            ok = 0;
+    }
+    uc_free(regions);
+    check(ok && run(uc, DATA_ADDR, 3) && pages_hold(uc, DATA_ADDR, 3, 0x11111111),
+            "permissions are restored");
+    uc_snapshot_restore(uc, snap);
+
+    // a snapshot that is not tracked anymore
+    run(uc, DATA_ADDR, PAGES);
+    check(uc_snapshot_take(uc, &other) == UC_ERR_OK, "take a second snapshot");
+    run(uc, DATA_ADDR + PAGES * 0x1000, PAGES);
+    check(uc_snapshot_restore(uc, snap) == UC_ERR_OK &&
+            pages_hold(uc, DATA_ADDR, 2 * PAGES, 0), "restore an older snapshot");
+    check(uc_snapshot_restore(uc, other) == UC_ERR_OK &&
+            pages_hold(uc, DATA_ADDR, PAGES, 0x11111111) &&
+            pages_hold(uc, DATA_ADDR + PAGES * 0x1000, PAGES, 0), "restore the newer snapshot");
+    uc_reg_read(uc, UC_X86_REG_ECX, &ecx);
+    check(ecx == 0, "registers of the newer snapshot");
+    uc_snapshot_free(other);
+
+    uc_mem_unmap(uc, PTR_ADDR, 0x2000);
+    check(uc_snapshot_restore(uc, snap) == UC_ERR_MAP, "restore with a saved region unmapped");
+
+    uc_close(uc);
+    check(uc_snapshot_free(snap) == UC_ERR_OK, "free a snapshot after uc_close()");
+    free(ptr);
+    return failed;
+}
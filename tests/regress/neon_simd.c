@@ -0,0 +1,503 @@
+/*
+Test for the NEON integer helpers.
+
+The saturating, halving, compare, min/max, absolute difference, multiply,
+shift, narrowing, widening and table lookup instructions of arm and arm64
+run on host SIMD on x86 hosts. They must give the results and the
+QC flags of the per-lane C code, which the test checks by running them on
+the same inputs in a copy of itself with UNICORN_NO_HOST_SIMD set.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define TRIALS 64
+
+typedef union {
+    unsigned char b[16];
+    uint64_t q[2];
+} vec;
+
+typedef struct {
+    vec out;
+    uint64_t status;
+} result;
+
+typedef struct {
+    uint32_t code;
+    const char *text;
+} insn;
+
+/* inputs in v1 and v2, counts that are the same in every lane in v3 and v4,
+   table indices in v6, tables in v16-v19 and v30, v31, v0, result in v5 */
+static const insn ARM64_INSNS[] = {
+    { 0x4e220c25, "sqadd v5.16b, v1.16b, v2.16b" },
+    { 0x6e220c25, "uqadd v5.16b, v1.16b, v2.16b" },
+    { 0x4e620c25, "sqadd v5.8h, v1.8h, v2.8h" },
+    { 0x6e620c25, "uqadd v5.8h, v1.8h, v2.8h" },
+    { 0x4e222c25, "sqsub v5.16b, v1.16b, v2.16b" },
+    { 0x6e222c25, "uqsub v5.16b, v1.16b, v2.16b" },
+    { 0x4e622c25, "sqsub v5.8h, v1.8h, v2.8h" },
+    { 0x6e622c25, "uqsub v5.8h, v1.8h, v2.8h" },
+    { 0x4e220425, "shadd v5.16b, v1.16b, v2.16b" },
+    { 0x6e220425, "uhadd v5.16b, v1.16b, v2.16b" },
+    { 0x4e620425, "shadd v5.8h, v1.8h, v2.8h" },
+    { 0x6e620425, "uhadd v5.8h, v1.8h, v2.8h" },
+    { 0x4e221425, "srhadd v5.16b, v1.16b, v2.16b" },
+    { 0x6e221425, "urhadd v5.16b, v1.16b, v2.16b" },
+    { 0x4e621425, "srhadd v5.8h, v1.8h, v2.8h" },
+    { 0x6e621425, "urhadd v5.8h, v1.8h, v2.8h" },
+    { 0x4e223425, "cmgt v5.16b, v1.16b, v2.16b" },
+    { 0x6e223425, "cmhi v5.16b, v1.16b, v2.16b" },
+    { 0x4e223c25, "cmge v5.16b, v1.16b, v2.16b" },
+    { 0x6e223c25, "cmhs v5.16b, v1.16b, v2.16b" },
+    { 0x4e623425, "cmgt v5.8h, v1.8h, v2.8h" },
+    { 0x6e623425, "cmhi v5.8h, v1.8h, v2.8h" },
+    { 0x4e623c25, "cmge v5.8h, v1.8h, v2.8h" },
+    { 0x6e623c25, "cmhs v5.8h, v1.8h, v2.8h" },
+    { 0x6e228c25, "cmeq v5.16b, v1.16b, v2.16b" },
+    { 0x6e628c25, "cmeq v5.8h, v1.8h, v2.8h" },
+    { 0x4e228c25, "cmtst v5.16b, v1.16b, v2.16b" },
+    { 0x4e628c25, "cmtst v5.8h, v1.8h, v2.8h" },
+    { 0x4e226c25, "smin v5.16b, v1.16b, v2.16b" },
+    { 0x6e226c25, "umin v5.16b, v1.16b, v2.16b" },
+    { 0x4e226425, "smax v5.16b, v1.16b, v2.16b" },
+    { 0x6e226425, "umax v5.16b, v1.16b, v2.16b" },
+    { 0x4e626c25, "smin v5.8h, v1.8h, v2.8h" },
+    { 0x6e626c25, "umin v5.8h, v1.8h, v2.8h" },
+    { 0x4e626425, "smax v5.8h, v1.8h, v2.8h" },
+    { 0x6e626425, "umax v5.8h, v1.8h, v2.8h" },
+    { 0x4e227425, "sabd v5.16b, v1.16b, v2.16b" },
+    { 0x6e227425, "uabd v5.16b, v1.16b, v2.16b" },
+    { 0x4e627425, "sabd v5.8h, v1.8h, v2.8h" },
+    { 0x6e627425, "uabd v5.8h, v1.8h, v2.8h" },
+    { 0x4e22ac25, "sminp v5.16b, v1.16b, v2.16b" },
+    { 0x6e22ac25, "uminp v5.16b, v1.16b, v2.16b" },
+    { 0x4e22a425, "smaxp v5.16b, v1.16b, v2.16b" },
+    { 0x6e22a425, "umaxp v5.16b, v1.16b, v2.16b" },
+    { 0x4e22bc25, "addp v5.16b, v1.16b, v2.16b" },
+    { 0x4e229c25, "mul v5.16b, v1.16b, v2.16b" },
+    { 0x4e629c25, "mul v5.8h, v1.8h, v2.8h" },
+    { 0x4e62b425, "sqdmulh v5.8h, v1.8h, v2.8h" },
+    { 0x6e62b425, "sqrdmulh v5.8h, v1.8h, v2.8h" },
+    { 0x6e234425, "ushl v5.16b, v1.16b, v3.16b" },
+    { 0x4e234425, "sshl v5.16b, v1.16b, v3.16b" },
+    { 0x6e644425, "ushl v5.8h, v1.8h, v4.8h" },
+    { 0x4e644425, "sshl v5.8h, v1.8h, v4.8h" },
+    { 0x6e224425, "ushl v5.16b, v1.16b, v2.16b" },
+    { 0x6e624425, "ushl v5.8h, v1.8h, v2.8h" },
+    { 0x4e624425, "sshl v5.8h, v1.8h, v2.8h" },
+    { 0x0e214825, "sqxtn v5.8b, v1.8h" },
+    { 0x2e214825, "uqxtn v5.8b, v1.8h" },
+    { 0x2e212825, "sqxtun v5.8b, v1.8h" },
+    { 0x4e214845, "sqxtn2 v5.16b, v2.8h" },
+    { 0x0e614825, "sqxtn v5.4h, v1.4s" },
+    { 0x2e22c025, "umull v5.8h, v1.8b, v2.8b" },
+    { 0x0e22c025, "smull v5.8h, v1.8b, v2.8b" },
+    { 0x2e62c025, "umull v5.4s, v1.4h, v2.4h" },
+    { 0x0e62c025, "smull v5.4s, v1.4h, v2.4h" },
+    { 0x2e227025, "uabdl v5.8h, v1.8b, v2.8b" },
+    { 0x0e227025, "sabdl v5.8h, v1.8b, v2.8b" },
+    { 0x2e627025, "uabdl v5.4s, v1.4h, v2.4h" },
+    { 0x0e627025, "sabdl v5.4s, v1.4h, v2.4h" },
+    { 0x4e060205, "tbl v5.16b, { v16.16b }, v6.16b" },
+    { 0x0e062205, "tbl v5.8b, { v16.16b, v17.16b }, v6.8b" },
+    { 0x4e064205, "tbl v5.16b, { v16.16b, v17.16b, v18.16b }, v6.16b" },
+    { 0x4e066205, "tbl v5.16b, { v16.16b, v17.16b, v18.16b, v19.16b }, v6.16b" },
+    { 0x4e063205, "tbx v5.16b, { v16.16b, v17.16b }, v6.16b" },
+    { 0x4e0653c5, "tbx v5.16b, { v30.16b, v31.16b, v0.16b }, v6.16b" },
+};
+
+/* inputs in q1 and q2, counts that are the same in every lane in q4 and q5,
+   table indices in d12 and d13, tables in d16-d19, result in q3 */
+static const insn ARM_INSNS[] = {
+    { 0xf2026054, "vqadd.s8 q3, q1, q2" },
+    { 0xf3026054, "vqadd.u8 q3, q1, q2" },
+    { 0xf2126054, "vqadd.s16 q3, q1, q2" },
+    { 0xf3126054, "vqadd.u16 q3, q1, q2" },
+    { 0xf2026254, "vqsub.s8 q3, q1, q2" },
+    { 0xf3026254, "vqsub.u8 q3, q1, q2" },
+    { 0xf2126254, "vqsub.s16 q3, q1, q2" },
+    { 0xf3126254, "vqsub.u16 q3, q1, q2" },
+    { 0xf2026044, "vhadd.s8 q3, q1, q2" },
+    { 0xf3026044, "vhadd.u8 q3, q1, q2" },
+    { 0xf2126044, "vhadd.s16 q3, q1, q2" },
+    { 0xf3126044, "vhadd.u16 q3, q1, q2" },
+    { 0xf2026144, "vrhadd.s8 q3, q1, q2" },
+    { 0xf3026144, "vrhadd.u8 q3, q1, q2" },
+    { 0xf2126144, "vrhadd.s16 q3, q1, q2" },
+    { 0xf3126144, "vrhadd.u16 q3, q1, q2" },
+    { 0xf2026344, "vcgt.s8 q3, q1, q2" },
+    { 0xf3026344, "vcgt.u8 q3, q1, q2" },
+    { 0xf2026354, "vcge.s8 q3, q1, q2" },
+    { 0xf3026354, "vcge.u8 q3, q1, q2" },
+    { 0xf2126344, "vcgt.s16 q3, q1, q2" },
+    { 0xf3126344, "vcgt.u16 q3, q1, q2" },
+    { 0xf2126354, "vcge.s16 q3, q1, q2" },
+    { 0xf3126354, "vcge.u16 q3, q1, q2" },
+    { 0xf3026854, "vceq.i8 q3, q1, q2" },
+    { 0xf3126854, "vceq.i16 q3, q1, q2" },
+    { 0xf2026854, "vtst.8 q3, q1, q2" },
+    { 0xf2126854, "vtst.16 q3, q1, q2" },
+    { 0xf2026654, "vmin.s8 q3, q1, q2" },
+    { 0xf3026654, "vmin.u8 q3, q1, q2" },
+    { 0xf2026644, "vmax.s8 q3, q1, q2" },
+    { 0xf3026644, "vmax.u8 q3, q1, q2" },
+    { 0xf2126654, "vmin.s16 q3, q1, q2" },
+    { 0xf3126654, "vmin.u16 q3, q1, q2" },
+    { 0xf2126644, "vmax.s16 q3, q1, q2" },
+    { 0xf3126644, "vmax.u16 q3, q1, q2" },
+    { 0xf2026744, "vabd.s8 q3, q1, q2" },
+    { 0xf3026744, "vabd.u8 q3, q1, q2" },
+    { 0xf2126744, "vabd.s16 q3, q1, q2" },
+    { 0xf3126744, "vabd.u16 q3, q1, q2" },
+    { 0xf2026a14, "vpmin.s8 d6, d2, d4" },
+    { 0xf3026a14, "vpmin.u8 d6, d2, d4" },
+    { 0xf2026a04, "vpmax.s8 d6, d2, d4" },
+    { 0xf3026a04, "vpmax.u8 d6, d2, d4" },
+    { 0xf2026b14, "vpadd.i8 d6, d2, d4" },
+    { 0xf2026954, "vmul.i8 q3, q1, q2" },
+    { 0xf2126954, "vmul.i16 q3, q1, q2" },
+    { 0xf2126b44, "vqdmulh.s16 q3, q1, q2" },
+    { 0xf3126b44, "vqrdmulh.s16 q3, q1, q2" },
+    { 0xf3086442, "vshl.u8 q3, q1, q4" },
+    { 0xf2086442, "vshl.s8 q3, q1, q4" },
+    { 0xf31a6442, "vshl.u16 q3, q1, q5" },
+    { 0xf21a6442, "vshl.s16 q3, q1, q5" },
+    { 0xf3046442, "vshl.u8 q3, q1, q2" },
+    { 0xf3146442, "vshl.u16 q3, q1, q2" },
+    { 0xf2146442, "vshl.s16 q3, q1, q2" },
+    { 0xf38d6052, "vshr.u8 q3, q1, #3" },
+    { 0xf39b6052, "vshr.u16 q3, q1, #5" },
+    { 0xf2956052, "vshr.s16 q3, q1, #11" },
+    { 0xf2946552, "vshl.i16 q3, q1, #4" },
+    { 0xf3b26282, "vqmovn.s16 d6, q1" },
+    { 0xf3b262c2, "vqmovn.u16 d6, q1" },
+    { 0xf3b26242, "vqmovun.s16 d6, q1" },
+    { 0xf3b66282, "vqmovn.s32 d6, q1" },
+    { 0xf3826c04, "vmull.u8 q3, d2, d4" },
+    { 0xf2826c04, "vmull.s8 q3, d2, d4" },
+    { 0xf3926c04, "vmull.u16 q3, d2, d4" },
+    { 0xf2926c04, "vmull.s16 q3, d2, d4" },
+    { 0xf3826704, "vabdl.u8 q3, d2, d4" },
+    { 0xf2826704, "vabdl.s8 q3, d2, d4" },
+    { 0xf3926704, "vabdl.u16 q3, d2, d4" },
+    { 0xf2926704, "vabdl.s16 q3, d2, d4" },
+    { 0xf3b0688c, "vtbl.8 d6, {d16}, d12" },
+    { 0xf3b0698c, "vtbl.8 d6, {d16, d17}, d12" },
+    { 0xf3b06a8d, "vtbl.8 d6, {d16, d17, d18}, d13" },
+    { 0xf3b06b8c, "vtbl.8 d6, {d16, d17, d18, d19}, d12" },
+    { 0xf3b06acc, "vtbx.8 d6, {d16, d17, d18}, d12" },
+    { 0xf3b07bcd, "vtbx.8 d7, {d16, d17, d18, d19}, d13" },
+};
+
+#define N_ARM64 (sizeof(ARM64_INSNS) / sizeof(ARM64_INSNS[0]))
+#define N_ARM (sizeof(ARM_INSNS) / sizeof(ARM_INSNS[0]))
+
+#define ARM64_CLEAR_FPSR 0xd51b443f     /* msr fpsr, xzr */
+#define ARM64_READ_FPSR  0xd53b4420     /* mrs x0, fpsr */
+#define ARM_CLEAR_FPSCR  0xeee11a10     /* vmsr fpscr, r1 */
+#define ARM_READ_FPSCR   0xeef10a10     /* vmrs r0, fpscr */
+
+static uint64_t seed = 0x0123456789abcdefULL;
+
+static result arm64_results[N_ARM64][TRIALS];
+static result arm_results[N_ARM][TRIALS];
+
+static uint64_t rnd(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+/* half of the bytes are ones where lanes saturate or change sign */
+static unsigned char rnd_byte(void)
+{
+    static const unsigned char edges[8] = {
+        0x00, 0x01, 0x40, 0x7f, 0x80, 0x81, 0xfe, 0xff
+    };
+    uint64_t r = rnd();
+
+    return (r & 1) ? edges[(r >> 1) & 7] : (unsigned char)(r >> 8);
+}
+
+static void rnd_vec(vec *v)
+{
+    int i;
+
+    for (i = 0; i < 16; i++)
+        v->b[i] = rnd_byte();
+}
+
+/* the shift count of each lane is in its low byte */
+static signed char rnd_count(void)
+{
+    uint64_t r = rnd();
+
+    return (r & 7) ? (signed char)(r % 41 - 20) : (signed char)(r >> 8);
+}
+
+static void count_vecs(vec *same8, vec *same16)
+{
+    signed char c = rnd_count();
+    int i;
+
+    memset(same8->b, (unsigned char)c, 16);
+    c = rnd_count();
+    for (i = 0; i < 16; i += 2) {
+        same16->b[i] = (unsigned char)c;
+        same16->b[i + 1] = rnd_byte();
+    }
+}
+
+/* mostly in the tables, which are 8 to 64 bytes long */
+static void index_vec(vec *v)
+{
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        uint64_t r = rnd();
+        v->b[i] = (r & 7) ? (unsigned char)(r % 72) : (unsigned char)(r >> 8);
+    }
+}
+
+static void run_arm64(void)
+{
+    static const int tables[7] = { 16, 17, 18, 19, 30, 31, 0 };
+    uint32_t code[4];
+    uint64_t cpacr = 3 << 20;
+    vec v;
+    uc_engine *uc;
+    int i, t, r;
+
+    if (uc_open(UC_ARCH_ARM64, UC_MODE_ARM, &uc) != UC_ERR_OK) {
+        check(0, "uc_open() arm64");
+        return;
+    }
+    uc_reg_write(uc, UC_ARM64_REG_CPACR_EL1, &cpacr);
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    for (i = 0; i < (int)N_ARM64; i++) {
+        code[0] = ARM64_CLEAR_FPSR;
+        code[1] = ARM64_INSNS[i].code;
+        code[2] = ARM64_READ_FPSR;
+        code[3] = 0;
+        uc_mem_write(uc, CODE_ADDR + i * 16, code, sizeof(code));
+    }
+
+    for (t = 0; t < TRIALS; t++) {
+        vec in1, in2, same8, same16, out, idx, tab[7];
+
+        rnd_vec(&in1);
+        rnd_vec(&in2);
+        rnd_vec(&out);
+        count_vecs(&same8, &same16);
+        index_vec(&idx);
+        for (r = 0; r < 7; r++)
+            rnd_vec(&tab[r]);
+
+        for (i = 0; i < (int)N_ARM64; i++) {
+            result *res = &arm64_results[i][t];
+            uint64_t start = CODE_ADDR + i * 16;
+
+            for (r = 0; r < 7; r++)
+                uc_reg_write(uc, UC_ARM64_REG_Q0 + tables[r], &tab[r]);
+            uc_reg_write(uc, UC_ARM64_REG_Q1, &in1);
+            uc_reg_write(uc, UC_ARM64_REG_Q2, &in2);
+            uc_reg_write(uc, UC_ARM64_REG_Q3, &same8);
+            uc_reg_write(uc, UC_ARM64_REG_Q4, &same16);
+            uc_reg_write(uc, UC_ARM64_REG_Q5, &out);
+            uc_reg_write(uc, UC_ARM64_REG_Q6, &idx);
+            if (uc_emu_start(uc, start, start + 12, 0, 0) != UC_ERR_OK) {
+                memset(res, 0xee, sizeof(*res));
+                continue;
+            }
+            uc_reg_read(uc, UC_ARM64_REG_Q5, &v);
+            res->out = v;
+            uc_reg_read(uc, UC_ARM64_REG_X0, &res->status);
+        }
+    }
+
+    uc_close(uc);
+}
+
+static void run_arm(void)
+{
+    uint32_t code[4];
+    uint64_t cpacr;
+    uint32_t fpexc = 0x40000000, zero = 0, status;
+    uc_engine *uc;
+    int i, t, r;
+
+    if (uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc) != UC_ERR_OK) {
+        check(0, "uc_open() arm");
+        return;
+    }
+    uc_reg_read(uc, UC_ARM_REG_C1_C0_2, &cpacr);
+    cpacr |= 0xf << 20;
+    uc_reg_write(uc, UC_ARM_REG_C1_C0_2, &cpacr);
+    uc_reg_write(uc, UC_ARM_REG_FPEXC, &fpexc);
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    for (i = 0; i < (int)N_ARM; i++) {
+        code[0] = ARM_CLEAR_FPSCR;
+        code[1] = ARM_INSNS[i].code;
+        code[2] = ARM_READ_FPSCR;
+        code[3] = 0;
+        uc_mem_write(uc, CODE_ADDR + i * 16, code, sizeof(code));
+    }
+
+    for (t = 0; t < TRIALS; t++) {
+        vec in1, in2, same8, same16, out, idx, tab[2];
+
+        rnd_vec(&in1);
+        rnd_vec(&in2);
+        rnd_vec(&out);
+        count_vecs(&same8, &same16);
+        index_vec(&idx);
+        for (r = 0; r < 2; r++)
+            rnd_vec(&tab[r]);
+
+        for (i = 0; i < (int)N_ARM; i++) {
+            result *res = &arm_results[i][t];
+            uint64_t start = CODE_ADDR + i * 16;
+
+            for (r = 0; r < 2; r++) {
+                uc_reg_write(uc, UC_ARM_REG_D16 + 2 * r, &tab[r].q[0]);
+                uc_reg_write(uc, UC_ARM_REG_D17 + 2 * r, &tab[r].q[1]);
+            }
+            uc_reg_write(uc, UC_ARM_REG_D2, &in1.q[0]);
+            uc_reg_write(uc, UC_ARM_REG_D3, &in1.q[1]);
+            uc_reg_write(uc, UC_ARM_REG_D4, &in2.q[0]);
+            uc_reg_write(uc, UC_ARM_REG_D5, &in2.q[1]);
+            uc_reg_write(uc, UC_ARM_REG_D6, &out.q[0]);
+            uc_reg_write(uc, UC_ARM_REG_D7, &out.q[1]);
+            uc_reg_write(uc, UC_ARM_REG_D8, &same8.q[0]);
+            uc_reg_write(uc, UC_ARM_REG_D9, &same8.q[1]);
+            uc_reg_write(uc, UC_ARM_REG_D10, &same16.q[0]);
+            uc_reg_write(uc, UC_ARM_REG_D11, &same16.q[1]);
+            uc_reg_write(uc, UC_ARM_REG_D12, &idx.q[0]);
+            uc_reg_write(uc, UC_ARM_REG_D13, &idx.q[1]);
+            uc_reg_write(uc, UC_ARM_REG_R1, &zero);
+            if (uc_emu_start(uc, start, start + 12, 0, 0) != UC_ERR_OK) {
+                memset(res, 0xee, sizeof(*res));
+                continue;
+            }
+            uc_reg_read(uc, UC_ARM_REG_D6, &res->out.q[0]);
+            uc_reg_read(uc, UC_ARM_REG_D7, &res->out.q[1]);
+            uc_reg_read(uc, UC_ARM_REG_R0, &status);
+            res->status = status;
+        }
+    }
+
+    uc_close(uc);
+}
+
+/* the results of the portable helpers, from a copy of the test */
+static int run_portable(char *path, result *arm64, result *arm)
+{
+    char *args[] = { path, "--dump", NULL };
+    int fds[2], status, ok;
+    FILE *f;
+    pid_t pid;
+
+    fflush(stdout);
+    if (pipe(fds))
+        return 0;
+    pid = fork();
+    if (pid == 0) {
+        setenv("UNICORN_NO_HOST_SIMD", "1", 1);
+        dup2(fds[1], 1);
+        close(fds[0]);
+        close(fds[1]);
+        execv(path, args);
+        _exit(127);
+    }
+    close(fds[1]);
+    f = fdopen(fds[0], "r");
+    ok = pid > 0 && f &&
+        fread(arm64, sizeof(arm64_results), 1, f) == 1 &&
+        fread(arm, sizeof(arm_results), 1, f) == 1 &&
+        fgetc(f) == EOF;
+    if (f)
+        fclose(f);
+    else
+        close(fds[0]);
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+        WEXITSTATUS(status) == 0 && ok;
+}
+
+static void compare(const char *arch, const insn *insns, int n,
+                    result (*host)[TRIALS], result (*portable)[TRIALS])
+{
+    char msg[128];
+    int i, t, bad = 0;
+
+    for (i = 0; i < n; i++) {
+        for (t = 0; t < TRIALS; t++) {
+            if (memcmp(&host[i][t], &portable[i][t], sizeof(result))) {
+                printf("# %s: %s differs\n", arch, insns[i].text);
+                bad = 1;
+                break;
+            }
+        }
+    }
+    snprintf(msg, sizeof(msg), "%s: %d NEON instructions give the results of the portable helpers",
+            arch, n);
+    check(!bad, msg);
+}
+
+int main(int argc, char **argv)
+{
+    static result arm64_portable[N_ARM64][TRIALS];
+    static result arm_portable[N_ARM][TRIALS];
+    int ran = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "--dump")) {
+        if (uc_arch_supported(UC_ARCH_ARM64))
+            run_arm64();
+        if (uc_arch_supported(UC_ARCH_ARM))
+            run_arm();
+        fwrite(arm64_results, sizeof(arm64_results), 1, stdout);
+        fwrite(arm_results, sizeof(arm_results), 1, stdout);
+        return 0;
+    }
+
+    printf("# NEON integer instructions\n");
+    if (uc_arch_supported(UC_ARCH_ARM64)) {
+        run_arm64();
+        ran = 1;
+    } else {
+        printf("# arm64 not built in, skipped\n");
+    }
+    if (uc_arch_supported(UC_ARCH_ARM)) {
+        run_arm();
+        ran = 1;
+    } else {
+        printf("# arm not built in, skipped\n");
+    }
+    if (!ran)
+        return 0;
+
+    if (getenv("UNICORN_NO_HOST_SIMD")) {
+        printf("# UNICORN_NO_HOST_SIMD is set: nothing to compare\n");
+        return 0;
+    }
+    if (!run_portable(argv[0], &arm64_portable[0][0], &arm_portable[0][0])) {
+        check(0, "the portable helpers run");
+        return failed;
+    }
+    if (uc_arch_supported(UC_ARCH_ARM64))
+        compare("arm64", ARM64_INSNS, N_ARM64, arm64_results, arm64_portable);
+    if (uc_arch_supported(UC_ARCH_ARM))
+        compare("arm", ARM_INSNS, N_ARM, arm_results, arm_portable);
+
+    return failed;
+}
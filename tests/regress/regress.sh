@@ -20,3 +20,25 @@
 ./mips_kseg0_1
 ./mem_double_unmap
 
+./threaded_engines
+./mem_prot_tlb
+./tb_chain
+./mem_regions_sorted
+./emu_count
+./emu_timeout
+./mem_snapshot
+./hook_ranges
+./mem_fault_exit
+./clone
+./tb_cache_size
+./rep_string
+./host_crypto
+./neon_simd
+./mem_dirty_log
+./mem_map_many
+./ro_mem_write
+./mem_batch
+./mem_protect_pages
+./mem_get_ptr
+./mem_map_file
+./tb_cache_keep
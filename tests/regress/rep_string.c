@@ -0,0 +1,248 @@
+/*
+Test for REP string instructions.
+
+REP MOVS, STOS, SCAS and CMPS do the elements that lie in RAM pages at once,
+up to the end of each page. They must give the same memory, registers and
+flags as one element at a time, across pages, with overlapping strings,
+16-bit addresses, faults, MMIO, hooks and code written by the instruction.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x200000
+#define DATA_SIZE 0x10000
+#define RO_ADDR (DATA_ADDR + DATA_SIZE)
+#define MMIO_ADDR 0x300000
+#define LOW_ADDR 0
+
+#define EFLAGS_CF 0x1
+#define EFLAGS_ZF 0x40
+
+static const unsigned char REP_MOVSB[] = "\xf3\xa4";
+static const unsigned char REP_MOVSD_BACK[] = "\xfd\xf3\xa5\xfc";   // std, rep movsd, cld
+static const unsigned char REP_STOSB[] = "\xf3\xaa";
+static const unsigned char REP_STOSD[] = "\xf3\xab";
+static const unsigned char REPNE_SCASB[] = "\xf2\xae";
+static const unsigned char REPE_CMPSB[] = "\xf3\xa6";
+static const unsigned char REPE_SCASW[] = "\xf3\x66\xaf";
+static const unsigned char ADDR16_REP_MOVSB[] = "\x67\xf3\xa4";
+static const unsigned char REP_MOVSQ[] = "\xf3\x48\xa5";
+
+/*
+bits 32
+
+    rep stosb           ; at CODE_ADDR, overwrites the two inc
+    inc ebx
+    inc ebx
+*/
+static const unsigned char SMC[] = "\xf3\xaa\x43\x43";
+
+static int write_hook_calls, code_hook_calls, mmio_writes;
+static unsigned char buf[DATA_SIZE], buf2[DATA_SIZE];
+
+static uint64_t reg(uc_engine *uc, int regid)
+{
+    uint64_t v = 0;
+
+    uc_reg_read(uc, regid, &v);
+    return v;
+}
+
+static void set_reg(uc_engine *uc, int regid, uint64_t v)
+{
+    uc_reg_write(uc, regid, &v);
+}
+
+/* Run @code at CODE_ADDR with ESI, EDI, ECX and EAX set. */
+static uc_err run(uc_engine *uc, const unsigned char *code, size_t size,
+        uint64_t esi, uint64_t edi, uint64_t ecx, uint64_t eax)
+{
+    uc_mem_write(uc, CODE_ADDR, code, size);
+    set_reg(uc, UC_X86_REG_ESI, esi);
+    set_reg(uc, UC_X86_REG_EDI, edi);
+    set_reg(uc, UC_X86_REG_ECX, ecx);
+    set_reg(uc, UC_X86_REG_EAX, eax);
+    return uc_emu_start(uc, CODE_ADDR, CODE_ADDR + size, 0, 0);
+}
+
+#define RUN(uc, code, esi, edi, ecx, eax) \
+    run(uc, code, sizeof(code) - 1, esi, edi, ecx, eax)
+
+static void hook_write(uc_engine *uc, uc_mem_type type,
+        uint64_t address, int size, int64_t value, void *user_data)
+{
+    write_hook_calls++;
+}
+
+static void hook_code(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    code_hook_calls++;
+}
+
+static uint64_t mmio_read(uc_engine *uc, uint64_t offset, unsigned size, void *user_data)
+{
+    return offset & 0xff;
+}
+
+static void mmio_write(uc_engine *uc, uint64_t offset, unsigned size, uint64_t value, void *user_data)
+{
+    mmio_writes++;
+}
+
+static void fill(uc_engine *uc, uint64_t addr, size_t size, int seed)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++)
+        buf[i] = (unsigned char)(i * 7 + seed);
+    uc_mem_write(uc, addr, buf, size);
+}
+
+static int test_64(void)
+{
+    uc_engine *uc;
+    int i, ok;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_64, &uc))
+        return 0;
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA_ADDR, DATA_SIZE, UC_PROT_READ | UC_PROT_WRITE);
+    fill(uc, DATA_ADDR, 0x4000, 1);
+    ok = RUN(uc, REP_MOVSQ, DATA_ADDR + 8, DATA_ADDR + 0x8004, 0x700, 0) == UC_ERR_OK &&
+        reg(uc, UC_X86_REG_RCX) == 0 && reg(uc, UC_X86_REG_RSI) == DATA_ADDR + 8 + 0x3800 &&
+        reg(uc, UC_X86_REG_RDI) == DATA_ADDR + 0x8004 + 0x3800;
+    uc_mem_read(uc, DATA_ADDR + 0x8004, buf2, 0x3800);
+    for (i = 0; i < 0x3800; i++)
+        ok &= buf2[i] == buf[i + 8];
+    uc_close(uc);
+    return ok;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_hook hh;
+    uint32_t v;
+    uint64_t flags;
+    int i, ok;
+
+    printf("# REP string instructions\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA_ADDR, DATA_SIZE, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_map(uc, RO_ADDR, 0x1000, UC_PROT_READ);
+    uc_mem_map(uc, LOW_ADDR, 0x10000, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mmio_map(uc, MMIO_ADDR, 0x1000, mmio_read, NULL, mmio_write, NULL);
+
+    fill(uc, DATA_ADDR + 0x123, 10000, 0);
+    ok = RUN(uc, REP_MOVSB, DATA_ADDR + 0x123, DATA_ADDR + 0x8456, 10000, 0) == UC_ERR_OK &&
+        reg(uc, UC_X86_REG_ECX) == 0 && reg(uc, UC_X86_REG_ESI) == DATA_ADDR + 0x123 + 10000 &&
+        reg(uc, UC_X86_REG_EDI) == DATA_ADDR + 0x8456 + 10000;
+    uc_mem_read(uc, DATA_ADDR + 0x8456, buf2, 10000);
+    check(ok && memcmp(buf, buf2, 10000) == 0, "rep movsb across pages");
+
+    uc_mem_write(uc, DATA_ADDR, "abc", 3);
+    ok = RUN(uc, REP_MOVSB, DATA_ADDR, DATA_ADDR + 3, 5000, 0) == UC_ERR_OK;
+    uc_mem_read(uc, DATA_ADDR, buf2, 5003);
+    for (i = 0; i < 5003; i++)
+        ok &= buf2[i] == "abc"[i % 3];
+    check(ok, "rep movsb repeats an overlapping source");
+
+    fill(uc, DATA_ADDR, 0x4000, 3);
+    ok = RUN(uc, REP_MOVSD_BACK, DATA_ADDR + 0x4000 - 4, DATA_ADDR + 0xc000 - 4, 3000, 0) == UC_ERR_OK &&
+        reg(uc, UC_X86_REG_ESI) == DATA_ADDR + 0x4000 - 4 - 4 * 3000 &&
+        reg(uc, UC_X86_REG_EDI) == DATA_ADDR + 0xc000 - 4 - 4 * 3000;
+    uc_mem_read(uc, DATA_ADDR + 0xc000 - 4 * 3000, buf2, 4 * 3000);
+    check(ok && memcmp(buf + 0x4000 - 4 * 3000, buf2, 4 * 3000) == 0,
+            "rep movsd backward");
+
+    ok = RUN(uc, REP_STOSD, 0, DATA_ADDR + 0x1002, 5000, 0x11223344) == UC_ERR_OK &&
+        reg(uc, UC_X86_REG_ECX) == 0 && reg(uc, UC_X86_REG_EDI) == DATA_ADDR + 0x1002 + 4 * 5000;
+    for (i = 0; i < 5000; i++) {
+        uc_mem_read(uc, DATA_ADDR + 0x1002 + 4 * i, &v, 4);
+        ok &= v == 0x11223344;
+    }
+    check(ok, "rep stosd across pages");
+
+    memset(buf, 'x', 9000);
+    buf[9000] = 0;
+    uc_mem_write(uc, DATA_ADDR + 0x10, buf, 9001);
+    ok = RUN(uc, REPNE_SCASB, 0, DATA_ADDR + 0x10, 0xffffffff, 0) == UC_ERR_OK &&
+        reg(uc, UC_X86_REG_ECX) == 0xffffffff - 9001 &&
+        reg(uc, UC_X86_REG_EDI) == DATA_ADDR + 0x10 + 9001;
+    check(ok && (reg(uc, UC_X86_REG_EFLAGS) & EFLAGS_ZF), "repne scasb finds the end of a string");
+
+    set_reg(uc, UC_X86_REG_EFLAGS, 0);
+    uc_mem_write(uc, DATA_ADDR + 0x10, "\0\0\0\0", 4);
+    ok = RUN(uc, REPE_SCASW, 0, DATA_ADDR + 0x10, 3000, 0x10000) == UC_ERR_OK &&
+        reg(uc, UC_X86_REG_ECX) == 3000 - 3 && reg(uc, UC_X86_REG_EDI) == DATA_ADDR + 0x10 + 6;
+    check(ok && !(reg(uc, UC_X86_REG_EFLAGS) & EFLAGS_ZF), "repe scasw stops on a different word");
+
+    memset(buf, 'y', 8000);
+    uc_mem_write(uc, DATA_ADDR + 0x100, buf, 8000);
+    uc_mem_write(uc, DATA_ADDR + 0x8100, buf, 8000);
+    uc_mem_write(uc, DATA_ADDR + 0x100 + 6000, "\x05", 1);
+    uc_mem_write(uc, DATA_ADDR + 0x8100 + 6000, "\x09", 1);
+    ok = RUN(uc, REPE_CMPSB, DATA_ADDR + 0x100, DATA_ADDR + 0x8100, 8000, 0) == UC_ERR_OK &&
+        reg(uc, UC_X86_REG_ECX) == 8000 - 6001 && reg(uc, UC_X86_REG_ESI) == DATA_ADDR + 0x100 + 6001 &&
+        reg(uc, UC_X86_REG_EDI) == DATA_ADDR + 0x8100 + 6001;
+    flags = reg(uc, UC_X86_REG_EFLAGS);
+    check(ok && !(flags & EFLAGS_ZF) && (flags & EFLAGS_CF), "repe cmpsb stops on a difference");
+
+    fill(uc, LOW_ADDR, 0x10000, 5);
+    ok = RUN(uc, ADDR16_REP_MOVSB, 0xabcdfff0, 0xabcd8000, 0xffff0020, 0) == UC_ERR_OK &&
+        reg(uc, UC_X86_REG_ECX) == 0xffff0000 && reg(uc, UC_X86_REG_ESI) == 0xabcd0010 &&
+        reg(uc, UC_X86_REG_EDI) == 0xabcd8020;
+    uc_mem_read(uc, LOW_ADDR + 0x8000, buf2, 0x20);
+    check(ok && memcmp(buf2, buf + 0xfff0, 0x10) == 0 && memcmp(buf2 + 0x10, buf, 0x10) == 0,
+            "16-bit addresses wrap around");
+
+    check(RUN(uc, REP_STOSB, 0, RO_ADDR - 100, 300, 0) == UC_ERR_WRITE_PROT &&
+            reg(uc, UC_X86_REG_ECX) == 200 && reg(uc, UC_X86_REG_EDI) == RO_ADDR &&
+            reg(uc, UC_X86_REG_EIP) == CODE_ADDR, "stop on a read-only page");
+    check(RUN(uc, REP_STOSB, 0, RO_ADDR + 0x1000 - 100, 300, 0) == UC_ERR_WRITE_PROT &&
+            reg(uc, UC_X86_REG_ECX) == 300, "stop on a read-only page at once");
+    check(RUN(uc, REP_MOVSB, RO_ADDR + 0x1000 - 8, DATA_ADDR, 300, 0) == UC_ERR_READ_UNMAPPED &&
+            reg(uc, UC_X86_REG_ECX) == 292 && reg(uc, UC_X86_REG_ESI) == RO_ADDR + 0x1000,
+            "stop on an unmapped page");
+
+    mmio_writes = 0;
+    ok = RUN(uc, REP_STOSB, 0, MMIO_ADDR, 10, 0) == UC_ERR_OK && reg(uc, UC_X86_REG_ECX) == 0;
+    ok &= RUN(uc, REP_MOVSB, MMIO_ADDR + 0x10, DATA_ADDR, 20, 0) == UC_ERR_OK;
+    uc_mem_read(uc, DATA_ADDR, buf2, 20);
+    for (i = 0; i < 20; i++)
+        ok &= buf2[i] == 0x10 + i;
+    check(ok && mmio_writes == 10, "MMIO is accessed one element at a time");
+
+    write_hook_calls = 0;
+    uc_hook_add(uc, &hh, UC_HOOK_MEM_WRITE, hook_write, NULL, 1, 0, 0);
+    check(RUN(uc, REP_STOSB, 0, DATA_ADDR + 0xff0, 100, 0) == UC_ERR_OK && write_hook_calls == 100,
+            "memory hooks see each element");
+    uc_hook_del(uc, hh);
+
+    code_hook_calls = 0;
+    uc_hook_add(uc, &hh, UC_HOOK_CODE, hook_code, NULL, 1, 0, 0);
+    check(RUN(uc, REP_STOSB, 0, DATA_ADDR, 3, 0) == UC_ERR_OK && code_hook_calls == 4,
+            "code hooks see each iteration and the end");
+    uc_hook_del(uc, hh);
+
+    set_reg(uc, UC_X86_REG_EBX, 0);
+    check(RUN(uc, SMC, 0, CODE_ADDR + 2, 2, 0x90) == UC_ERR_OK && reg(uc, UC_X86_REG_EBX) == 0,
+            "code written by rep stosb is run");
+
+    uc_close(uc);
+
+    check(test_64(), "rep movsq in 64-bit mode");
+
+    return failed;
+}
@@ -0,0 +1,118 @@
+/*
+Test for uc_mem_write() to memory mapped without UC_PROT_WRITE.
+
+The host may write read-only memory, such as code it patches. The write
+must reach the guest, drop the code translated from the bytes written,
+and leave the guest unable to write the memory itself.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define STORE_ADDR 0x200000
+#define LOAD_ADDR 0x201000
+#define RO_ADDR 0x300000
+#define RW_ADDR 0x301000
+#define PTR_ADDR 0x400000
+
+// mov eax, 0x11111111
+static const unsigned char SET[] = "\xb8\x11\x11\x11\x11";
+// mov [ebx], eax
+static const unsigned char STORE[] = "\x89\x03";
+// mov eax, [ebx]
+static const unsigned char LOAD[] = "\x8b\x03";
+
+/* Run the instruction at @addr with ebx = @ebx; return eax, or 0 on error. */
+static uint32_t run(uc_engine *uc, uint64_t addr, size_t len, uint32_t ebx, uc_err *err)
+{
+    uint32_t eax = 0x5a5a5a5a;
+
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    *err = uc_emu_start(uc, addr, addr + len, 0, 0);
+    if (*err != UC_ERR_OK)
+        return 0;
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    return eax;
+}
+
+static uint32_t word_at(uc_engine *uc, uint64_t addr)
+{
+    uint32_t value = 0;
+
+    uc_mem_read(uc, addr, &value, sizeof(value));
+    return value;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_mem_region *regions;
+    uc_err err;
+    uint32_t count, i, value;
+    uint8_t bitmap, *buf;
+    uint64_t both = 0x0807060504030201ULL, back = 0;
+
+    printf("# host writes to read-only memory\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_READ | UC_PROT_EXEC);
+    uc_mem_map(uc, STORE_ADDR, 0x2000, UC_PROT_ALL);
+    uc_mem_map(uc, RO_ADDR, 0x1000, UC_PROT_READ);
+    uc_mem_map(uc, RW_ADDR, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_write(uc, STORE_ADDR, STORE, sizeof(STORE) - 1);
+    uc_mem_write(uc, LOAD_ADDR, LOAD, sizeof(LOAD) - 1);
+
+    check(uc_mem_write(uc, CODE_ADDR, SET, sizeof(SET) - 1) == UC_ERR_OK, "write code to a read-only page");
+    check(run(uc, CODE_ADDR, sizeof(SET) - 1, 0, &err) == 0x11111111, "run it");
+    value = 0x22222222;
+    check(uc_mem_write(uc, CODE_ADDR + 1, &value, sizeof(value)) == UC_ERR_OK, "patch the code");
+    check(run(uc, CODE_ADDR, sizeof(SET) - 1, 0, &err) == value, "the patched code runs");
+
+    run(uc, STORE_ADDR, sizeof(STORE) - 1, CODE_ADDR, &err);
+    check(err == UC_ERR_WRITE_PROT && word_at(uc, CODE_ADDR + 1) == value,
+            "the guest still cannot write the page");
+
+    uc_mem_regions(uc, &regions, &count);
+    for (i = 0; i < count; i++) {
+        if (regions[i].begin == CODE_ADDR)
+            check(regions[i].perms == (UC_PROT_READ | UC_PROT_EXEC), "the protection is unchanged");
+    }
+    uc_free(regions);
+
+    // the guest reads the page through its TLB entry
+    value = 0x33333333;
+    uc_mem_write(uc, RO_ADDR, &value, sizeof(value));
+    check(run(uc, LOAD_ADDR, sizeof(LOAD) - 1, RO_ADDR, &err) == value, "the guest reads a read-only page");
+    value = 0x44444444;
+    uc_mem_write(uc, RO_ADDR, &value, sizeof(value));
+    check(run(uc, LOAD_ADDR, sizeof(LOAD) - 1, RO_ADDR, &err) == value, "and sees the next host write");
+
+    check(uc_mem_write(uc, RW_ADDR - 4, &both, sizeof(both)) == UC_ERR_OK
+            && uc_mem_read(uc, RW_ADDR - 4, &back, sizeof(back)) == UC_ERR_OK && back == both,
+            "write across a read-only and a writable page");
+
+    check(uc_mem_dirty_log_start(uc, RO_ADDR, 0x1000) == UC_ERR_OK, "log the writes to the read-only page");
+    uc_mem_write(uc, RO_ADDR + 8, &value, sizeof(value));
+    check(uc_mem_dirty_log_get(uc, RO_ADDR, 0x1000, &bitmap, false) == UC_ERR_OK && bitmap == 1,
+            "the host write is logged");
+
+    buf = calloc(1, 0x1000);
+    uc_mem_map_ptr(uc, PTR_ADDR, 0x1000, UC_PROT_READ, buf);
+    value = 0x55555555;
+    check(uc_mem_write(uc, PTR_ADDR + 0x10, &value, sizeof(value)) == UC_ERR_OK && memcmp(buf + 0x10, &value, 4) == 0,
+            "a write to read-only memory of uc_mem_map_ptr() reaches the buffer");
+
+    uc_close(uc);
+    free(buf);
+
+    return failed;
+}
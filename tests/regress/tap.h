@@ -0,0 +1,24 @@
+/*
+TAP output for the regress tests: check() prints one "ok" or "not ok" line
+per condition, and main() returns failed.
+*/
+
+#ifndef REGRESS_TAP_H
+#define REGRESS_TAP_H
+
+#include <stdio.h>
+
+static int log_num = 1;
+static int failed = 0;
+
+static void check(int cond, const char *msg)
+{
+    if (cond) {
+        printf("ok %d - %s\n", log_num++, msg);
+    } else {
+        printf("not ok %d - %s\n", log_num++, msg);
+        failed = 1;
+    }
+}
+
+#endif
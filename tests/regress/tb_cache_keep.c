@@ -0,0 +1,101 @@
+/*
+Test for the translation cache kept across uc_emu_start() calls.
+
+Running the same code again must reuse its translated blocks, as reported by
+UC_QUERY_TB_REUSED and UC_QUERY_TB_TRANSLATED. The cached blocks must not
+outlive the code they were translated from: code rewritten by
+uc_mem_write() runs in its new form, and code whose page lost UC_PROT_EXEC
+or was unmapped faults.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+
+/*
+bits 32
+
+    mov eax, 0x11111111     ; immediate at CODE_ADDR + 1
+    add eax, ebx
+*/
+static const unsigned char PROGRAM[] = "\xb8\x11\x11\x11\x11\x01\xd8";
+#define END (CODE_ADDR + sizeof(PROGRAM) - 1)
+
+static size_t query(uc_engine *uc, uc_query_type type)
+{
+    size_t result = 0;
+
+    uc_query(uc, type, &result);
+    return result;
+}
+
+/* Run the program with ebx = 1; return eax, and the blocks reused and
+   translated by the run. */
+static uint32_t run(uc_engine *uc, uc_err *err, size_t *reused, size_t *translated)
+{
+    uint32_t eax = 0, ebx = 1;
+    size_t reused_before = query(uc, UC_QUERY_TB_REUSED);
+    size_t translated_before = query(uc, UC_QUERY_TB_TRANSLATED);
+
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    *err = uc_emu_start(uc, CODE_ADDR, END, 0, 0);
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    *reused = query(uc, UC_QUERY_TB_REUSED) - reused_before;
+    *translated = query(uc, UC_QUERY_TB_TRANSLATED) - translated_before;
+    return eax;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_err err;
+    size_t reused, translated;
+    uint32_t value;
+
+    printf("# translation cache kept across runs\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+
+    check(run(uc, &err, &reused, &translated) == 0x11111112 && err == UC_ERR_OK && translated > 0,
+            "the first run translates the code");
+    check(run(uc, &err, &reused, &translated) == 0x11111112 && err == UC_ERR_OK
+            && reused > 0 && translated == 0,
+            "the second run reuses its blocks");
+
+    value = 0x22222222;
+    uc_mem_write(uc, CODE_ADDR + 1, &value, sizeof(value));
+    check(run(uc, &err, &reused, &translated) == 0x22222223 && err == UC_ERR_OK && translated > 0,
+            "code rewritten by uc_mem_write() runs in its new form");
+    check(run(uc, &err, &reused, &translated) == 0x22222223 && reused > 0 && translated == 0,
+            "and is reused in turn");
+
+    uc_mem_protect(uc, CODE_ADDR, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    run(uc, &err, &reused, &translated);
+    check(err == UC_ERR_FETCH_PROT, "code whose page lost UC_PROT_EXEC faults");
+    uc_mem_protect(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    check(run(uc, &err, &reused, &translated) == 0x22222223 && err == UC_ERR_OK,
+            "and runs again once executable");
+
+    uc_mem_unmap(uc, CODE_ADDR, 0x1000);
+    run(uc, &err, &reused, &translated);
+    check(err == UC_ERR_FETCH_UNMAPPED, "code unmapped faults");
+
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+    check(run(uc, &err, &reused, &translated) == 0x11111112 && err == UC_ERR_OK,
+            "code mapped in its place runs, not the old blocks");
+
+    uc_close(uc);
+
+    return failed;
+}
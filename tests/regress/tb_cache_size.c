@@ -0,0 +1,99 @@
+/*
+Test for the size of the translation cache.
+
+The cache starts small and grows when it fills up, up to the maximum set by
+uc_tb_cache_resize(). Once at the maximum, it is flushed when it fills up.
+Emulation must give the same results whatever the size of the cache.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define BLOCKS 4000
+#define MB (1024 * 1024)
+
+/*
+bits 32
+
+    times BLOCKS: inc eax / jmp $+2
+*/
+static unsigned char program[BLOCKS * 3];
+#define END (CODE_ADDR + sizeof(program))
+
+static size_t query(uc_engine *uc, uc_query_type type)
+{
+    size_t v = 0;
+
+    uc_query(uc, type, &v);
+    return v;
+}
+
+/* Run the program, which increments eax once per block. */
+static int run(uc_engine *uc)
+{
+    uint32_t eax = 0;
+
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    if (uc_emu_start(uc, CODE_ADDR, END, 0, 0) != UC_ERR_OK)
+        return 0;
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    return eax == BLOCKS;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    size_t flushes;
+    int i;
+
+    printf("# size of the translation cache\n");
+
+    for (i = 0; i < BLOCKS; i++) {
+        program[i * 3] = 0x40;
+        program[i * 3 + 1] = 0xeb;
+        program[i * 3 + 2] = 0x00;
+    }
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x100000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, program, sizeof(program));
+
+    check(query(uc, UC_QUERY_TB_CACHE_SIZE) == 1 * MB &&
+            query(uc, UC_QUERY_TB_CACHE_USED) == 0, "new engine has a small empty cache");
+    check(run(uc), "run many blocks");
+    check(query(uc, UC_QUERY_TB_CACHE_SIZE) > 1 * MB &&
+            query(uc, UC_QUERY_TB_CACHE_SIZE) <= 8 * MB, "cache grew up to the default maximum");
+    check(query(uc, UC_QUERY_TB_CACHE_USED) > 0 &&
+            query(uc, UC_QUERY_TB_CACHE_USED) < query(uc, UC_QUERY_TB_CACHE_SIZE),
+            "cache use is reported");
+    // the blocks flushed when the cache grew are translated again, and may
+    // make it grow once more
+    run(uc);
+    flushes = query(uc, UC_QUERY_TB_FLUSHES);
+    check(run(uc) && query(uc, UC_QUERY_TB_FLUSHES) == flushes,
+            "blocks are reused without flushing once the cache has grown");
+
+    check(uc_tb_cache_resize(uc, 2 * MB, 1 * MB) == UC_ERR_ARG &&
+            uc_tb_cache_resize(uc, 0, 0) == UC_ERR_ARG, "invalid sizes");
+    check(uc_tb_cache_resize(uc, 0, 1 * MB) == UC_ERR_OK && run(uc) &&
+            query(uc, UC_QUERY_TB_CACHE_SIZE) == 1 * MB, "shrink the cache");
+    flushes = query(uc, UC_QUERY_TB_FLUSHES);
+    check(run(uc) && query(uc, UC_QUERY_TB_FLUSHES) > flushes + 1 &&
+            query(uc, UC_QUERY_TB_CACHE_SIZE) == 1 * MB, "full cache at its maximum is flushed");
+
+    check(uc_tb_cache_resize(uc, 32 * MB, 32 * MB) == UC_ERR_OK && run(uc) &&
+            query(uc, UC_QUERY_TB_CACHE_SIZE) == 32 * MB, "grow the cache");
+    flushes = query(uc, UC_QUERY_TB_FLUSHES);
+    check(run(uc) && query(uc, UC_QUERY_TB_FLUSHES) == flushes,
+            "big cache holds all the blocks");
+
+    uc_close(uc);
+    return failed;
+}
@@ -0,0 +1,97 @@
+/*
+Test for block chaining.
+
+Translated blocks that end in a direct jump on the same page are linked
+to their successor, so a loop runs without going back to the block lookup
+on every iteration. The links must be dropped when the code of the target
+block changes, whether from the host between two runs or from the guest
+while the loop is running.
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tap.h"
+
+#define CODE_ADDR 0x100000
+#define LOOPS 100000
+
+/*
+bits 32
+
+start:
+    mov ecx, LOOPS
+add:
+    add eax, 1          ; immediate at CODE_ADDR + 7
+    jmp next
+next:
+    dec ecx
+    jnz add
+    inc edx
+    cmp edx, 2
+    je end
+    mov byte [CODE_ADDR + 7], 2
+    jmp start
+end:
+*/
+static const unsigned char PROGRAM[] =
+    "\xb9\xa0\x86\x01\x00\x83\xc0\x01\xeb\x00\x49\x75\xf8\x42\x83\xfa"
+    "\x02\x74\x09\xc6\x05\x07\x00\x10\x00\x02\xeb\xe4";
+#define ADD_IMM (CODE_ADDR + 7)
+#define END (CODE_ADDR + sizeof(PROGRAM) - 1)
+
+static size_t lookups(uc_engine *uc)
+{
+    size_t reused = 0, translated = 0;
+
+    uc_query(uc, UC_QUERY_TB_REUSED, &reused);
+    uc_query(uc, UC_QUERY_TB_TRANSLATED, &translated);
+    return reused + translated;
+}
+
+/* Run the program with the given start value of edx, return eax. */
+static uint32_t run(uc_engine *uc, uint32_t edx, size_t *nr_lookups)
+{
+    uint32_t eax = 0;
+    size_t before = lookups(uc);
+
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_write(uc, UC_X86_REG_EDX, &edx);
+    if (uc_emu_start(uc, CODE_ADDR, END, 0, 0) != UC_ERR_OK) {
+        return 0;
+    }
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    *nr_lookups = lookups(uc) - before;
+    return eax;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    size_t n = 0;
+
+    printf("# block chaining\n");
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("not ok %d - uc_open() failed\n", log_num++);
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+
+    check(run(uc, 1, &n) == LOOPS, "loop of chained blocks");
+    check(n < LOOPS / 100, "loop runs without a block lookup per iteration");
+
+    uc_mem_write(uc, ADD_IMM, "\x02", 1);
+    check(run(uc, 1, &n) == 2 * LOOPS,
+            "chained block rewritten by the host between runs");
+    check(n < LOOPS / 100, "rewritten block is chained again");
+
+    uc_mem_write(uc, ADD_IMM, "\x01", 1);
+    check(run(uc, 0, &n) == 3 * LOOPS,
+            "chained block rewritten by the guest during the run");
+
+    uc_close(uc);
+    return failed;
+}
@@ -0,0 +1,135 @@
+/*
+Test for several engines running at the same time on different threads.
+
+Every thread opens its own engine, runs the same code on the same input
+and reports the resulting registers and memory checksum. All threads must
+agree with a reference run done on the main thread beforehand.
+
+With the TCI backend this used to fail: the interpreter register file was
+a global shared by every engine of the process.
+*/
+
+#include <unicorn/unicorn.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define NUM_THREADS 8
+#define NUM_ROUNDS 200
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x200000
+#define DATA_SIZE 0x1000
+
+/*
+bits 32
+
+    mov esi, 0x200000
+    mov ecx, 0x400
+    xor eax, eax
+    mov ebx, 0x9e3779b9
+loop:
+    mov edx, [esi]
+    imul edx, ebx
+    add eax, edx
+    rol eax, 5
+    xor [esi], eax
+    add esi, 4
+    dec ecx
+    jnz loop
+*/
+static const unsigned char PROGRAM[] =
+    "\xbe\x00\x00\x20\x00\xb9\x00\x04\x00\x00\x31\xc0\xbb\xb9\x79\x37"
+    "\x9e\x8b\x16\x0f\xaf\xd3\x01\xd0\xc1\xc0\x05\x31\x06\x83\xc6\x04"
+    "\x49\x75\xee";
+
+struct result {
+    uc_err err;
+    uint32_t eax;
+    uint32_t checksum;
+};
+
+static void *run_engine(void *param)
+{
+    struct result *res = (struct result *)param;
+    uint32_t buf[DATA_SIZE / 4];
+    uc_engine *uc;
+    int i;
+
+    memset(res, 0, sizeof(*res));
+
+    res->err = uc_open(UC_ARCH_X86, UC_MODE_32, &uc);
+    if (res->err)
+        return NULL;
+
+    for (i = 0; i < DATA_SIZE / 4; i++)
+        buf[i] = ((uint32_t)i * 0x01010101) ^ 0x5a5a5a5a;
+
+    if ((res->err = uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_READ | UC_PROT_EXEC)) ||
+        (res->err = uc_mem_map(uc, DATA_ADDR, DATA_SIZE, UC_PROT_READ | UC_PROT_WRITE)) ||
+        (res->err = uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1)) ||
+        (res->err = uc_mem_write(uc, DATA_ADDR, buf, DATA_SIZE))) {
+        uc_close(uc);
+        return NULL;
+    }
+
+    for (i = 0; i < NUM_ROUNDS; i++) {
+        res->err = uc_emu_start(uc, CODE_ADDR, CODE_ADDR + sizeof(PROGRAM) - 1, 0, 0);
+        if (res->err) {
+            uc_close(uc);
+            return NULL;
+        }
+    }
+
+    uc_reg_read(uc, UC_X86_REG_EAX, &res->eax);
+    res->err = uc_mem_read(uc, DATA_ADDR, buf, DATA_SIZE);
+    for (i = 0; i < DATA_SIZE / 4; i++)
+        res->checksum = (res->checksum << 1 | res->checksum >> 31) ^ buf[i];
+
+    uc_close(uc);
+    return NULL;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    pthread_t threads[NUM_THREADS];
+    struct result results[NUM_THREADS];
+    struct result reference;
+    int log_num = 1;
+    int failed = 0;
+    int i;
+
+    printf("# threaded engines test\n");
+
+    run_engine(&reference);
+    if (reference.err) {
+        printf("not ok %d - reference run failed: %s\n", log_num++, uc_strerror(reference.err));
+        return 1;
+    }
+    printf("ok %d - reference run: eax = 0x%08x, checksum = 0x%08x\n",
+            log_num++, reference.eax, reference.checksum);
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        if (pthread_create(&threads[i], NULL, run_engine, &results[i])) {
+            printf("not ok %d - pthread_create() failed\n", log_num++);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        if (results[i].err) {
+            printf("not ok %d - thread %d failed: %s\n", log_num++, i, uc_strerror(results[i].err));
+            failed = 1;
+        } else if (results[i].eax != reference.eax || results[i].checksum != reference.checksum) {
+            printf("not ok %d - thread %d: eax = 0x%08x, checksum = 0x%08x\n",
+                    log_num++, i, results[i].eax, results[i].checksum);
+            failed = 1;
+        } else {
+            printf("ok %d - thread %d matches the reference run\n", log_num++, i);
+        }
+    }
+
+    return failed;
+}
@@ -0,0 +1,19 @@
+/*
+Timing for the microbenchmarks.
+*/
+
+#ifndef UNIT_BENCH_H
+#define UNIT_BENCH_H
+
+#include <time.h>
+
+/* seconds on a monotonic clock */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#endif
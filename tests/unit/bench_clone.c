@@ -0,0 +1,99 @@
+/*
+Benchmark: fuzzing executions per second with an engine set up for each
+input, as tests/fuzz did, and with a clone of a template engine.
+
+Each execution maps 4MB, writes a short program over it and runs 4096
+instructions, like the fuzz targets. The program stores to a few pages so
+that closed clones have written pages to reset.
+
+Usage: ./bench_clone [executions]   (default: 20000)
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define ADDRESS 0x1000000
+#define SIZE (4 * 1024 * 1024)
+
+/*
+bits 32
+
+loop:
+    mov [ebx], eax
+    add ebx, 0x1000
+    and ebx, 0x1103fff
+    inc eax
+    jmp loop
+*/
+static const unsigned char PROGRAM[] =
+    "\x89\x03\x81\xc3\x00\x10\x00\x00\x81\xe3\xff\x3f\x10\x01\x40\xeb\xef";
+
+static void run(uc_engine *uc)
+{
+    uint32_t ebx = ADDRESS + 0x100000;
+
+    uc_mem_write(uc, ADDRESS, PROGRAM, sizeof(PROGRAM) - 1);
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    if (uc_emu_start(uc, ADDRESS, ADDRESS + SIZE, 0, 0x1000) != UC_ERR_OK) {
+        printf("uc_emu_start() failed\n");
+        exit(1);
+    }
+}
+
+/* Return executions per second with uc_open() and uc_mem_map() for each. */
+static double bench_open(unsigned execs)
+{
+    uc_engine *uc;
+    unsigned i;
+    double start = now();
+
+    for (i = 0; i < execs; i++) {
+        if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+            printf("uc_open() failed\n");
+            exit(1);
+        }
+        uc_mem_map(uc, ADDRESS, SIZE, UC_PROT_ALL);
+        run(uc);
+        uc_close(uc);
+    }
+    return execs / (now() - start);
+}
+
+/* Return executions per second with uc_clone() of a template for each. */
+static double bench_clone(unsigned execs)
+{
+    uc_engine *template, *uc;
+    unsigned i;
+    double start = now();
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &template)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+    uc_mem_map(template, ADDRESS, SIZE, UC_PROT_ALL);
+    for (i = 0; i < execs; i++) {
+        if (uc_clone(template, &uc)) {
+            printf("uc_clone() failed\n");
+            exit(1);
+        }
+        run(uc);
+        uc_close(uc);
+    }
+    uc_close(template);
+    return execs / (now() - start);
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    unsigned execs = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 20000;
+    double open, clone;
+
+    open = bench_open(execs);
+    clone = bench_clone(execs);
+    printf("uc_open:  %10.0f execs/s\n", open);
+    printf("uc_clone: %10.0f execs/s (x%.1f)\n", clone, clone / open);
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+Microbenchmark: guest AES-128 and GHASH with AES-NI and PCLMULQDQ.
+
+The guest encrypts a block with ten AES rounds and folds it into a GHASH
+accumulator with three carry-less multiplies, like the inner loop of
+AES-GCM. The benchmark runs again with UNICORN_NO_HOST_CRYPTO set to give
+the speed of the portable helpers.
+
+Usage: ./bench_crypto [blocks]   (default: 200000)
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define CODE_ADDR 0x100000
+#define KEYS_ADDR 0x200000
+
+/*
+bits 64
+
+loop:
+    pxor xmm0, [rsi]
+    aesenc xmm0, [rsi + 16]
+    ...
+    aesenc xmm0, [rsi + 144]
+    aesenclast xmm0, [rsi + 160]
+    pxor xmm1, xmm0
+    movdqa xmm3, xmm1
+    pclmulqdq xmm3, xmm2, 0x00
+    movdqa xmm4, xmm1
+    pclmulqdq xmm4, xmm2, 0x11
+    pclmulqdq xmm1, xmm2, 0x10
+    pxor xmm1, xmm3
+    pxor xmm1, xmm4
+    dec edx
+    jnz loop
+*/
+static const unsigned char PROGRAM[] =
+    "\x66\x0f\xef\x06\x66\x0f\x38\xdc\x46\x10\x66\x0f\x38\xdc\x46\x20"
+    "\x66\x0f\x38\xdc\x46\x30\x66\x0f\x38\xdc\x46\x40\x66\x0f\x38\xdc"
+    "\x46\x50\x66\x0f\x38\xdc\x46\x60\x66\x0f\x38\xdc\x46\x70\x66\x0f"
+    "\x38\xdc\x86\x80\x00\x00\x00\x66\x0f\x38\xdc\x86\x90\x00\x00\x00"
+    "\x66\x0f\x38\xdd\x86\xa0\x00\x00\x00\x66\x0f\xef\xc8\x66\x0f\x6f"
+    "\xd9\x66\x0f\x3a\x44\xda\x00\x66\x0f\x6f\xe1\x66\x0f\x3a\x44\xe2"
+    "\x11\x66\x0f\x3a\x44\xca\x10\x66\x0f\xef\xcb\x66\x0f\xef\xcc\xff"
+    "\xca\x75\x8d";
+
+int main(int argc, char **argv, char **envp)
+{
+    uint32_t blocks = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 200000;
+    unsigned char keys[11 * 16];
+    uint64_t rsi = KEYS_ADDR;
+    char cmd[4096];
+    uc_engine *uc;
+    double start;
+    int i;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_64, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+    for (i = 0; i < (int)sizeof(keys); i++)
+        keys[i] = (unsigned char)(i * 13 + 1);
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, KEYS_ADDR, 0x1000, UC_PROT_READ);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+    uc_mem_write(uc, KEYS_ADDR, keys, sizeof(keys));
+    uc_reg_write(uc, UC_X86_REG_RSI, &rsi);
+    uc_reg_write(uc, UC_X86_REG_EDX, &blocks);
+
+    start = now();
+    if (uc_emu_start(uc, CODE_ADDR, CODE_ADDR + sizeof(PROGRAM) - 1, 0, 0) != UC_ERR_OK) {
+        printf("uc_emu_start() failed\n");
+        return 1;
+    }
+    start = now() - start;
+    uc_close(uc);
+
+    printf("%-22s %10.1f MB/s\n", getenv("UNICORN_NO_HOST_CRYPTO") ?
+            "portable helpers:" : "host crypto:", blocks * 16.0 / (1024 * 1024) / start);
+    if (!getenv("UNICORN_NO_HOST_CRYPTO") && strlen(argv[0]) < sizeof(cmd) - 64) {
+        fflush(stdout);
+        snprintf(cmd, sizeof(cmd), "UNICORN_NO_HOST_CRYPTO=1 '%s' %u", argv[0], blocks);
+        return system(cmd) != 0;
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+Microbenchmark: finding the pages written by the guest.
+
+The guest stores to every word of a 1MB buffer, again and again. The pages
+it wrote are found once with a UC_HOOK_MEM_WRITE hook that marks them in a
+bitmap, and once with uc_mem_dirty_log_start() and uc_mem_dirty_log_get(),
+where only the first store to each page after a clear leaves the fast path.
+
+Usage: ./bench_dirty_log [passes]   (default: 200)
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x1000000
+#define DATA_SIZE (1024 * 1024)
+#define DATA_PAGES (DATA_SIZE / 0x1000)
+
+/*
+bits 32
+
+pass:
+    mov edi, 0x1000000
+    mov ecx, 0x40000
+store:
+    mov [edi], eax
+    add edi, 4
+    dec ecx
+    jnz store
+    dec edx
+    jnz pass
+*/
+static const unsigned char PROGRAM[] =
+    "\xbf\x00\x00\x00\x01\xb9\x00\x00\x04\x00\x89\x07\x83\xc7\x04\x49"
+    "\x75\xf8\x4a\x75\xeb";
+
+static uint8_t hook_bitmap[DATA_PAGES / 8];
+
+static void hook_write(uc_engine *uc, uc_mem_type type, uint64_t address,
+        int size, int64_t value, void *user_data)
+{
+    uint64_t page = (address - DATA_ADDR) / 0x1000;
+
+    hook_bitmap[page / 8] |= 1 << (page % 8);
+}
+
+static double run(uint32_t passes, int use_hook)
+{
+    uint8_t bitmap[DATA_PAGES / 8];
+    uc_hook hh;
+    uc_engine *uc;
+    double start;
+    uint32_t i, written = 0;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA_ADDR, DATA_SIZE, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM) - 1);
+    uc_reg_write(uc, UC_X86_REG_EDX, &passes);
+
+    memset(hook_bitmap, 0, sizeof(hook_bitmap));
+    if (use_hook)
+        uc_hook_add(uc, &hh, UC_HOOK_MEM_WRITE, hook_write, NULL, DATA_ADDR, DATA_ADDR + DATA_SIZE - 1, 0);
+    else
+        uc_mem_dirty_log_start(uc, DATA_ADDR, DATA_SIZE);
+
+    start = now();
+    if (uc_emu_start(uc, CODE_ADDR, CODE_ADDR + sizeof(PROGRAM) - 1, 0, 0) != UC_ERR_OK) {
+        printf("uc_emu_start() failed\n");
+        exit(1);
+    }
+    if (use_hook)
+        memcpy(bitmap, hook_bitmap, sizeof(bitmap));
+    else
+        uc_mem_dirty_log_get(uc, DATA_ADDR, DATA_SIZE, bitmap, true);
+    start = now() - start;
+    uc_close(uc);
+
+    for (i = 0; i < DATA_PAGES; i++)
+        written += (bitmap[i / 8] >> (i % 8)) & 1;
+    if (written != DATA_PAGES) {
+        printf("%u of %u pages reported written\n", written, DATA_PAGES);
+        exit(1);
+    }
+
+    return start;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uint32_t passes = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 200;
+    double hook = run(passes, 1);
+    double log = run(passes, 0);
+
+    printf("%-22s %10.1f MB/s\n", "UC_HOOK_MEM_WRITE:", passes * (double)DATA_SIZE / (1024 * 1024) / hook);
+    printf("%-22s %10.1f MB/s\n", "dirty log:", passes * (double)DATA_SIZE / (1024 * 1024) / log);
+
+    return 0;
+}
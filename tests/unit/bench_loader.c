@@ -0,0 +1,114 @@
+/*
+Microbenchmark: loading and unloading an image with many sections.
+
+A loader maps each section of a PE or ELF image, copies its contents in and
+sets its protection: code sections read-only and executable, data sections
+writable. Each of these changes rebuilds the view of all the regions and
+flushes the TLB, unless they are made in one batch between
+uc_mem_batch_begin() and uc_mem_batch_commit().
+
+Usage: ./bench_loader [sections...]   (default: 250 500 1000 2000)
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define IMAGE_ADDR 0x400000ULL
+#define SECTION_SIZE 0x2000
+
+static void fail(const char *what, uint64_t addr, uc_err err)
+{
+    printf("%s 0x%llx failed: %s\n", what, (unsigned long long)addr, uc_strerror(err));
+    exit(1);
+}
+
+// sections are a page apart, so that no two are merged
+static uint64_t section_addr(uint32_t i)
+{
+    return IMAGE_ADDR + i * (SECTION_SIZE + 0x1000ULL);
+}
+
+static void load(uc_engine *uc, uint32_t sections, const uint8_t *contents)
+{
+    uint64_t addr;
+    uint32_t i;
+    uc_err err;
+
+    for (i = 0; i < sections; i++) {
+        addr = section_addr(i);
+        if ((err = uc_mem_map(uc, addr, SECTION_SIZE, UC_PROT_READ | UC_PROT_WRITE)) != UC_ERR_OK)
+            fail("uc_mem_map", addr, err);
+        if ((err = uc_mem_write(uc, addr, contents, SECTION_SIZE)) != UC_ERR_OK)
+            fail("uc_mem_write", addr, err);
+        if (i % 4 == 0 && (err = uc_mem_protect(uc, addr, SECTION_SIZE, UC_PROT_READ | UC_PROT_EXEC)) != UC_ERR_OK)
+            fail("uc_mem_protect", addr, err);
+    }
+}
+
+static void unload(uc_engine *uc, uint32_t sections)
+{
+    uint64_t addr;
+    uint32_t i;
+    uc_err err;
+
+    for (i = 0; i < sections; i++) {
+        addr = section_addr(i);
+        if ((err = uc_mem_unmap(uc, addr, SECTION_SIZE)) != UC_ERR_OK)
+            fail("uc_mem_unmap", addr, err);
+    }
+}
+
+/* Load and unload an image of @sections sections, in batches if @batch is set. */
+static void run(uint32_t sections, int batch, const uint8_t *contents)
+{
+    uc_engine *uc;
+    double load_time, unload_time;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_64, &uc)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+
+    load_time = now();
+    if (batch)
+        uc_mem_batch_begin(uc);
+    load(uc, sections, contents);
+    if (batch)
+        uc_mem_batch_commit(uc);
+    load_time = now() - load_time;
+
+    unload_time = now();
+    if (batch)
+        uc_mem_batch_begin(uc);
+    unload(uc, sections);
+    if (batch)
+        uc_mem_batch_commit(uc);
+    unload_time = now() - unload_time;
+
+    uc_close(uc);
+
+    printf("%6u sections %-9s load %8.3f s, unload %8.3f s\n",
+            sections, batch ? "batched:" : "one by one:", load_time, unload_time);
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    static const uint32_t defaults[] = { 250, 500, 1000, 2000 };
+    uint8_t *contents = malloc(SECTION_SIZE);
+    uint32_t sections;
+    int i, n = argc > 1 ? argc - 1 : (int)(sizeof(defaults) / sizeof(defaults[0]));
+
+    memset(contents, 0x90, SECTION_SIZE);
+    for (i = 0; i < n; i++) {
+        sections = argc > 1 ? (uint32_t)strtoul(argv[i + 1], NULL, 0) : defaults[i];
+        run(sections, 0, contents);
+        run(sections, 1, contents);
+    }
+    free(contents);
+
+    return 0;
+}
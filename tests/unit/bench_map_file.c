@@ -0,0 +1,77 @@
+/*
+Microbenchmark: loading a disk image into guest memory.
+
+The image is either read into a buffer and copied in with uc_mem_write(),
+or mapped in with uc_mem_map_file(). The guest then touches a few pages of
+it, as firmware probing a disk would.
+
+Usage: ./bench_map_file [MB] [pages touched]   (default: 256 64)
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "bench.h"
+
+#define IMAGE_ADDR 0x10000000ULL
+
+static void touch(uc_engine *uc, size_t size, uint32_t pages)
+{
+    uint32_t i, value;
+
+    for (i = 0; i < pages; i++)
+        uc_mem_read(uc, IMAGE_ADDR + (size / pages) * i, &value, sizeof(value));
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    size_t size = (argc > 1 ? strtoul(argv[1], NULL, 0) : 256) << 20;
+    uint32_t pages = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 64;
+    char path[] = "/tmp/bench_map_file_XXXXXX";
+    uint8_t *buf = malloc(size);
+    double t_copy, t_map;
+    uc_engine *uc;
+    int fd;
+
+    fd = mkstemp(path);
+    memset(buf, 0x90, size);
+    if (fd < 0 || write(fd, buf, size) != (ssize_t)size) {
+        printf("cannot write the image\n");
+        return 1;
+    }
+    unlink(path);
+
+    uc_open(UC_ARCH_X86, UC_MODE_64, &uc);
+    t_copy = now();
+    if (pread(fd, buf, size, 0) != (ssize_t)size) {
+        printf("cannot read the image\n");
+        return 1;
+    }
+    uc_mem_map(uc, IMAGE_ADDR, size, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_write(uc, IMAGE_ADDR, buf, size);
+    touch(uc, size, pages);
+    t_copy = now() - t_copy;
+    uc_close(uc);
+    free(buf);
+
+    uc_open(UC_ARCH_X86, UC_MODE_64, &uc);
+    t_map = now();
+    if (uc_mem_map_file(uc, IMAGE_ADDR, size, UC_PROT_READ | UC_PROT_WRITE, fd, 0) != UC_ERR_OK) {
+        printf("uc_mem_map_file() failed\n");
+        return 1;
+    }
+    touch(uc, size, pages);
+    t_map = now() - t_map;
+    uc_close(uc);
+    close(fd);
+
+    printf("%zu MB image, %u pages touched\n", size >> 20, pages);
+    printf("%-10s %8.3f ms\n", "copied:", t_copy * 1000);
+    printf("%-10s %8.3f ms\n", "mapped:", t_map * 1000);
+
+    return 0;
+}
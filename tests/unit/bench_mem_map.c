@@ -0,0 +1,134 @@
+/*
+Microbenchmark: mapping and unmapping many small regions.
+
+Every region gets its own RAM block, so placing a block in the RAM address
+space and finding the block of a RAM address should not slow down as
+blocks are added. The pages are mapped apart so that no two regions are
+merged, unmapped every other one first to leave gaps to be reused, mapped
+again and finally all unmapped.
+
+Each map and unmap on its own rebuilds the flat view of all the regions,
+which is what remains of the cost. Each step is therefore also timed in a
+uc_mem_batch_begin()/uc_mem_batch_commit() pair, which rebuilds it once.
+
+Usage: ./bench_mem_map [pages...]   (default: 500 1000 2000 one at a time,
+                                     then 10000 100000 in batches)
+       ./bench_mem_map -b [pages...]   (in batches)
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define DATA_ADDR 0x10000000ULL
+
+static void fail(const char *what, uint64_t addr, uc_err err)
+{
+    printf("%s 0x%llx failed: %s\n", what, (unsigned long long)addr, uc_strerror(err));
+    exit(1);
+}
+
+static void begin(uc_engine *uc, int batch)
+{
+    if (batch)
+        uc_mem_batch_begin(uc);
+}
+
+static void commit(uc_engine *uc, int batch)
+{
+    uc_err err;
+
+    if (batch && (err = uc_mem_batch_commit(uc)) != UC_ERR_OK)
+        fail("uc_mem_batch_commit", 0, err);
+}
+
+static void run(uint32_t pages, int batch)
+{
+    uc_engine *uc;
+    uc_err err;
+    uint64_t addr;
+    uint32_t i, value;
+    double map, remap, unmap;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_64, &uc)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+
+    map = now();
+    begin(uc, batch);
+    for (i = 0; i < pages; i++) {
+        addr = DATA_ADDR + i * 0x2000ULL;
+        if ((err = uc_mem_map(uc, addr, 0x1000, UC_PROT_READ | UC_PROT_WRITE)) != UC_ERR_OK)
+            fail("uc_mem_map", addr, err);
+    }
+    commit(uc, batch);
+    map = now() - map;
+
+    remap = now();
+    begin(uc, batch);
+    for (i = 0; i < pages; i += 2) {
+        addr = DATA_ADDR + i * 0x2000ULL;
+        if ((err = uc_mem_unmap(uc, addr, 0x1000)) != UC_ERR_OK)
+            fail("uc_mem_unmap", addr, err);
+    }
+    for (i = 0; i < pages; i += 2) {
+        addr = DATA_ADDR + i * 0x2000ULL;
+        if ((err = uc_mem_map(uc, addr, 0x1000, UC_PROT_READ | UC_PROT_WRITE)) != UC_ERR_OK)
+            fail("uc_mem_map", addr, err);
+        value = i;
+        uc_mem_write(uc, addr, &value, sizeof(value));
+    }
+    commit(uc, batch);
+    remap = now() - remap;
+
+    for (i = 0; i < pages; i += 2) {
+        addr = DATA_ADDR + i * 0x2000ULL;
+        if (uc_mem_read(uc, addr, &value, sizeof(value)) != UC_ERR_OK || value != i) {
+            printf("page 0x%llx lost its contents\n", (unsigned long long)addr);
+            exit(1);
+        }
+    }
+
+    unmap = now();
+    begin(uc, batch);
+    for (i = 0; i < pages; i++) {
+        addr = DATA_ADDR + i * 0x2000ULL;
+        if ((err = uc_mem_unmap(uc, addr, 0x1000)) != UC_ERR_OK)
+            fail("uc_mem_unmap", addr, err);
+    }
+    commit(uc, batch);
+    unmap = now() - unmap;
+
+    uc_close(uc);
+
+    printf("%8u pages%s: map %8.3f s, unmap half and map again %8.3f s, unmap %8.3f s\n",
+            pages, batch ? " in a batch" : "", map, remap, unmap);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    int i, batch = 0;
+
+    if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+        batch = 1;
+        argc--;
+        argv++;
+    }
+    if (argc > 1) {
+        for (i = 1; i < argc; i++)
+            run((uint32_t)strtoul(argv[i], NULL, 0), batch);
+    } else {
+        run(500, 0);
+        run(1000, 0);
+        run(2000, 0);
+        run(10000, 1);
+        run(100000, 1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+Microbenchmark: protecting single pages of a large region.
+
+A JIT writes code to a page of its code cache, makes the page executable and
+runs it, then makes it writable again to patch it. Changing the protection of
+one page should cost the same whatever the size of the region it is in.
+
+Usage: ./bench_mem_protect [flips] [region MB...]   (default: 2000 1 16 256)
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define CACHE_ADDR 0x10000000ULL
+
+/* Return the W^X flips per second of a page in a region of @mb MB. */
+static double run(uint32_t mb, uint32_t flips)
+{
+    uint64_t addr = CACHE_ADDR + mb * 0x80000ULL;
+    uc_engine *uc;
+    double start;
+    uint32_t i;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_64, &uc)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+    if (uc_mem_map(uc, CACHE_ADDR, mb * 0x100000ULL, UC_PROT_READ | UC_PROT_WRITE)) {
+        printf("uc_mem_map() failed\n");
+        exit(1);
+    }
+
+    start = now();
+    for (i = 0; i < flips; i++) {
+        if (uc_mem_protect(uc, addr, 0x1000, UC_PROT_READ | UC_PROT_EXEC) != UC_ERR_OK
+                || uc_mem_protect(uc, addr, 0x1000, UC_PROT_READ | UC_PROT_WRITE) != UC_ERR_OK) {
+            printf("uc_mem_protect() failed\n");
+            exit(1);
+        }
+    }
+    start = now() - start;
+
+    uc_close(uc);
+
+    return flips / start;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    static const uint32_t defaults[] = { 1, 16, 256 };
+    uint32_t flips = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 2000;
+    uint32_t mb;
+    int i, n = argc > 2 ? argc - 2 : (int)(sizeof(defaults) / sizeof(defaults[0]));
+
+    for (i = 0; i < n; i++) {
+        mb = argc > 2 ? (uint32_t)strtoul(argv[i + 2], NULL, 0) : defaults[i];
+        printf("%5u MB region: %10.0f flips/s\n", mb, run(mb, flips));
+    }
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+Microbenchmark: host access to guest buffers, copied or in place.
+
+A syscall layer fills the buffer of a read() and sums the buffer of a
+write(). Through uc_mem_write() and uc_mem_read() each buffer is copied once
+more; through uc_mem_get_ptr() it is accessed in place.
+
+Usage: ./bench_mem_ptr [buffer KB] [MB]   (default: 64 2048)
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define BUF_ADDR 0x10000000ULL
+
+static uint64_t sum(const uint8_t *buf, size_t size)
+{
+    uint64_t s = 0;
+    size_t i;
+
+    for (i = 0; i < size; i++)
+        s += buf[i];
+    return s;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    size_t size = (argc > 1 ? strtoul(argv[1], NULL, 0) : 64) * 1024;
+    uint64_t total = (argc > 2 ? strtoull(argv[2], NULL, 0) : 2048) << 20;
+    uint64_t calls = total / size, i, s = 0;
+    uint8_t *host = malloc(size), *ptr;
+    double t_copy, t_ptr;
+    uc_engine *uc;
+    void *p;
+    size_t len;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_64, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+    uc_mem_map(uc, BUF_ADDR, (size + 0xfff) & ~(size_t)0xfff, UC_PROT_READ | UC_PROT_WRITE);
+
+    t_copy = now();
+    for (i = 0; i < calls; i++) {
+        memset(host, (int)i, size);
+        uc_mem_write(uc, BUF_ADDR, host, size);
+        uc_mem_read(uc, BUF_ADDR, host, size);
+        s += sum(host, size);
+    }
+    t_copy = now() - t_copy;
+
+    t_ptr = now();
+    for (i = 0; i < calls; i++) {
+        if (uc_mem_get_ptr(uc, BUF_ADDR, size, &p, &len) != UC_ERR_OK || len != size) {
+            printf("uc_mem_get_ptr() failed\n");
+            return 1;
+        }
+        ptr = p;
+        memset(ptr, (int)i, size);
+        uc_mem_written(uc, BUF_ADDR, size);
+        s -= sum(ptr, size);
+    }
+    t_ptr = now() - t_ptr;
+
+    uc_close(uc);
+    free(host);
+
+    printf("%zu KB buffers, %s\n", size / 1024, s ? "MISMATCH" : "same sums");
+    printf("%-10s %8.0f MB/s\n", "copied:", (calls * size >> 20) / t_copy);
+    printf("%-10s %8.0f MB/s\n", "in place:", (calls * size >> 20) / t_ptr);
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+Microbenchmark: arm64 NEON integer instructions on host SIMD.
+
+The guest loop runs saturating, halving, min/max, compare, multiply,
+absolute difference, narrowing and table lookup instructions, which the
+NEON helpers do with SSE2 or SSSE3 on x86 hosts. The benchmark runs again
+with UNICORN_NO_HOST_SIMD set to give the speed of the per-lane C code.
+
+Usage: ./bench_neon [iterations]   (default: 1000000)
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define CODE_ADDR 0x100000
+
+/*
+loop:
+    sqadd v0.16b, v0.16b, v8.16b
+    uhadd v1.8h, v1.8h, v9.8h
+    smax v2.16b, v2.16b, v8.16b
+    cmhi v3.8h, v1.8h, v9.8h
+    sqdmulh v4.8h, v4.8h, v9.8h
+    umull v5.8h, v0.8b, v8.8b
+    uabd v6.16b, v6.16b, v2.16b
+    sqxtn v7.8b, v5.8h
+    tbl v10.16b, {v16.16b, v17.16b}, v0.16b
+    eor v11.16b, v11.16b, v3.16b
+    subs w1, w1, #1
+    b.ne loop
+*/
+static const uint32_t PROGRAM[] = {
+    0x4e280c00, 0x6e690421, 0x4e286442, 0x6e693423,
+    0x4e69b484, 0x2e28c005, 0x6e2274c6, 0x0e2148a7,
+    0x4e00220a, 0x6e231d6b, 0x71000421, 0x54fffea1,
+};
+
+int main(int argc, char **argv, char **envp)
+{
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 1000000;
+    uint64_t cpacr = 3 << 20;
+    uint64_t v[2];
+    char cmd[4096];
+    uc_engine *uc;
+    double start;
+    int i;
+
+    if (uc_open(UC_ARCH_ARM64, UC_MODE_ARM, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+    uc_reg_write(uc, UC_ARM64_REG_CPACR_EL1, &cpacr);
+    for (i = 0; i < 32; i++) {
+        v[0] = 0x0123456789abcdefULL * (i + 1);
+        v[1] = 0xfedcba9876543210ULL ^ (i * 0x1111);
+        uc_reg_write(uc, UC_ARM64_REG_Q0 + i, v);
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE_ADDR, PROGRAM, sizeof(PROGRAM));
+    uc_reg_write(uc, UC_ARM64_REG_W1, &iterations);
+
+    start = now();
+    if (uc_emu_start(uc, CODE_ADDR, CODE_ADDR + sizeof(PROGRAM), 0, 0) != UC_ERR_OK) {
+        printf("uc_emu_start() failed\n");
+        return 1;
+    }
+    start = now() - start;
+    uc_close(uc);
+
+    printf("%-22s %10.1f M insns/s\n", getenv("UNICORN_NO_HOST_SIMD") ?
+            "per-lane helpers:" : "host SIMD:",
+            iterations * 10.0 / 1e6 / start);
+    if (!getenv("UNICORN_NO_HOST_SIMD") && strlen(argv[0]) < sizeof(cmd) - 64) {
+        fflush(stdout);
+        snprintf(cmd, sizeof(cmd), "UNICORN_NO_HOST_SIMD=1 '%s' %u", argv[0], iterations);
+        return system(cmd) != 0;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+Microbenchmark: host writes to read-only and to writable memory.
+
+A debugger sets and clears a breakpoint in read-only code again and again,
+with a few hundred other regions mapped. Writing read-only memory should
+cost about as much as writing writable memory, however many regions there
+are.
+
+Usage: ./bench_ro_write [writes] [regions]   (default: 100000 256)
+*/
+
+#include <unicorn/unicorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define CODE_ADDR 0x100000
+#define DATA_ADDR 0x200000
+#define OTHER_ADDR 0x1000000
+
+/* Return host writes per second to @addr. */
+static double run(uc_engine *uc, uint64_t addr, uint32_t writes)
+{
+    static const uint8_t patch[2] = { 0xcc, 0x90 };
+    double start = now();
+    uint32_t i;
+
+    for (i = 0; i < writes; i++) {
+        if (uc_mem_write(uc, addr, &patch[i & 1], 1) != UC_ERR_OK) {
+            printf("uc_mem_write() failed\n");
+            exit(1);
+        }
+    }
+
+    return writes / (now() - start);
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uint32_t writes = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 100000;
+    uint32_t regions = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 256;
+    uc_engine *uc;
+    uint32_t i;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+    uc_mem_map(uc, CODE_ADDR, 0x1000, UC_PROT_READ | UC_PROT_EXEC);
+    uc_mem_map(uc, DATA_ADDR, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    for (i = 0; i < regions; i++)
+        uc_mem_map(uc, OTHER_ADDR + i * 0x2000, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+
+    printf("%-22s %10.0f writes/s\n", "read-only memory:", run(uc, CODE_ADDR, writes));
+    printf("%-22s %10.0f writes/s\n", "writable memory:", run(uc, DATA_ADDR, writes));
+
+    uc_close(uc);
+
+    return 0;
+}
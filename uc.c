@@ -13,6 +13,12 @@
 
 #include <string.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "uc_priv.h"
 
 // target specific headers
@@ -152,10 +158,6 @@ uc_err uc_open(uc_arch arch, uc_mode mode, uc_engine **result)
         uc->arch = arch;
         uc->mode = mode;
 
-        // uc->ram_list = { .blocks = QTAILQ_HEAD_INITIALIZER(ram_list.blocks) };
-        uc->ram_list.blocks.tqh_first = NULL;
-        uc->ram_list.blocks.tqh_last = &(uc->ram_list.blocks.tqh_first);
-
         uc->memory_listeners.tqh_first = NULL;
         uc->memory_listeners.tqh_last = &uc->memory_listeners.tqh_first;
 
@@ -288,6 +290,148 @@ uc_err uc_open(uc_arch arch, uc_mode mode, uc_engine **result)
 }
 
 
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static bool hook_covers(const struct hook *hook, uint64_t addr)
+{
+    return hook->begin > hook->end || (addr >= hook->begin && addr <= hook->end);
+}
+
+static struct hook_table *hook_table_build(struct list *list)
+{
+    struct hook_table *table;
+    struct list_item *cur;
+    struct hook *hook;
+    uint64_t *bounds;
+    size_t nbounds = 1, nhooks = 0, total = 0, count, i, j;
+
+    for (cur = list->head; cur != NULL; cur = cur->next)
+        nhooks++;
+
+    // segments start at 0 and at the bounds of every bounded hook
+    bounds = malloc((2 * nhooks + 1) * sizeof(*bounds));
+    if (bounds == NULL)
+        return NULL;
+    bounds[0] = 0;
+    for (cur = list->head; cur != NULL && (hook = (struct hook *)cur->data); cur = cur->next) {
+        if (hook->to_delete || hook->begin > hook->end)
+            continue;
+        bounds[nbounds++] = hook->begin;
+        if (hook->end != UINT64_MAX)
+            bounds[nbounds++] = hook->end + 1;
+    }
+    qsort(bounds, nbounds, sizeof(*bounds), cmp_u64);
+    for (i = 1, count = 1; i < nbounds; i++) {
+        if (bounds[i] != bounds[count - 1])
+            bounds[count++] = bounds[i];
+    }
+
+    for (i = 0; i < count; i++) {
+        for (cur = list->head; cur != NULL && (hook = (struct hook *)cur->data); cur = cur->next) {
+            if (!hook->to_delete && hook_covers(hook, bounds[i]))
+                total++;
+        }
+    }
+
+    table = malloc(sizeof(*table) + count * sizeof(*table->start) +
+            total * sizeof(*table->hooks) + (count + 1) * sizeof(*table->first));
+    if (table == NULL) {
+        free(bounds);
+        return NULL;
+    }
+    table->count = (uint32_t)count;
+    table->start = (uint64_t *)(table + 1);
+    table->hooks = (struct hook **)(table->start + count);
+    table->first = (uint32_t *)(table->hooks + total);
+    memcpy(table->start, bounds, count * sizeof(*bounds));
+    free(bounds);
+
+    for (i = 0, j = 0; i < count; i++) {
+        table->first[i] = (uint32_t)j;
+        for (cur = list->head; cur != NULL && (hook = (struct hook *)cur->data); cur = cur->next) {
+            if (!hook->to_delete && hook_covers(hook, table->start[i]))
+                table->hooks[j++] = hook;
+        }
+    }
+    table->first[count] = (uint32_t)j;
+
+    return table;
+}
+
+// the hooks of list @idx changed: drop its index, a dispatch running in a
+// callback may still walk it, so it is only freed after emulation
+static void hook_table_invalidate(uc_engine *uc, int idx)
+{
+    if (uc->hook_table[idx] != NULL) {
+        list_append(&uc->hook_tables_retired, uc->hook_table[idx]);
+        uc->hook_table[idx] = NULL;
+    }
+}
+
+static void free_retired_hook_tables(uc_engine *uc)
+{
+    struct list_item *cur;
+
+    for (cur = uc->hook_tables_retired.head; cur != NULL; cur = cur->next)
+        free(cur->data);
+    list_clear(&uc->hook_tables_retired);
+}
+
+void hook_iter_start(struct uc_struct *uc, int idx, uint64_t addr, struct hook_iter *it)
+{
+    struct hook_table *table = uc->hook_table[idx];
+    uint32_t left, right, mid;
+
+    it->cur = it->end = NULL;
+    it->item = NULL;
+    it->addr = addr;
+
+    if (table == NULL) {
+        if (uc->hook[idx].head == NULL)
+            return;
+        table = hook_table_build(&uc->hook[idx]);
+        if (table == NULL) {
+            // out of memory: walk the list, the table is tried again next time
+            it->item = uc->hook[idx].head;
+            return;
+        }
+        uc->hook_table[idx] = table;
+    }
+
+    // last segment starting at or before addr
+    left = 0;
+    right = table->count;
+    while (right - left > 1) {
+        mid = left + (right - left) / 2;
+        if (table->start[mid] <= addr)
+            left = mid;
+        else
+            right = mid;
+    }
+
+    it->cur = table->hooks + table->first[left];
+    it->end = table->hooks + table->first[left + 1];
+}
+
+struct hook *hook_iter_next_item(struct hook_iter *it)
+{
+    struct hook *hook;
+
+    while (it->item != NULL) {
+        hook = (struct hook *)it->item->data;
+        it->item = it->item->next;
+        if (!hook->to_delete && hook_covers(hook, it->addr))
+            return hook;
+    }
+
+    return NULL;
+}
+
 UNICORN_EXPORT
 uc_err uc_close(uc_engine *uc)
 {
@@ -295,6 +439,33 @@ uc_err uc_close(uc_engine *uc)
     struct list_item *cur;
     struct hook *hook;
 
+    // free the regions unmapped in a batch left open
+    if (uc->mem_batch_depth) {
+        uc->mem_batch_depth = 1;
+        uc_mem_batch_commit(uc);
+    }
+
+    // keep an unchanged clone for the next uc_clone() of its template
+    if (uc->clone_template) {
+        list_remove(&uc->clone_template->clones, uc);
+        if (uc->layout_gen == uc->clone_layout_gen &&
+                list_append(&uc->clone_template->clones_spare, uc)) {
+            return UC_ERR_OK;
+        }
+        uc->clone_template = NULL;
+    }
+
+    // clones outlive their template
+    for (cur = uc->clones.head; cur != NULL; cur = cur->next) {
+        ((struct uc_struct *)cur->data)->clone_template = NULL;
+    }
+    list_clear(&uc->clones);
+    for (cur = uc->clones_spare.head; cur != NULL; cur = cur->next) {
+        ((struct uc_struct *)cur->data)->clone_template = NULL;
+        uc_close((struct uc_struct *)cur->data);
+    }
+    list_clear(&uc->clones_spare);
+
     // Cleanup internally.
     if (uc->release)
         uc->release(uc->tcg_ctx);
@@ -338,6 +509,9 @@ uc_err uc_close(uc_engine *uc)
     for (i = 0; i < DIRTY_MEMORY_NUM; i++) {
         free(uc->ram_list.dirty_memory[i]);
     }
+    free(uc->ram_list.blocks);
+    free(uc->ram_list.blocks_by_host);
+    free(uc->ram_list.gaps);
 
     // free hooks and hook lists
     for (i = 0; i < UC_HOOK_MAX; i++) {
@@ -352,9 +526,21 @@ uc_err uc_close(uc_engine *uc)
             cur = cur->next;
         }
         list_clear(&uc->hook[i]);
+        free(uc->hook_table[i]);
     }
+    free_retired_hook_tables(uc);
 
     free(uc->mapped_blocks);
+    free(uc->unmapped_blocks);
+
+    // no region is left in the memory mapped from files
+#ifndef _WIN32
+    for (i = 0; i < (int)uc->mapped_file_count; i++) {
+        munmap(uc->mapped_files[i].host, uc->mapped_files[i].size);
+        close(uc->mapped_files[i].fd);
+    }
+#endif
+    free(uc->mapped_files);
 
     // free the saved contexts list and notify them that uc has been closed.
     cur = uc->saved_contexts.head;
@@ -366,6 +552,16 @@ uc_err uc_close(uc_engine *uc)
     }
     list_clear(&uc->saved_contexts);
 
+    // notify the snapshots that uc has been closed.
+    cur = uc->snapshots.head;
+    while (cur != NULL) {
+        struct uc_snapshot *snapshot = (struct uc_snapshot*)cur->data;
+        snapshot->uc = NULL;
+        cur = cur->next;
+    }
+    list_clear(&uc->snapshots);
+    free(uc->dirty_ranges);
+
     // finally, free uc itself.
     memset(uc, 0, sizeof(*uc));
     free(uc);
@@ -411,6 +607,24 @@ uc_err uc_reg_write(uc_engine *uc, int regid, const void *value)
     return uc_reg_write_batch(uc, &regid, (void *const *)&value, 1);
 }
 
+// apply the changes of the open batch to the flat view, which MMIO
+// accesses and the guest go through, and drop the TLB entries that
+// permissions changed in the batch made stale
+static void mem_batch_flush(uc_engine *uc)
+{
+    if (!uc->mem_batch_depth)
+        return;
+
+    if (uc->memory_region_update_pending) {
+        uc->memory_batch(uc, false);
+        uc->memory_batch(uc, true);
+    }
+    if (uc->mem_batch_tlb_flush) {
+        uc->mem_batch_tlb_flush = false;
+        uc->uc_tlb_flush(uc);
+    }
+}
+
 // check if a memory area is mapped
 // this is complicated because an area can overlap adjacent blocks
 static bool check_mem_area(uc_engine *uc, uint64_t address, size_t size)
@@ -449,8 +663,13 @@ uc_err uc_mem_read(uc_engine *uc, uint64_t address, void *_bytes, size_t size)
         MemoryRegion *mr = memory_mapping(uc, address);
         if (mr) {
             len = (size_t)MIN(size - count, mr->end - address);
-            if (uc->read_mem(&uc->as, address, bytes, len) == false)
-                break;
+            if (mr->ram) {
+                uc->read_ram(uc, mr, address - mr->addr, bytes, len);
+            } else {
+                mem_batch_flush(uc);
+                if (uc->read_mem(&uc->as, address, bytes, len) == false)
+                    break;
+            }
             count += len;
             address += len;
             bytes += len;
@@ -477,22 +696,33 @@ uc_err uc_mem_write(uc_engine *uc, uint64_t address, const void *_bytes, size_t
     if (!check_mem_area(uc, address, size))
         return UC_ERR_WRITE_UNMAPPED;
 
+    uc->content_gen++;
+
     // memory area can overlap adjacent memory blocks
     while(count < size) {
         MemoryRegion *mr = memory_mapping(uc, address);
         if (mr) {
             uint32_t operms = mr->perms;
-            if (!(operms & UC_PROT_WRITE)) // write protected
-                // but this is not the program accessing memory, so temporarily mark writable
-                uc->readonly_mem(mr, false);
 
             len = (size_t)MIN(size - count, mr->end - address);
-            if (uc->write_mem(&uc->as, address, bytes, len) == false)
-                break;
+            if (mr->ram) {
+                // this is not the program accessing memory: write the RAM
+                // directly, whatever its protection, leaving the TLB as it is
+                uc->write_ram(uc, mr, address - mr->addr, bytes, len);
+            } else {
+                mem_batch_flush(uc);
+
+                if (!(operms & UC_PROT_WRITE)) // write protected
+                    // but this is not the program accessing memory, so temporarily mark writable
+                    uc->readonly_mem(mr, false);
 
-            if (!(operms & UC_PROT_WRITE)) // write protected
-                // now write protect it again
-                uc->readonly_mem(mr, true);
+                if (uc->write_mem(&uc->as, address, bytes, len) == false)
+                    break;
+
+                if (!(operms & UC_PROT_WRITE)) // write protected
+                    // now write protect it again
+                    uc->readonly_mem(mr, true);
+            }
 
             count += len;
             address += len;
@@ -507,43 +737,57 @@ uc_err uc_mem_write(uc_engine *uc, uint64_t address, const void *_bytes, size_t
         return UC_ERR_WRITE_UNMAPPED;
 }
 
-#define TIMEOUT_STEP 2    // microseconds
-static void *_timeout_fn(void *arg)
+UNICORN_EXPORT
+uc_err uc_mem_get_ptr(uc_engine *uc, uint64_t address, size_t size, void **ptr, size_t *len)
 {
-    struct uc_struct *uc = arg;
-    int64_t current_time = get_clock();
-
-    do {
-        usleep(TIMEOUT_STEP);
-        // perhaps emulation is even done before timeout?
-        if (uc->emulation_done)
-            break;
-    } while((uint64_t)(get_clock() - current_time) < uc->timeout);
+    MemoryRegion *mr;
 
-    // timeout before emulation is done?
-    if (!uc->emulation_done) {
-        uc->timed_out = true;
-        // force emulation to stop
-        uc_emu_stop(uc);
+    if (uc->mem_redirect) {
+        address = uc->mem_redirect(address);
     }
 
-    return NULL;
-}
+    if (size == 0)
+        return UC_ERR_ARG;
 
-static void enable_emu_timer(uc_engine *uc, uint64_t timeout)
-{
-    uc->timeout = timeout;
-    qemu_thread_create(uc, &uc->timer, "timeout", _timeout_fn,
-            uc, QEMU_THREAD_JOINABLE);
+    mr = memory_mapping(uc, address);
+    if (mr == NULL)
+        return UC_ERR_READ_UNMAPPED;
+
+    // MMIO has no memory behind it
+    if (!mr->ram)
+        return UC_ERR_ARG;
+
+    // the blocks of adjacent regions need not be adjacent in the host
+    *len = (size_t)MIN(size, mr->end - address);
+    *ptr = uc->get_ram_ptr(uc, mr, address - mr->addr, len);
+
+    return UC_ERR_OK;
 }
 
-static void hook_count_cb(struct uc_struct *uc, uint64_t address, uint32_t size, void *user_data)
+UNICORN_EXPORT
+uc_err uc_mem_written(uc_engine *uc, uint64_t address, size_t size)
 {
-    // count this instruction. ah ah ah.
-    uc->emu_counter++;
+    size_t count = 0, len;
 
-    if (uc->emu_counter > uc->emu_count)
-        uc_emu_stop(uc);
+    if (uc->mem_redirect) {
+        address = uc->mem_redirect(address);
+    }
+
+    if (!check_mem_area(uc, address, size))
+        return UC_ERR_WRITE_UNMAPPED;
+
+    uc->content_gen++;
+
+    while(count < size) {
+        MemoryRegion *mr = memory_mapping(uc, address);
+        len = (size_t)MIN(size - count, mr->end - address);
+        if (mr->ram)
+            uc->ram_written(uc, mr, address - mr->addr, len);
+        count += len;
+        address += len;
+    }
+
+    return UC_ERR_OK;
 }
 
 static void clear_deleted_hooks(uc_engine *uc)
@@ -567,6 +811,7 @@ static void clear_deleted_hooks(uc_engine *uc)
     }
 
     list_clear(&uc->hooks_to_del);
+    free_retired_hook_tables(uc);
 }
 
 UNICORN_EXPORT int uc_hit_execution_limit(uc_engine* uc) {
@@ -583,6 +828,11 @@ uc_err uc_emu_start(uc_engine* uc, uint64_t begin, uint64_t until, uint64_t time
     uc->emulation_done = false;
     uc->size_recur_mem = 0;
     uc->timed_out = false;
+    // the guest writes memory that clones are reset from
+    uc->content_gen++;
+
+    // the guest sees the regions mapped in an open batch
+    mem_batch_flush(uc);
 
     switch(uc->arch) {
         default:
@@ -643,30 +893,41 @@ uc_err uc_emu_start(uc_engine* uc, uint64_t begin, uint64_t until, uint64_t time
     uc->stop_request = false;
 
     uc->emu_count = count;
-    // remove count hook if counting isn't necessary
-    if (count <= 0 && uc->count_hook != 0) {
-        uc_hook_del(uc, uc->count_hook);
-        uc->count_hook = 0;
-    }
-    // set up count hook to count instructions.
-    if (count > 0 && uc->count_hook == 0) {
-        uc_err err;
-        // callback to count instructions must be run before everything else,
-        // so instead of appending, we must insert the hook at the begin
-        // of the hook list
-        uc->hook_insert = 1;
-        err = uc_hook_add(uc, &uc->count_hook, UC_HOOK_CODE, hook_count_cb, NULL, 1, 0, 0);
-        // restore to append mode for uc_hook_add()
-        uc->hook_insert = 0;
-        if (err != UC_ERR_OK) {
-            return err;
-        }
+    uc->timeout = timeout * 1000;   // microseconds -> nanoseconds
+    if (timeout) {
+        uc->timeout_deadline = get_clock() + uc->timeout;
+    }
+    // instructions are counted by the translated code itself, which only
+    // carries the counter when @count or @timeout is set: cpu_exec() checks
+    // the deadline of @timeout each time a slice of the count runs out
+    if (uc->icount != (count > 0 || timeout > 0)) {
+        uc->icount = count > 0 || timeout > 0;
+        uc->tb_flush_pending = true;
+    }
+    if (uc->icount) {
+        // the first block refills the decrementer from icount_extra
+        uc->cpu->icount_decr.u32 = 0;
+        uc->cpu->icount_extra = count ? count : INT64_MAX;
     }
 
-    uc->addr_end = until;
+    // translated code depends on the hooks and on @until, so only
+    // reuse the translation cache if these did not change. Hooks deleted
+    // since the last run are dropped first: cpu_restore_state() regenerates
+    // blocks with the current hooks, which must be those they were
+    // translated with.
+    clear_deleted_hooks(uc);
+    if (uc->tb_cache_resize_to) {
+        // this flushes the cache too
+        if (!uc->tb_cache_resize(uc, uc->tb_cache_resize_to))
+            return UC_ERR_NOMEM;
+        uc->tb_cache_resize_to = 0;
+    }
+    if (uc->tb_flush_pending || uc->addr_end != until) {
+        uc->tb_flush(uc);
+        uc->tb_flush_pending = false;
+    }
 
-    if (timeout)
-        enable_emu_timer(uc, timeout * 1000);   // microseconds -> nanoseconds
+    uc->addr_end = until;
 
     if (uc->vm_start(uc)) {
         return UC_ERR_RESOURCE;
@@ -675,14 +936,14 @@ uc_err uc_emu_start(uc_engine* uc, uint64_t begin, uint64_t until, uint64_t time
     // emulation is done
     uc->emulation_done = true;
 
+    // cpu_exec() sets the counter past @count when it stopped on it
+    if (count && uc->emu_counter == 0) {
+        uc->emu_counter = count - uc->cpu->icount_decr.u16.low - uc->cpu->icount_extra;
+    }
+
     // remove hooks to delete
     clear_deleted_hooks(uc);
 
-    if (timeout) {
-        // wait for the timer to finish
-        qemu_thread_join(&uc->timer);
-    }
-
     return uc->invalid_error;
 }
 
@@ -703,34 +964,45 @@ uc_err uc_emu_stop(uc_engine *uc)
     return UC_ERR_OK;
 }
 
+// find the index of the region holding this address in the sorted
+// uc->mapped_blocks, or the index where a region starting there belongs
+uint32_t bsearch_mapped_blocks(const struct uc_struct *uc, uint64_t address)
+{
+    uint32_t left = 0, right = uc->mapped_block_count, mid;
+    MemoryRegion *mr;
+
+    while (left < right) {
+        mid = left + (right - left) / 2;
+        mr = uc->mapped_blocks[mid];
+        if (address > mr->end - 1)
+            left = mid + 1;
+        else if (address < mr->addr)
+            right = mid;
+        else
+            return mid;
+    }
+
+    return left;
+}
+
 // find if a memory range overlaps with existing mapped regions
 static bool memory_overlap(struct uc_struct *uc, uint64_t begin, size_t size)
 {
-    unsigned int i;
+    uint32_t i;
     uint64_t end = begin + size - 1;
 
-    for(i = 0; i < uc->mapped_block_count; i++) {
-        // begin address falls inside this region?
-        if (begin >= uc->mapped_blocks[i]->addr && begin <= uc->mapped_blocks[i]->end - 1)
-            return true;
-
-        // end address falls inside this region?
-        if (end >= uc->mapped_blocks[i]->addr && end <= uc->mapped_blocks[i]->end - 1)
-            return true;
-
-        // this region falls totally inside this range?
-        if (begin < uc->mapped_blocks[i]->addr && end > uc->mapped_blocks[i]->end - 1)
-            return true;
-    }
+    // first region that does not end before this range
+    i = bsearch_mapped_blocks(uc, begin);
 
-    // not found
-    return false;
+    // overlap if it starts within the range
+    return i < uc->mapped_block_count && end >= uc->mapped_blocks[i]->addr;
 }
 
 // common setup/error checking shared between uc_mem_map and uc_mem_map_ptr
 static uc_err mem_map(uc_engine *uc, uint64_t address, size_t size, uint32_t perms, MemoryRegion *block)
 {
     MemoryRegion **regions;
+    uint32_t pos;
 
     if (block == NULL)
         return UC_ERR_NOMEM;
@@ -744,8 +1016,13 @@ static uc_err mem_map(uc_engine *uc, uint64_t address, size_t size, uint32_t per
         uc->mapped_blocks = regions;
     }
 
-    uc->mapped_blocks[uc->mapped_block_count] = block;
+    // keep the regions sorted by address for bsearch_mapped_blocks()
+    pos = bsearch_mapped_blocks(uc, block->addr);
+    memmove(&uc->mapped_blocks[pos + 1], &uc->mapped_blocks[pos],
+            sizeof(MemoryRegion*) * (uc->mapped_block_count - pos));
+    uc->mapped_blocks[pos] = block;
     uc->mapped_block_count++;
+    uc->layout_gen++;
 
     return UC_ERR_OK;
 }
@@ -801,6 +1078,7 @@ uc_err uc_mmio_map(uc_engine *uc, uint64_t address, size_t size, uc_cb_mmio_read
 {
     uc_err res;
     struct mmio_data *data;
+    uint32_t i, count = 0;
 
     if (uc->mem_redirect) {
         address = uc->mem_redirect(address);
@@ -810,9 +1088,24 @@ uc_err uc_mmio_map(uc_engine *uc, uint64_t address, size_t size, uc_cb_mmio_read
     if (res)
         return res;
 
+    // the TLB entries of MMIO hold the number of its region, which must
+    // stay below the page size along with the 4 numbers exec.c reserves
+    for (i = 0; i < uc->mapped_block_count; i++)
+        count += !uc->mapped_blocks[i]->ram;
+    if (count + 4 >= uc->target_page_size)
+        return UC_ERR_NOMEM;
+
     // The callbacks do not need to be checked for NULL here, as their presence
     // (or lack thereof) will determine the permissions used.
-    return mem_map(uc, address, size, UC_PROT_NONE, uc->memory_map_io(uc, address, size, read_cb, write_cb, user_data_write));
+    res = mem_map(uc, address, size, UC_PROT_NONE, uc->memory_map_io(uc, address, size, read_cb, write_cb, user_data_write));
+
+    // cached translations do not check for a stop from MMIO callbacks
+    if (res == UC_ERR_OK && !uc->mmio_mapped) {
+        uc->mmio_mapped = true;
+        uc->tb_flush_pending = true;
+    }
+
+    return res;
 }
 
 UNICORN_EXPORT
@@ -834,6 +1127,195 @@ uc_err uc_mem_map_ptr(uc_engine *uc, uint64_t address, size_t size, uint32_t per
     return mem_map(uc, address, size, UC_PROT_ALL, uc->memory_map_ptr(uc, address, size, perms, ptr));
 }
 
+// the file whose memory the RAM region @mr is in, or NULL
+static struct uc_mapped_file *mem_file_of(uc_engine *uc, MemoryRegion *mr)
+{
+    struct uc_mapped_file *file;
+    uint8_t *host = mr->ram_block->host;
+    uint32_t i;
+
+    for (i = 0; i < uc->mapped_file_count; i++) {
+        file = &uc->mapped_files[i];
+        if (host >= file->host && host < file->host + file->size)
+            return file;
+    }
+
+    return NULL;
+}
+
+// unmap the host memory of the files no region is left in
+static void mem_release_files(uc_engine *uc)
+{
+    struct uc_mapped_file *file;
+    MemoryRegion *mr;
+    uint8_t *host;
+    uint32_t i, j;
+
+    for (i = 0; i < uc->mapped_file_count; ) {
+        file = &uc->mapped_files[i];
+        for (j = 0; j < uc->mapped_block_count; j++) {
+            mr = uc->mapped_blocks[j];
+            host = mr->ram ? mr->ram_block->host : NULL;
+            if (host >= file->host && host < file->host + file->size)
+                break;
+        }
+        if (j < uc->mapped_block_count) {
+            i++;
+            continue;
+        }
+#ifndef _WIN32
+        munmap(file->host, file->size);
+        close(file->fd);
+#endif
+        *file = uc->mapped_files[--uc->mapped_file_count];
+    }
+}
+
+#ifndef _WIN32
+// map @size bytes of the file @fd from @offset at @address, once checked
+static uc_err mem_map_file(uc_engine *uc, uint64_t address, size_t size, uint32_t perms, int fd, uint64_t offset)
+{
+    struct uc_mapped_file *files;
+    struct stat st;
+    uint64_t file_size;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    uint8_t *host;
+    uc_err res;
+
+    if ((offset & (page - 1)) != 0 || fstat(fd, &st) != 0)
+        return UC_ERR_ARG;
+
+    if ((uc->mapped_file_count & (MEM_BLOCK_INCR - 1)) == 0) {  //time to grow
+        files = g_realloc(uc->mapped_files,
+                sizeof(*files) * (uc->mapped_file_count + MEM_BLOCK_INCR));
+        if (files == NULL)
+            return UC_ERR_NOMEM;
+        uc->mapped_files = files;
+    }
+
+    // reserve the whole region, zero past the end of the file, and map the
+    // pages of the file over it: they are read in on first access, and
+    // copied on first write; no swap is set aside for it where the host
+    // lets us say so
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    host = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (host == MAP_FAILED)
+        return UC_ERR_NOMEM;
+
+    file_size = (uint64_t)st.st_size > offset ? (uint64_t)st.st_size - offset : 0;
+    file_size = MIN((file_size + page - 1) & ~(uint64_t)(page - 1), size);
+    if (file_size && mmap(host, (size_t)file_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_FIXED, fd, (off_t)offset) == MAP_FAILED) {
+        munmap(host, size);
+        return UC_ERR_ARG;
+    }
+
+    // kept for the clones, which map the file again
+    fd = dup(fd);
+    if (fd < 0) {
+        munmap(host, size);
+        return UC_ERR_NOMEM;
+    }
+
+    res = mem_map(uc, address, size, UC_PROT_ALL, uc->memory_map_ptr(uc, address, size, perms, host));
+    if (res) {
+        munmap(host, size);
+        close(fd);
+        return res;
+    }
+
+    uc->mapped_files[uc->mapped_file_count].host = host;
+    uc->mapped_files[uc->mapped_file_count].size = size;
+    uc->mapped_files[uc->mapped_file_count].fd = fd;
+    uc->mapped_files[uc->mapped_file_count].offset = offset;
+    uc->mapped_file_count++;
+
+    // no page was written yet: a clone copies none of them
+    uc->file_written(uc, memory_mapping(uc, address), address, size, NULL, 0, false);
+
+    return UC_ERR_OK;
+}
+#endif
+
+UNICORN_EXPORT
+uc_err uc_mem_map_file(uc_engine *uc, uint64_t address, size_t size, uint32_t perms, int fd, uint64_t offset)
+{
+#ifdef _WIN32
+    return UC_ERR_ARG;
+#else
+    uc_err res;
+
+    if (uc->mem_redirect) {
+        address = uc->mem_redirect(address);
+    }
+
+    res = mem_map_check(uc, address, size, perms);
+    if (res)
+        return res;
+
+    return mem_map_file(uc, address, size, perms, fd, offset);
+#endif
+}
+
+// permissions of the page of @address in @mr
+static uint32_t mem_page_perms(struct uc_struct *uc, MemoryRegion *mr, uint64_t address)
+{
+    if (mr->page_perms == NULL)
+        return mr->perms;
+
+    return mr->page_perms[(address - mr->addr) / uc->target_page_size];
+}
+
+// give the pages [address, address + size) of RAM region @mr the permissions
+// @perms, and return the permissions changed on any of them
+static uint32_t mem_set_perms(struct uc_struct *uc, MemoryRegion *mr,
+        uint64_t address, size_t size, uint32_t perms)
+{
+    size_t pages = (size_t)((mr->end - mr->addr) / uc->target_page_size);
+    size_t first = (size_t)((address - mr->addr) / uc->target_page_size);
+    size_t last = first + size / uc->target_page_size, i;
+    uint32_t changed = 0;
+
+    if (mr->page_perms == NULL) {
+        if (mr->perms == perms)
+            return 0;
+        if (last - first == pages) {
+            changed = mr->perms ^ perms;
+            mr->perms = perms;
+            return changed;
+        }
+        mr->page_perms = g_malloc(pages);
+        memset(mr->page_perms, mr->perms, pages);
+    }
+
+    for (i = first; i < last; i++) {
+        changed |= mr->page_perms[i] ^ perms;
+        mr->page_perms[i] = perms;
+    }
+
+    // all the pages alike again
+    if (last - first == pages) {
+        g_free(mr->page_perms);
+        mr->page_perms = NULL;
+        mr->perms = perms;
+    }
+
+    return changed;
+}
+
+// give the pages of RAM region @mr the permissions in @page_perms
+static void mem_copy_perms(struct uc_struct *uc, MemoryRegion *mr, const uint8_t *page_perms)
+{
+    size_t pages = (size_t)((mr->end - mr->addr) / uc->target_page_size);
+
+    g_free(mr->page_perms);
+    mr->page_perms = g_malloc(pages);
+    memcpy(mr->page_perms, page_perms, pages);
+}
+
 // Create a backup copy of the indicated MemoryRegion.
 // Generally used in prepartion for splitting a MemoryRegion.
 static uint8_t *copy_region(struct uc_struct *uc, MemoryRegion *mr)
@@ -854,7 +1336,9 @@ static uint8_t *copy_region(struct uc_struct *uc, MemoryRegion *mr)
    Split the given MemoryRegion at the indicated address for the indicated size
    this may result in the create of up to 3 spanning sections. If the delete
    parameter is true, the no new section will be created to replace the indicate
-   range. This functions exists to support uc_mem_protect and uc_mem_unmap.
+   range. This functions exists to support uc_mem_unmap: uc_mem_protect
+   changes the permissions of pages in place. The pieces keep the
+   permissions of their pages.
 
    This is a static function and callers have already done some preliminary
    parameter validation.
@@ -872,8 +1356,9 @@ static bool split_region(struct uc_struct *uc, MemoryRegion *mr, uint64_t addres
     uint32_t perms;
     uint64_t begin, end, chunk_end;
     size_t l_size, m_size, r_size;
-    RAMBlock *block = NULL;
+    RAMBlock *block;
     bool prealloc = false;
+    uint8_t *page_perms, *written = NULL;
 
     chunk_end = address + size;
 
@@ -890,21 +1375,20 @@ static bool split_region(struct uc_struct *uc, MemoryRegion *mr, uint64_t addres
         // impossible case
         return false;
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (block->offset <= mr->addr && block->length >= (mr->end - mr->addr)) {
-            break;
-        }
-    }
-
-    if (block == NULL)
+    if (!mr->ram)
         return false;
 
-    // RAM_PREALLOC is not defined outside exec.c and I didn't feel like
-    // moving it
-	prealloc = !!(block->flags & 1);
+    block = mr->ram_block;
+
+    prealloc = uc->memory_region_is_prealloc(mr);
 
-    if (block->flags & 1) {
+    if (prealloc) {
         backup = block->host;
+        // the pieces of a file mapping keep track of the pages written
+        if (mem_file_of(uc, mr) != NULL) {
+            written = g_malloc0((size_t)((mr->end - mr->addr) / uc->target_page_size / 8 + 1));
+            uc->file_written(uc, mr, mr->addr, (size_t)(mr->end - mr->addr), written, 0, true);
+        }
     } else {
         backup = copy_region(uc, mr);
         if (backup == NULL)
@@ -913,12 +1397,14 @@ static bool split_region(struct uc_struct *uc, MemoryRegion *mr, uint64_t addres
 
     // save the essential information required for the split before mr gets deleted
     perms = mr->perms;
+    page_perms = mr->page_perms;
+    mr->page_perms = NULL;
     begin = mr->addr;
     end = mr->end;
 
-    // unmap this region first, then do split it later
-    if (uc_mem_unmap(uc, mr->addr, (size_t)int128_get64(mr->size)) != UC_ERR_OK)
-        goto error;
+    // unmap this region first, then do split it later; not with
+    // uc_mem_unmap(), which would release the memory of a mapped file
+    uc->memory_unmap(uc, mr);
 
     /* overlapping cases
      *               |------mr------|
@@ -951,7 +1437,11 @@ static bool split_region(struct uc_struct *uc, MemoryRegion *mr, uint64_t addres
         } else {
             if (uc_mem_map_ptr(uc, begin, l_size, perms, backup) != UC_ERR_OK)
                 goto error;
+            if (written)
+                uc->file_written(uc, memory_mapping(uc, begin), begin, l_size, written, 0, false);
         }
+        if (page_perms)
+            mem_copy_perms(uc, memory_mapping(uc, begin), page_perms);
     }
 
     if (m_size > 0 && !do_delete) {
@@ -963,7 +1453,13 @@ static bool split_region(struct uc_struct *uc, MemoryRegion *mr, uint64_t addres
         } else {
             if (uc_mem_map_ptr(uc, address, m_size, perms, backup + l_size) != UC_ERR_OK)
                 goto error;
+            if (written)
+                uc->file_written(uc, memory_mapping(uc, address), address, m_size, written,
+                        l_size / uc->target_page_size, false);
         }
+        if (page_perms)
+            mem_copy_perms(uc, memory_mapping(uc, address),
+                    page_perms + l_size / uc->target_page_size);
     }
 
     if (r_size > 0) {
@@ -975,16 +1471,26 @@ static bool split_region(struct uc_struct *uc, MemoryRegion *mr, uint64_t addres
         } else {
             if (uc_mem_map_ptr(uc, chunk_end, r_size, perms, backup + l_size + m_size) != UC_ERR_OK)
                 goto error;
+            if (written)
+                uc->file_written(uc, memory_mapping(uc, chunk_end), chunk_end, r_size, written,
+                        (l_size + m_size) / uc->target_page_size, false);
         }
+        if (page_perms)
+            mem_copy_perms(uc, memory_mapping(uc, chunk_end),
+                    page_perms + (l_size + m_size) / uc->target_page_size);
     }
 
     if (!prealloc)
         free(backup);
+    g_free(page_perms);
+    g_free(written);
     return true;
 
 error:
     if (!prealloc)
         free(backup);
+    g_free(page_perms);
+    g_free(written);
     return false;
 }
 
@@ -994,7 +1500,7 @@ uc_err uc_mem_protect(struct uc_struct *uc, uint64_t address, size_t size, uint3
     MemoryRegion *mr;
     uint64_t addr = address;
     size_t count, len;
-    bool remove_exec = false;
+    uint32_t changed = 0;
 
     if (size == 0)
         // trivial case, no change
@@ -1020,34 +1526,60 @@ uc_err uc_mem_protect(struct uc_struct *uc, uint64_t address, size_t size, uint3
     if (!check_mem_area(uc, address, size))
         return UC_ERR_NOMEM;
 
-    // Now we know entire region is mapped, so change permissions
-    // We may need to split regions if this area spans adjacent regions
+    // MMIO regions are protected as a whole: check them all before any
+    // permission changes, so that a failure leaves the map as it was
     addr = address;
     count = 0;
     while(count < size) {
         mr = memory_mapping(uc, addr);
         len = (size_t)MIN(size - count, mr->end - addr);
-        if (!split_region(uc, mr, addr, len, false))
+        if (!mr->ram && (addr != mr->addr || len != mr->end - mr->addr))
             return UC_ERR_NOMEM;
 
-        mr = memory_mapping(uc, addr);
-        // will this remove EXEC permission?
-        if (((mr->perms & UC_PROT_EXEC) != 0) && ((perms & UC_PROT_EXEC) == 0))
-            remove_exec = true;
-        mr->perms = perms;
-        uc->readonly_mem(mr, (perms & UC_PROT_WRITE) == 0);
-
         count += len;
         addr += len;
     }
 
-    // if EXEC permission is removed, then quit TB and continue at the same place
-    if (remove_exec) {
-        uc->quit_request = true;
-        uc_emu_stop(uc);
-    }
+    uc->layout_gen++;
 
-    return UC_ERR_OK;
+    // Now we know entire region is mapped, so change permissions
+    // The pages of RAM regions have their own permissions, checked when
+    // the TLB is filled, so the regions are neither split nor copied
+    addr = address;
+    count = 0;
+    while(count < size) {
+        mr = memory_mapping(uc, addr);
+        len = (size_t)MIN(size - count, mr->end - addr);
+        if (mr->ram) {
+            changed |= mem_set_perms(uc, mr, addr, len, perms);
+        } else {
+            changed |= mr->perms ^ perms;
+            mr->perms = perms;
+            uc->readonly_mem(mr, (perms & UC_PROT_WRITE) == 0);
+        }
+
+        count += len;
+        addr += len;
+    }
+
+    // TLB entries only exist for readable pages and let through writes to
+    // writable ones and fetches from executable ones, drop the stale ones
+    if (changed & (UC_PROT_READ | UC_PROT_WRITE | UC_PROT_EXEC)) {
+        if (uc->mem_batch_depth)
+            uc->mem_batch_tlb_flush = true;
+        else
+            uc->uc_tlb_flush(uc);
+    }
+
+    // if EXEC permission is removed, then quit TB and continue at the same place
+    if ((changed & UC_PROT_EXEC) && !(perms & UC_PROT_EXEC)) {
+        // cached code of this area must be fetched again to fault
+        uc->uc_invalidate_tb(uc, address, size);
+        uc->quit_request = true;
+        uc_emu_stop(uc);
+    }
+
+    return UC_ERR_OK;
 }
 
 UNICORN_EXPORT
@@ -1077,6 +1609,8 @@ uc_err uc_mem_unmap(struct uc_struct *uc, uint64_t address, size_t size)
     if (!check_mem_area(uc, address, size))
         return UC_ERR_NOMEM;
 
+    uc->layout_gen++;
+
     // Now we know entire region is mapped, so do the unmap
     // We may need to split regions if this area spans adjacent regions
     addr = address;
@@ -1096,6 +1630,39 @@ uc_err uc_mem_unmap(struct uc_struct *uc, uint64_t address, size_t size)
         addr += len;
     }
 
+    // the regions unmapped in a batch are freed on its commit
+    if (uc->mapped_file_count && !uc->mem_batch_depth)
+        mem_release_files(uc);
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_mem_batch_begin(uc_engine *uc)
+{
+    if (uc->mem_batch_depth++ == 0)
+        uc->memory_batch(uc, true);
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_mem_batch_commit(uc_engine *uc)
+{
+    if (uc->mem_batch_depth == 0)
+        return UC_ERR_ARG;
+
+    if (--uc->mem_batch_depth == 0) {
+        // rebuilds the flat view, and flushes the TLB if it changed
+        uc->memory_batch(uc, false);
+        if (uc->mem_batch_tlb_flush) {
+            uc->mem_batch_tlb_flush = false;
+            uc->uc_tlb_flush(uc);
+        }
+        if (uc->mapped_file_count)
+            mem_release_files(uc);
+    }
+
     return UC_ERR_OK;
 }
 
@@ -1117,12 +1684,12 @@ MemoryRegion *memory_mapping(struct uc_struct* uc, uint64_t address)
     if (i < uc->mapped_block_count && address >= uc->mapped_blocks[i]->addr && address < uc->mapped_blocks[i]->end)
         return uc->mapped_blocks[i];
 
-    for(i = 0; i < uc->mapped_block_count; i++) {
-        if (address >= uc->mapped_blocks[i]->addr && address <= uc->mapped_blocks[i]->end - 1) {
-            // cache this index for the next query
-            uc->mapped_block_cache_index = i;
-            return uc->mapped_blocks[i];
-        }
+    i = bsearch_mapped_blocks(uc, address);
+
+    if (i < uc->mapped_block_count && address >= uc->mapped_blocks[i]->addr) {
+        // cache this index for the next query
+        uc->mapped_block_cache_index = i;
+        return uc->mapped_blocks[i];
     }
 
     // not found
@@ -1177,7 +1744,9 @@ uc_err uc_hook_add(uc_engine *uc, uc_hook *hh, int type, void *callback,
             }
         }
 
+        hook_table_invalidate(uc, UC_HOOK_INSN_IDX);
         hook->refs++;
+        uc->layout_gen++;
         return UC_ERR_OK;
     }
 
@@ -1200,12 +1769,21 @@ uc_err uc_hook_add(uc_engine *uc, uc_hook *hh, int type, void *callback,
                         return UC_ERR_NOMEM;
                     }
                 }
+                hook_table_invalidate(uc, i);
                 hook->refs++;
             }
         }
         i++;
     }
 
+    // cached translations were generated without this hook
+    if (hook->refs > 0 && (type & UC_HOOK_TB_MASK)) {
+        uc->tb_flush_pending = true;
+    }
+    if (hook->refs > 0) {
+        uc->layout_gen++;
+    }
+
     // we didn't use the hook
     // TODO: return an error?
     if (hook->refs == 0) {
@@ -1231,6 +1809,10 @@ uc_err uc_hook_del(uc_engine *uc, uc_hook hh)
         if (list_exists(&uc->hook[i], (void *) hook)) {
             hook->to_delete = true;
             list_append(&uc->hooks_to_del, hook);
+            hook_table_invalidate(uc, i);
+            uc->layout_gen++;
+            if ((1 << i) & UC_HOOK_TB_MASK)
+                uc->tb_flush_pending = true;
         }
     }
 
@@ -1242,7 +1824,7 @@ void helper_uc_tracecode(int32_t size, uc_hook_type type, void *handle, int64_t
 void helper_uc_tracecode(int32_t size, uc_hook_type type, void *handle, int64_t address)
 {
     struct uc_struct *uc = handle;
-    struct list_item *cur;
+    struct hook_iter it;
     struct hook *hook;
 
     // sync PC in CPUArchState with address
@@ -1250,22 +1832,47 @@ void helper_uc_tracecode(int32_t size, uc_hook_type type, void *handle, int64_t
         uc->set_pc(uc, address);
     }
 
-    for (cur = uc->hook[type].head; cur != NULL && (hook = (struct hook *)cur->data); cur = cur->next) {
+    hook_iter_start(uc, type, (uint64_t)address, &it);
+    while ((hook = hook_iter_next(&it)) != NULL) {
+        // a callback may delete the hooks that follow it
         if (hook->to_delete)
             continue;
-        if (HOOK_BOUND_CHECK(hook, (uint64_t)address)) {
-            ((uc_cb_hookcode_t)hook->callback)(uc, address, size, hook->user_data);
+        ((uc_cb_hookcode_t)hook->callback)(uc, address, size, hook->user_data);
+    }
+}
+
+// list in @r, if not NULL, the runs of pages of @mr with the same
+// permissions, and return their number
+static uint32_t mem_perms_runs(struct uc_struct *uc, MemoryRegion *mr, uc_mem_region *r)
+{
+    uint64_t addr, run;
+    uint32_t n = 0, perms;
+
+    for (addr = mr->addr; addr < mr->end; addr = run, n++) {
+        perms = mem_page_perms(uc, mr, addr);
+        run = mr->page_perms ? addr + uc->target_page_size : mr->end;
+        while (run < mr->end && mem_page_perms(uc, mr, run) == perms)
+            run += uc->target_page_size;
+        if (r) {
+            r[n].begin = addr;
+            r[n].end = run - 1;
+            r[n].perms = perms;
         }
     }
+
+    return n;
 }
 
 UNICORN_EXPORT
 uint32_t uc_mem_regions(uc_engine *uc, uc_mem_region **regions, uint32_t *count)
 {
-    uint32_t i;
+    uint32_t i, n;
     uc_mem_region *r = NULL;
 
-    *count = uc->mapped_block_count;
+    // pages of a region with other permissions are listed apart
+    *count = 0;
+    for (i = 0; i < uc->mapped_block_count; i++)
+        *count += mem_perms_runs(uc, uc->mapped_blocks[i], NULL);
 
     if (*count) {
         r = g_malloc0(*count * sizeof(uc_mem_region));
@@ -1275,11 +1882,8 @@ uint32_t uc_mem_regions(uc_engine *uc, uc_mem_region **regions, uint32_t *count)
         }
     }
 
-    for (i = 0; i < *count; i++) {
-        r[i].begin = uc->mapped_blocks[i]->addr;
-        r[i].end = uc->mapped_blocks[i]->end - 1;
-        r[i].perms = uc->mapped_blocks[i]->perms;
-    }
+    for (i = 0, n = 0; i < uc->mapped_block_count; i++)
+        n += mem_perms_runs(uc, uc->mapped_blocks[i], r + n);
 
     *regions = r;
 
@@ -1289,6 +1893,8 @@ uint32_t uc_mem_regions(uc_engine *uc, uc_mem_region **regions, uint32_t *count)
 UNICORN_EXPORT
 uc_err uc_query(uc_engine *uc, uc_query_type type, size_t *result)
 {
+    size_t size, used, flushes;
+
     switch(type) {
         default:
             return UC_ERR_ARG;
@@ -1313,11 +1919,62 @@ uc_err uc_query(uc_engine *uc, uc_query_type type, size_t *result)
         case UC_QUERY_TIMEOUT:
             *result = uc->timed_out;
             break;
+
+        case UC_QUERY_TIMEOUT_PRECISION:
+            *result = uc->timeout_overrun / 1000;  // nanoseconds -> microseconds
+            break;
+
+        case UC_QUERY_TB_REUSED:
+            *result = uc->tb_reused;
+            break;
+
+        case UC_QUERY_TB_TRANSLATED:
+            *result = uc->tb_translated;
+            break;
+
+        case UC_QUERY_TB_CACHE_SIZE:
+            uc->tb_cache_query(uc, result, &used, &flushes);
+            break;
+
+        case UC_QUERY_TB_CACHE_USED:
+            uc->tb_cache_query(uc, &size, result, &flushes);
+            break;
+
+        case UC_QUERY_TB_FLUSHES:
+            uc->tb_cache_query(uc, &size, &used, result);
+            break;
     }
 
     return UC_ERR_OK;
 }
 
+UNICORN_EXPORT
+uc_err uc_tb_cache_resize(uc_engine *uc, size_t size, size_t max_size)
+{
+    size_t used, flushes;
+
+    if (max_size == 0 || size > max_size)
+        return UC_ERR_ARG;
+
+    // clones of this engine get its sizes
+    uc->layout_gen++;
+
+    uc->tb_cache_max = max_size;
+    if (size == 0) {
+        // keep the current size, unless it is above the new maximum
+        if (uc->tb_cache_resize_to)
+            size = uc->tb_cache_resize_to;
+        else
+            uc->tb_cache_query(uc, &size, &used, &flushes);
+        if (size <= max_size)
+            return UC_ERR_OK;
+        size = max_size;
+    }
+    uc->tb_cache_resize_to = size;
+
+    return UC_ERR_OK;
+}
+
 static size_t cpu_context_size(uc_arch arch, uc_mode mode)
 {
     // each of these constants is defined by offsetof(CPUXYZState, tlb_table)
@@ -1430,3 +2087,502 @@ uc_err uc_context_free(uc_context *context)
     }
     return uc_free(context);
 }
+
+UNICORN_EXPORT
+uc_err uc_snapshot_take(uc_engine *uc, uc_snapshot **snapshot)
+{
+    struct uc_snapshot *snap;
+    struct uc_snapshot_region *region;
+    MemoryRegion *mr;
+    uint32_t i;
+    size_t pages;
+
+    snap = calloc(1, sizeof(*snap));
+    if (snap == NULL)
+        return UC_ERR_NOMEM;
+
+    snap->regions = calloc(uc->mapped_block_count + 1, sizeof(*snap->regions));
+    if (snap->regions == NULL || uc_context_alloc(uc, &snap->context) != UC_ERR_OK)
+        goto error;
+
+    for (i = 0; i < uc->mapped_block_count; i++) {
+        mr = uc->mapped_blocks[i];
+        if (!mr->ram)
+            continue;
+        region = &snap->regions[snap->region_count];
+        region->begin = mr->addr;
+        region->end = mr->end - 1;
+        region->perms = mr->perms;
+        region->data = malloc((size_t)(mr->end - mr->addr));
+        if (region->data == NULL)
+            goto error;
+        snap->region_count++;
+        if (mr->page_perms) {
+            pages = (size_t)((mr->end - mr->addr) / uc->target_page_size);
+            region->page_perms = malloc(pages);
+            if (region->page_perms == NULL)
+                goto error;
+            memcpy(region->page_perms, mr->page_perms, pages);
+        }
+        uc->snapshot_save(uc, mr, region->data);
+    }
+    uc_context_save(uc, snap->context);
+
+    snap->uc = uc;
+    if (!list_insert(&uc->snapshots, snap)) {
+        snap->uc = NULL;
+        goto error;
+    }
+    uc->snapshot = snap;
+    // the written pages are now tracked against the snapshot
+    uc->layout_gen++;
+    *snapshot = snap;
+
+    return UC_ERR_OK;
+
+error:
+    uc_snapshot_free(snap);
+    return UC_ERR_NOMEM;
+}
+
+// permissions of the page of @address in the saved @region
+static uint32_t snapshot_page_perms(struct uc_struct *uc,
+        struct uc_snapshot_region *region, uint64_t address)
+{
+    if (region->page_perms == NULL)
+        return region->perms;
+
+    return region->page_perms[(address - region->begin) / uc->target_page_size];
+}
+
+// give the pages [address, address + len) of @mr the permissions they have
+// in the saved @region
+static uc_err snapshot_restore_perms(struct uc_struct *uc,
+        struct uc_snapshot_region *region, MemoryRegion *mr, uint64_t address, size_t len)
+{
+    uint64_t end = address + len, run;
+    uint32_t perms;
+    bool changed;
+
+    if (region->page_perms == NULL && mr->page_perms == NULL) {
+        if (mr->perms != region->perms)
+            return uc_mem_protect(uc, address, len, region->perms);
+        return UC_ERR_OK;
+    }
+
+    while (address < end) {
+        perms = snapshot_page_perms(uc, region, address);
+        changed = false;
+        for (run = address; run < end && snapshot_page_perms(uc, region, run) == perms;
+                run += uc->target_page_size)
+            changed |= mem_page_perms(uc, mr, run) != perms;
+        if (changed && uc_mem_protect(uc, address, (size_t)(run - address), perms) != UC_ERR_OK)
+            return UC_ERR_NOMEM;
+        address = run;
+    }
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_snapshot_restore(uc_engine *uc, uc_snapshot *snapshot)
+{
+    struct uc_snapshot_region *region;
+    MemoryRegion *mr;
+    uint64_t addr;
+    size_t size, count, len;
+    bool all = uc->snapshot != snapshot;
+    uint32_t i;
+
+    // check that all saved regions are still mapped
+    for (i = 0; i < snapshot->region_count; i++) {
+        region = &snapshot->regions[i];
+        if (!check_mem_area(uc, region->begin, (size_t)(region->end - region->begin + 1)))
+            return UC_ERR_MAP;
+    }
+
+    for (i = 0; i < snapshot->region_count; i++) {
+        region = &snapshot->regions[i];
+        size = (size_t)(region->end - region->begin + 1);
+        addr = region->begin;
+        count = 0;
+        while (count < size) {
+            mr = memory_mapping(uc, addr);
+            len = (size_t)MIN(size - count, mr->end - addr);
+            if (snapshot_restore_perms(uc, region, mr, addr, len) != UC_ERR_OK)
+                return UC_ERR_NOMEM;
+            if (mr->ram)
+                uc->snapshot_reset(uc, mr, addr, len, region->data + count, all, NULL);
+            count += len;
+            addr += len;
+        }
+    }
+
+    uc_context_restore(uc, snapshot->context);
+    uc->snapshot = snapshot;
+    uc->layout_gen++;
+    uc->content_gen++;
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_snapshot_free(uc_snapshot *snapshot)
+{
+    uc_engine *uc = snapshot->uc;
+    uint32_t i;
+
+    // if uc is NULL, it means that uc_engine has been free-ed.
+    if (uc) {
+        list_remove(&uc->snapshots, snapshot);
+        if (uc->snapshot == snapshot)
+            uc->snapshot = NULL;
+    }
+    for (i = 0; i < snapshot->region_count; i++) {
+        free(snapshot->regions[i].data);
+        free(snapshot->regions[i].page_perms);
+    }
+    free(snapshot->regions);
+    if (snapshot->context)
+        uc_context_free(snapshot->context);
+    free(snapshot);
+
+    return UC_ERR_OK;
+}
+
+// add (@add) or remove guest memory [begin, end) to the ranges whose written
+// pages are logged, keeping them sorted and apart
+static bool dirty_ranges_update(struct uc_struct *uc, uint64_t begin, uint64_t end, bool add)
+{
+    struct uc_dirty_range *ranges, *r;
+    uint32_t i, count = 0;
+    bool done = !add;
+
+    ranges = malloc((uc->dirty_range_count + 1) * sizeof(*ranges));
+    if (ranges == NULL)
+        return false;
+
+    for (i = 0; i < uc->dirty_range_count; i++) {
+        r = &uc->dirty_ranges[i];
+        if (add) {
+            if (r->end < begin) {
+                ranges[count++] = *r;
+            } else if (r->begin > end) {
+                if (!done) {
+                    ranges[count].begin = begin;
+                    ranges[count++].end = end;
+                    done = true;
+                }
+                ranges[count++] = *r;
+            } else {
+                // overlapping or adjacent: merge into the new range
+                begin = MIN(begin, r->begin);
+                end = MAX(end, r->end);
+            }
+        } else {
+            if (r->end <= begin || r->begin >= end) {
+                ranges[count++] = *r;
+                continue;
+            }
+            if (r->begin < begin) {
+                ranges[count].begin = r->begin;
+                ranges[count++].end = begin;
+            }
+            if (r->end > end) {
+                ranges[count].begin = end;
+                ranges[count++].end = r->end;
+            }
+        }
+    }
+    if (!done) {
+        ranges[count].begin = begin;
+        ranges[count++].end = end;
+    }
+
+    free(uc->dirty_ranges);
+    uc->dirty_ranges = ranges;
+    uc->dirty_range_count = count;
+    return true;
+}
+
+// first RAM region mapped in guest memory [*address, end), with *address moved
+// to where it starts in the range and *len set to its length there
+static MemoryRegion *next_ram_region(struct uc_struct *uc, uint64_t *address,
+        uint64_t end, size_t *len)
+{
+    uint32_t i;
+    MemoryRegion *mr;
+
+    if (*address >= end)
+        return NULL;
+
+    for (i = bsearch_mapped_blocks(uc, *address); i < uc->mapped_block_count; i++) {
+        mr = uc->mapped_blocks[i];
+        if (mr->addr >= end)
+            break;
+        if (!mr->ram)
+            continue;
+        *address = MAX(*address, mr->addr);
+        *len = (size_t)(MIN(end, mr->end) - *address);
+        return mr;
+    }
+
+    return NULL;
+}
+
+UNICORN_EXPORT
+uc_err uc_mem_dirty_log_start(uc_engine *uc, uint64_t address, size_t size)
+{
+    MemoryRegion *mr;
+    uint64_t addr, end;
+    size_t len;
+
+    if (size == 0)
+        return UC_ERR_OK;
+
+    // address and size must be aligned to uc->target_page_size
+    if ((address & uc->target_page_align) != 0 || (size & uc->target_page_align) != 0)
+        return UC_ERR_ARG;
+
+    if (uc->mem_redirect) {
+        address = uc->mem_redirect(address);
+    }
+
+    // check that user's entire requested block is mapped
+    if (!check_mem_area(uc, address, size))
+        return UC_ERR_NOMEM;
+
+    end = address + size;
+    if (!dirty_ranges_update(uc, address, end, true))
+        return UC_ERR_NOMEM;
+
+    // a clone is not handed out again with the pages it logs
+    uc->layout_gen++;
+
+    addr = address;
+    while ((mr = next_ram_region(uc, &addr, end, &len)) != NULL) {
+        uc->dirty_log_enable(uc, mr, addr, len, true);
+        addr += len;
+    }
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_mem_dirty_log_stop(uc_engine *uc, uint64_t address, size_t size)
+{
+    MemoryRegion *mr;
+    uint64_t addr, end;
+    size_t len;
+
+    if (size == 0)
+        return UC_ERR_OK;
+
+    // address and size must be aligned to uc->target_page_size
+    if ((address & uc->target_page_align) != 0 || (size & uc->target_page_align) != 0)
+        return UC_ERR_ARG;
+
+    if (uc->mem_redirect) {
+        address = uc->mem_redirect(address);
+    }
+
+    end = address + size;
+    if (!dirty_ranges_update(uc, address, end, false))
+        return UC_ERR_NOMEM;
+
+    uc->layout_gen++;
+
+    addr = address;
+    while ((mr = next_ram_region(uc, &addr, end, &len)) != NULL) {
+        uc->dirty_log_enable(uc, mr, addr, len, false);
+        addr += len;
+    }
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_mem_dirty_log_get(uc_engine *uc, uint64_t address, size_t size,
+        uint8_t *bitmap, bool clear)
+{
+    struct uc_dirty_range *r;
+    MemoryRegion *mr;
+    uint64_t addr, end;
+    size_t len;
+    uint32_t i;
+
+    // address and size must be aligned to uc->target_page_size
+    if ((address & uc->target_page_align) != 0 || (size & uc->target_page_align) != 0)
+        return UC_ERR_ARG;
+
+    memset(bitmap, 0, (size / uc->target_page_size + 7) / 8);
+
+    if (uc->mem_redirect) {
+        address = uc->mem_redirect(address);
+    }
+
+    for (i = 0; i < uc->dirty_range_count; i++) {
+        r = &uc->dirty_ranges[i];
+        if (r->end <= address || r->begin >= address + size)
+            continue;
+        addr = MAX(address, r->begin);
+        end = MIN(address + size, r->end);
+        while ((mr = next_ram_region(uc, &addr, end, &len)) != NULL) {
+            uc->dirty_log_sync(uc, mr, addr, len, bitmap,
+                    (addr - address) / uc->target_page_size, clear);
+            addr += len;
+        }
+    }
+
+    return UC_ERR_OK;
+}
+
+// copy into @clone the memory and the registers of @uc, which it was cloned
+// from. Only the pages written since the last reset are copied, unless @all
+// is set: the memory of @uc itself may have changed since then.
+static void clone_reset(struct uc_struct *uc, struct uc_struct *clone, bool all)
+{
+    MemoryRegion *mr, *cmr;
+    RAMBlock *block;
+    uint8_t *pages;
+    size_t size;
+    uint32_t i;
+
+    for (i = 0; i < uc->mapped_block_count; i++) {
+        mr = uc->mapped_blocks[i];
+        if (!mr->ram)
+            continue;
+        block = mr->ram_block;
+        cmr = memory_mapping(clone, mr->addr);
+        size = (size_t)(mr->end - mr->addr);
+        if (all && mem_file_of(uc, mr) != NULL) {
+            // the clone maps the same file: the pages neither wrote match
+            pages = g_malloc0(size / uc->target_page_size / 8 + 1);
+            uc->file_written(uc, mr, mr->addr, size, pages, 0, true);
+            clone->file_written(clone, cmr, mr->addr, size, pages, 0, true);
+            clone->snapshot_reset(clone, cmr, mr->addr, size, block->host, false, pages);
+            g_free(pages);
+            continue;
+        }
+        // memory of uc_mem_map_ptr() is written behind our back: copy it all
+        clone->snapshot_reset(clone, cmr, mr->addr, size, block->host,
+                all || uc->memory_region_is_prealloc(mr), NULL);
+    }
+
+    memcpy(clone->cpu->env_ptr, uc->cpu->env_ptr, cpu_context_size(uc->arch, uc->mode));
+    if (clone->context_copied)
+        clone->context_copied(clone);
+    clone->cpu->halted = uc->cpu->halted;
+    clone->thumb = uc->thumb;
+    clone->uc_tlb_flush(clone);
+
+    clone->clone_template = uc;
+    clone->clone_layout_gen = clone->layout_gen;
+    clone->template_layout_gen = uc->layout_gen;
+    clone->template_content_gen = uc->content_gen;
+}
+
+// create a clone of @uc with the same memory mappings and hooks
+static uc_err clone_new(struct uc_struct *uc, struct uc_struct **result)
+{
+    struct uc_struct *clone;
+    struct list_item *cur;
+    struct hook *hook;
+    struct uc_mapped_file *file;
+    MemoryRegion *mr, *cmr;
+    uc_hook hh;
+    uc_err err;
+    uint32_t i;
+
+    err = uc_open(uc->arch, uc->mode, &clone);
+    if (err)
+        return err;
+    clone->tb_cache_max = uc->tb_cache_max;
+
+    for (i = 0; err == UC_ERR_OK && i < uc->mapped_block_count; i++) {
+        mr = uc->mapped_blocks[i];
+        if (mr->ram) {
+            // memory of a file is mapped from it again; if it cannot be,
+            // every page of it is copied
+            file = mem_file_of(uc, mr);
+            err = UC_ERR_ARG;
+#ifndef _WIN32
+            if (file != NULL)
+                err = mem_map_file(clone, mr->addr, (size_t)(mr->end - mr->addr), mr->perms,
+                        file->fd, file->offset + (uint64_t)(mr->ram_block->host - file->host));
+#endif
+            if (err != UC_ERR_OK)
+                err = uc_mem_map(clone, mr->addr, (size_t)(mr->end - mr->addr), mr->perms);
+            if (err == UC_ERR_OK && mr->page_perms)
+                mem_copy_perms(clone, memory_mapping(clone, mr->addr), mr->page_perms);
+        } else {
+            err = uc_mmio_map(clone, mr->addr, (size_t)(mr->end - mr->addr),
+                    mr->ops->read, mr->opaque, mr->ops->write, mr->opaque);
+            // the callbacks only give the permissions the region was mapped with
+            if (err == UC_ERR_OK) {
+                cmr = memory_mapping(clone, mr->addr);
+                cmr->perms = mr->perms;
+                clone->readonly_mem(cmr, (mr->perms & UC_PROT_WRITE) == 0);
+            }
+        }
+    }
+
+    // hooks of several types are added once per type, in the order of each list
+    for (i = 0; err == UC_ERR_OK && i < UC_HOOK_MAX; i++) {
+        for (cur = uc->hook[i].head; err == UC_ERR_OK && cur != NULL; cur = cur->next) {
+            hook = (struct hook *)cur->data;
+            if (hook->to_delete)
+                continue;
+            err = uc_hook_add(clone, &hh, i == UC_HOOK_INSN_IDX ? UC_HOOK_INSN : (1 << i),
+                    hook->callback, hook->user_data, hook->begin, hook->end, hook->insn);
+        }
+    }
+    clone->hook_insert = uc->hook_insert;
+
+    if (err) {
+        uc_close(clone);
+        return err;
+    }
+
+    *result = clone;
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_clone(uc_engine *uc, uc_engine **result)
+{
+    struct uc_struct *clone = NULL;
+    uc_err err;
+    bool all = true;
+
+    // the spares were reset from an older state of uc: they can be reused
+    // as long as the memory map and the hooks did not change
+    while (clone == NULL && uc->clones_spare.head != NULL) {
+        clone = (struct uc_struct *)uc->clones_spare.head->data;
+        list_remove(&uc->clones_spare, clone);
+        if (clone->template_layout_gen != uc->layout_gen) {
+            clone->clone_template = NULL;
+            uc_close(clone);
+            clone = NULL;
+        } else {
+            all = clone->template_content_gen != uc->content_gen;
+        }
+    }
+
+    if (clone == NULL) {
+        err = clone_new(uc, &clone);
+        if (err)
+            return err;
+        all = true;
+    }
+
+    if (list_append(&uc->clones, clone) == NULL) {
+        clone->clone_template = NULL;
+        uc_close(clone);
+        return UC_ERR_NOMEM;
+    }
+    clone_reset(uc, clone, all);
+    *result = clone;
+
+    return UC_ERR_OK;
+}